@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Symbolize a sampling-profiler dump ("prof dump" on the serial console).
+
+Host-side tool, not a PlatformIO build script. Usage:
+
+    pio device monitor | tee prof.log        # then type: prof start, ..., prof dump
+    python extra_scripts/profile_report.py prof.log
+    python extra_scripts/profile_report.py prof.log --folded prof.folded
+    flamegraph.pl prof.folded > prof.svg     # or load prof.folded in speedscope.app
+
+The ELF defaults to the newest .pio/build/*/*.elf; addr2line is looked up on
+PATH and in the PlatformIO toolchain packages.
+"""
+import argparse
+import collections
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+SAMPLE_RE = re.compile(r"\bP ([0-9]) 0x([0-9a-fA-F]{8}) 0x([0-9a-fA-F]{8})")
+ADDR2LINE = "xtensa-esp32s3-elf-addr2line"
+
+
+def find_elf():
+    elfs = glob.glob(os.path.join(".pio", "build", "*", "*.elf"))
+    return max(elfs, key=os.path.getmtime) if elfs else None
+
+
+def find_addr2line():
+    path = shutil.which(ADDR2LINE)
+    if path:
+        return path
+    pio_home = os.path.expanduser(os.path.join("~", ".platformio", "packages"))
+    hits = glob.glob(os.path.join(pio_home, "toolchain-xtensa*", "bin", ADDR2LINE + "*"))
+    return hits[0] if hits else None
+
+
+def read_samples(path):
+    samples = []
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = SAMPLE_RE.search(line)
+            if m:
+                samples.append((int(m.group(1)), int(m.group(2), 16), int(m.group(3), 16)))
+    return samples
+
+
+def symbolize(addrs, elf, addr2line):
+    """Map each address to a function name in one addr2line run."""
+    addrs = sorted(a for a in addrs if a)
+    names = {0: "[interrupt]"}
+    if not addrs:
+        return names
+    out = subprocess.run(
+        [addr2line, "-f", "-C", "-e", elf] + ["0x%08x" % a for a in addrs],
+        check=True, capture_output=True, text=True,
+    ).stdout.splitlines()
+    for i, addr in enumerate(addrs):
+        func = out[2 * i] if 2 * i < len(out) else "??"
+        names[addr] = func if func != "??" else "0x%08x" % addr
+    return names
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("log", help="serial log containing a 'prof dump'")
+    ap.add_argument("--elf", default=None, help="firmware ELF (default: newest .pio/build/*/*.elf)")
+    ap.add_argument("--addr2line", default=None, help="path to xtensa-esp32s3-elf-addr2line")
+    ap.add_argument("--folded", default=None, help="write collapsed stacks for flamegraph.pl / speedscope")
+    ap.add_argument("--top", type=int, default=30, help="rows in the flat profile")
+    args = ap.parse_args()
+
+    samples = read_samples(args.log)
+    if not samples:
+        sys.exit("no 'P <core> <pc> <caller>' lines found in %s" % args.log)
+
+    elf = args.elf or find_elf()
+    addr2line = args.addr2line or find_addr2line()
+    if not elf or not addr2line:
+        sys.exit("need --elf and --addr2line (could not auto-detect)")
+
+    names = symbolize({a for _, pc, caller in samples for a in (pc, caller)}, elf, addr2line)
+
+    flat = collections.Counter()
+    per_core = collections.Counter()
+    folded = collections.Counter()
+    for core, pc, caller in samples:
+        func = names.get(pc, "??")
+        flat[func] += 1
+        per_core[core] += 1
+        stack = ["core%d" % core]
+        if caller:
+            stack.append(names.get(caller, "??"))
+        stack.append(func)
+        folded[";".join(stack)] += 1
+
+    total = len(samples)
+    print("%d samples (%s)" % (total, ", ".join("core%d: %d" % kv for kv in sorted(per_core.items()))))
+    print("%7s %6s  %s" % ("samples", "self%", "function"))
+    for func, n in flat.most_common(args.top):
+        print("%7d %5.1f%%  %s" % (n, 100.0 * n / total, func))
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, n in sorted(folded.items()):
+                f.write("%s %d\n" % (stack, n))
+        print("wrote %s" % args.folded)
+
+
+if __name__ == "__main__":
+    main()
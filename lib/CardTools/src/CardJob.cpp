@@ -0,0 +1,140 @@
+#include "CardJob.h"
+#include <Console.h>
+#include <Energy.h>
+#include <SdCard.h>
+#include <stdarg.h>
+
+static CardJob::Status s_status   = {};
+static CardJob::Access s_access   = CardJob::Access::Raw;
+static CardJob::Fn     s_fn       = nullptr;
+static void*           s_arg      = nullptr;
+static uint32_t        s_startMs  = 0;
+static uint64_t        s_ioRead   = 0;
+static uint64_t        s_ioWrite  = 0;
+static portMUX_TYPE    s_lock     = portMUX_INITIALIZER_UNLOCKED;
+
+static void releaseCard() {
+  if (s_access == CardJob::Access::Files) SdCard::endFs();
+  else SdCard::end();
+}
+
+static void jobTask(void*) {
+  Energy::beginActivity(s_status.name);
+  const bool ok = s_fn(s_arg);
+  Energy::endActivity(s_status.name, s_ioRead, s_ioWrite);
+  releaseCard();
+
+  portENTER_CRITICAL(&s_lock);
+  s_status.ok        = ok;
+  s_status.elapsedMs = millis() - s_startMs;
+  s_status.item[0]   = '\0';
+  s_status.running   = false;
+  portEXIT_CRITICAL(&s_lock);
+  vTaskDelete(nullptr);
+}
+
+// ---------------- Console ----------------
+static void cmdJob(Print& out, const char* args) {
+  if (strcmp(args, "cancel") == 0) {
+    CardJob::cancel();
+  }
+  const CardJob::Status st = CardJob::status();
+  if (!st.name) {
+    out.println("job: none yet");
+    return;
+  }
+  out.printf("job %s: %s", st.name, st.running ? (st.cancelled ? "cancelling" : "running") : (st.ok ? "done" : "failed"));
+  if (st.total) out.printf(" %.1f%%", st.done * 100.0 / st.total);
+  out.printf(", %u items, %.1f s\n", (unsigned)st.items, st.elapsedMs / 1000.0f);
+  if (st.running && st.item[0]) out.printf("  at %s\n", st.item);
+  if (!st.running && st.message[0]) out.printf("  %s\n", st.message);
+}
+
+namespace CardJob {
+
+void begin() {
+  Console::add("job", "card tool job status: [cancel]", cmdJob);
+}
+
+bool start(const char* name, Access access, Fn fn, void* arg, uint32_t stackBytes) {
+  if (s_status.running) return false;
+  // Claim the card here (loop context) so the UI scanner sees it busy at once.
+  if (!(access == Access::Files ? SdCard::beginFs() : SdCard::begin())) return false;
+
+  s_access  = access;
+  s_fn      = fn;
+  s_arg     = arg;
+  s_startMs = millis();
+  s_ioRead  = s_ioWrite = 0;
+  portENTER_CRITICAL(&s_lock);
+  s_status         = {};
+  s_status.name    = name;
+  s_status.running = true;
+  portEXIT_CRITICAL(&s_lock);
+
+  // Core 0: keeps card I/O off the LVGL/loop core.
+  if (xTaskCreatePinnedToCore(jobTask, "card_job", stackBytes, nullptr, 3, nullptr, 0) != pdPASS) {
+    releaseCard();
+    s_status.running = false;
+    snprintf(s_status.message, sizeof(s_status.message), "could not start task");
+    return false;
+  }
+  Serial.printf("CardJob: %s started\n", name);
+  return true;
+}
+
+bool busy() { return s_status.running; }
+
+void cancel() {
+  portENTER_CRITICAL(&s_lock);
+  if (s_status.running) s_status.cancelled = true;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+Status status() {
+  portENTER_CRITICAL(&s_lock);
+  Status st = s_status;
+  if (st.running) st.elapsedMs = millis() - s_startMs;
+  portEXIT_CRITICAL(&s_lock);
+  return st;
+}
+
+bool cancelled() { return s_status.cancelled; }
+
+void setTotal(uint64_t total) {
+  portENTER_CRITICAL(&s_lock);
+  s_status.total = total;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void advance(uint64_t units, uint32_t items) {
+  portENTER_CRITICAL(&s_lock);
+  s_status.done  += units;
+  s_status.items += items;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void setItem(const char* text) {
+  portENTER_CRITICAL(&s_lock);
+  strlcpy(s_status.item, text, sizeof(s_status.item));
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void finish(const char* fmt, ...) {
+  char msg[sizeof(s_status.message)];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(msg, sizeof(msg), fmt, ap);
+  va_end(ap);
+  portENTER_CRITICAL(&s_lock);
+  memcpy(s_status.message, msg, sizeof(msg));
+  portEXIT_CRITICAL(&s_lock);
+  Serial.printf("CardJob: %s: %s\n", s_status.name, msg);
+}
+
+void countIo(uint64_t bytesRead, uint64_t bytesWritten) {
+  s_ioRead  += bytesRead;
+  s_ioWrite += bytesWritten;
+}
+
+} // namespace CardJob
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+
+// Background runner for long card tools (hashing, scans, erase...).
+// One job at a time: start() claims the card from the caller's (loop)
+// context, runs the job on its own task, then releases the card. Progress
+// is published through a small status block the UI and console poll.
+namespace CardJob {
+
+  // How the job needs the card: raw sectors (SdCard::read/write) or files
+  // under SdCard::FS_ROOT.
+  enum class Access : uint8_t { Raw, Files };
+
+  // Job body; runs on the job task with the card open. Return false on failure
+  // (set a message with finish() first). Check cancelled() regularly.
+  using Fn = bool (*)(void* arg);
+
+  struct Status {
+    const char* name;         // job name (string literal), nullptr before the first job
+    bool        running;
+    bool        cancelled;
+    bool        ok;           // result of the finished job
+    uint64_t    done;         // progress units chosen by the job (usually bytes)
+    uint64_t    total;        // 0 = unknown
+    uint32_t    items;        // files/blocks handled
+    uint32_t    elapsedMs;
+    char        item[64];     // what it is working on now
+    char        message[128]; // summary or error once finished
+  };
+
+  // Register the "job" console command.
+  void begin();
+
+  // Returns false if a job is running or the card can't be claimed.
+  bool start(const char* name, Access access, Fn fn, void* arg, uint32_t stackBytes = 6144);
+  bool busy();
+  void cancel();
+  Status status();
+
+  // ---- For job bodies ----
+  bool cancelled();
+  void setTotal(uint64_t total);
+  void advance(uint64_t units, uint32_t items = 0);
+  void setItem(const char* text);
+  void finish(const char* fmt, ...);          // final message (also logged)
+  void countIo(uint64_t bytesRead, uint64_t bytesWritten);  // for energy per GB
+
+} // namespace CardJob
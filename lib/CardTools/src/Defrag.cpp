@@ -0,0 +1,246 @@
+#include "Defrag.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+
+// The reads and writes share one SD bus, so they can't overlap; what pays
+// is long multi-block commands from a DMA-capable buffer.
+static constexpr uint32_t CHUNK_SECTORS = 128;   // 64 KB per command
+
+static char s_path[FatVolume::MAX_PATH];
+
+struct Find {
+  Entry entry;
+  bool  found;
+};
+
+static FileWalk::Action findEntry(const Entry& e, void* arg) {
+  Find& f = *(Find*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  if (strcmp(e.path, s_path) == 0) {
+    f.entry = e;
+    f.entry.path = s_path;
+    f.entry.name = strrchr(s_path, '/') + 1;
+    f.found = true;
+    return FileWalk::Action::Stop;
+  }
+  // Only descend into directories on the way to the file
+  const size_t len = strlen(e.path);
+  if (e.dir && !(strncmp(e.path, s_path, len) == 0 && s_path[len] == '/')) return FileWalk::Action::Skip;
+  return FileWalk::Action::Continue;
+}
+
+// Clusters in the chain (up to limit + 1) and its extents; 0 if broken.
+static uint32_t chainLength(uint32_t c, uint32_t limit, uint32_t& extents) {
+  uint32_t n = 0;
+  extents = 1;
+  while (n <= limit) {
+    n++;
+    const uint32_t next = FatVolume::next(c);
+    if (next == FatVolume::END) return n;
+    if (!FatVolume::isCluster(next)) return 0;
+    if (next != c + 1) extents++;
+    c = next;
+  }
+  return n;
+}
+
+// First run of n free clusters; 0 if none. Whole words at a time where
+// they are all used or all free.
+static uint32_t findFreeRun(const uint32_t* bits, uint32_t n) {
+  const uint32_t clusters = FatVolume::info().clusters;
+  uint32_t start = 0, len = 0;
+  for (uint32_t w = 0; w < (clusters + 31) / 32; ++w) {
+    const uint32_t word = bits[w];
+    if (word == 0xFFFFFFFF) {
+      len = 0;
+      continue;
+    }
+    if (word == 0 && w * 32 + 32 <= clusters) {
+      if (!len) start = w * 32 + 2;
+      len += 32;
+      if (len >= n) return start;
+      continue;
+    }
+    for (uint32_t b = 0; b < 32 && w * 32 + b < clusters; ++b) {
+      if (word & (1u << b)) {
+        len = 0;
+      } else {
+        if (!len) start = w * 32 + b + 2;
+        if (++len >= n) return start;
+      }
+    }
+  }
+  return 0;
+}
+
+// Copy the chain starting at src to n consecutive clusters at dst.
+static bool copyChain(uint32_t src, uint32_t dst, uint32_t n, uint8_t* buf) {
+  const uint32_t spc = FatVolume::info().spc;
+  uint32_t done = 0;
+  while (done < n) {
+    // One extent of the source at a time
+    uint32_t len = 1, last = src;
+    while (done + len < n && FatVolume::next(last) == last + 1) {
+      last++;
+      len++;
+    }
+    uint32_t from = FatVolume::clusterLba(src);
+    uint32_t to   = FatVolume::clusterLba(dst + done);
+    for (uint32_t left = len * spc; left; ) {
+      if (CardJob::cancelled()) return false;
+      const uint32_t k = min(CHUNK_SECTORS, left);
+      if (!SdCard::read(buf, from, k)) {
+        CardJob::finish("read error at sector %u", (unsigned)from);
+        return false;
+      }
+      if (!SdCard::write(buf, to, k)) {
+        CardJob::finish("write error at sector %u", (unsigned)to);
+        return false;
+      }
+      CardJob::advance((uint64_t)k * SdCard::SECTOR_SIZE);
+      CardJob::countIo((uint64_t)k * SdCard::SECTOR_SIZE, (uint64_t)k * SdCard::SECTOR_SIZE);
+      from += k;
+      to   += k;
+      left -= k;
+    }
+    done += len;
+    src = FatVolume::next(last);
+  }
+  return true;
+}
+
+static bool defragFile(Entry& e) {
+  const FatVolume::Info& vi = FatVolume::info();
+  const bool exfat = vi.type == FatVolume::Type::ExFat;
+  if (e.dir) {
+    CardJob::finish("%s is a folder", e.name);
+    return false;
+  }
+  const uint32_t n = (uint32_t)((e.size + vi.clusterBytes - 1) / vi.clusterBytes);
+  if (!n || e.contiguous) {
+    CardJob::finish("already contiguous");
+    return true;
+  }
+  uint32_t extents;
+  if (chainLength(e.firstCluster, n, extents) != n) {
+    CardJob::finish("chain doesn't match the file size, run \"fsck\" first");
+    return false;
+  }
+  if (extents == 1) {
+    CardJob::finish("already contiguous");
+    return true;
+  }
+
+  const uint32_t* bits = FatVolume::loadBitmap();
+  const uint32_t  dst  = bits ? findFreeRun(bits, n) : 0;
+  if (!dst) {
+    CardJob::finish(bits ? "no contiguous free space of %.1f MB" : "out of memory for the allocation bitmap",
+                    (double)n * vi.clusterBytes / 1048576.0);
+    return false;
+  }
+
+  // 1. Copy
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(CHUNK_SECTORS * SdCard::SECTOR_SIZE);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  CardJob::setTotal((uint64_t)n * vi.clusterBytes);
+  CardJob::setItem(e.path);
+  const bool copied = copyChain(e.firstCluster, dst, n, buf);
+  heap_caps_free(buf);
+  if (!copied) {
+    if (CardJob::cancelled()) CardJob::finish("cancelled, file unchanged");
+    return false;
+  }
+
+  // 2. New chain (exFAT: bitmap only, the file becomes NoFatChain)
+  CardJob::setItem("updating the allocation table");
+  for (uint32_t i = 0; i < n; ++i) {
+    if (!exfat) FatVolume::setNext(dst + i, i + 1 < n ? dst + i + 1 : FatVolume::END);
+    FatVolume::setAllocated(dst + i, true);
+  }
+  if (!FatVolume::flush()) {
+    CardJob::finish("FAT write error, file unchanged");
+    return false;
+  }
+
+  // 3. Switch the entry over
+  const uint32_t old = e.firstCluster;
+  if (!FatVolume::updateEntry(e, dst, e.size, exfat)) {
+    CardJob::finish("directory write error, file unchanged (run \"fsck repair yes\")");
+    return false;
+  }
+
+  // 4. Free the old chain
+  for (uint32_t c = old, i = 0; i < n && FatVolume::isCluster(c); ++i) {
+    const uint32_t next = FatVolume::next(c);
+    FatVolume::setNext(c, FatVolume::FREE);
+    FatVolume::setAllocated(c, false);
+    c = next;
+  }
+  if (!FatVolume::flush()) {
+    CardJob::finish("moved, but freeing the old clusters failed (run \"fsck repair yes\")");
+    return false;
+  }
+  CardJob::advance(0, 1);
+  CardJob::finish("%u extents -> 1, %.1f MB moved", (unsigned)extents, e.size / 1048576.0);
+  return true;
+}
+
+static bool defragJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  CardJob::setItem("reading allocation table");
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  FatVolume::loadFat();   // optional: chain edits then go out in coalesced writes
+
+  CardJob::setItem("looking for the file");
+  Find f = {};
+  FatVolume::walk(findEntry, &f);
+  bool ok = false;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled, file unchanged");
+  } else if (!f.found) {
+    CardJob::finish("%s not found", s_path);
+  } else {
+    ok = defragFile(f.entry);
+  }
+  FatVolume::close();
+  if (ok) {
+    Serial.printf("defrag: %s in %.1f s\n", s_path, (esp_timer_get_time() - start) / 1e6f);
+  }
+  return ok;
+}
+
+// ---------------- Console ----------------
+static void cmdDefrag(Print& out, const char* args) {
+  if (*args != '/') {
+    out.println("usage: defrag /path/to/file (see \"frag report\")");
+    return;
+  }
+  out.println(Defrag::start(args) ? "defrag: started, \"job\" for progress"
+                                  : "defrag: card busy or missing (unmount USB first)");
+}
+
+namespace Defrag {
+
+void begin() {
+  Console::add("defrag", "make one file contiguous: /path", cmdDefrag);
+}
+
+bool start(const char* path) {
+  if (CardJob::busy() || strlen(path) >= sizeof(s_path)) return false;
+  strlcpy(s_path, path, sizeof(s_path));
+  return CardJob::start("defrag", CardJob::Access::Raw, defragJob, nullptr);
+}
+
+} // namespace Defrag
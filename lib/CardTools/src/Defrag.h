@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+
+// Defragment one file ("defrag" console command, fragmentation panel):
+// copies its clusters into the first free run long enough to hold it, then
+// switches the file over in an order that survives power loss at any point:
+//   1. copy the data        - nothing on the card refers to the new run yet
+//   2. write the new chain  - a crash leaves it as a lost chain (fsck frees it)
+//   3. point the entry at it
+//   4. free the old chain   - a crash before this leaves the old one lost
+// On exFAT the file becomes a NoFatChain file.
+namespace Defrag {
+
+  // Register the console command.
+  void begin();
+
+  // path as listed by FragScan ("/DIR/FILE", UTF-8).
+  bool start(const char* path);
+
+} // namespace Defrag
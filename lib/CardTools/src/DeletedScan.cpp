@@ -0,0 +1,189 @@
+#include "DeletedScan.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include <Console.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+using DeletedScan::State;
+
+static constexpr size_t POOL_BYTES = 512 * 1024;   // paths of all items
+
+struct Record {
+  uint64_t size;
+  uint32_t pathOff;
+  uint32_t firstCluster;
+  uint32_t mtime;
+  bool     dir;
+  State    state;
+};
+
+// Allocated once and kept, so the UI can read while a new scan fills them
+static Record*           s_items    = nullptr;
+static char*             s_pool     = nullptr;
+static size_t            s_poolUsed = 0;
+static volatile uint32_t s_count    = 0;
+
+struct Scan {
+  bool            exfat;
+  const uint32_t* bits;
+  int             deletedDepth;   // depth of the deleted folder being read, -1 none
+  uint32_t        found[4];       // per State
+  uint64_t        intactBytes;
+};
+
+// Are the entry's data clusters still free?
+static State assess(const Scan& s, const Entry& e) {
+  const uint32_t cb    = FatVolume::info().clusterBytes;
+  const uint64_t bytes = e.dir && !s.exfat ? cb : e.size;
+  if (!bytes) return State::Empty;
+  uint32_t c = e.firstCluster;
+  if (!FatVolume::isCluster(c) || FatVolume::isAllocated(s.bits, c)) return State::Overwritten;
+  const bool     chained = s.exfat && !e.contiguous;
+  const uint32_t n       = (uint32_t)((bytes + cb - 1) / cb);
+  for (uint32_t i = 1; i < n; ++i) {
+    c = chained ? FatVolume::next(c) : c + 1;
+    if (!FatVolume::isCluster(c) || FatVolume::isAllocated(s.bits, c)) return State::Partial;
+  }
+  return State::Intact;
+}
+
+static void record(Scan& s, const Entry& e, State state) {
+  s.found[(int)state]++;
+  if (state == State::Intact) s.intactBytes += e.size;
+  const size_t len = strlen(e.path) + 1;
+  if (s_count >= DeletedScan::MAX_ITEMS || s_poolUsed + len > POOL_BYTES) return;
+  memcpy(s_pool + s_poolUsed, e.path, len);
+  s_items[s_count] = { e.size, (uint32_t)s_poolUsed, e.firstCluster, e.mtime, e.dir, state };
+  s_poolUsed += len;
+  s_count = s_count + 1;          // publish after the record is complete
+}
+
+static FileWalk::Action visitEntry(const Entry& e, void* arg) {
+  Scan& s = *(Scan*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  CardJob::advance(0, 1);
+  if (s.deletedDepth >= 0 && e.depth <= s.deletedDepth) s.deletedDepth = -1;   // left that folder
+
+  // Entries inside a deleted folder count as deleted even if never marked
+  if (!e.deleted && s.deletedDepth < 0) {
+    if (e.dir) CardJob::setItem(e.path);
+    return FileWalk::Action::Continue;
+  }
+  const State state = assess(s, e);
+  record(s, e, state);
+  if (!e.dir) return FileWalk::Action::Continue;
+  if (state == State::Overwritten) return FileWalk::Action::Skip;   // would read someone else's data
+  if (s.deletedDepth < 0) s.deletedDepth = e.depth;
+  return FileWalk::Action::Continue;
+}
+
+static bool scanJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  Scan s = {};
+  s.deletedDepth = -1;
+
+  CardJob::setItem("reading allocation table");
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  s.exfat = FatVolume::info().type == FatVolume::Type::ExFat;
+  FatVolume::loadFat();   // optional: next() reads the card otherwise
+  s.bits = FatVolume::loadBitmap();
+  if (!s.bits) {
+    FatVolume::close();
+    CardJob::finish("out of memory for the allocation bitmap");
+    return false;
+  }
+
+  const bool walked = FatVolume::walk(visitEntry, &s, true);
+  FatVolume::close();
+
+  const uint32_t total = s.found[0] + s.found[1] + s.found[2] + s.found[3];
+  const float    secs  = (esp_timer_get_time() - start) / 1e6f;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled, %u deleted entries so far", (unsigned)total);
+  } else if (!walked) {
+    CardJob::finish("directory read error, %u deleted entries so far", (unsigned)total);
+  } else {
+    CardJob::finish("%u deleted: %u intact (%.1f MB), %u partly reused, %u overwritten, %.1f s%s",
+                    (unsigned)total, (unsigned)s.found[(int)State::Intact], s.intactBytes / 1048576.0,
+                    (unsigned)s.found[(int)State::Partial], (unsigned)s.found[(int)State::Overwritten], secs,
+                    total > s_count ? " (list truncated)" : "");
+  }
+  return walked && !CardJob::cancelled();
+}
+
+// ---------------- Console ----------------
+static void printItems(Print& out) {
+  const uint32_t n = s_count;
+  if (!n) {
+    out.println("deleted: nothing found (run \"deleted\" first)");
+    return;
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    DeletedScan::Item it;
+    DeletedScan::item(i, it);
+    const uint16_t d = it.mtime >> 16, t = it.mtime & 0xFFFF;
+    out.printf("%-11s %10.1f KB  %04u-%02u-%02u %02u:%02u  %s%s\n", DeletedScan::stateName(it.state),
+               it.size / 1024.0, 1980 + (d >> 9), (d >> 5) & 15, d & 31, t >> 11, (t >> 5) & 63, it.path,
+               it.dir ? "/" : "");
+  }
+}
+
+static void cmdDeleted(Print& out, const char* args) {
+  if (strcmp(args, "list") == 0) {
+    printItems(out);
+  } else if (*args == '\0') {
+    out.println(DeletedScan::start() ? "deleted: scanning, \"job\" for progress, \"deleted list\" for results"
+                                     : "deleted: card busy or missing (unmount USB first)");
+  } else {
+    out.println("usage: deleted [list]");
+  }
+}
+
+namespace DeletedScan {
+
+void begin() {
+  Console::add("deleted", "find deleted files: [list]", cmdDeleted);
+}
+
+bool start() {
+  if (CardJob::busy()) return false;
+  if (!s_items) {
+    s_items = (Record*)heap_caps_malloc(MAX_ITEMS * sizeof(Record), MALLOC_CAP_SPIRAM);
+    s_pool  = (char*)heap_caps_malloc(POOL_BYTES, MALLOC_CAP_SPIRAM);
+    if (!s_items || !s_pool) {
+      heap_caps_free(s_items);
+      heap_caps_free(s_pool);
+      s_items = nullptr;
+      s_pool  = nullptr;
+      return false;
+    }
+  }
+  s_count    = 0;
+  s_poolUsed = 0;
+  return CardJob::start("deleted scan", CardJob::Access::Raw, scanJob, nullptr);
+}
+
+uint32_t count() { return s_count; }
+
+bool item(uint32_t i, Item& out) {
+  if (i >= s_count) return false;
+  const Record& r = s_items[i];
+  out = { s_pool + r.pathOff, r.size, r.firstCluster, r.mtime, r.dir, r.state };
+  return true;
+}
+
+const char* stateName(State s) {
+  switch (s) {
+    case State::Intact:      return "intact";
+    case State::Partial:     return "partial";
+    case State::Overwritten: return "overwritten";
+    default:                 return "empty";
+  }
+}
+
+} // namespace DeletedScan
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+// Deleted-file discovery ("deleted" console command, Tools screen): one raw
+// pass over the directory clusters of the FAT32/exFAT volume listing entries
+// marked deleted, including the contents of deleted folders whose clusters
+// are still free. Each entry is rated by whether its data clusters are still
+// free: FAT32 clears the chain on delete, so the clusters are assumed to
+// follow each other; exFAT keeps it.
+namespace DeletedScan {
+
+  enum class State : uint8_t {
+    Intact,        // every data cluster still free
+    Partial,       // first cluster free, later ones reused
+    Overwritten,   // first cluster reused
+    Empty,         // no data (0-byte file)
+  };
+
+  static constexpr uint32_t MAX_ITEMS = 8192;
+
+  struct Item {
+    const char* path;         // as it was, first char "_" on FAT32 without a long name
+    uint64_t    size;
+    uint32_t    firstCluster;
+    uint32_t    mtime;        // FAT date << 16 | time
+    bool        dir;
+    State       state;
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+  // Items found by the running or last scan; safe to read while it runs.
+  uint32_t    count();
+  bool        item(uint32_t i, Item& out);
+  const char* stateName(State s);
+
+} // namespace DeletedScan
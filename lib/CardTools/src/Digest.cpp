@@ -0,0 +1,153 @@
+#include "Digest.h"
+#include <esp_rom_crc.h>
+
+static const char* const ALGO_NAMES[(size_t)Digest::Algo::Count] = { "sha256", "crc32", "xxh32" };
+static const uint8_t     ALGO_SIZES[(size_t)Digest::Algo::Count] = { 32, 4, 4 };
+
+// ---------------- xxHash32 ----------------
+static constexpr uint32_t XXH_P1 = 2654435761u;
+static constexpr uint32_t XXH_P2 = 2246822519u;
+static constexpr uint32_t XXH_P3 = 3266489917u;
+static constexpr uint32_t XXH_P4 = 668265263u;
+static constexpr uint32_t XXH_P5 = 374761393u;
+
+static inline uint32_t rotl(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+static inline uint32_t readLe32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);  // little-endian core
+  return v;
+}
+
+static inline uint32_t xxhRound(uint32_t acc, uint32_t in) {
+  return rotl(acc + in * XXH_P2, 13) * XXH_P1;
+}
+
+static void storeBe32(uint8_t* out, uint32_t v) {
+  out[0] = v >> 24;
+  out[1] = v >> 16;
+  out[2] = v >> 8;
+  out[3] = v;
+}
+
+namespace Digest {
+
+const char* name(Algo a) { return a < Algo::Count ? ALGO_NAMES[(size_t)a] : "?"; }
+size_t      size(Algo a) { return a < Algo::Count ? ALGO_SIZES[(size_t)a] : 0; }
+
+bool parse(const char* s, Algo& a) {
+  for (size_t i = 0; i < (size_t)Algo::Count; ++i) {
+    if (strcmp(s, ALGO_NAMES[i]) == 0) {
+      a = (Algo)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+Hasher::Hasher(Algo a) : algo_(a) {
+  if (algo_ == Algo::Sha256) mbedtls_sha256_init(&sha_);
+  reset();
+}
+
+Hasher::~Hasher() {
+  if (algo_ == Algo::Sha256) mbedtls_sha256_free(&sha_);
+}
+
+void Hasher::reset() {
+  switch (algo_) {
+    case Algo::Sha256:
+      mbedtls_sha256_starts(&sha_, 0);
+      break;
+    case Algo::Crc32:
+      crc_ = 0;
+      break;
+    default:
+      xxh_.total   = 0;
+      xxh_.memSize = 0;
+      xxh_.v[0]    = XXH_P1 + XXH_P2;  // seed 0
+      xxh_.v[1]    = XXH_P2;
+      xxh_.v[2]    = 0;
+      xxh_.v[3]    = 0u - XXH_P1;
+      break;
+  }
+}
+
+void Hasher::update(const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  switch (algo_) {
+    case Algo::Sha256:
+      mbedtls_sha256_update(&sha_, p, len);
+      return;
+    case Algo::Crc32:
+      crc_ = esp_rom_crc32_le(crc_, p, len);
+      return;
+    default:
+      break;
+  }
+
+  xxh_.total += len;
+  if (xxh_.memSize + len < 16) {
+    memcpy(xxh_.mem + xxh_.memSize, p, len);
+    xxh_.memSize += len;
+    return;
+  }
+  if (xxh_.memSize) {
+    const size_t fill = 16 - xxh_.memSize;
+    memcpy(xxh_.mem + xxh_.memSize, p, fill);
+    for (int i = 0; i < 4; ++i) xxh_.v[i] = xxhRound(xxh_.v[i], readLe32(xxh_.mem + 4 * i));
+    p   += fill;
+    len -= fill;
+    xxh_.memSize = 0;
+  }
+  uint32_t v0 = xxh_.v[0], v1 = xxh_.v[1], v2 = xxh_.v[2], v3 = xxh_.v[3];
+  for (; len >= 16; p += 16, len -= 16) {
+    v0 = xxhRound(v0, readLe32(p));
+    v1 = xxhRound(v1, readLe32(p + 4));
+    v2 = xxhRound(v2, readLe32(p + 8));
+    v3 = xxhRound(v3, readLe32(p + 12));
+  }
+  xxh_.v[0] = v0; xxh_.v[1] = v1; xxh_.v[2] = v2; xxh_.v[3] = v3;
+  memcpy(xxh_.mem, p, len);
+  xxh_.memSize = len;
+}
+
+size_t Hasher::finish(uint8_t* out) {
+  switch (algo_) {
+    case Algo::Sha256:
+      mbedtls_sha256_finish(&sha_, out);
+      return 32;
+    case Algo::Crc32:
+      storeBe32(out, crc_);
+      return 4;
+    default:
+      break;
+  }
+
+  uint32_t h = xxh_.total >= 16
+    ? rotl(xxh_.v[0], 1) + rotl(xxh_.v[1], 7) + rotl(xxh_.v[2], 12) + rotl(xxh_.v[3], 18)
+    : xxh_.v[2] + XXH_P5;
+  h += (uint32_t)xxh_.total;   // the spec adds the length modulo 2^32
+  const uint8_t* p = xxh_.mem;
+  size_t left = xxh_.memSize;
+  for (; left >= 4; p += 4, left -= 4) h = rotl(h + readLe32(p) * XXH_P3, 17) * XXH_P4;
+  for (; left; ++p, --left) h = rotl(h + *p * XXH_P5, 11) * XXH_P1;
+  h ^= h >> 15;
+  h *= XXH_P2;
+  h ^= h >> 13;
+  h *= XXH_P3;
+  h ^= h >> 16;
+  storeBe32(out, h);
+  return 4;
+}
+
+void toHex(const uint8_t* digest, size_t len, char* out) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; ++i) {
+    out[2 * i]     = HEX_DIGITS[digest[i] >> 4];
+    out[2 * i + 1] = HEX_DIGITS[digest[i] & 0x0F];
+  }
+  out[2 * len] = '\0';
+}
+
+} // namespace Digest
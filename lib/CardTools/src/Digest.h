@@ -0,0 +1,49 @@
+#pragma once
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+
+// Streaming file digests. SHA-256 goes through mbedtls, which the ESP32-S3
+// build routes to the SHA accelerator; CRC32 uses the ROM table routine;
+// xxHash32 is a small software implementation (fastest on this 32-bit core).
+namespace Digest {
+
+  enum class Algo : uint8_t { Sha256 = 0, Crc32, Xxh32, Count };
+
+  static constexpr size_t MAX_SIZE = 32;
+
+  const char* name(Algo a);          // "sha256", "crc32", "xxh32"
+  size_t      size(Algo a);          // digest bytes
+  bool        parse(const char* s, Algo& a);
+
+  class Hasher {
+  public:
+    explicit Hasher(Algo a);
+    ~Hasher();
+    Hasher(const Hasher&) = delete;
+    Hasher& operator=(const Hasher&) = delete;
+
+    void   reset();
+    void   update(const void* data, size_t len);
+    size_t finish(uint8_t* out);     // writes size(algo()) bytes, big-endian for the 32-bit sums
+    Algo   algo() const { return algo_; }
+
+  private:
+    struct Xxh32 {
+      uint64_t total;     // 64-bit so the large-input branch survives files over 4 GB
+      uint32_t v[4];
+      uint8_t  mem[16];
+      uint8_t  memSize;
+    };
+
+    Algo algo_;
+    union {
+      mbedtls_sha256_context sha_;
+      uint32_t               crc_;
+      Xxh32                  xxh_;
+    };
+  };
+
+  // Lowercase hex into out (2*len + 1 bytes).
+  void toHex(const uint8_t* digest, size_t len, char* out);
+
+} // namespace Digest
@@ -0,0 +1,260 @@
+#include "DirPager.h"
+#include "CardJob.h"
+#include <esp_heap_caps.h>
+
+using DirPager::Item;
+using DirPager::PAGE_ENTRIES;
+using FatVolume::DirPos;
+
+static constexpr const char* JOB_NAME    = "file browser";
+static constexpr uint32_t    FIRST_MARKS = 64;
+static constexpr uint32_t    WANTED      = 4;      // pages queued by get(), newest served first
+static constexpr uint32_t    STACK_BYTES = 8192;   // room for the worker (JPEG decoding)
+
+struct Page {
+  uint32_t gen;             // directory it belongs to
+  uint32_t index;
+  uint32_t used;            // LRU tick
+  uint32_t count;
+  bool     ready;           // false while the job fills it
+  Item     items[PAGE_ENTRIES];
+};
+
+// Shared with the UI, under s_lock
+static portMUX_TYPE      s_lock     = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_wake     = nullptr;
+static Page*             s_pages    = nullptr;      // CACHED_PAGES, PSRAM
+static char              s_path[FatVolume::MAX_PATH] = "/";
+static uint32_t          s_gen      = 0;            // bumped by open()
+static uint32_t          s_tick     = 0;
+static uint32_t          s_wanted[WANTED];
+static uint32_t          s_wantedCount = 0;
+static DirPager::Listing s_listing  = {};
+static DirPager::Filter  s_filter   = nullptr;      // set before the job starts
+static DirPager::Worker  s_worker   = nullptr;
+
+// Job only
+static DirPos*  s_marks   = nullptr;                // start of each page, PSRAM
+static size_t   s_markCap = 0;
+static DirPos   s_scan;                             // counting cursor
+static uint32_t s_scanned = 0;
+
+// Directory at path
+static bool resolve(const char* path, DirPos& pos) {
+  if (path[strspn(path, "/")] == '\0') {
+    pos = FatVolume::rootDir();
+    return true;
+  }
+  FatVolume::Entry e;
+  if (!FatVolume::find(path, e) || !e.dir) return false;
+  pos = FatVolume::dirOf(e);
+  return true;
+}
+
+// Next entry at pos that passes the filter.
+static bool nextEntry(DirPos& pos, FatVolume::Entry& e, bool* ok = nullptr) {
+  while (FatVolume::readDir(pos, e, ok)) {
+    if (!s_filter || s_filter(e.name, e.dir)) return true;
+  }
+  return false;
+}
+
+static bool reserveMarks(size_t need) {
+  if (need <= s_markCap) return true;
+  size_t n = s_markCap ? s_markCap * 2 : FIRST_MARKS;
+  while (n < need) n *= 2;
+  DirPos* q = (DirPos*)heap_caps_realloc(s_marks, n * sizeof(DirPos), MALLOC_CAP_SPIRAM);
+  if (!q) return false;
+  s_marks   = q;
+  s_markCap = n;
+  return true;
+}
+
+// Count one more page of the directory; false once the end is reached.
+static bool countPage(uint32_t gen) {
+  const uint32_t page = s_scanned / PAGE_ENTRIES;
+  bool ok = reserveMarks(page + 1);
+  uint32_t n = 0;
+  if (ok) {
+    s_marks[page] = s_scan;
+    FatVolume::Entry e;
+    while (n < PAGE_ENTRIES && nextEntry(s_scan, e, &ok)) n++;
+  }
+  s_scanned += n;
+  CardJob::advance(0, n);
+  const bool more = ok && n == PAGE_ENTRIES && s_scanned < DirPager::MAX_ENTRIES;
+  portENTER_CRITICAL(&s_lock);
+  if (gen == s_gen) {
+    s_listing.count    = s_scanned;
+    s_listing.complete = !more;
+    s_listing.failed   = !ok;
+  }
+  portEXIT_CRITICAL(&s_lock);
+  return more;
+}
+
+static bool takeWanted(uint32_t* index) {
+  portENTER_CRITICAL(&s_lock);
+  const bool any = s_wantedCount > 0;
+  if (any) *index = s_wanted[--s_wantedCount];
+  portEXIT_CRITICAL(&s_lock);
+  return any;
+}
+
+static Page* findPage(uint32_t index) {
+  for (uint32_t i = 0; i < DirPager::CACHED_PAGES; ++i) {
+    Page& p = s_pages[i];
+    if (p.ready && p.gen == s_gen && p.index == index) return &p;
+  }
+  return nullptr;
+}
+
+static void loadPage(uint32_t gen, uint32_t index) {
+  // Reuse the least recently read page (stale directories first)
+  portENTER_CRITICAL(&s_lock);
+  const bool cached = findPage(index);
+  Page* p = &s_pages[0];
+  for (uint32_t i = 1; i < DirPager::CACHED_PAGES && p->gen == s_gen; ++i) {
+    Page& q = s_pages[i];
+    if (q.gen != s_gen || q.used < p->used) p = &q;
+  }
+  if (!cached) p->ready = false;
+  portEXIT_CRITICAL(&s_lock);
+  if (cached) return;
+
+  DirPos pos = s_marks[index];
+  FatVolume::Entry e;
+  uint32_t n = 0;
+  while (n < PAGE_ENTRIES && nextEntry(pos, e)) {
+    Item& it = p->items[n++];
+    strlcpy(it.name, e.name, sizeof(it.name));
+    it.size         = e.size;
+    it.mtime        = e.mtime;
+    it.firstCluster = e.firstCluster;
+    it.contiguous   = e.contiguous;
+    it.dir          = e.dir;
+  }
+  portENTER_CRITICAL(&s_lock);
+  if (gen == s_gen) {
+    p->gen   = gen;
+    p->index = index;
+    p->count = n;
+    p->used  = ++s_tick;
+    p->ready = true;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+static bool browseJob(void*) {
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  uint32_t gen = s_gen - 1;     // resolve the first directory
+  bool counting = false;
+  char path[FatVolume::MAX_PATH];
+  while (!CardJob::cancelled()) {
+    if (gen != s_gen) {
+      portENTER_CRITICAL(&s_lock);
+      gen = s_gen;
+      memcpy(path, s_path, sizeof(path));
+      portEXIT_CRITICAL(&s_lock);
+      CardJob::setItem(path);
+      s_scanned = 0;
+      counting  = resolve(path, s_scan);
+      if (!counting) {
+        portENTER_CRITICAL(&s_lock);
+        if (gen == s_gen) s_listing = { 0, true, true };
+        portEXIT_CRITICAL(&s_lock);
+      }
+      continue;
+    }
+    // Pages on screen first, then count on and work in turns; sleep once
+    // all are done
+    uint32_t index;
+    if (takeWanted(&index)) {
+      loadPage(gen, index);
+      continue;
+    }
+    const bool counted = counting;
+    if (counting) counting = countPage(gen);
+    const bool worked = s_worker && s_worker();
+    if (!counted && !worked) xSemaphoreTake(s_wake, pdMS_TO_TICKS(100));
+  }
+  FatVolume::close();
+  CardJob::finish("closed");
+  return true;
+}
+
+namespace DirPager {
+
+bool start(const char* dir, Filter filter, Worker worker) {
+  if (CardJob::busy()) return false;
+  s_filter = filter;
+  s_worker = worker;
+  if (!s_wake) s_wake = xSemaphoreCreateBinary();
+  if (!s_pages) s_pages = (Page*)heap_caps_calloc(CACHED_PAGES, sizeof(Page), MALLOC_CAP_SPIRAM);
+  if (!s_wake || !s_pages) return false;
+  open(dir);
+  return CardJob::start(JOB_NAME, CardJob::Access::Raw, browseJob, nullptr, STACK_BYTES);
+}
+
+void stop() {
+  if (!running()) return;
+  CardJob::cancel();
+  xSemaphoreGive(s_wake);
+}
+
+void wake() {
+  if (s_wake) xSemaphoreGive(s_wake);
+}
+
+bool running() {
+  return CardJob::busy() && CardJob::status().name == JOB_NAME;
+}
+
+void open(const char* dir) {
+  portENTER_CRITICAL(&s_lock);
+  strlcpy(s_path, dir, sizeof(s_path));
+  s_gen++;
+  s_listing     = {};
+  s_wantedCount = 0;
+  portEXIT_CRITICAL(&s_lock);
+  wake();
+}
+
+const char* path() { return s_path; }
+
+Listing listing() {
+  portENTER_CRITICAL(&s_lock);
+  const Listing l = s_listing;
+  portEXIT_CRITICAL(&s_lock);
+  return l;
+}
+
+bool get(uint32_t index, Item& out) {
+  const uint32_t page = index / PAGE_ENTRIES;
+  bool found = false, queued = false;
+  portENTER_CRITICAL(&s_lock);
+  if (index < s_listing.count) {
+    Page* p = findPage(page);
+    if (p && index % PAGE_ENTRIES < p->count) {
+      out     = p->items[index % PAGE_ENTRIES];
+      p->used = ++s_tick;
+      found   = true;
+    } else if (!p) {
+      uint32_t i = 0;
+      while (i < s_wantedCount && s_wanted[i] != page) i++;
+      if (i == s_wantedCount) {
+        if (s_wantedCount == WANTED) memmove(s_wanted, s_wanted + 1, --s_wantedCount * sizeof(uint32_t));
+        s_wanted[s_wantedCount++] = page;
+        queued = true;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&s_lock);
+  if (queued) xSemaphoreGive(s_wake);
+  return found;
+}
+
+} // namespace DirPager
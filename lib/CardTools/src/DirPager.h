@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include "FatVolume.h"
+
+// One directory at a time for the file browser, read in pages on demand.
+// A long-running raw CardJob ("file browser") owns the card while the
+// browser is open, so the UI never waits on card I/O. For the whole
+// directory only where each page starts is kept (16 bytes per 32 entries);
+// entries themselves live in a few LRU pages in PSRAM. The directory is
+// counted in the background once its first page is in, so a folder of 20k
+// photos opens at once and its length grows as counting goes on. Entries
+// come in on-disk order (sorting would mean reading them all first).
+namespace DirPager {
+
+  static constexpr uint32_t PAGE_ENTRIES = 32;
+  static constexpr uint32_t CACHED_PAGES = 8;
+  static constexpr uint32_t MAX_ENTRIES  = 1u << 20;   // counting stops here
+
+  struct Item {
+    char     name[FatVolume::MAX_PATH];
+    uint64_t size;
+    uint32_t mtime;           // FAT date << 16 | time
+    uint32_t firstCluster;    // for raw reads of the data on the job task
+    bool     contiguous;
+    bool     dir;
+  };
+
+  struct Listing {
+    uint32_t count;           // entries counted so far
+    bool     complete;        // counting reached the end
+    bool     failed;          // folder not found or unreadable
+  };
+
+  // Entries to list (all if none)
+  using Filter = bool (*)(const char* name, bool dir);
+  // Extra work done on the job task between page reads, one piece per call
+  // (the thumbnail decoder); returns false when it has nothing to do.
+  using Worker = bool (*)();
+
+  // Start the job on `path` ("/" or "/DCIM/100CANON"); false if the card is
+  // busy or missing. stop() ends it and releases the card.
+  bool start(const char* path, Filter filter = nullptr, Worker worker = nullptr);
+  void stop();
+  bool running();
+  // New work for the worker: don't let the job sleep.
+  void wake();
+
+  // Switch to another directory of the running job.
+  void open(const char* path);
+  const char* path();
+  Listing listing();
+
+  // Copy entry `index` of the current directory; false while its page is
+  // still being read (it is queued, ask again on the next refresh).
+  bool get(uint32_t index, Item& out);
+
+} // namespace DirPager
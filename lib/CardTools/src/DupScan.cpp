@@ -0,0 +1,427 @@
+#include "DupScan.h"
+#include "CardJob.h"
+#include "Digest.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using DupScan::PROBE_BYTES;
+using FatVolume::Entry;
+
+static constexpr uint32_t    SECTOR        = SdCard::SECTOR_SIZE;
+static constexpr uint32_t    CHUNK_SECTORS = 64;            // 32 KB, internal DMA RAM
+static constexpr uint32_t    FIRST_FILES   = 4096;
+static constexpr uint32_t    FIRST_DIRS    = 256;
+static constexpr size_t      FIRST_NAMES   = 64 * 1024;
+static constexpr uint32_t    ROOT          = 0;
+static const char* const     SKIP_DIR      = "System Volume Information";   // host metadata
+
+struct File {
+  uint64_t size;
+  uint32_t cluster;
+  uint32_t dir        : 31;
+  uint32_t contiguous : 1;
+  uint32_t name;            // into the name pool
+  uint32_t probe;           // xxHash32 of head and tail; 0 until probed
+};
+
+struct Dir {
+  uint32_t parent;
+  uint32_t name;
+};
+
+struct Scan {
+  File*    files;           // PSRAM
+  size_t   fileCap;
+  uint32_t fileCount;
+  Dir*     dirs;
+  size_t   dirCap;
+  uint32_t dirCount;
+  char*    names;
+  size_t   namesCap;
+  size_t   namesUsed;
+  uint32_t stack[FatVolume::MAX_DEPTH + 1];   // dir at each depth
+  bool     failed;                            // out of memory during the walk
+  uint8_t* buf;                               // CHUNK_SECTORS, DMA
+  DupScan::Result* r;
+};
+
+static DupScan::Result* s_result  = nullptr;   // PSRAM, last completed scan; loop task only
+static DupScan::Result* s_pending = nullptr;   // handed over by the job, under s_lock
+static portMUX_TYPE     s_lock    = portMUX_INITIALIZER_UNLOCKED;
+
+// Double a PSRAM array until it holds `need` elements.
+static bool reserve(void** p, size_t* cap, size_t need, size_t elem, size_t first) {
+  if (need <= *cap) return true;
+  size_t n = *cap ? *cap : first;
+  while (n < need) n *= 2;
+  void* q = heap_caps_realloc(*p, n * elem, MALLOC_CAP_SPIRAM);
+  if (!q) return false;
+  *p   = q;
+  *cap = n;
+  return true;
+}
+
+static uint32_t addName(Scan& s, const char* name) {
+  const size_t len = strlen(name) + 1;
+  if (!reserve((void**)&s.names, &s.namesCap, s.namesUsed + len, 1, FIRST_NAMES)) return UINT32_MAX;
+  memcpy(s.names + s.namesUsed, name, len);
+  s.namesUsed += len;
+  return s.namesUsed - len;
+}
+
+static void filePath(const Scan& s, const File& f, char* out, size_t len) {
+  uint32_t chain[FatVolume::MAX_DEPTH + 1];
+  uint32_t depth = 0;
+  for (uint32_t d = f.dir; d != ROOT && depth <= (uint32_t)FatVolume::MAX_DEPTH; d = s.dirs[d].parent) chain[depth++] = d;
+  size_t used = 0;
+  out[0] = '\0';
+  while (depth--) {
+    const int n = snprintf(out + used, len - used, "/%s", s.names + s.dirs[chain[depth]].name);
+    if (n < 0 || used + n >= len) return;
+    used += n;
+  }
+  snprintf(out + used, len - used, "/%s", s.names + f.name);
+}
+
+// ---------------- 1. Walk: sizes, no data ----------------
+static FileWalk::Action visitEntry(const Entry& e, void* arg) {
+  Scan& s = *(Scan*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  if (s.failed) return FileWalk::Action::Skip;
+  if (e.dir) {
+    if (e.depth == 0 && strcmp(e.name, SKIP_DIR) == 0) return FileWalk::Action::Skip;
+    const uint32_t name = addName(s, e.name);
+    if (name == UINT32_MAX || !reserve((void**)&s.dirs, &s.dirCap, s.dirCount + 1, sizeof(Dir), FIRST_DIRS)) {
+      s.failed = true;
+      return FileWalk::Action::Skip;
+    }
+    s.dirs[s.dirCount] = { s.stack[e.depth], name };
+    s.stack[e.depth + 1] = s.dirCount++;
+    CardJob::setItem(e.path);
+    return FileWalk::Action::Continue;
+  }
+  if (!e.size || !FatVolume::isCluster(e.firstCluster)) return FileWalk::Action::Continue;
+  s.r->files++;
+  if (s.fileCount >= DupScan::MAX_FILES) {
+    s.r->dropped++;
+    return FileWalk::Action::Continue;
+  }
+  const uint32_t name = addName(s, e.name);
+  if (name == UINT32_MAX || !reserve((void**)&s.files, &s.fileCap, s.fileCount + 1, sizeof(File), FIRST_FILES)) {
+    s.failed = true;
+    return FileWalk::Action::Skip;
+  }
+  File& f = s.files[s.fileCount++];
+  f.size       = e.size;
+  f.cluster    = e.firstCluster;
+  f.dir        = s.stack[e.depth];
+  f.contiguous = e.contiguous;
+  f.name       = name;
+  f.probe      = 0;
+  CardJob::advance(0, 1);
+  return FileWalk::Action::Continue;
+}
+
+// ---------------- Reading file data ----------------
+static inline uint32_t nextCluster(const File& f, uint32_t c) {
+  return f.contiguous ? c + 1 : FatVolume::next(c);
+}
+
+// Feed bytes [offset, offset + len) of the file to h, reading runs of
+// consecutive clusters with one command each. False on a read error, a
+// broken chain or cancel.
+static bool hashRange(Scan& s, const File& f, uint64_t offset, uint64_t len, Digest::Hasher& h) {
+  const FatVolume::Info& vi = FatVolume::info();
+  const uint64_t end = offset + len;
+  uint64_t pos = offset;
+  uint32_t index = (uint32_t)(pos / vi.clusterBytes);   // of cluster c in the file
+  uint32_t c = f.cluster;
+  for (uint32_t i = 0; i < index && FatVolume::isCluster(c); ++i) c = nextCluster(f, c);
+
+  while (pos < end) {
+    if (CardJob::cancelled() || !FatVolume::isCluster(c)) return false;
+    const uint32_t first = (uint32_t)(pos % vi.clusterBytes) / SECTOR;
+    const uint32_t need  = (uint32_t)((end - (pos - pos % SECTOR) + SECTOR - 1) / SECTOR);
+    uint32_t sectors = vi.spc - first;
+    for (uint32_t last = c; sectors < need && sectors + vi.spc <= CHUNK_SECTORS;) {
+      const uint32_t n = nextCluster(f, last);
+      if (n != last + 1 || !FatVolume::isCluster(n)) break;
+      last = n;
+      sectors += vi.spc;
+    }
+    sectors = min(min(sectors, need), CHUNK_SECTORS);
+    if (!SdCard::read(s.buf, FatVolume::clusterLba(c) + first, sectors)) return false;
+    CardJob::countIo((uint64_t)sectors * SECTOR, 0);
+
+    const uint32_t skip  = (uint32_t)(pos % SECTOR);
+    const uint32_t bytes = (uint32_t)min<uint64_t>((uint64_t)sectors * SECTOR - skip, end - pos);
+    h.update(s.buf + skip, bytes);
+    s.r->bytesRead += bytes;
+    CardJob::advance(bytes);
+    pos += bytes;
+
+    // On to the cluster holding pos
+    for (const uint32_t to = (uint32_t)(pos / vi.clusterBytes); index < to && pos < end; ++index) {
+      c = nextCluster(f, c);
+    }
+  }
+  return true;
+}
+
+// ---------------- 2. Probe, 3. full hash ----------------
+static bool probe(Scan& s, File& f, Digest::Hasher& h) {
+  uint8_t d[4];
+  h.reset();
+  if (!hashRange(s, f, 0, PROBE_BYTES, h) || !hashRange(s, f, f.size - PROBE_BYTES, PROBE_BYTES, h)) return false;
+  h.finish(d);
+  f.probe = (uint32_t)d[0] << 24 | d[1] << 16 | d[2] << 8 | d[3];
+  return true;
+}
+
+// Runs of at least two entries of order[] that same() puts together
+template <typename Same, typename Fn>
+static void forEachRun(const uint32_t* order, uint32_t n, Same same, Fn fn) {
+  for (uint32_t i = 0; i < n;) {
+    uint32_t j = i + 1;
+    while (j < n && same(order[i], order[j])) j++;
+    if (j - i >= 2) fn(i, j);
+    i = j;
+  }
+}
+
+// Keep the listed groups sorted by reclaimable space, most first.
+static void rank(Scan& s, const uint32_t* members, uint32_t copies) {
+  DupScan::Result& r = *s.r;
+  const uint32_t cb = FatVolume::info().clusterBytes;
+  const uint64_t size = s.files[members[0]].size;
+  const uint64_t waste = (size + cb - 1) / cb * cb * (copies - 1);
+  uint32_t pos = r.listed;
+  while (pos > 0) {
+    const DupScan::Group& g = r.list[pos - 1];
+    if ((g.size + cb - 1) / cb * cb * (g.copies - 1) >= waste) break;
+    pos--;
+  }
+  if (pos >= DupScan::MAX_GROUPS) return;
+  const uint32_t last = min(r.listed, DupScan::MAX_GROUPS - 1);
+  memmove(&r.list[pos + 1], &r.list[pos], (last - pos) * sizeof(DupScan::Group));
+  DupScan::Group& g = r.list[pos];
+  g.size   = size;
+  g.copies = copies;
+  g.paths  = min(copies, DupScan::MAX_PATHS);
+  for (uint32_t i = 0; i < g.paths; ++i) filePath(s, s.files[members[i]], g.path[i], sizeof(g.path[i]));
+  if (r.listed < DupScan::MAX_GROUPS) r.listed++;
+}
+
+static bool compare(Scan& s) {
+  DupScan::Result& r = *s.r;
+  const uint32_t n = s.fileCount;
+  File* files = s.files;
+  uint32_t* order = (uint32_t*)heap_caps_malloc(max<size_t>(n, 1) * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  if (!order) return false;
+  for (uint32_t i = 0; i < n; ++i) order[i] = i;
+
+  // 2. Same size: probe head and tail (small files skip to the full hash)
+  CardJob::setItem("grouping by size");
+  std::sort(order, order + n, [files](uint32_t a, uint32_t b) { return files[a].size > files[b].size; });
+  uint64_t probeBytes = 0;
+  forEachRun(order, n, [files](uint32_t a, uint32_t b) { return files[a].size == files[b].size; },
+             [&](uint32_t i, uint32_t j) {
+               r.sameSize += j - i;
+               if (files[order[i]].size > 2 * PROBE_BYTES) probeBytes += (uint64_t)(j - i) * 2 * PROBE_BYTES;
+             });
+  CardJob::setTotal(probeBytes);
+  Digest::Hasher xxh(Digest::Algo::Xxh32);
+  bool ok = true;
+  char path[FatVolume::MAX_PATH];
+  forEachRun(order, n, [files](uint32_t a, uint32_t b) { return files[a].size == files[b].size; },
+             [&](uint32_t i, uint32_t j) {
+               if (!ok || files[order[i]].size <= 2 * PROBE_BYTES) return;
+               for (uint32_t k = i; k < j && ok; ++k) {
+                 filePath(s, files[order[k]], path, sizeof(path));
+                 CardJob::setItem(path);
+                 // An unreadable file keeps probe 0 and fails again in full
+                 ok = probe(s, files[order[k]], xxh) || !CardJob::cancelled();
+                 r.probed++;
+               }
+             });
+
+  // 3. Same size and probe: read in full
+  auto sameProbe = [files](uint32_t a, uint32_t b) {
+    return files[a].size == files[b].size && files[a].probe == files[b].probe;
+  };
+  std::sort(order, order + n, [files](uint32_t a, uint32_t b) {
+    return files[a].size != files[b].size ? files[a].size > files[b].size : files[a].probe < files[b].probe;
+  });
+  uint32_t cand = 0;
+  uint64_t fullBytes = 0;
+  forEachRun(order, n, sameProbe, [&](uint32_t i, uint32_t j) {
+    cand += j - i;
+    fullBytes += (uint64_t)(j - i) * files[order[i]].size;
+  });
+  uint32_t* cands = (uint32_t*)heap_caps_malloc(max<size_t>(cand, 1) * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  uint8_t* digests = (uint8_t*)heap_caps_malloc(max<size_t>(cand, 1) * Digest::MAX_SIZE, MALLOC_CAP_SPIRAM);
+  Digest::Hasher sha(Digest::Algo::Sha256);
+  ok = ok && cands && digests;
+  if (ok) {
+    CardJob::setTotal(CardJob::status().done + fullBytes);
+    uint32_t c = 0;
+    forEachRun(order, n, sameProbe, [&](uint32_t i, uint32_t j) {
+      for (uint32_t k = i; k < j; ++k) cands[c++] = order[k];
+    });
+    for (uint32_t k = 0; k < cand && ok; ++k) {
+      File& f = files[cands[k]];
+      filePath(s, f, path, sizeof(path));
+      CardJob::setItem(path);
+      sha.reset();
+      if (hashRange(s, f, 0, f.size, sha)) {
+        sha.finish(digests + k * Digest::MAX_SIZE);
+      } else if (CardJob::cancelled()) {
+        ok = false;
+      } else {
+        // Unreadable: a digest no other file can have
+        memset(digests + k * Digest::MAX_SIZE, 0, Digest::MAX_SIZE);
+        memcpy(digests + k * Digest::MAX_SIZE, &k, sizeof(k));
+        Serial.printf("dups: read error, skipped %s\n", path);
+      }
+      r.hashed++;
+    }
+  }
+
+  // Sets of identical files
+  if (ok) {
+    CardJob::setItem("comparing digests");
+    uint32_t* pos = order;   // position in cands of each candidate, sorted by (size, digest)
+    for (uint32_t k = 0; k < cand; ++k) pos[k] = k;
+    auto same = [&](uint32_t a, uint32_t b) {
+      return files[cands[a]].size == files[cands[b]].size &&
+             memcmp(digests + a * Digest::MAX_SIZE, digests + b * Digest::MAX_SIZE, Digest::MAX_SIZE) == 0;
+    };
+    std::sort(pos, pos + cand, [&](uint32_t a, uint32_t b) {
+      if (files[cands[a]].size != files[cands[b]].size) return files[cands[a]].size > files[cands[b]].size;
+      const int d = memcmp(digests + a * Digest::MAX_SIZE, digests + b * Digest::MAX_SIZE, Digest::MAX_SIZE);
+      return d ? d < 0 : a < b;
+    });
+    const uint32_t cb = FatVolume::info().clusterBytes;
+    uint32_t members[DupScan::MAX_PATHS];
+    forEachRun(pos, cand, same, [&](uint32_t i, uint32_t j) {
+      const uint64_t size = files[cands[pos[i]]].size;
+      r.groups++;
+      r.duplicates  += j - i - 1;
+      r.reclaimable += (size + cb - 1) / cb * cb * (j - i - 1);
+      for (uint32_t k = 0; k < DupScan::MAX_PATHS && i + k < j; ++k) members[k] = cands[pos[i + k]];
+      rank(s, members, j - i);
+    });
+  }
+  heap_caps_free(cands);
+  heap_caps_free(digests);
+  heap_caps_free(order);
+  return ok;
+}
+
+static bool scanJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  Scan s = {};
+  s.r   = (DupScan::Result*)heap_caps_calloc(1, sizeof(DupScan::Result), MALLOC_CAP_SPIRAM);
+  s.buf = (uint8_t*)SdCard::allocBuffer(CHUNK_SECTORS * SECTOR);
+  const uint32_t root = s.r && s.buf ? addName(s, "") : UINT32_MAX;
+  bool ok = root != UINT32_MAX && reserve((void**)&s.dirs, &s.dirCap, 1, sizeof(Dir), FIRST_DIRS);
+  const char* error = "out of memory";
+  if (ok) {
+    // FAT chains are followed from PSRAM; without the copy next() reads the card
+    FatVolume::loadFat();
+    s.dirs[ROOT] = { ROOT, root };
+    s.dirCount   = 1;
+    s.stack[0]   = ROOT;
+    ok    = FatVolume::walk(visitEntry, &s) && !s.failed;
+    error = s.failed ? "out of memory for the file list" : "directory read error";
+    if (ok) {
+      ok    = compare(s);
+      error = "out of memory";
+    }
+  }
+  FatVolume::close();
+
+  DupScan::Result* r = s.r;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled");
+  } else if (!ok) {
+    CardJob::finish("%s", error);
+  } else {
+    CardJob::finish("%u sets of duplicates, %.1f MB reclaimable; %u same size, %u probed, %u read in full, %.1f MB read, %.1f s",
+                    (unsigned)r->groups, r->reclaimable / 1048576.0, (unsigned)r->sameSize, (unsigned)r->probed,
+                    (unsigned)r->hashed, r->bytesRead / 1048576.0, (esp_timer_get_time() - start) / 1e6f);
+    // The readers may be using s_result; result() adopts this one on their task
+    portENTER_CRITICAL(&s_lock);
+    std::swap(s_pending, r);
+    portEXIT_CRITICAL(&s_lock);
+  }
+  heap_caps_free(r);   // failed scan, or a result no reader has seen
+  heap_caps_free(s.buf);
+  heap_caps_free(s.files);
+  heap_caps_free(s.dirs);
+  heap_caps_free(s.names);
+  return ok && !CardJob::cancelled();
+}
+
+// ---------------- Console ----------------
+static void cmdDups(Print& out, const char* args) {
+  if (strcmp(args, "report") == 0) {
+    DupScan::printResult(out);
+  } else if (*args == '\0') {
+    out.println(DupScan::start() ? "dups: scanning, \"job\" for progress, \"dups report\" for results"
+                                 : "dups: card busy or missing (unmount USB first)");
+  } else {
+    out.println("usage: dups [report]");
+  }
+}
+
+namespace DupScan {
+
+void begin() {
+  Console::add("dups", "duplicate files: [report]", cmdDups);
+}
+
+bool start() {
+  if (CardJob::busy()) return false;
+  return CardJob::start("duplicates", CardJob::Access::Raw, scanJob, nullptr, 8192);
+}
+
+const Result* result() {
+  portENTER_CRITICAL(&s_lock);
+  Result* fresh = s_pending;
+  s_pending = nullptr;
+  portEXIT_CRITICAL(&s_lock);
+  if (fresh) {
+    heap_caps_free(s_result);
+    s_result = fresh;
+  }
+  return s_result;
+}
+
+void printResult(Print& out) {
+  const Result* r = result();
+  if (!r) {
+    out.println("dups: no completed scan");
+    return;
+  }
+  out.printf("Duplicates: %u sets, %u extra copies, %.1f MB reclaimable\n", (unsigned)r->groups,
+             (unsigned)r->duplicates, r->reclaimable / 1048576.0);
+  out.printf("  files %u, same size %u, probed %u, read in full %u, %.1f MB read\n", (unsigned)r->files,
+             (unsigned)r->sameSize, (unsigned)r->probed, (unsigned)r->hashed, r->bytesRead / 1048576.0);
+  if (r->dropped) out.printf("  %u files past the first %u not compared\n", (unsigned)r->dropped, (unsigned)MAX_FILES);
+  for (uint32_t i = 0; i < r->listed; ++i) {
+    const Group& g = r->list[i];
+    out.printf("  %u x %.1f MB\n", (unsigned)g.copies, g.size / 1048576.0);
+    for (uint32_t k = 0; k < g.paths; ++k) out.printf("    %s\n", g.path[k]);
+    if (g.copies > g.paths) out.printf("    and %u more\n", (unsigned)(g.copies - g.paths));
+  }
+}
+
+} // namespace DupScan
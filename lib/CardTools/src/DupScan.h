@@ -0,0 +1,51 @@
+#pragma once
+#include <Arduino.h>
+#include "FatVolume.h"
+
+// Duplicate files ("dups" console command, Tools screen), found in stages
+// that each read as little as possible. One raw walk of the directory tree
+// groups files by size without touching their data; files that share a
+// size are told apart by an xxHash32 of their first and last PROBE_BYTES;
+// only those still colliding are read in full and compared by SHA-256.
+// Files read in full by the probe already (up to 2 x PROBE_BYTES) go
+// straight to SHA-256. Reclaimable space is the clusters taken by every
+// copy but one.
+namespace DupScan {
+
+  static constexpr uint32_t PROBE_BYTES = 4096;
+  static constexpr uint32_t MAX_FILES   = 1u << 20;   // later files are left out
+  static constexpr uint32_t MAX_GROUPS  = 16;         // listed, most space first
+  static constexpr uint32_t MAX_PATHS   = 4;          // paths kept per listed group
+
+  struct Group {
+    uint64_t size;              // of each copy
+    uint32_t copies;
+    uint32_t paths;             // kept, up to MAX_PATHS
+    char     path[MAX_PATHS][FatVolume::MAX_PATH];
+  };
+
+  struct Result {
+    uint32_t files;             // with data
+    uint32_t sameSize;          // sharing their size with another file
+    uint32_t probed;            // head and tail hashed
+    uint32_t hashed;            // read in full
+    uint32_t groups;            // sets of identical files
+    uint32_t duplicates;        // copies beyond the first of each set
+    uint64_t reclaimable;       // bytes of clusters
+    uint64_t bytesRead;         // file data read by the probes and hashes
+    uint32_t dropped;           // past MAX_FILES, not compared
+    uint32_t listed;
+    Group    list[MAX_GROUPS];
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+  // Last completed scan, kept while a new one runs; nullptr before one.
+  // Call from the loop task only (UI and console): a scan that finished
+  // since the last call replaces the result here, never under a reader.
+  const Result* result();
+  void printResult(Print& out);
+
+} // namespace DupScan
@@ -0,0 +1,368 @@
+#include "FakeCheck.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SD_MMC.h>
+#include <SdCard.h>
+#include <errno.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <fcntl.h>
+#include <ff.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t CHUNK_SECTORS = 128;                        // 64 KB per command
+static constexpr size_t   CHUNK_BYTES   = CHUNK_SECTORS * SdCard::SECTOR_SIZE;
+static constexpr uint32_t SECTOR_WORDS  = SdCard::SECTOR_SIZE / 4;
+static constexpr uint32_t MAGIC         = 0x4B414B46;                 // "FKAK"
+static constexpr uint64_t FILE_BYTES    = 1024ull * 1024 * 1024;      // free-space mode: 1 GB per file
+static constexpr uint32_t FILE_SECTORS  = FILE_BYTES / SdCard::SECTOR_SIZE;
+static constexpr uint32_t MAX_FILES     = 2048;
+static const char* const  TEST_DIR      = "/sdcard/FAKECHK";
+
+static FakeCheck::Result s_result = {};
+
+// ---------------- Pattern ----------------
+// Every sector carries MAGIC^seed and its own position in the first words,
+// then 32-bit words from four interleaved xorshift streams seeded from the
+// position. The four lanes are independent so the core can overlap them.
+static inline uint32_t mix32(uint32_t x) {
+  x ^= x >> 16; x *= 0x7feb352d;
+  x ^= x >> 15; x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x ? x : 1;   // xorshift state must not be zero
+}
+
+static void fillSector(uint32_t* w, uint64_t pos, uint32_t seed) {
+  const uint32_t base = mix32((uint32_t)pos ^ seed) ^ (uint32_t)(pos >> 32);
+  uint32_t a = mix32(base), b = mix32(base + 1), c = mix32(base + 2), d = mix32(base + 3);
+  w[0] = MAGIC ^ seed;
+  w[1] = (uint32_t)pos;
+  w[2] = (uint32_t)(pos >> 32);
+  w[3] = ~(uint32_t)pos;
+  for (uint32_t i = 4; i < SECTOR_WORDS; i += 4) {
+    a ^= a << 13; a ^= a >> 17; a ^= a << 5;
+    b ^= b << 13; b ^= b >> 17; b ^= b << 5;
+    c ^= c << 13; c ^= c >> 17; c ^= c << 5;
+    d ^= d << 13; d ^= d >> 17; d ^= d << 5;
+    w[i] = a; w[i + 1] = b; w[i + 2] = c; w[i + 3] = d;
+  }
+}
+
+static void fillChunk(uint8_t* buf, uint64_t pos, uint32_t sectors, uint32_t seed) {
+  for (uint32_t s = 0; s < sectors; ++s) {
+    fillSector((uint32_t*)(buf + s * SdCard::SECTOR_SIZE), pos + s, seed);
+  }
+}
+
+// Per-run verify state
+struct Verify {
+  uint32_t seed;
+  uint64_t good;          // sectors
+  uint64_t firstBad;      // position, UINT64_MAX if none
+  uint32_t bad;
+  uint32_t aliased;
+  uint64_t aliasAt;       // closest alias: read at this position ...
+  uint64_t aliasFrom;     // ... the data written for this one (0, 0 if none)
+};
+
+static void markBad(Verify& v, uint64_t pos, uint32_t sectors) {
+  if (pos < v.firstBad) v.firstBad = pos;
+  v.bad += sectors;
+}
+
+static void checkChunk(Verify& v, const uint8_t* buf, uint64_t pos, uint32_t sectors) {
+  uint32_t expect[SECTOR_WORDS];
+  for (uint32_t s = 0; s < sectors; ++s) {
+    const uint32_t* got = (const uint32_t*)(buf + s * SdCard::SECTOR_SIZE);
+    fillSector(expect, pos + s, v.seed);
+    if (memcmp(got, expect, SdCard::SECTOR_SIZE) == 0) {
+      v.good++;
+      continue;
+    }
+    markBad(v, pos + s, 1);
+    // Another sector's intact header here means the card maps both
+    // positions to the same flash: the signature of a fake.
+    if (got[0] == expect[0] && got[3] == ~got[1] && (got[1] != expect[1] || got[2] != expect[2])) {
+      v.aliased++;
+      const uint64_t from = got[1] | (uint64_t)got[2] << 32;
+      if (from > pos + s && (!v.aliasFrom || from - (pos + s) < v.aliasFrom - v.aliasAt)) {
+        v.aliasAt   = pos + s;
+        v.aliasFrom = from;
+      }
+    }
+  }
+}
+
+// A wrap-around card keeps only the last write to each real sector: every
+// aliased read lies a multiple of the real size below the sector whose data
+// it returns, and about the real size in sectors reads back its own data.
+static uint64_t realSectors(uint64_t distance, uint64_t good) {
+  if (!distance || !good) return distance;
+  return distance / max<uint64_t>(1, (distance + good / 2) / good);
+}
+
+// firstBad and distance are card sectors (UINT64_MAX / 0 if unknown); good
+// counts the sectors that held their data plus those not under test.
+static void finishRun(FakeCheck::Mode mode, const Verify& v, uint64_t reported, uint64_t tested,
+                      uint64_t firstBad, uint64_t distance, uint64_t good, float wMBps, float rMBps) {
+  FakeCheck::Result r = {};
+  r.valid          = !CardJob::cancelled();
+  r.mode           = mode;
+  r.reportedBytes  = reported;
+  r.testedBytes    = tested;
+  r.goodBytes      = v.good * SdCard::SECTOR_SIZE;
+  r.firstBadOffset = firstBad == UINT64_MAX ? UINT64_MAX : firstBad * SdCard::SECTOR_SIZE;
+  r.badSectors     = v.bad;
+  r.aliasedSectors = v.aliased;
+  r.realBytes      = realSectors(distance, good) * SdCard::SECTOR_SIZE;
+  r.writeMBps      = wMBps;
+  r.readMBps       = rMBps;
+  s_result = r;
+
+  const float gb = 1024.0f * 1024.0f * 1024.0f;
+  const uint64_t card = (uint64_t)SdCard::sectorCount() * SdCard::SECTOR_SIZE;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled");
+  } else if (!v.bad) {
+    CardJob::finish("OK: %.2f GB verified, write %.1f MB/s, read %.1f MB/s", tested / gb, wMBps, rMBps);
+  } else if (r.realBytes) {
+    CardJob::finish("FAKE: %.2f GB real of %.2f GB, %u bad sectors (%u aliased)",
+                    r.realBytes / gb, card / gb, (unsigned)v.bad, (unsigned)v.aliased);
+  } else if (r.firstBadOffset != UINT64_MAX) {
+    CardJob::finish("%s: usable up to %.2f GB of %.2f GB, %u bad sectors (%u aliased)",
+                    v.aliased ? "FAKE" : "FAIL", r.firstBadOffset / gb, card / gb,
+                    (unsigned)v.bad, (unsigned)v.aliased);
+  } else {
+    CardJob::finish("%s: %u bad sectors (%u aliased)", v.aliased ? "FAKE" : "FAIL",
+                    (unsigned)v.bad, (unsigned)v.aliased);
+  }
+}
+
+static float mbps(uint64_t bytes, int64_t us) {
+  return us > 0 ? bytes / 1048576.0f / (us / 1e6f) : 0.0f;
+}
+
+// ---------------- Destructive: whole card ----------------
+static bool destructiveJob(void*) {
+  const uint32_t total = SdCard::sectorCount();
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(CHUNK_BYTES);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  Verify v = { esp_random(), 0, UINT64_MAX, 0, 0, 0, 0 };
+  CardJob::setTotal(2ull * total * SdCard::SECTOR_SIZE);
+  char item[32];
+
+  // Write everything first: a fake card only shows its wrap-around once the
+  // high addresses have overwritten the low ones.
+  const int64_t t0 = esp_timer_get_time();
+  uint32_t written = 0;
+  for (uint32_t lba = 0; lba < total && !CardJob::cancelled(); lba += CHUNK_SECTORS) {
+    const uint32_t n = min(CHUNK_SECTORS, total - lba);
+    if ((lba & 0x3FFFF) == 0) {   // every 128 MB
+      snprintf(item, sizeof(item), "write %u / %u MB", (unsigned)(lba / 2048), (unsigned)(total / 2048));
+      CardJob::setItem(item);
+    }
+    fillChunk(buf, lba, n, v.seed);
+    SdCard::write(buf, lba, n);   // failures show up in the verify pass
+    written = lba + n;
+    CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE);
+    CardJob::countIo(0, (uint64_t)n * SdCard::SECTOR_SIZE);
+  }
+  const int64_t t1 = esp_timer_get_time();
+
+  for (uint32_t lba = 0; lba < written && !CardJob::cancelled(); lba += CHUNK_SECTORS) {
+    const uint32_t n = min(CHUNK_SECTORS, written - lba);
+    if ((lba & 0x3FFFF) == 0) {
+      snprintf(item, sizeof(item), "verify %u / %u MB", (unsigned)(lba / 2048), (unsigned)(total / 2048));
+      CardJob::setItem(item);
+    }
+    if (SdCard::read(buf, lba, n)) checkChunk(v, buf, lba, n);
+    else markBad(v, lba, n);
+    CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE, 1);
+    CardJob::countIo((uint64_t)n * SdCard::SECTOR_SIZE, 0);
+  }
+  const int64_t t2 = esp_timer_get_time();
+
+  heap_caps_free(buf);
+  const uint64_t bytes = (uint64_t)written * SdCard::SECTOR_SIZE;
+  // Positions are card sectors here
+  finishRun(FakeCheck::Mode::Destructive, v, (uint64_t)total * SdCard::SECTOR_SIZE, bytes,
+            v.firstBad, v.aliasFrom - v.aliasAt, v.good, mbps(bytes, t1 - t0), mbps(bytes, t2 - t1));
+  return s_result.valid && !v.bad;
+}
+
+// ---------------- Free space: test files ----------------
+static void filePath(char* out, size_t len, uint32_t index) {
+  snprintf(out, len, "%s/%04u.bin", TEST_DIR, (unsigned)index);
+}
+
+// Card sector holding test position pos, through FatFs' view of the file;
+// UINT64_MAX if unknown. Run while the test files still exist.
+static uint64_t positionLba(uint64_t pos) {
+  char path[48];
+  snprintf(path, sizeof(path), "%s%s/%04u.bin", SdCard::FS_DRIVE, TEST_DIR + strlen(SdCard::FS_ROOT),
+           (unsigned)(pos / FILE_SECTORS));
+  FIL f;
+  if (f_open(&f, path, FA_READ) != FR_OK) return UINT64_MAX;
+  // One byte into the sector: FatFs only resolves f.sect off a sector boundary
+  const FSIZE_t ofs = (FSIZE_t)(pos % FILE_SECTORS) * SdCard::SECTOR_SIZE + 1;
+  const uint64_t lba = f_lseek(&f, ofs) == FR_OK && f.fptr == ofs ? (uint64_t)f.sect : UINT64_MAX;
+  f_close(&f);
+  return lba;
+}
+
+static void removeTestFiles() {
+  char path[48];
+  for (uint32_t i = 0; i < MAX_FILES; ++i) {
+    filePath(path, sizeof(path), i);
+    if (unlink(path) != 0) break;
+  }
+  rmdir(TEST_DIR);
+}
+
+static bool freeSpaceJob(void*) {
+  removeTestFiles();   // leftovers of an interrupted run
+  const uint64_t freeBytes = SD_MMC.totalBytes() - SD_MMC.usedBytes();
+  if (mkdir(TEST_DIR, 0777) != 0 && errno != EEXIST) {
+    CardJob::finish("cannot create %s", TEST_DIR);
+    return false;
+  }
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(CHUNK_BYTES);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  Verify v = { esp_random(), 0, UINT64_MAX, 0, 0, 0, 0 };
+  CardJob::setTotal(2 * freeBytes);
+  char path[48];
+
+  // Fill free space until the file system says it is full. Positions count
+  // sectors across the files, so a file's data can't pass for another's.
+  const int64_t t0 = esp_timer_get_time();
+  uint64_t written = 0;   // sectors
+  uint32_t files = 0;
+  bool full = false;
+  while (!full && files < MAX_FILES && !CardJob::cancelled()) {
+    filePath(path, sizeof(path), files);
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) break;
+    files++;
+    CardJob::setItem(path + strlen(SdCard::FS_ROOT) + 1);
+    for (uint32_t s = 0; s < FILE_SECTORS && !CardJob::cancelled(); s += CHUNK_SECTORS) {
+      const uint64_t pos = (uint64_t)(files - 1) * FILE_SECTORS + s;
+      fillChunk(buf, pos, CHUNK_SECTORS, v.seed);
+      const ssize_t w = write(fd, buf, CHUNK_BYTES);
+      const uint32_t got = w > 0 ? w / SdCard::SECTOR_SIZE : 0;
+      written = pos + got;
+      CardJob::advance((uint64_t)got * SdCard::SECTOR_SIZE);
+      CardJob::countIo(0, (uint64_t)got * SdCard::SECTOR_SIZE);
+      if (got < CHUNK_SECTORS) {
+        full = true;
+        break;
+      }
+    }
+    close(fd);
+  }
+  const int64_t t1 = esp_timer_get_time();
+
+  for (uint32_t f = 0; f < files && !CardJob::cancelled(); ++f) {
+    filePath(path, sizeof(path), f);
+    CardJob::setItem(path + strlen(SdCard::FS_ROOT) + 1);
+    const uint64_t first = (uint64_t)f * FILE_SECTORS;
+    const uint64_t end   = min<uint64_t>(written, first + FILE_SECTORS);
+    const int fd = open(path, O_RDONLY);
+    for (uint64_t pos = first; pos < end && !CardJob::cancelled(); pos += CHUNK_SECTORS) {
+      const uint32_t n = min<uint64_t>(CHUNK_SECTORS, end - pos);
+      const ssize_t r = fd < 0 ? -1 : read(fd, buf, (size_t)n * SdCard::SECTOR_SIZE);
+      const uint32_t got = r > 0 ? r / SdCard::SECTOR_SIZE : 0;
+      checkChunk(v, buf, pos, got);
+      if (got < n) markBad(v, pos + got, n - got);
+      CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE, 1);
+      CardJob::countIo((uint64_t)got * SdCard::SECTOR_SIZE, 0);
+    }
+    if (fd >= 0) close(fd);
+  }
+  const int64_t t2 = esp_timer_get_time();
+
+  // Positions count test data; where the card put it decides the offsets.
+  uint64_t firstBad = UINT64_MAX, distance = 0;
+  if (v.bad && !CardJob::cancelled()) {
+    if (v.firstBad != UINT64_MAX) firstBad = positionLba(v.firstBad);
+    if (v.aliasFrom) {
+      const uint64_t at = positionLba(v.aliasAt), from = positionLba(v.aliasFrom);
+      if (at != UINT64_MAX && from != UINT64_MAX && from > at) distance = from - at;
+    }
+  }
+  heap_caps_free(buf);
+  removeTestFiles();
+  const uint64_t bytes = written * SdCard::SECTOR_SIZE;
+  const uint64_t untested = SdCard::sectorCount() - freeBytes / SdCard::SECTOR_SIZE;
+  finishRun(FakeCheck::Mode::FreeSpace, v, freeBytes, bytes, firstBad, distance, v.good + untested,
+            mbps(bytes, t1 - t0), mbps(bytes, t2 - t1));
+  return s_result.valid && !v.bad;
+}
+
+// ---------------- Console ----------------
+static void printResult(Print& out) {
+  const FakeCheck::Result& r = s_result;
+  if (!r.valid) {
+    out.println("fakecheck: no completed test");
+    return;
+  }
+  const float mb = 1024.0f * 1024.0f;
+  out.printf("Fake capacity test (%s)\n", r.mode == FakeCheck::Mode::Destructive ? "whole card" : "free space");
+  out.printf("  %s      : %.0f MB\n", r.mode == FakeCheck::Mode::Destructive ? "reported" : "free    ", r.reportedBytes / mb);
+  out.printf("  tested        : %.0f MB\n", r.testedBytes / mb);
+  out.printf("  good          : %.0f MB\n", r.goodBytes / mb);
+  if (r.realBytes) {
+    out.printf("  real capacity : %.0f MB (addresses wrap around)\n", r.realBytes / mb);
+  }
+  if (r.firstBadOffset != UINT64_MAX) {
+    out.printf("  first failure : %.0f MB into the card%s\n", r.firstBadOffset / mb,
+               r.realBytes ? "" : " (usable capacity)");
+  }
+  if (r.badSectors) {
+    out.printf("  bad sectors   : %u, aliased %u\n", (unsigned)r.badSectors, (unsigned)r.aliasedSectors);
+  }
+  out.printf("  write %.1f MB/s, read %.1f MB/s\n", r.writeMBps, r.readMBps);
+  out.println(!r.badSectors ? "  verdict: OK"
+              : r.aliasedSectors ? "  verdict: FAKE (addresses wrap around)" : "  verdict: FAILING");
+}
+
+static void cmdFakecheck(Print& out, const char* args) {
+  bool started;
+  if (*args == '\0') {
+    printResult(out);
+    return;
+  } else if (strcmp(args, "free") == 0) {
+    started = FakeCheck::start(FakeCheck::Mode::FreeSpace);
+  } else if (strcmp(args, "erase yes") == 0) {
+    started = FakeCheck::start(FakeCheck::Mode::Destructive);
+  } else {
+    out.println("usage: fakecheck [free|erase yes]  (\"erase\" destroys all data)");
+    return;
+  }
+  out.println(started ? "fakecheck: started, \"job\" for progress, \"fakecheck\" for results"
+                      : "fakecheck: card busy or missing (unmount USB first)");
+}
+
+namespace FakeCheck {
+
+void begin() {
+  Console::add("fakecheck", "fake-capacity test: [free|erase yes]", cmdFakecheck);
+}
+
+bool start(Mode mode) {
+  if (mode == Mode::Destructive) {
+    return CardJob::start("fakecheck", CardJob::Access::Raw, destructiveJob, nullptr);
+  }
+  return CardJob::start("fakecheck", CardJob::Access::Files, freeSpaceJob, nullptr);
+}
+
+Result result() { return s_result; }
+
+} // namespace FakeCheck
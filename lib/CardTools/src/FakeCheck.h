@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+// Counterfeit / fake-capacity test ("fakecheck" console command, Tools screen).
+// Writes a pattern derived from each sector's position (plus a per-run seed)
+// and reads it all back: sectors that don't hold their own pattern are
+// lost, and sectors holding another position's pattern show the address
+// wrap-around typical of fake cards.
+//   Destructive - whole card through the raw host (erases everything)
+//   FreeSpace   - fills free space with test files in /FAKECHK, then removes them
+namespace FakeCheck {
+
+  enum class Mode : uint8_t { FreeSpace, Destructive };
+
+  struct Result {
+    bool     valid;           // a test ran to completion
+    Mode     mode;
+    uint64_t reportedBytes;   // what the card claims (destructive) / free space found
+    uint64_t testedBytes;
+    uint64_t goodBytes;
+    uint64_t firstBadOffset;  // card offset of the first bad sector; UINT64_MAX if none or unknown
+    uint32_t badSectors;
+    uint32_t aliasedSectors;  // held another position's data
+    uint64_t realBytes;       // flash behind a wrap-around card, from the aliased data; 0 if unknown
+    float    writeMBps;
+    float    readMBps;
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool   start(Mode mode);
+  Result result();
+
+} // namespace FakeCheck
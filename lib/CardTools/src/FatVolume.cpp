@@ -0,0 +1,748 @@
+#include "FatVolume.h"
+#include "CardJob.h"
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+
+using FatVolume::DirPos;
+using FatVolume::Entry;
+using FatVolume::Info;
+using FatVolume::Type;
+
+static constexpr uint32_t SECTOR          = SdCard::SECTOR_SIZE;
+static constexpr uint32_t STREAM_SECTORS  = 128;                    // 64 KB reads for whole-FAT/bitmap passes
+static constexpr uint32_t CACHE_SECTORS   = 8;                      // next() without a FAT copy
+static constexpr uint32_t DIR_SECTORS     = 32;                     // directory read window
+static constexpr uint32_t FAT32_MAX_DIR   = 65536 * 32;             // 64K entries
+static constexpr uint32_t EXFAT_MAX_DIR   = 256u * 1024u * 1024u;
+
+static Info      s_info     = {};
+static uint32_t* s_fat      = nullptr;   // PSRAM copy of the FAT, FAT32 entries masked to 28 bits
+static uint32_t* s_bitmap   = nullptr;   // PSRAM allocation bitmap
+static uint8_t*  s_cache    = nullptr;   // FAT sectors for next() without a copy
+static uint32_t  s_cacheLba = UINT32_MAX;
+static uint32_t* s_fatDirty = nullptr;   // FAT sectors changed in s_fat, not yet written
+static uint32_t* s_bmDirty  = nullptr;   // exFAT bitmap sectors changed in s_bitmap
+static uint8_t   s_sector[3 * SECTOR] __attribute__((aligned(4)));   // boot sectors, entry sets, RMW
+
+static inline uint16_t get16(const uint8_t* p) { return p[0] | p[1] << 8; }
+static inline uint32_t get32(const uint8_t* p) { return get16(p) | (uint32_t)get16(p + 2) << 16; }
+static inline uint64_t get64(const uint8_t* p) { return get32(p) | (uint64_t)get32(p + 4) << 32; }
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+static inline void put64(uint8_t* p, uint64_t v) { put32(p, v); put32(p + 4, v >> 32); }
+
+// Card I/O, counted so metadata scans report the bytes they moved
+static bool readSectors(void* dst, uint32_t lba, uint32_t count) {
+  if (!SdCard::read(dst, lba, count)) return false;
+  CardJob::countIo((uint64_t)count * SECTOR, 0);
+  return true;
+}
+
+static bool writeSectors(const void* src, uint32_t lba, uint32_t count) {
+  if (!SdCard::write(src, lba, count)) return false;
+  CardJob::countIo(0, (uint64_t)count * SECTOR);
+  return true;
+}
+
+// ---------------- Boot sectors ----------------
+static bool parseFat32(const uint8_t* bs, uint32_t start) {
+  if (bs[510] != 0x55 || bs[511] != 0xAA || get16(bs + 11) != SECTOR) return false;
+  const uint8_t  spc   = bs[13];
+  const uint16_t rsvd  = get16(bs + 14);
+  const uint8_t  fats  = bs[16];
+  const uint32_t fatSz = get32(bs + 36);
+  const uint32_t total = get16(bs + 19) ? get16(bs + 19) : get32(bs + 32);
+  // FAT12/16 have a fixed root directory and a 16-bit FAT size
+  if (!spc || (spc & (spc - 1)) || !rsvd || !fats || get16(bs + 17) || get16(bs + 22) || !fatSz) return false;
+  const uint32_t data = rsvd + fats * fatSz;
+  if (data >= total) return false;
+
+  Info& i = s_info;
+  i.type         = Type::Fat32;
+  i.partStart    = start;
+  i.partSectors  = total;
+  i.fatStart     = start + rsvd;
+  i.fatSectors   = fatSz;
+  i.numFats      = fats;
+  i.dataStart    = start + data;
+  i.clusters     = min((total - data) / spc, fatSz * (SECTOR / 4) - 2);
+  i.spc          = spc;
+  i.clusterBytes = spc * SECTOR;
+  i.rootCluster  = get32(bs + 44);
+  i.fsInfoLba    = start + get16(bs + 48);
+  return i.clusters >= 65525;
+}
+
+static bool parseExFat(const uint8_t* bs, uint32_t start) {
+  if (memcmp(bs + 3, "EXFAT   ", 8) != 0 || bs[108] != 9 || bs[109] > 16) return false;
+  Info& i = s_info;
+  i.type         = Type::ExFat;
+  i.partStart    = start;
+  i.partSectors  = (uint32_t)min<uint64_t>(get64(bs + 72), UINT32_MAX);
+  i.fatStart     = start + get32(bs + 80);
+  i.fatSectors   = get32(bs + 84);
+  i.numFats      = 1;                       // TexFAT's second FAT is not maintained here
+  i.dataStart    = start + get32(bs + 88);
+  i.clusters     = get32(bs + 92);
+  i.spc          = 1u << bs[109];
+  i.clusterBytes = i.spc * SECTOR;
+  i.rootCluster  = get32(bs + 96);
+  return i.clusters && (uint64_t)i.fatSectors * (SECTOR / 4) >= (uint64_t)i.clusters + 2;
+}
+
+// Bitmap and up-case table are entries of the exFAT root directory,
+// normally at its very start.
+static bool findExFatTables() {
+  const uint32_t n = min(s_info.spc, DIR_SECTORS);
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(n * SECTOR);
+  if (!buf || !FatVolume::isCluster(s_info.rootCluster) ||
+      !readSectors(buf, FatVolume::clusterLba(s_info.rootCluster), n)) {
+    heap_caps_free(buf);
+    return false;
+  }
+  for (uint32_t off = 0; off < n * SECTOR; off += 32) {
+    const uint8_t* e = buf + off;
+    if (e[0] == 0x00) break;
+    if (e[0] == 0x81 && !(e[1] & 1)) s_info.bitmapCluster = get32(e + 20);   // first bitmap only
+    if (e[0] == 0x82) {
+      s_info.upcaseCluster = get32(e + 20);
+      s_info.upcaseBytes   = get64(e + 24);
+    }
+  }
+  heap_caps_free(buf);
+  return FatVolume::isCluster(s_info.bitmapCluster);
+}
+
+// ---------------- FAT access ----------------
+static uint32_t normalize(uint32_t v) {
+  if (s_info.type == Type::Fat32) {
+    v &= 0x0FFFFFFF;
+    if (v >= 0x0FFFFFF8) return FatVolume::END;
+    if (v == 0x0FFFFFF7) return FatVolume::BAD;
+    return v;
+  }
+  return v >= 0xFFFFFFF8 ? FatVolume::END : v;
+}
+
+// Reads the FAT front to back in big transfers; fn gets consecutive runs of
+// raw entries starting at cluster `first`.
+static bool streamFat(void (*fn)(uint32_t first, const uint32_t* entries, uint32_t count, void* arg), void* arg) {
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(STREAM_SECTORS * SECTOR);
+  if (!buf) return false;
+  const uint32_t entries = s_info.clusters + 2;
+  const uint32_t sectors = (entries + SECTOR / 4 - 1) / (SECTOR / 4);
+  bool ok = true;
+  for (uint32_t s = 0; s < sectors && ok; s += STREAM_SECTORS) {
+    const uint32_t n = min(STREAM_SECTORS, sectors - s);
+    ok = readSectors(buf, s_info.fatStart + s, n);
+    const uint32_t first = s * (SECTOR / 4);
+    if (ok) fn(first, (const uint32_t*)buf, min(n * (SECTOR / 4), entries - first), arg);
+  }
+  heap_caps_free(buf);
+  return ok;
+}
+
+static void copyEntries(uint32_t first, const uint32_t* e, uint32_t count, void*) {
+  const uint32_t mask = s_info.type == Type::Fat32 ? 0x0FFFFFFF : 0xFFFFFFFF;
+  for (uint32_t i = 0; i < count; ++i) s_fat[first + i] = e[i] & mask;
+}
+
+static void markUsed(uint32_t first, const uint32_t* e, uint32_t count, void*) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t c = first + i;
+    if (c >= 2 && (e[i] & 0x0FFFFFFF)) s_bitmap[(c - 2) >> 5] |= 1u << ((c - 2) & 31);
+  }
+}
+
+// Sector `index` of the exFAT bitmap, following its cluster chain.
+static uint32_t bitmapLba(uint32_t index) {
+  uint32_t c = s_info.bitmapCluster;
+  for (uint32_t skip = index / s_info.spc; skip && FatVolume::isCluster(c); --skip) c = FatVolume::next(c);
+  return FatVolume::isCluster(c) ? FatVolume::clusterLba(c) + index % s_info.spc : 0;
+}
+
+// ---------------- Directory parsing ----------------
+enum class Parsed : uint8_t { None, Ready, DirEnd };
+
+struct Pending {
+  Entry    e;
+  uint16_t name[256];        // UTF-16
+  uint16_t nameLen;
+  uint8_t  lfnSum;           // FAT32: checksum the long name parts carry
+  bool     lfnDeleted;       // FAT32: long name parts come from deleted entries
+  uint8_t  remaining;        // exFAT: secondary entries still expected
+  uint8_t  nameChars;        // exFAT: name length from the stream extension
+  uint8_t  lbas;
+};
+
+struct Frame {
+  DirPos   pos;
+  uint16_t pathLen;          // length of this directory's path
+};
+
+// Sectors of directory data at hand; after a subdirectory the parent's
+// window is simply read again.
+struct Window {
+  uint8_t* buf;
+  uint32_t lba;
+  uint32_t count;
+};
+
+static Pending s_pend;
+static Frame   s_frames[FatVolume::MAX_DEPTH];
+static char    s_path[FatVolume::MAX_PATH];
+static Window  s_dirWin = { nullptr, UINT32_MAX, 0 };   // readDir()
+
+static void resetPending() {
+  s_pend.nameLen    = 0;
+  s_pend.remaining  = 0;
+  s_pend.lfnSum     = 0;
+  s_pend.lfnDeleted = false;
+}
+
+static uint8_t shortNameSum(const uint8_t* d) {
+  uint8_t sum = 0;
+  for (int i = 0; i < 11; ++i) sum = ((sum & 1) << 7) + (sum >> 1) + d[i];
+  return sum;
+}
+
+static Parsed parseFat32Entry(const uint8_t* d, uint32_t lba, uint16_t off, bool wantDeleted) {
+  if (d[0] == 0x00) return Parsed::DirEnd;
+  const bool    del  = d[0] == 0xE5;
+  const uint8_t attr = d[11];
+
+  if (attr == 0x0F) {
+    // Long name parts come last-first; each holds 13 UTF-16 chars. Deleted
+    // parts lost their sequence byte, so they are simply prepended in order.
+    if (del && !wantDeleted) { resetPending(); return Parsed::None; }
+    if (del ? !s_pend.lfnDeleted : (d[0] & 0x40) != 0) {
+      resetPending();
+      s_pend.lfnDeleted = del;
+      s_pend.lfnSum     = d[13];
+    } else if (!del && (s_pend.lfnDeleted || d[13] != s_pend.lfnSum)) {
+      resetPending();
+      return Parsed::None;
+    }
+    static const uint8_t POS[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    uint16_t part[13];
+    uint16_t n = 0;
+    while (n < 13 && (part[n] = get16(d + POS[n])) != 0x0000 && part[n] != 0xFFFF) n++;
+    if (s_pend.nameLen + n > 255) { resetPending(); return Parsed::None; }
+    memmove(s_pend.name + n, s_pend.name, s_pend.nameLen * 2);
+    memcpy(s_pend.name, part, n * 2);
+    s_pend.nameLen += n;
+    return Parsed::None;
+  }
+
+  if ((del && !wantDeleted) || (attr & 0x08) || (d[0] == '.' && (d[1] == ' ' || d[1] == '.'))) {
+    resetPending();   // volume label, "." and ".."
+    return Parsed::None;
+  }
+
+  Entry& e = s_pend.e;
+  const bool longName = s_pend.nameLen && (del ? s_pend.lfnDeleted : !s_pend.lfnDeleted && s_pend.lfnSum == shortNameSum(d));
+  if (!longName) {
+    // 8.3 name, with the NT lower-case flags for base and extension
+    uint16_t n = 0;
+    for (int i = 0; i < 11; ++i) {
+      if (i == 8 && d[8] != ' ') s_pend.name[n++] = '.';
+      uint8_t ch = d[i];
+      if (ch == ' ') continue;
+      if (i == 0 && del) ch = '_';            // first char lost on delete
+      else if (i == 0 && ch == 0x05) ch = 0xE5;
+      if (ch >= 'A' && ch <= 'Z' && (d[12] & (i < 8 ? 0x08 : 0x10))) ch += 'a' - 'A';
+      s_pend.name[n++] = ch;
+    }
+    s_pend.nameLen = n;
+  }
+  e.firstCluster = (uint32_t)get16(d + 20) << 16 | get16(d + 26);
+  e.attr         = attr;
+  e.dir          = attr & 0x10;
+  e.size         = e.dir ? 0 : get32(d + 28);
+  e.mtime        = (uint32_t)get16(d + 24) << 16 | get16(d + 22);
+  e.deleted      = del;
+  e.contiguous   = false;
+  e.lba[0]       = lba;
+  e.lba[1]       = e.lba[2] = 0;
+  e.offset       = off;
+  e.count        = 1;
+  return Parsed::Ready;
+}
+
+static Parsed parseExFatEntry(const uint8_t* d, uint32_t lba, uint16_t off, bool wantDeleted) {
+  const uint8_t type = d[0];
+  if (type == 0x00) return Parsed::DirEnd;
+  const bool inUse = type & 0x80;
+  Entry& e = s_pend.e;
+
+  if (!(type & 0x40)) {                       // primary entry: starts a new set
+    resetPending();
+    if ((type & 0x7F) != 0x05 || (!inUse && !wantDeleted) || d[1] < 2) return Parsed::None;
+    s_pend.remaining = d[1];
+    s_pend.nameChars = 0;
+    s_pend.lbas      = 1;
+    e.attr           = get16(d + 4);
+    e.dir            = e.attr & 0x10;
+    e.mtime          = get32(d + 12);
+    e.deleted        = !inUse;
+    e.contiguous     = false;
+    e.firstCluster   = 0;
+    e.size           = 0;
+    e.lba[0]         = lba;
+    e.lba[1]         = e.lba[2] = 0;
+    e.offset         = off;
+    e.count          = 1 + d[1];
+    return Parsed::None;
+  }
+
+  if (!s_pend.remaining) return Parsed::None;
+  if (inUse == e.deleted) {                   // secondary doesn't belong to this set
+    resetPending();
+    return Parsed::None;
+  }
+  if (lba != e.lba[s_pend.lbas - 1] && s_pend.lbas < 3) e.lba[s_pend.lbas++] = lba;
+
+  switch (type & 0x7F) {
+    case 0x40:                                // stream extension
+      e.contiguous   = d[1] & 0x02;
+      s_pend.nameChars = d[3];
+      e.firstCluster = get32(d + 20);
+      e.size         = get64(d + 24);
+      break;
+    case 0x41:                                // file name, 15 chars per entry
+      for (int i = 0; i < 15 && s_pend.nameLen < s_pend.nameChars; ++i) {
+        s_pend.name[s_pend.nameLen++] = get16(d + 2 + i * 2);
+      }
+      break;
+  }
+  if (--s_pend.remaining) return Parsed::None;
+  return s_pend.nameLen ? Parsed::Ready : Parsed::None;
+}
+
+// UTF-16 name -> UTF-8 at out; false if it doesn't fit.
+static bool appendName(char* out, size_t cap) {
+  size_t o = 0;
+  for (uint16_t i = 0; i < s_pend.nameLen; ++i) {
+    uint32_t cp = s_pend.name[i];
+    if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < s_pend.nameLen) {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (s_pend.name[++i] - 0xDC00);
+    }
+    if (cp == '/' || cp == 0) cp = '_';
+    char enc[4];
+    size_t n;
+    if (cp < 0x80) { enc[0] = cp; n = 1; }
+    else if (cp < 0x800) { enc[0] = 0xC0 | cp >> 6; enc[1] = 0x80 | (cp & 0x3F); n = 2; }
+    else if (cp < 0x10000) { enc[0] = 0xE0 | cp >> 12; enc[1] = 0x80 | (cp >> 6 & 0x3F); enc[2] = 0x80 | (cp & 0x3F); n = 3; }
+    else { enc[0] = 0xF0 | cp >> 18; enc[1] = 0x80 | (cp >> 12 & 0x3F); enc[2] = 0x80 | (cp >> 6 & 0x3F); enc[3] = 0x80 | (cp & 0x3F); n = 4; }
+    if (o + n >= cap) return false;
+    memcpy(out + o, enc, n);
+    o += n;
+  }
+  out[o] = '\0';
+  return true;
+}
+
+// Next entry set of the directory at pos, parsed into s_pend.e: Ready, or
+// DirEnd at the end of the directory (also after a read error, with *ok false).
+static Parsed readEntry(DirPos& pos, Window& w, bool deleted, bool* ok) {
+  const bool exfat = s_info.type == Type::ExFat;
+  while (pos.left && FatVolume::isCluster(pos.cluster)) {
+    if (pos.offset >= s_info.clusterBytes) {
+      pos.cluster = pos.contiguous ? pos.cluster + 1 : FatVolume::next(pos.cluster);
+      pos.offset  = 0;
+      continue;
+    }
+    const uint32_t lba = FatVolume::clusterLba(pos.cluster) + pos.offset / SECTOR;
+    if (lba < w.lba || lba >= w.lba + w.count) {
+      w.count = min(DIR_SECTORS, s_info.spc - pos.offset / SECTOR);
+      if (!readSectors(w.buf, lba, w.count)) {
+        w.lba    = UINT32_MAX;
+        pos.left = 0;
+        *ok      = false;
+        break;
+      }
+      w.lba = lba;
+    }
+    const uint16_t off = pos.offset % SECTOR;
+    const uint8_t* d   = w.buf + (lba - w.lba) * SECTOR + off;
+    pos.offset += 32;
+    pos.left    = pos.left > 32 ? pos.left - 32 : 0;
+
+    const Parsed r = exfat ? parseExFatEntry(d, lba, off, deleted) : parseFat32Entry(d, lba, off, deleted);
+    if (r == Parsed::DirEnd) pos.left = 0;
+    else if (r == Parsed::Ready) return r;
+  }
+  resetPending();
+  return Parsed::DirEnd;
+}
+
+namespace FatVolume {
+
+bool open() {
+  close();
+  if (!SdCard::isOpen() || SdCard::isFsOpen()) return false;
+  uint8_t* bs = s_sector;
+  if (!readSectors(bs, 0, 1)) return false;
+
+  s_info = {};
+  bool ok = parseExFat(bs, 0) || parseFat32(bs, 0);   // partitionless card
+  if (!ok && bs[510] == 0x55 && bs[511] == 0xAA) {
+    for (int p = 0; p < 4 && !ok; ++p) {
+      const uint8_t* pe    = bs + 446 + p * 16;
+      const uint32_t start = get32(pe + 8);
+      if (pe[4] == 0x00) continue;
+      if (pe[4] == 0xEE) break;                // GPT
+      s_info = {};
+      ok = readSectors(bs, start, 1) && (parseExFat(bs, start) || parseFat32(bs, start));
+      if (!ok && !readSectors(bs, 0, 1)) break;
+    }
+  }
+  if (!ok) {
+    s_info = {};
+    return false;
+  }
+
+  s_cache = (uint8_t*)SdCard::allocBuffer(CACHE_SECTORS * SECTOR);
+  if (!s_cache || (s_info.type == Type::ExFat && !findExFatTables())) {
+    close();
+    return false;
+  }
+  s_cacheLba = UINT32_MAX;
+  return true;
+}
+
+void close() {
+  heap_caps_free(s_fat);
+  heap_caps_free(s_bitmap);
+  heap_caps_free(s_cache);
+  heap_caps_free(s_fatDirty);
+  heap_caps_free(s_bmDirty);
+  heap_caps_free(s_dirWin.buf);
+  s_dirWin   = { nullptr, UINT32_MAX, 0 };
+  s_fatDirty = nullptr;
+  s_bmDirty  = nullptr;
+  s_fat      = nullptr;
+  s_bitmap   = nullptr;
+  s_cache    = nullptr;
+  s_cacheLba = UINT32_MAX;
+  s_info     = {};
+}
+
+bool        isOpen() { return s_info.type != Type::None; }
+const Info& info()   { return s_info; }
+
+const char* typeName() {
+  return s_info.type == Type::Fat32 ? "FAT32" : s_info.type == Type::ExFat ? "exFAT" : "none";
+}
+
+uint32_t next(uint32_t c) {
+  if (!isCluster(c)) return BAD;
+  if (s_fat) return normalize(s_fat[c]);
+  const uint32_t lba    = s_info.fatStart + c / (SECTOR / 4);
+  const uint32_t window = lba - (lba - s_info.fatStart) % CACHE_SECTORS;
+  if (window != s_cacheLba) {
+    const uint32_t n = min(CACHE_SECTORS, s_info.fatStart + s_info.fatSectors - window);
+    if (!readSectors(s_cache, window, n)) {
+      s_cacheLba = UINT32_MAX;
+      return BAD;
+    }
+    s_cacheLba = window;
+  }
+  return normalize(get32(s_cache + (lba - window) * SECTOR + (c % (SECTOR / 4)) * 4));
+}
+
+bool loadFat() {
+  if (s_fat) return true;
+  if (!isOpen()) return false;
+  s_fat = (uint32_t*)heap_caps_malloc(((size_t)s_info.clusters + 2) * 4, MALLOC_CAP_SPIRAM);
+  if (!s_fat) return false;
+  if (!streamFat(copyEntries, nullptr)) {
+    heap_caps_free(s_fat);
+    s_fat = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool fatLoaded() { return s_fat != nullptr; }
+
+const uint32_t* loadBitmap() {
+  if (s_bitmap || !isOpen()) return s_bitmap;
+  const uint32_t words = (s_info.clusters + 31) / 32;
+  s_bitmap = (uint32_t*)heap_caps_calloc(words, 4, MALLOC_CAP_SPIRAM);
+  if (!s_bitmap) return nullptr;
+
+  bool ok = true;
+  if (s_info.type == Type::Fat32) {
+    if (s_fat) markUsed(0, s_fat, s_info.clusters + 2, nullptr);
+    else ok = streamFat(markUsed, nullptr);
+  } else {
+    // exFAT: copy the on-disk bitmap, a cluster run at a time
+    uint8_t* buf = (uint8_t*)SdCard::allocBuffer(STREAM_SECTORS * SECTOR);
+    const uint32_t bytes = (s_info.clusters + 7) / 8;
+    uint32_t done = 0;
+    ok = buf != nullptr;
+    for (uint32_t c = s_info.bitmapCluster; ok && done < bytes; c = next(c)) {
+      if (!isCluster(c)) { ok = false; break; }
+      for (uint32_t s = 0; s < s_info.spc && done < bytes && ok; s += STREAM_SECTORS) {
+        const uint32_t n = min(STREAM_SECTORS, s_info.spc - s);
+        ok = readSectors(buf, clusterLba(c) + s, n);
+        const uint32_t take = min(n * SECTOR, bytes - done);
+        if (ok) memcpy((uint8_t*)s_bitmap + done, buf, take);
+        done += take;
+      }
+    }
+    heap_caps_free(buf);
+    if (s_info.clusters % 32) s_bitmap[words - 1] &= (1u << (s_info.clusters % 32)) - 1;
+  }
+  if (!ok) {
+    heap_caps_free(s_bitmap);
+    s_bitmap = nullptr;
+  }
+  return s_bitmap;
+}
+
+const uint32_t* bitmap() { return s_bitmap; }
+
+bool walk(Visitor visit, void* arg, bool deleted) {
+  if (!isOpen()) return false;
+  Window w = { (uint8_t*)SdCard::allocBuffer(DIR_SECTORS * SECTOR), UINT32_MAX, 0 };
+  if (!w.buf) return false;
+  bool ok = true;
+  int depth = 0;
+  s_path[0] = '\0';
+  s_frames[0] = { rootDir(), 0 };
+  resetPending();
+
+  while (depth >= 0) {
+    Frame& f = s_frames[depth];
+    if (readEntry(f.pos, w, deleted, &ok) == Parsed::DirEnd) {
+      if (--depth >= 0) s_path[s_frames[depth].pathLen] = '\0';
+      continue;
+    }
+
+    Entry& e = s_pend.e;
+    s_path[f.pathLen] = '/';
+    const bool fits = appendName(s_path + f.pathLen + 1, sizeof(s_path) - f.pathLen - 1);
+    resetPending();
+    if (!fits) {
+      s_path[f.pathLen] = '\0';
+      continue;
+    }
+    e.path  = s_path;
+    e.name  = s_path + f.pathLen + 1;
+    e.depth = depth;
+    const FileWalk::Action a = visit(e, arg);
+    if (a == FileWalk::Action::Stop) {
+      ok = false;
+      break;
+    }
+    if (a == FileWalk::Action::Continue && e.dir && depth + 1 < MAX_DEPTH && isCluster(e.firstCluster)) {
+      s_frames[++depth] = { dirOf(e), (uint16_t)strlen(s_path) };
+    } else {
+      s_path[f.pathLen] = '\0';
+    }
+  }
+  heap_caps_free(w.buf);
+  return ok;
+}
+
+DirPos rootDir() {
+  return { s_info.rootCluster, 0, s_info.type == Type::ExFat ? EXFAT_MAX_DIR : FAT32_MAX_DIR, false };
+}
+
+DirPos dirOf(const Entry& e) {
+  // A deleted FAT32 directory lost its chain: only its first cluster is
+  // read. exFAT keeps the chain (or NoFatChain run) and the size.
+  const uint32_t left = s_info.type == Type::ExFat ? (uint32_t)min<uint64_t>(e.size, EXFAT_MAX_DIR)
+                      : e.deleted ? s_info.clusterBytes : FAT32_MAX_DIR;
+  return { e.firstCluster, 0, left, e.contiguous };
+}
+
+bool readDir(DirPos& pos, Entry& e, bool* ok) {
+  bool readOk = true;
+  if (ok) *ok = true;
+  if (!isOpen()) return false;
+  if (!s_dirWin.buf) {
+    s_dirWin = { (uint8_t*)SdCard::allocBuffer(DIR_SECTORS * SECTOR), UINT32_MAX, 0 };
+    if (!s_dirWin.buf) {
+      if (ok) *ok = false;
+      return false;
+    }
+  }
+  resetPending();
+  while (readEntry(pos, s_dirWin, false, &readOk) == Parsed::Ready) {
+    const bool fits = appendName(s_path, sizeof(s_path));
+    resetPending();
+    if (!fits) continue;
+    e       = s_pend.e;
+    e.path  = s_path;
+    e.name  = s_path;
+    e.depth = 0;
+    return true;
+  }
+  if (ok) *ok = readOk;
+  return false;
+}
+
+bool find(const char* path, Entry& e) {
+  DirPos pos = rootDir();
+  bool found = false;
+  while (true) {
+    while (*path == '/') path++;
+    if (!*path) return found;
+    if (found) {
+      if (!e.dir) return false;
+      pos = dirOf(e);
+    }
+    const char* end = strchr(path, '/');
+    const size_t len = end ? (size_t)(end - path) : strlen(path);
+    found = false;
+    while (!found && readDir(pos, e)) {
+      found = strncasecmp(e.name, path, len) == 0 && e.name[len] == '\0';
+    }
+    if (!found) return false;
+    path += len;
+  }
+}
+
+// ---------------- Writes ----------------
+bool setNext(uint32_t c, uint32_t value) {
+  if (!isCluster(c)) return false;
+  const bool fat32 = s_info.type == Type::Fat32;
+  const uint32_t raw = fat32 ? (value == END ? 0x0FFFFFFF : value & 0x0FFFFFFF) : value;
+  if (fat32 && s_bitmap) {
+    if (raw) s_bitmap[(c - 2) >> 5] |= 1u << ((c - 2) & 31);
+    else s_bitmap[(c - 2) >> 5] &= ~(1u << ((c - 2) & 31));
+  }
+  const uint32_t rel = c / (SECTOR / 4);
+  if (s_fat) {
+    if (!s_fatDirty) s_fatDirty = (uint32_t*)heap_caps_calloc(s_info.fatSectors / 32 + 1, 4, MALLOC_CAP_SPIRAM);
+    if (s_fatDirty) {
+      s_fat[c] = raw;
+      s_fatDirty[rel >> 5] |= 1u << (rel & 31);
+      return true;
+    }
+  }
+
+  for (uint8_t k = 0; k < s_info.numFats; ++k) {
+    const uint32_t lba = s_info.fatStart + k * s_info.fatSectors + rel;
+    if (!readSectors(s_sector, lba, 1)) return false;
+    uint8_t* p = s_sector + (c % (SECTOR / 4)) * 4;
+    put32(p, fat32 ? (get32(p) & 0xF0000000) | raw : raw);   // FAT32 keeps the top 4 bits
+    if (!writeSectors(s_sector, lba, 1)) return false;
+    if (k == 0 && lba >= s_cacheLba && lba < s_cacheLba + CACHE_SECTORS) {
+      memcpy(s_cache + (lba - s_cacheLba) * SECTOR, s_sector, SECTOR);
+    }
+  }
+  if (s_fat) s_fat[c] = raw;
+  return true;
+}
+
+bool setAllocated(uint32_t c, bool used) {
+  if (!isCluster(c)) return false;
+  if (s_info.type != Type::ExFat) return true;
+  const uint32_t bit = c - 2;
+  const uint32_t sector = bit / 8 / SECTOR;
+  if (s_bitmap) {
+    if (used) s_bitmap[bit >> 5] |= 1u << (bit & 31);
+    else s_bitmap[bit >> 5] &= ~(1u << (bit & 31));
+    if (!s_bmDirty) s_bmDirty = (uint32_t*)heap_caps_calloc((s_info.clusters / 8 / SECTOR) / 32 + 1, 4, MALLOC_CAP_SPIRAM);
+    if (s_bmDirty) {
+      s_bmDirty[sector >> 5] |= 1u << (sector & 31);
+      return true;
+    }
+  }
+  const uint32_t lba = bitmapLba(sector);
+  if (!lba || !readSectors(s_sector, lba, 1)) return false;
+  uint8_t& b = s_sector[bit / 8 % SECTOR];
+  b = used ? b | (1 << (bit % 8)) : b & ~(1 << (bit % 8));
+  return writeSectors(s_sector, lba, 1);
+}
+
+bool flush() {
+  bool ok = true;
+  if (s_fatDirty) {
+    uint8_t* buf = (uint8_t*)SdCard::allocBuffer(STREAM_SECTORS * SECTOR);
+    const bool fat32 = s_info.type == Type::Fat32;
+    const uint32_t entries = s_info.clusters + 2;
+    for (uint32_t s = 0; buf && s < s_info.fatSectors; ) {
+      if (!(s_fatDirty[s >> 5] & (1u << (s & 31)))) { ++s; continue; }
+      uint32_t n = 1;   // run of dirty sectors
+      while (n < STREAM_SECTORS && s + n < s_info.fatSectors && (s_fatDirty[(s + n) >> 5] & (1u << ((s + n) & 31)))) n++;
+      if (!readSectors(buf, s_info.fatStart + s, n)) { ok = false; break; }
+      for (uint32_t i = 0; i < n * (SECTOR / 4); ++i) {
+        const uint32_t c = s * (SECTOR / 4) + i;
+        if (c >= entries) break;
+        uint8_t* p = buf + i * 4;
+        put32(p, fat32 ? (get32(p) & 0xF0000000) | s_fat[c] : s_fat[c]);
+      }
+      for (uint8_t k = 0; k < s_info.numFats; ++k) ok &= writeSectors(buf, s_info.fatStart + k * s_info.fatSectors + s, n);
+      s += n;
+    }
+    ok &= buf != nullptr;
+    heap_caps_free(buf);
+    heap_caps_free(s_fatDirty);
+    s_fatDirty = nullptr;
+  }
+  if (s_bmDirty) {
+    const uint32_t bytes = (s_info.clusters + 7) / 8;
+    for (uint32_t s = 0; s * SECTOR < bytes; ++s) {
+      if (!(s_bmDirty[s >> 5] & (1u << (s & 31)))) continue;
+      const uint32_t lba = bitmapLba(s);
+      if (!lba || !readSectors(s_sector, lba, 1)) { ok = false; continue; }
+      memcpy(s_sector, (const uint8_t*)s_bitmap + s * SECTOR, min(SECTOR, bytes - s * SECTOR));
+      ok &= writeSectors(s_sector, lba, 1);
+    }
+    heap_caps_free(s_bmDirty);
+    s_bmDirty = nullptr;
+  }
+  return ok;
+}
+
+bool updateEntry(const Entry& e, uint32_t firstCluster, uint64_t size, bool contiguous) {
+  if (s_info.type == Type::Fat32) {
+    if (!readSectors(s_sector, e.lba[0], 1)) return false;
+    uint8_t* d = s_sector + e.offset;
+    put16(d + 20, firstCluster >> 16);
+    put16(d + 26, firstCluster);
+    if (!e.dir) put32(d + 28, (uint32_t)size);
+    return writeSectors(s_sector, e.lba[0], 1);
+  }
+
+  // exFAT: the set may span up to three sectors; patch the stream extension
+  // and recompute the set checksum over all of it. Only the sectors holding
+  // the primary entry (checksum) and the stream extension change, usually
+  // one sector, so the switch is a single atomic write. When the stream
+  // extension starts the next sector, a power loss between the two writes
+  // leaves the checksum wrong (see README, Defragment).
+  const uint32_t sectors = (e.offset + e.count * 32 + SECTOR - 1) / SECTOR;
+  if (sectors > 3) return false;
+  for (uint32_t s = 0; s < sectors; ++s) {
+    if (!e.lba[s] || !readSectors(s_sector + s * SECTOR, e.lba[s], 1)) return false;
+  }
+  uint8_t* set    = s_sector + e.offset;
+  uint8_t* stream = set + 32;
+  stream[1] = contiguous ? stream[1] | 0x02 : stream[1] & ~0x02;
+  put32(stream + 20, firstCluster);
+  put64(stream + 8, min<uint64_t>(get64(stream + 8), size));   // ValidDataLength
+  put64(stream + 24, size);
+  uint16_t sum = 0;
+  for (uint32_t i = 0; i < e.count * 32u; ++i) {
+    if (i == 2 || i == 3) continue;
+    sum = ((sum & 1) ? 0x8000 : 0) + (sum >> 1) + set[i];
+  }
+  put16(set + 2, sum);
+  const uint32_t streamSector = (e.offset + 32) / SECTOR;
+  if (streamSector && !writeSectors(s_sector + streamSector * SECTOR, e.lba[streamSector], 1)) return false;
+  return writeSectors(s_sector, e.lba[0], 1);
+}
+
+bool invalidateFreeCount() {
+  if (s_info.type != Type::Fat32) return true;
+  if (!readSectors(s_sector, s_info.fsInfoLba, 1) || get32(s_sector) != 0x41615252) return false;
+  put32(s_sector + 488, 0xFFFFFFFF);
+  return writeSectors(s_sector, s_info.fsInfoLba, 1);
+}
+
+} // namespace FatVolume
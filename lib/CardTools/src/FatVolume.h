@@ -0,0 +1,130 @@
+#pragma once
+#include <Arduino.h>
+#include "FileWalk.h"
+
+// The card's FAT32 or exFAT volume seen through raw sectors (card opened
+// with SdCard::begin()), for tools that need the on-disk structures rather
+// than files: consistency check, undelete scan, fragmentation, maps.
+// The volume is found through the MBR, or at sector 0 on partitionless
+// cards. FAT12/16 and GPT are not handled.
+//
+// Clusters are numbered as on disk: 2 .. clusters + 1.
+namespace FatVolume {
+
+  enum class Type : uint8_t { None, Fat32, ExFat };
+
+  // next() results besides a cluster number (same for both FAT types)
+  static constexpr uint32_t FREE = 0;
+  static constexpr uint32_t BAD  = 0xFFFFFFF7;
+  static constexpr uint32_t END  = 0xFFFFFFFF;
+
+  static constexpr size_t MAX_PATH  = FileWalk::MAX_PATH;
+  static constexpr int    MAX_DEPTH = FileWalk::MAX_DEPTH;
+
+  struct Info {
+    Type     type;
+    uint32_t partStart;
+    uint32_t partSectors;
+    uint32_t fatStart;        // LBA of the first FAT
+    uint32_t fatSectors;      // per FAT
+    uint8_t  numFats;
+    uint32_t dataStart;       // LBA of cluster 2
+    uint32_t clusters;
+    uint32_t spc;             // sectors per cluster
+    uint32_t clusterBytes;
+    uint32_t rootCluster;
+    uint32_t bitmapCluster;   // exFAT allocation bitmap (0 on FAT32)
+    uint32_t upcaseCluster;   // exFAT up-case table
+    uint64_t upcaseBytes;
+    uint32_t fsInfoLba;       // FAT32 FSInfo sector (0 on exFAT)
+  };
+
+  // False if the card isn't open raw or holds no FAT32/exFAT volume.
+  bool open();
+  // Frees the FAT copy, bitmap and caches (unflushed changes are dropped).
+  void close();
+  bool isOpen();
+  const Info& info();
+
+  inline bool     isCluster(uint32_t c) { return c >= 2 && c < info().clusters + 2; }
+  inline uint32_t clusterLba(uint32_t c) { return info().dataStart + (c - 2) * info().spc; }
+  const char*     typeName();
+
+  // ---- Allocation table ----
+  // Next cluster of c: a cluster number, FREE, BAD or END. Uses the PSRAM
+  // copy once loadFat() succeeded, else a small sector cache.
+  uint32_t next(uint32_t c);
+  // Copy the whole FAT to PSRAM in one streamed pass; false if it doesn't fit
+  // (next() keeps working from the card).
+  bool loadFat();
+  bool fatLoaded();
+
+  // Allocation bitmap in PSRAM, bit n = cluster n + 2, as 32-bit words:
+  // exFAT's own bitmap, or FAT entries != FREE on FAT32.
+  const uint32_t* loadBitmap();
+  const uint32_t* bitmap();     // nullptr until loaded
+  inline bool isAllocated(const uint32_t* bits, uint32_t c) {
+    return bits[(c - 2) >> 5] & (1u << ((c - 2) & 31));
+  }
+
+  // ---- Directory tree ----
+  struct Entry {
+    const char* path;         // "/DIR/NAME", UTF-8; valid during the visit
+    const char* name;         // last component of path
+    uint32_t    firstCluster;
+    uint64_t    size;         // bytes (0 for FAT32 directories)
+    uint32_t    mtime;        // FAT date << 16 | time
+    uint8_t     attr;         // FAT attribute bits
+    bool        dir;
+    bool        deleted;
+    bool        contiguous;   // exFAT NoFatChain: clusters are consecutive, FAT unused
+    uint8_t     depth;        // 0 = in the root directory
+    // Where the entry lives, for updateEntry()
+    uint32_t    lba[3];       // sectors of the entry (set), in order
+    uint16_t    offset;       // of the first entry in lba[0]
+    uint8_t     count;        // entries in the set (FAT32: the short entry only)
+  };
+
+  using Visitor = FileWalk::Action (*)(const Entry& e, void* arg);
+
+  // Depth-first walk of the whole tree; directories are visited before their
+  // contents. With deleted = true, deleted entries are visited as well, and
+  // deleted directories are descended into unless the visitor returns Skip
+  // (their clusters may have been reused). Returns false if stopped or
+  // unreadable.
+  bool walk(Visitor visit, void* arg, bool deleted = false);
+
+  // Place in one directory, between two entries. Saved copies let a reader
+  // come back to any point without reading what comes before it.
+  struct DirPos {
+    uint32_t cluster;
+    uint32_t offset;          // bytes into the cluster
+    uint32_t left;            // bytes of directory left
+    bool     contiguous;
+  };
+  DirPos rootDir();
+  DirPos dirOf(const Entry& e);     // contents of a directory entry
+  // Next live entry at pos, advancing it; e.path and e.name are the bare
+  // name, valid until the next call. False at the end of the directory, or
+  // on a read error if ok comes back false.
+  bool readDir(DirPos& pos, Entry& e, bool* ok = nullptr);
+  // Entry at path ("/DCIM/100CANON/IMG_0001.JPG"), names compared without
+  // case, as readDir() gives it. False if not found (the root has no entry).
+  bool find(const char* path, Entry& e);
+
+  // ---- Writes (repair, defrag) ----
+  // While the FAT copy / bitmap are loaded, changes stay in PSRAM until
+  // flush(); otherwise they go straight to the card.
+  // Set a FAT entry in every FAT copy (value: cluster, FREE or END).
+  bool setNext(uint32_t c, uint32_t value);
+  // exFAT allocation bitmap bit; no-op on FAT32 (the FAT is the allocation).
+  bool setAllocated(uint32_t c, bool used);
+  // Write pending FAT and bitmap changes, coalescing adjacent sectors.
+  bool flush();
+  // Rewrite an entry found by walk() with a new start, size and (exFAT)
+  // NoFatChain flag, keeping the entry set checksum valid.
+  bool updateEntry(const Entry& e, uint32_t firstCluster, uint64_t size, bool contiguous);
+  // FAT32: mark the FSInfo free count unknown so hosts recount it.
+  bool invalidateFreeCount();
+
+} // namespace FatVolume
@@ -0,0 +1,327 @@
+#include "FileView.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+
+using FileView::PAGE_BYTES;
+
+static constexpr const char* JOB_NAME     = "file viewer";
+static constexpr uint32_t    SECTOR       = SdCard::SECTOR_SIZE;
+static constexpr uint32_t    PAGE_SECTORS = PAGE_BYTES / SECTOR;
+static constexpr uint32_t    WANTED       = 8;        // pages queued by read(), newest served first
+static constexpr uint32_t    MAP_STEP     = 4096;     // clusters mapped between page reads
+static constexpr uint32_t    FIRST_EXTENTS = 16;
+static constexpr uint32_t    FAT_STREAM_GAIN = 16;    // lone FAT sector reads that cost one streamed
+
+struct Page {
+  uint32_t index;
+  uint32_t used;            // LRU tick
+  bool     ready;           // false while the job fills it
+  uint8_t  data[PAGE_BYTES];
+};
+
+// Run of consecutive clusters of the file
+struct Extent {
+  uint32_t index;           // of its first cluster in the file
+  uint32_t cluster;
+  uint32_t count;
+};
+
+// Shared with the UI, under s_lock
+static portMUX_TYPE      s_lock  = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_wake  = nullptr;
+static Page*             s_pages = nullptr;          // CACHED_PAGES, PSRAM
+static uint32_t          s_tick  = 0;
+static uint32_t          s_wanted[WANTED];
+static uint32_t          s_wantedCount = 0;
+static FileView::Info    s_info  = {};
+static char              s_path[FatVolume::MAX_PATH];   // set before the job starts
+static bool              s_raw   = false;
+
+// Job only
+static Extent*  s_ext      = nullptr;                // PSRAM
+static uint32_t s_extCap   = 0;
+static uint32_t s_extCount = 0;
+static uint32_t s_mapped   = 0;                      // clusters mapped
+static uint32_t s_chain    = 0;                      // next cluster to map
+static bool     s_contiguous = false;
+static bool     s_fatWanted  = false;                // load the FAT copy after the first step
+static uint8_t* s_io       = nullptr;                // DMA buffer, one page
+
+static Page* findPage(uint32_t index) {
+  for (uint32_t i = 0; i < FileView::CACHED_PAGES; ++i) {
+    Page& p = s_pages[i];
+    if (p.ready && p.index == index) return &p;
+  }
+  return nullptr;
+}
+
+static bool peekWanted(uint32_t* index) {
+  portENTER_CRITICAL(&s_lock);
+  const bool any = s_wantedCount > 0;
+  if (any) *index = s_wanted[s_wantedCount - 1];
+  portEXIT_CRITICAL(&s_lock);
+  return any;
+}
+
+static void dropWanted(uint32_t index) {
+  portENTER_CRITICAL(&s_lock);
+  for (uint32_t i = 0; i < s_wantedCount; ++i) {
+    if (s_wanted[i] == index) {
+      memmove(s_wanted + i, s_wanted + i + 1, (--s_wantedCount - i) * sizeof(uint32_t));
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+// ---------------- Extent map ----------------
+static bool addCluster(uint32_t c) {
+  if (s_extCount && s_ext[s_extCount - 1].cluster + s_ext[s_extCount - 1].count == c) {
+    s_ext[s_extCount - 1].count++;
+    return true;
+  }
+  if (s_extCount == s_extCap) {
+    const uint32_t n = s_extCap ? s_extCap * 2 : FIRST_EXTENTS;
+    Extent* q = (Extent*)heap_caps_realloc(s_ext, n * sizeof(Extent), MALLOC_CAP_SPIRAM);
+    if (!q) return false;
+    s_ext    = q;
+    s_extCap = n;
+  }
+  s_ext[s_extCount++] = { s_mapped, c, 1 };
+  return true;
+}
+
+// Follow the chain for up to MAP_STEP more clusters; false once all are mapped.
+static bool mapChunk() {
+  const uint32_t cb    = FatVolume::info().clusterBytes;
+  const uint32_t total = (uint32_t)((s_info.size + cb - 1) / cb);
+  if (s_fatWanted && s_mapped) {
+    // The opening pages are mapped through next(); the long rest of the
+    // chain goes faster from a PSRAM copy (if it doesn't fit, next() goes on)
+    s_fatWanted = false;
+    FatVolume::loadFat();
+  }
+  bool broken = false;
+  for (uint32_t n = 0; n < MAP_STEP && s_mapped < total; ++n) {
+    broken = !FatVolume::isCluster(s_chain) || !addCluster(s_chain);
+    if (broken) break;
+    s_mapped++;
+    if (s_mapped < total) s_chain = s_contiguous ? s_chain + 1 : FatVolume::next(s_chain);
+  }
+  const uint64_t bytes = min<uint64_t>((uint64_t)s_mapped * cb, s_info.size);
+  portENTER_CRITICAL(&s_lock);
+  s_info.mapped  = bytes;
+  s_info.extents = s_extCount;
+  if (broken) {
+    // Shows what the chain holds
+    s_info.size   = bytes;
+    s_info.failed = true;
+  }
+  portEXIT_CRITICAL(&s_lock);
+  return !broken && s_mapped < total;
+}
+
+// Card sector of a sector of the file
+static uint32_t sectorLba(uint64_t sector) {
+  if (s_raw) return (uint32_t)sector;
+  const uint32_t spc = FatVolume::info().spc;
+  const uint32_t ci  = (uint32_t)(sector / spc);
+  uint32_t lo = 0, hi = s_extCount;   // last extent with index <= ci
+  while (hi - lo > 1) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (s_ext[mid].index <= ci) lo = mid;
+    else hi = mid;
+  }
+  const Extent& x = s_ext[lo];
+  return FatVolume::clusterLba(x.cluster + (ci - x.index)) + sector % spc;
+}
+
+// ---------------- Pages ----------------
+static void loadPage(uint32_t index) {
+  // Reuse the least recently read page
+  portENTER_CRITICAL(&s_lock);
+  const bool cached = findPage(index);
+  Page* p = &s_pages[0];
+  for (uint32_t i = 1; i < FileView::CACHED_PAGES && p->ready; ++i) {
+    Page& q = s_pages[i];
+    if (!q.ready || q.used < p->used) p = &q;
+  }
+  if (!cached) p->ready = false;
+  const uint64_t size = s_info.size;
+  portEXIT_CRITICAL(&s_lock);
+  if (cached) return;
+
+  const uint64_t first   = (uint64_t)index * PAGE_SECTORS;
+  const uint64_t bytes   = min<uint64_t>(PAGE_BYTES, size - (uint64_t)index * PAGE_BYTES);
+  const uint32_t sectors = (uint32_t)((bytes + SECTOR - 1) / SECTOR);
+  uint32_t errors = 0;
+  for (uint32_t i = 0; i < sectors;) {
+    // One command per run of consecutive sectors
+    const uint32_t lba = sectorLba(first + i);
+    uint32_t run = 1;
+    while (i + run < sectors && sectorLba(first + i + run) == lba + run) run++;
+    if (SdCard::read(s_io + i * SECTOR, lba, run)) {
+      CardJob::countIo(run * SECTOR, 0);
+    } else {
+      memset(s_io + i * SECTOR, 0, run * SECTOR);
+      errors++;
+    }
+    i += run;
+  }
+  memcpy(p->data, s_io, sectors * SECTOR);
+  CardJob::advance(0, 1);
+
+  portENTER_CRITICAL(&s_lock);
+  p->index = index;
+  p->used  = ++s_tick;
+  p->ready = true;
+  s_info.readErrors += errors;
+  portEXIT_CRITICAL(&s_lock);
+}
+
+static bool openSource() {
+  if (s_raw) {
+    const uint64_t size = (uint64_t)SdCard::sectorCount() * SECTOR;
+    portENTER_CRITICAL(&s_lock);
+    s_info.size   = size;
+    s_info.mapped = size;
+    s_info.ready  = true;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+  }
+  FatVolume::Entry e;
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  if (!FatVolume::find(s_path, e) || e.dir) {
+    CardJob::finish("%s not found", s_path);
+    return false;
+  }
+  // Streaming the whole FAT only pays for chains long enough that reading
+  // a FAT sector per cluster would cost more
+  const uint64_t clusters = (e.size + FatVolume::info().clusterBytes - 1) / FatVolume::info().clusterBytes;
+  s_fatWanted  = !e.contiguous && clusters * FAT_STREAM_GAIN > FatVolume::info().fatSectors;
+  s_extCount   = 0;
+  s_mapped     = 0;
+  s_chain      = e.firstCluster;
+  s_contiguous = e.contiguous;
+  portENTER_CRITICAL(&s_lock);
+  s_info.size  = e.size;
+  s_info.mtime = e.mtime;
+  s_info.ready = true;
+  portEXIT_CRITICAL(&s_lock);
+  return true;
+}
+
+static bool viewJob(void*) {
+  CardJob::setItem(s_raw ? "card sectors" : s_path);
+  if (!openSource()) {
+    portENTER_CRITICAL(&s_lock);
+    s_info.failed = true;
+    portEXIT_CRITICAL(&s_lock);
+    FatVolume::close();
+    return false;
+  }
+  bool mapping = !s_raw;
+  while (!CardJob::cancelled()) {
+    // Pages on screen first, then map on; sleep once both are done
+    uint32_t index;
+    if (peekWanted(&index)) {
+      const FileView::Info vi = FileView::info();
+      const uint64_t start = (uint64_t)index * PAGE_BYTES;
+      if (start < vi.size && min<uint64_t>(start + PAGE_BYTES, vi.size) <= vi.mapped) {
+        loadPage(index);
+        dropWanted(index);
+      } else if (start < vi.size && mapping) {
+        mapping = mapChunk();   // a seek past what is mapped yet
+      } else {
+        dropWanted(index);      // past the end of a broken chain
+      }
+      continue;
+    }
+    if (mapping) {
+      mapping = mapChunk();
+      continue;
+    }
+    xSemaphoreTake(s_wake, pdMS_TO_TICKS(100));
+  }
+  FatVolume::close();
+  CardJob::finish("closed");
+  return true;
+}
+
+namespace FileView {
+
+bool start(const char* path) {
+  if (CardJob::busy()) return false;
+  if (!s_wake) s_wake = xSemaphoreCreateBinary();
+  if (!s_pages) s_pages = (Page*)heap_caps_calloc(CACHED_PAGES, sizeof(Page), MALLOC_CAP_SPIRAM);
+  if (!s_io) s_io = (uint8_t*)SdCard::allocBuffer(PAGE_BYTES);
+  if (!s_wake || !s_pages || !s_io) return false;
+  s_raw = !path;
+  strlcpy(s_path, path ? path : "", sizeof(s_path));
+  portENTER_CRITICAL(&s_lock);
+  for (uint32_t i = 0; i < CACHED_PAGES; ++i) s_pages[i].ready = false;
+  s_wantedCount = 0;
+  s_info        = {};
+  portEXIT_CRITICAL(&s_lock);
+  return CardJob::start(JOB_NAME, CardJob::Access::Raw, viewJob, nullptr);
+}
+
+void stop() {
+  if (!running()) return;
+  CardJob::cancel();
+  xSemaphoreGive(s_wake);
+}
+
+bool running() {
+  return CardJob::busy() && CardJob::status().name == JOB_NAME;
+}
+
+Info info() {
+  portENTER_CRITICAL(&s_lock);
+  const Info i = s_info;
+  portEXIT_CRITICAL(&s_lock);
+  return i;
+}
+
+uint32_t read(uint64_t offset, uint8_t* dst, uint32_t len) {
+  uint32_t copied = 0;
+  bool hit = true, queued = false;
+  portENTER_CRITICAL(&s_lock);
+  if (offset < s_info.size) {
+    const uint64_t end = offset + min<uint64_t>(len, s_info.size - offset);
+    for (uint64_t pos = offset; pos < end;) {
+      const uint32_t index = (uint32_t)(pos / PAGE_BYTES);
+      const uint32_t off   = (uint32_t)(pos % PAGE_BYTES);
+      const uint32_t n     = (uint32_t)min<uint64_t>(PAGE_BYTES - off, end - pos);
+      Page* p = findPage(index);
+      if (p && hit) {
+        memcpy(dst + copied, p->data + off, n);
+        p->used = ++s_tick;
+        copied += n;
+      } else if (!p) {
+        // Queue every missing page of the range, dropping the oldest wish
+        hit = false;
+        uint32_t i = 0;
+        while (i < s_wantedCount && s_wanted[i] != index) i++;
+        if (i == s_wantedCount) {
+          if (s_wantedCount == WANTED) memmove(s_wanted, s_wanted + 1, --s_wantedCount * sizeof(uint32_t));
+          s_wanted[s_wantedCount++] = index;
+          queued = true;
+        }
+      } else {
+        hit = false;
+      }
+      pos += n;
+    }
+  }
+  portEXIT_CRITICAL(&s_lock);
+  if (queued) xSemaphoreGive(s_wake);
+  return copied;
+}
+
+} // namespace FileView
@@ -0,0 +1,39 @@
+#pragma once
+#include <Arduino.h>
+
+// Random access to one file (or the whole card, sector view) for the text
+// and hex viewer, in fixed pages read on demand into a small LRU cache in
+// PSRAM. A long-running raw CardJob ("file viewer") owns the card while the
+// viewer is open. The file's cluster chain is turned into a list of extents
+// (runs of consecutive clusters) in the background, never reading the
+// file's data, so any offset of a 4 GB file maps to a sector by binary
+// search and a seek reads just the page it lands in. Long fragmented chains
+// switch to a PSRAM copy of the FAT after the first step.
+namespace FileView {
+
+  static constexpr uint32_t PAGE_BYTES   = 4096;
+  static constexpr uint32_t CACHED_PAGES = 32;     // 128 KB
+
+  struct Info {
+    uint64_t size;            // bytes
+    uint64_t mapped;          // bytes whose sectors are known (size once done)
+    uint32_t mtime;           // FAT date << 16 | time (0 for the card)
+    uint32_t extents;
+    uint32_t readErrors;      // sectors that failed, shown as zeros
+    bool     ready;           // file found, size valid
+    bool     failed;          // not found, not a file, or a broken chain
+  };
+
+  // Start the job on a file ("/LOGS/SYSTEM.LOG"), or on the whole card
+  // (path nullptr). False if the card is busy or missing.
+  bool start(const char* path);
+  void stop();
+  bool running();
+  Info info();
+
+  // Copy bytes from offset to dst, as far as the pages are in the cache;
+  // returns the count copied (short at the end of the file). Missing pages
+  // of the range are queued, ask again on the next refresh.
+  uint32_t read(uint64_t offset, uint8_t* dst, uint32_t len);
+
+} // namespace FileView
@@ -0,0 +1,53 @@
+#include "FileWalk.h"
+#include <dirent.h>
+
+// path holds the directory being listed; len is its length.
+static bool walkDir(char* path, size_t len, int depth, FileWalk::Visitor visit, void* arg) {
+  DIR* dir = opendir(path);
+  if (!dir) return depth > 0;  // unreadable subdirectory: skip it, keep walking
+
+  bool keepGoing = true;
+  while (keepGoing) {
+    const struct dirent* de = readdir(dir);
+    if (!de) break;
+    if (de->d_name[0] == '.' && (de->d_name[1] == '\0' || (de->d_name[1] == '.' && de->d_name[2] == '\0'))) continue;
+
+    const size_t nameLen = strlen(de->d_name);
+    if (len + 1 + nameLen >= FileWalk::MAX_PATH) {
+      Serial.printf("FileWalk: path too long, skipped: %s/%s\n", path, de->d_name);
+      continue;
+    }
+    path[len] = '/';
+    memcpy(path + len + 1, de->d_name, nameLen + 1);
+
+    const bool isDir = de->d_type == DT_DIR;
+    const FileWalk::Action act = visit(path, isDir, arg);
+    if (act == FileWalk::Action::Stop) {
+      keepGoing = false;
+    } else if (isDir && act == FileWalk::Action::Continue) {
+      if (depth + 1 >= FileWalk::MAX_DEPTH) {
+        Serial.printf("FileWalk: too deep, skipped: %s\n", path);
+      } else {
+        keepGoing = walkDir(path, len + 1 + nameLen, depth + 1, visit, arg);
+      }
+    }
+    path[len] = '\0';
+  }
+  closedir(dir);
+  return keepGoing;
+}
+
+namespace FileWalk {
+
+bool walk(const char* root, Visitor visit, void* arg) {
+  char* path = (char*)malloc(MAX_PATH);
+  if (!path) return false;
+  strlcpy(path, root, MAX_PATH);
+  size_t len = strlen(path);
+  while (len > 1 && path[len - 1] == '/') path[--len] = '\0';
+  const bool ok = walkDir(path, len, 0, visit, arg);
+  free(path);
+  return ok;
+}
+
+} // namespace FileWalk
@@ -0,0 +1,20 @@
+#pragma once
+#include <Arduino.h>
+
+// Depth-first walk of a directory tree through the VFS (card opened with
+// SdCard::beginFs()). Uses one path buffer for the whole walk, so the
+// visitor's path is only valid during the call.
+namespace FileWalk {
+
+  static constexpr size_t MAX_PATH  = 256;
+  static constexpr int    MAX_DEPTH = 32;
+
+  enum class Action : uint8_t { Continue, Skip, Stop };   // Skip: don't descend (dirs)
+
+  // Called for every file and directory (before descending into it).
+  using Visitor = Action (*)(const char* path, bool isDir, void* arg);
+
+  // Returns false if the walk was stopped or root could not be opened.
+  bool walk(const char* root, Visitor visit, void* arg);
+
+} // namespace FileWalk
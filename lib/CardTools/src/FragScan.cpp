@@ -0,0 +1,161 @@
+#include "FragScan.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+
+static FragScan::Result s_result = {};
+
+struct Scan {
+  FragScan::Result* r;       // filled by the job, copied to s_result at the end
+  uint32_t          clusterBytes;
+};
+
+// Extents of a FAT chain of n clusters; stops early on a broken chain.
+static uint32_t countExtents(uint32_t c, uint32_t n) {
+  uint32_t extents = 1;
+  for (uint32_t i = 1; i < n; ++i) {
+    const uint32_t next = FatVolume::next(c);
+    if (!FatVolume::isCluster(next)) break;
+    if (next != c + 1) extents++;
+    c = next;
+  }
+  return extents;
+}
+
+// Keep the list sorted by extents (then size), worst first.
+static void rank(FragScan::Result& r, const Entry& e, uint32_t extents) {
+  uint32_t pos = r.worstCount;
+  while (pos > 0) {
+    const FragScan::File& f = r.worst[pos - 1];
+    if (f.extents > extents || (f.extents == extents && f.size >= e.size)) break;
+    pos--;
+  }
+  if (pos >= FragScan::MAX_WORST) return;
+  const uint32_t last = min(r.worstCount, FragScan::MAX_WORST - 1);
+  memmove(&r.worst[pos + 1], &r.worst[pos], (last - pos) * sizeof(FragScan::File));
+  FragScan::File& f = r.worst[pos];
+  strlcpy(f.path, e.path, sizeof(f.path));
+  f.size    = e.size;
+  f.extents = extents;
+  if (r.worstCount < FragScan::MAX_WORST) r.worstCount++;
+}
+
+static FileWalk::Action visitEntry(const Entry& e, void* arg) {
+  Scan& s = *(Scan*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  if (e.dir) {
+    CardJob::setItem(e.path);
+    return FileWalk::Action::Continue;
+  }
+  if (!e.size || !FatVolume::isCluster(e.firstCluster)) return FileWalk::Action::Continue;
+
+  FragScan::Result& r = *s.r;
+  const uint32_t n = (uint32_t)((e.size + s.clusterBytes - 1) / s.clusterBytes);
+  const uint32_t extents = e.contiguous ? 1 : countExtents(e.firstCluster, n);
+  r.files++;
+  r.extents += extents;
+  r.bytes   += e.size;
+  if (extents > 1) {
+    r.fragmented++;
+    r.fragmentedBytes += e.size;
+    r.maxExtents = max(r.maxExtents, extents);
+    if (e.size >= FragScan::MIN_SIZE) rank(r, e, extents);
+  }
+  CardJob::advance((uint64_t)n * s.clusterBytes, 1);
+  return FileWalk::Action::Continue;
+}
+
+static bool scanJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  CardJob::setItem("reading allocation table");
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  if (!FatVolume::loadFat()) {
+    FatVolume::close();
+    CardJob::finish("not enough PSRAM for the FAT");
+    return false;
+  }
+  const FatVolume::Info& vi = FatVolume::info();
+  const uint32_t* bits = FatVolume::loadBitmap();
+  if (bits) {
+    uint64_t used = 0;
+    for (uint32_t w = 0; w < (vi.clusters + 31) / 32; ++w) used += __builtin_popcount(bits[w]);
+    CardJob::setTotal(used * vi.clusterBytes);
+  }
+
+  Scan s = {};
+  s.clusterBytes = vi.clusterBytes;
+  s.r = (FragScan::Result*)heap_caps_calloc(1, sizeof(FragScan::Result), MALLOC_CAP_SPIRAM);
+  if (!s.r) {
+    FatVolume::close();
+    CardJob::finish("out of memory");
+    return false;
+  }
+  const bool walked = FatVolume::walk(visitEntry, &s);
+  FatVolume::close();
+
+  FragScan::Result& r = *s.r;
+  const float secs = (esp_timer_get_time() - start) / 1e6f;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled after %u files", (unsigned)r.files);
+  } else if (!walked) {
+    CardJob::finish("directory read error after %u files", (unsigned)r.files);
+  } else {
+    r.valid = true;
+    r.score = r.bytes ? 100.0f * r.fragmentedBytes / r.bytes : 0;
+    s_result = r;
+    CardJob::finish("%.1f%% fragmented: %u of %u files, %.2f extents per file, %.1f s", r.score,
+                    (unsigned)r.fragmented, (unsigned)r.files, r.files ? (float)r.extents / r.files : 0.0f, secs);
+  }
+  heap_caps_free(s.r);
+  return walked && !CardJob::cancelled();
+}
+
+// ---------------- Console ----------------
+static void cmdFrag(Print& out, const char* args) {
+  if (strcmp(args, "report") == 0) {
+    FragScan::printResult(out);
+  } else if (*args == '\0') {
+    out.println(FragScan::start() ? "frag: scanning, \"job\" for progress, \"frag report\" for results"
+                                  : "frag: card busy or missing (unmount USB first)");
+  } else {
+    out.println("usage: frag [report]");
+  }
+}
+
+namespace FragScan {
+
+void begin() {
+  Console::add("frag", "fragmentation analysis: [report]", cmdFrag);
+}
+
+bool start() {
+  if (CardJob::busy()) return false;
+  return CardJob::start("fragmentation", CardJob::Access::Raw, scanJob, nullptr);
+}
+
+const Result& result() { return s_result; }
+
+void printResult(Print& out) {
+  const Result& r = s_result;
+  if (!r.valid) {
+    out.println("frag: no completed scan");
+    return;
+  }
+  out.printf("Fragmentation: %.1f%% of file data in fragmented files\n", r.score);
+  out.printf("  files %u, fragmented %u, extents %llu (max %u)\n", (unsigned)r.files, (unsigned)r.fragmented,
+             (unsigned long long)r.extents, (unsigned)r.maxExtents);
+  if (!r.worstCount) return;
+  out.printf("  most fragmented files of %u MB or more:\n", (unsigned)(MIN_SIZE >> 20));
+  for (uint32_t i = 0; i < r.worstCount; ++i) {
+    out.printf("  %6u extents %9.1f MB  %s\n", (unsigned)r.worst[i].extents, r.worst[i].size / 1048576.0,
+               r.worst[i].path);
+  }
+}
+
+} // namespace FragScan
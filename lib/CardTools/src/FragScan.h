@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+#include "FatVolume.h"
+
+// File fragmentation analysis ("frag" console command, Tools screen). Walks
+// every file's cluster chain from the PSRAM copy of the FAT (no SD read per
+// cluster) and counts its extents, runs of consecutive clusters. The score
+// is the share of file data held in files with more than one extent.
+namespace FragScan {
+
+  static constexpr uint32_t MAX_WORST = 16;                // files kept in the list
+  static constexpr uint64_t MIN_SIZE  = 1024 * 1024;       // smaller files aren't listed
+
+  struct File {
+    char     path[FatVolume::MAX_PATH];
+    uint64_t size;
+    uint32_t extents;
+  };
+
+  struct Result {
+    bool     valid;             // a scan ran to completion
+    uint32_t files;             // with data
+    uint32_t fragmented;        // more than one extent
+    uint64_t extents;
+    uint32_t maxExtents;
+    uint64_t bytes;
+    uint64_t fragmentedBytes;
+    float    score;             // % of file data in fragmented files
+    uint32_t worstCount;
+    File     worst[MAX_WORST];  // most extents first
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+  // Last completed scan (valid = false before one); the list is kept while a
+  // new scan runs.
+  const Result& result();
+  void printResult(Print& out);
+
+} // namespace FragScan
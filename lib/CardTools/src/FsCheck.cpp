@@ -0,0 +1,357 @@
+#include "FsCheck.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+
+struct Check {
+  bool            repair;
+  bool            exfat;
+  uint32_t*       owned;      // claimed by a chain found through the directories
+  uint32_t*       linked;     // target of a FAT link; chain heads are not
+  FsCheck::Report r;
+  uint32_t        listed;
+};
+
+static FsCheck::Report s_report = {};
+static bool            s_repair = false;
+
+static inline bool testBit(const uint32_t* b, uint32_t c) { return b[(c - 2) >> 5] & (1u << ((c - 2) & 31)); }
+static inline void setBit(uint32_t* b, uint32_t c) { b[(c - 2) >> 5] |= 1u << ((c - 2) & 31); }
+
+static void problem(Check& k, const char* what, const char* path, uint32_t cluster) {
+  if (k.listed++ < FsCheck::MAX_LISTED) {
+    Serial.printf("fsck: %s: %s (cluster %u)\n", what, path, (unsigned)cluster);
+  }
+}
+
+static bool claim(Check& k, uint32_t c, const char* path) {
+  if (testBit(k.owned, c)) {
+    k.r.crossLinks++;
+    problem(k, "cross-linked", path, c);
+    return false;
+  }
+  setBit(k.owned, c);
+  return true;
+}
+
+// Claims the clusters of one file or directory and compares the chain with
+// its size (UINT64_MAX: no size, FAT32 directories and the root).
+static void checkChain(Check& k, const char* path, uint32_t first, bool contiguous, uint64_t size, const Entry* e) {
+  const uint32_t cb    = FatVolume::info().clusterBytes;
+  const bool     sized = size != UINT64_MAX;
+  const uint32_t need  = sized ? (uint32_t)((size + cb - 1) / cb) : UINT32_MAX;
+  const bool     fix   = k.repair && e;
+
+  if (!first && sized && !need) return;   // empty file
+  if (!FatVolume::isCluster(first)) {
+    k.r.badChains++;
+    problem(k, first ? "bad start cluster" : "size without clusters", path, first);
+    if (fix && FatVolume::updateEntry(*e, 0, 0, false)) k.r.fixed++;
+    return;
+  }
+
+  if (contiguous) {                       // exFAT NoFatChain: size says it all
+    uint32_t n = 0;
+    for (; n < need && FatVolume::isCluster(first + n); ++n) claim(k, first + n, path);
+    CardJob::advance(n);
+    if (n < need) {
+      k.r.badChains++;
+      problem(k, "runs past the end of the volume", path, first + n);
+      if (fix && FatVolume::updateEntry(*e, first, (uint64_t)n * cb, true)) k.r.fixed++;
+    }
+    return;
+  }
+
+  uint32_t c = first, last = 0, n = 0;
+  bool broken = false, crossed = false;
+  while (!sized || n < need) {
+    if (!claim(k, c, path)) {             // also ends loops
+      crossed = true;
+      break;
+    }
+    n++;
+    last = c;
+    const uint32_t next = FatVolume::next(c);
+    if (next == FatVolume::END) {
+      c = FatVolume::END;
+      break;
+    }
+    if (!FatVolume::isCluster(next)) {    // FREE, BAD or out of range
+      broken = true;
+      break;
+    }
+    c = next;
+  }
+  CardJob::advance(n);
+  if (crossed) return;
+
+  if (broken) {
+    k.r.badChains++;
+    problem(k, "broken chain", path, last);
+    if (k.repair) FatVolume::setNext(last, FatVolume::END);
+    if (fix && (!sized || FatVolume::updateEntry(*e, first, (uint64_t)n * cb, false))) k.r.fixed++;
+    return;
+  }
+  if (!sized) return;
+  if (n == need && c != FatVolume::END) {
+    k.r.sizeMismatches++;
+    problem(k, "chain longer than size", path, c);
+    if (fix) {
+      // Only cut here: the tail may be cross-linked with a file the walk
+      // hasn't reached yet. Whatever no entry claims is freed afterwards
+      // as a lost chain.
+      if (last ? FatVolume::setNext(last, FatVolume::END) : FatVolume::updateEntry(*e, 0, 0, false)) {
+        k.r.fixed++;
+        k.linked[(c - 2) >> 5] &= ~(1u << ((c - 2) & 31));   // now a chain head
+      }
+    } else {
+      // Claim the tail so it isn't reported as lost as well
+      for (uint32_t t = c; FatVolume::isCluster(t) && !testBit(k.owned, t); t = FatVolume::next(t)) setBit(k.owned, t);
+    }
+  } else if (n < need) {
+    k.r.sizeMismatches++;
+    problem(k, "chain shorter than size", path, last);
+    if (fix && FatVolume::updateEntry(*e, first, (uint64_t)n * cb, false)) k.r.fixed++;
+  }
+}
+
+static FileWalk::Action visitEntry(const Entry& e, void* arg) {
+  Check& k = *(Check*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  if (e.dir) k.r.dirs++;
+  else k.r.files++;
+  const uint64_t size = e.dir && !k.exfat ? UINT64_MAX : e.size;
+  checkChain(k, e.path, e.firstCluster, e.contiguous, size, &e);
+  CardJob::advance(0, 1);
+  return FileWalk::Action::Continue;
+}
+
+// Main boot region against its backup (and the exFAT checksum). FAT32
+// names its backup in BPB_BkBootSec; 0 means there is none.
+static uint32_t checkBoot() {
+  const FatVolume::Info& vi = FatVolume::info();
+  const bool     exfat   = vi.type == FatVolume::Type::ExFat;
+  const uint32_t sectors = exfat ? 12 : 1;
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(2 * sectors * SdCard::SECTOR_SIZE);
+  if (!buf) return 0;
+  uint8_t* bak = buf + sectors * SdCard::SECTOR_SIZE;
+  uint32_t errors = 0;
+  if (!SdCard::read(buf, vi.partStart, sectors)) {
+    heap_caps_free(buf);
+    return 1;
+  }
+  const uint32_t backup = exfat ? 12 : (uint32_t)(buf[50] | buf[51] << 8);
+  if (backup && !SdCard::read(bak, vi.partStart + backup, sectors)) {
+    heap_caps_free(buf);
+    return 1;
+  }
+  if (exfat) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < 11 * SdCard::SECTOR_SIZE; ++i) {
+      if (i == 106 || i == 107 || i == 112) continue;    // VolumeFlags, PercentInUse
+      sum = ((sum & 1) ? 0x80000000u : 0) + (sum >> 1) + buf[i];
+    }
+    if (memcmp(buf + 11 * SdCard::SECTOR_SIZE, &sum, 4) != 0) errors++;
+    // The backup doesn't track the volume flags
+    buf[106] = bak[106]; buf[107] = bak[107]; buf[112] = bak[112];
+  }
+  if (backup && memcmp(buf, bak, sectors * SdCard::SECTOR_SIZE) != 0) errors++;
+  heap_caps_free(buf);
+  return errors;
+}
+
+// Allocated clusters no chain claimed, and (exFAT) claimed ones the bitmap
+// calls free, 32 clusters per step.
+static void scanBitmaps(Check& k, const uint32_t* alloc) {
+  const uint32_t clusters = FatVolume::info().clusters;
+  const uint32_t words    = (clusters + 31) / 32;
+  bool prevLost = false;
+  for (uint32_t w = 0; w < words && !CardJob::cancelled(); ++w) {
+    const uint32_t a     = alloc[w];
+    uint32_t       lost  = a & ~k.owned[w];
+    // Clusters marked bad belong to no chain but must never be freed
+    for (uint32_t b = 0; b < 32 && (lost >> b); ++b) {
+      if ((lost & (1u << b)) && FatVolume::next(w * 32 + b + 2) == FatVolume::BAD) lost &= ~(1u << b);
+    }
+    const uint32_t unset = k.exfat ? k.owned[w] & ~a : 0;   // FAT32: the FAT is the bitmap
+    if (unset) {
+      k.r.unmarked += __builtin_popcount(unset);
+      if (k.repair) {
+        for (uint32_t b = 0; b < 32; ++b) {
+          if (unset & (1u << b)) FatVolume::setAllocated(w * 32 + b + 2, true);
+        }
+        k.r.fixed += __builtin_popcount(unset);
+      }
+    }
+    if (!lost) {
+      prevLost = false;
+      continue;
+    }
+    k.r.lostClusters += __builtin_popcount(lost);
+    for (uint32_t b = 0; b < 32; ++b) {
+      const uint32_t c = w * 32 + b + 2;
+      if (!(lost & (1u << b))) {
+        prevLost = false;
+        continue;
+      }
+      // A chain starts where no link points; on exFAT, runs without FAT
+      // links (NoFatChain files) count as one chain.
+      const bool head = !testBit(k.linked, c) && !(k.exfat && prevLost && !FatVolume::isCluster(FatVolume::next(c - 1)));
+      if (head) {
+        k.r.lostChains++;
+        if (k.listed++ < FsCheck::MAX_LISTED) Serial.printf("fsck: lost chain at cluster %u\n", (unsigned)c);
+      }
+      prevLost = true;
+    }
+    if (k.repair) {
+      for (uint32_t b = 0; b < 32; ++b) {
+        if (!(lost & (1u << b))) continue;
+        const uint32_t c = w * 32 + b + 2;
+        if (k.exfat) FatVolume::setAllocated(c, false);
+        else FatVolume::setNext(c, FatVolume::FREE);
+      }
+    }
+  }
+  if (k.repair && k.r.lostChains) k.r.fixed += k.r.lostChains;
+}
+
+static bool checkJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  Check k = {};
+  k.repair = s_repair;
+  k.r.repair = s_repair;
+  s_report = {};
+
+  CardJob::setItem("reading boot sector");
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  const FatVolume::Info& vi = FatVolume::info();
+  k.exfat = vi.type == FatVolume::Type::ExFat;
+  const char* type = FatVolume::typeName();
+  k.r.bootErrors = checkBoot();
+
+  CardJob::setItem("reading allocation table");
+  const bool fatInRam = FatVolume::loadFat();
+  const uint32_t* alloc = FatVolume::loadBitmap();
+  const uint32_t words = (vi.clusters + 31) / 32;
+  k.owned  = (uint32_t*)heap_caps_calloc(words, 4, MALLOC_CAP_SPIRAM);
+  k.linked = (uint32_t*)heap_caps_calloc(words, 4, MALLOC_CAP_SPIRAM);
+  if (!alloc || !k.owned || !k.linked) {
+    heap_caps_free(k.owned);
+    heap_caps_free(k.linked);
+    FatVolume::close();
+    CardJob::finish("out of memory for %u clusters", (unsigned)vi.clusters);
+    return false;
+  }
+
+  uint64_t used = 0;
+  for (uint32_t w = 0; w < words; ++w) used += __builtin_popcount(alloc[w]);
+  for (uint32_t c = 2; c < vi.clusters + 2; ++c) {
+    if (!FatVolume::isAllocated(alloc, c)) continue;   // exFAT FAT entries of free clusters are stale
+    const uint32_t next = FatVolume::next(c);
+    if (FatVolume::isCluster(next)) setBit(k.linked, next);
+  }
+  CardJob::setTotal(used);
+
+  // System chains first, then every file and directory
+  CardJob::setItem("checking directories");
+  if (k.exfat) {
+    checkChain(k, "(allocation bitmap)", vi.bitmapCluster, false, (vi.clusters + 7) / 8, nullptr);
+    if (vi.upcaseCluster) checkChain(k, "(up-case table)", vi.upcaseCluster, false, vi.upcaseBytes, nullptr);
+  }
+  checkChain(k, "/", vi.rootCluster, false, UINT64_MAX, nullptr);
+  const bool walked = FatVolume::walk(visitEntry, &k);
+
+  if (walked && !CardJob::cancelled()) {
+    CardJob::setItem("looking for lost clusters");
+    scanBitmaps(k, alloc);
+  }
+  bool flushed = true;
+  if (k.repair) {
+    CardJob::setItem("writing repairs");
+    flushed = FatVolume::flush();
+    if (k.r.fixed) FatVolume::invalidateFreeCount();
+  }
+  heap_caps_free(k.owned);
+  heap_caps_free(k.linked);
+  FatVolume::close();
+
+  k.r.valid = walked && !CardJob::cancelled();
+  s_report = k.r;
+  const FsCheck::Report& r = k.r;
+  const uint32_t problems = r.lostChains + r.crossLinks + r.sizeMismatches + r.badChains + r.unmarked + r.bootErrors;
+  const float secs = (esp_timer_get_time() - start) / 1e6f;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled");
+  } else if (!walked) {
+    CardJob::finish("directory read error after %u files", (unsigned)r.files);
+  } else if (!flushed) {
+    CardJob::finish("write error while repairing");
+  } else if (!problems) {
+    CardJob::finish("%s clean: %u files, %u folders, %.1f s%s", type, (unsigned)r.files,
+                    (unsigned)r.dirs, secs, fatInRam ? "" : " (FAT read from card)");
+  } else {
+    CardJob::finish("%u lost chains (%u clusters), %u cross-links, %u size, %u broken%s, %u fixed",
+                    (unsigned)r.lostChains, (unsigned)r.lostClusters, (unsigned)r.crossLinks,
+                    (unsigned)r.sizeMismatches, (unsigned)r.badChains, r.bootErrors ? ", boot sector" : "",
+                    (unsigned)r.fixed);
+  }
+  FsCheck::printReport(Serial);
+  return k.r.valid && (!problems || (k.repair && flushed));
+}
+
+// ---------------- Console ----------------
+static void cmdFsck(Print& out, const char* args) {
+  bool repair;
+  if (*args == '\0') repair = false;
+  else if (strcmp(args, "repair yes") == 0) repair = true;
+  else if (strcmp(args, "report") == 0) {
+    FsCheck::printReport(out);
+    return;
+  } else {
+    out.println("usage: fsck [repair yes|report]");
+    return;
+  }
+  out.println(FsCheck::start(repair) ? "fsck: started, \"job\" for progress, \"fsck report\" for results"
+                                     : "fsck: card busy or missing (unmount USB first)");
+}
+
+namespace FsCheck {
+
+void begin() {
+  Console::add("fsck", "check FAT32/exFAT: [repair yes|report]", cmdFsck);
+}
+
+bool start(bool repair) {
+  if (CardJob::busy()) return false;
+  s_repair = repair;
+  return CardJob::start("fsck", CardJob::Access::Raw, checkJob, nullptr);
+}
+
+Report report() { return s_report; }
+
+void printReport(Print& out) {
+  const Report& r = s_report;
+  if (!r.valid) {
+    out.println("fsck: no completed check");
+    return;
+  }
+  out.printf("File system check%s\n", r.repair ? " and repair" : "");
+  out.printf("  files %u, folders %u\n", (unsigned)r.files, (unsigned)r.dirs);
+  out.printf("  lost chains     %u (%u clusters)\n", (unsigned)r.lostChains, (unsigned)r.lostClusters);
+  out.printf("  cross-links     %u\n", (unsigned)r.crossLinks);
+  out.printf("  size mismatches %u\n", (unsigned)r.sizeMismatches);
+  out.printf("  broken chains   %u\n", (unsigned)r.badChains);
+  out.printf("  bitmap unmarked %u\n", (unsigned)r.unmarked);
+  out.printf("  boot sector     %s\n", r.bootErrors ? "differs from backup" : "ok");
+  if (r.repair) out.printf("  fixed           %u\n", (unsigned)r.fixed);
+}
+
+} // namespace FsCheck
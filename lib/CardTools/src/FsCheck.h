@@ -0,0 +1,40 @@
+#pragma once
+#include <Arduino.h>
+
+// File system consistency check ("fsck" console command, Tools screen) for
+// the card's FAT32/exFAT volume over raw sectors. One streamed pass loads
+// the FAT (and exFAT bitmap) into PSRAM, one walk over the directories
+// claims every chain in a bit-per-cluster ownership map, and the maps are
+// then compared word by word. Three bits per cluster: a 1 TB exFAT card
+// (4M clusters) needs 1.5 MB.
+//
+// Repair (optional) frees lost clusters, cuts chains that run past the file
+// size, shrinks files whose chain ends early or is broken, and marks used
+// clusters in the exFAT bitmap. Cross-links are only reported.
+namespace FsCheck {
+
+  static constexpr uint32_t MAX_LISTED = 32;   // problems logged with their path
+
+  struct Report {
+    bool     valid;            // a check ran to completion
+    bool     repair;
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t lostChains;
+    uint32_t lostClusters;
+    uint32_t crossLinks;       // clusters claimed by more than one chain
+    uint32_t sizeMismatches;   // chain length doesn't match the size
+    uint32_t badChains;        // link to a free or out-of-range cluster
+    uint32_t unmarked;         // exFAT: used clusters free in the bitmap
+    uint32_t bootErrors;       // boot sector differs from its backup / bad checksum
+    uint32_t fixed;            // problems repaired
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool   start(bool repair);
+  Report report();
+  void   printReport(Print& out);
+
+} // namespace FsCheck
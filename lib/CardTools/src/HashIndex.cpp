@@ -0,0 +1,184 @@
+#include "HashIndex.h"
+#include <esp_heap_caps.h>
+#include <unistd.h>
+
+struct __attribute__((packed)) Header {
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  algo;
+  uint8_t  digestSize;
+  uint8_t  reserved;
+  uint32_t count;
+  uint32_t perPage;
+  uint32_t fenceOffset;
+};
+
+// Record field offsets; digest follows mtime.
+static constexpr size_t REC_KEY    = 0;
+static constexpr size_t REC_SIZE   = 8;
+static constexpr size_t REC_MTIME  = 16;
+static constexpr size_t REC_DIGEST = 20;
+
+static inline uint64_t recKey(const uint8_t* rec) {
+  uint64_t k;
+  memcpy(&k, rec + REC_KEY, sizeof(k));
+  return k;
+}
+
+static int compareKeys(const void* a, const void* b) {
+  const uint64_t ka = recKey((const uint8_t*)a), kb = recKey((const uint8_t*)b);
+  return ka < kb ? -1 : ka > kb;
+}
+
+namespace HashIndex {
+
+uint64_t pathKey(const char* relPath) {
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (const uint8_t* p = (const uint8_t*)relPath; *p; ++p) {
+    h ^= *p;
+    h *= 0x100000001B3ull;
+  }
+  return h;
+}
+
+// ---------------- Reader ----------------
+bool Reader::open(const char* file, Digest::Algo algo) {
+  close();
+  f_ = fopen(file, "rb");
+  if (!f_) return false;
+
+  Header h;
+  const size_t digestSize = Digest::size(algo);
+  if (fread(&h, sizeof(h), 1, f_) != 1 || h.magic != MAGIC || h.version != VERSION ||
+      h.algo != (uint8_t)algo || h.digestSize != digestSize || (h.count && !h.perPage)) {
+    close();
+    return false;
+  }
+  recSize_ = REC_DIGEST + digestSize;
+  count_   = h.count;
+  perPage_ = h.perPage;
+  pages_   = perPage_ ? (count_ + perPage_ - 1) / perPage_ : 0;
+
+  fence_ = (uint64_t*)heap_caps_malloc(max<size_t>(pages_, 1) * sizeof(uint64_t), MALLOC_CAP_SPIRAM);
+  page_  = (uint8_t*)heap_caps_malloc(max<size_t>(perPage_, 1) * recSize_, MALLOC_CAP_SPIRAM);
+  if (!fence_ || !page_ || fseek(f_, h.fenceOffset, SEEK_SET) != 0 ||
+      fread(fence_, sizeof(uint64_t), pages_, f_) != pages_) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void Reader::close() {
+  if (f_) fclose(f_);
+  heap_caps_free(fence_);
+  heap_caps_free(page_);
+  f_      = nullptr;
+  fence_  = nullptr;
+  page_   = nullptr;
+  pageNo_ = UINT32_MAX;
+  count_  = pages_ = 0;
+}
+
+bool Reader::loadPage(uint32_t page) {
+  if (page == pageNo_) return true;
+  pageNo_    = UINT32_MAX;
+  pageCount_ = min(perPage_, count_ - page * perPage_);
+  const long off = sizeof(Header) + (long)page * perPage_ * recSize_;
+  if (fseek(f_, off, SEEK_SET) != 0 || fread(page_, recSize_, pageCount_, f_) != pageCount_) return false;
+  pageNo_ = page;
+  return true;
+}
+
+bool Reader::find(uint64_t key, uint64_t size, uint32_t mtime, uint8_t* digest) {
+  if (!f_ || !pages_) return false;
+
+  // Last page whose first key <= key.
+  uint32_t lo = 0, hi = pages_;
+  while (hi - lo > 1) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (fence_[mid] <= key) lo = mid;
+    else hi = mid;
+  }
+  if (fence_[lo] > key || !loadPage(lo)) return false;
+
+  uint32_t a = 0, b = pageCount_;
+  while (a < b) {
+    const uint32_t mid = (a + b) / 2;
+    if (recKey(page_ + mid * recSize_) < key) a = mid + 1;
+    else b = mid;
+  }
+  if (a == pageCount_) return false;
+  const uint8_t* rec = page_ + a * recSize_;
+  uint64_t recSize;
+  uint32_t recMtime;
+  memcpy(&recSize, rec + REC_SIZE, sizeof(recSize));
+  memcpy(&recMtime, rec + REC_MTIME, sizeof(recMtime));
+  if (recKey(rec) != key || recSize != size || recMtime != mtime) return false;
+  memcpy(digest, rec + REC_DIGEST, recSize_ - REC_DIGEST);
+  return true;
+}
+
+// ---------------- Writer ----------------
+void Writer::begin(Digest::Algo algo) {
+  heap_caps_free(recs_);
+  algo_    = algo;
+  recSize_ = REC_DIGEST + Digest::size(algo);
+  recs_    = nullptr;
+  count_   = cap_ = 0;
+  failed_  = false;
+}
+
+bool Writer::add(uint64_t key, uint64_t size, uint32_t mtime, const uint8_t* digest) {
+  if (failed_) return false;
+  if (count_ == cap_) {
+    const uint32_t cap = cap_ ? cap_ + cap_ / 2 : 1024;
+    uint8_t* grown = (uint8_t*)heap_caps_realloc(recs_, (size_t)cap * recSize_, MALLOC_CAP_SPIRAM);
+    if (!grown) {
+      failed_ = true;
+      return false;
+    }
+    recs_ = grown;
+    cap_  = cap;
+  }
+  uint8_t* rec = recs_ + (size_t)count_++ * recSize_;
+  memcpy(rec + REC_KEY, &key, sizeof(key));
+  memcpy(rec + REC_SIZE, &size, sizeof(size));
+  memcpy(rec + REC_MTIME, &mtime, sizeof(mtime));
+  memcpy(rec + REC_DIGEST, digest, recSize_ - REC_DIGEST);
+  return true;
+}
+
+bool Writer::write(const char* file) {
+  if (failed_) return false;
+  qsort(recs_, count_, recSize_, compareKeys);
+
+  Header h = {};
+  h.magic       = MAGIC;
+  h.version     = VERSION;
+  h.algo        = (uint8_t)algo_;
+  h.digestSize  = recSize_ - REC_DIGEST;
+  h.count       = count_;
+  h.perPage     = PAGE_BYTES / recSize_;
+  h.fenceOffset = sizeof(Header) + count_ * recSize_;
+
+  char tmp[64];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(recs_, recSize_, count_, f) == count_;
+  for (uint32_t i = 0; ok && i < count_; i += h.perPage) {
+    const uint64_t k = recKey(recs_ + (size_t)i * recSize_);
+    ok = fwrite(&k, sizeof(k), 1, f) == 1;
+  }
+  ok = (fclose(f) == 0) && ok;
+  if (ok) {
+    unlink(file);
+    ok = rename(tmp, file) == 0;
+  } else {
+    unlink(tmp);
+  }
+  return ok;
+}
+
+} // namespace HashIndex
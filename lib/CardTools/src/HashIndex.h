@@ -0,0 +1,72 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <stdio.h>
+#include "Digest.h"
+
+// On-card index of file digests keyed by (path, size, mtime), so the hash
+// job only rereads files that changed.
+//
+// File layout (little-endian):
+//   header   magic "SDMI", version, algo, digest size, 0, count,
+//            records per page, fence offset
+//   records  count x { u64 path key, u64 size, u32 mtime, digest }, sorted by key
+//   fence    u64 first key of every page of records
+// The path key is FNV-1a 64 of the card-relative path. A lookup binary
+// searches the fence (the only part kept in RAM, ~0.2% of the file) and
+// reads a single page of records.
+namespace HashIndex {
+
+  static constexpr uint32_t MAGIC      = 0x494D4453;  // "SDMI"
+  static constexpr uint8_t  VERSION    = 1;
+  static constexpr size_t   PAGE_BYTES = 4096;
+
+  uint64_t pathKey(const char* relPath);
+
+  class Reader {
+  public:
+    ~Reader() { close(); }
+    // False if missing, corrupt or built for another algorithm.
+    bool open(const char* file, Digest::Algo algo);
+    void close();
+    bool isOpen() const { return f_ != nullptr; }
+    uint32_t count() const { return count_; }
+
+    // Digest of an unchanged file, if indexed.
+    bool find(uint64_t key, uint64_t size, uint32_t mtime, uint8_t* digest);
+
+  private:
+    bool loadPage(uint32_t page);
+
+    FILE*     f_         = nullptr;
+    size_t    recSize_   = 0;
+    uint32_t  count_     = 0;
+    uint32_t  perPage_   = 0;
+    uint32_t  pages_     = 0;
+    uint64_t* fence_     = nullptr;
+    uint8_t*  page_      = nullptr;   // one cached page of records
+    uint32_t  pageNo_    = UINT32_MAX;
+    uint32_t  pageCount_ = 0;         // records in the cached page
+  };
+
+  // Collects records in PSRAM, then sorts and writes them in one go.
+  class Writer {
+  public:
+    ~Writer() { heap_caps_free(recs_); }
+    void begin(Digest::Algo algo);
+    bool add(uint64_t key, uint64_t size, uint32_t mtime, const uint8_t* digest);  // false: out of memory
+    bool ok() const { return !failed_; }
+    uint32_t count() const { return count_; }
+    // Writes file via file.tmp + rename.
+    bool write(const char* file);
+
+  private:
+    Digest::Algo algo_    = Digest::Algo::Sha256;
+    size_t       recSize_ = 0;
+    uint8_t*     recs_    = nullptr;
+    uint32_t     count_   = 0;
+    uint32_t     cap_     = 0;
+    bool         failed_  = false;
+  };
+
+} // namespace HashIndex
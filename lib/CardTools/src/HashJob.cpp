@@ -0,0 +1,341 @@
+#include "HashJob.h"
+#include "CardJob.h"
+#include "FileWalk.h"
+#include "HashIndex.h"
+#include <Console.h>
+#include <SD_MMC.h>
+#include <SdCard.h>
+#include <Trace.h>
+#include <ctype.h>
+#include <esp_heap_caps.h>
+#include <fcntl.h>
+#include <new>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr size_t  CHUNK_BYTES = 32 * 1024;   // internal DMA RAM: no bounce copies in the SD driver
+static constexpr uint8_t SLOTS       = 2;
+
+static const char* const MANIFEST_NAMES[(size_t)Digest::Algo::Count] = { "SHA256SUMS", "CRC32.sfv", "XXH32SUMS" };
+static const char* const SKIP_DIR = "System Volume Information";  // host metadata, changes per mount
+
+enum ChunkFlags : uint8_t {
+  CHUNK_FIRST = 1,   // first chunk of a file: reset the hasher
+  CHUNK_LAST  = 2,   // last chunk: emit the manifest line
+  CHUNK_ERROR = 4,   // read failed or cancelled: drop the file
+  CHUNK_END   = 8,   // no more files
+  CHUNK_INDEX = 16,  // unchanged file: digest comes from the index, no data
+};
+
+struct Chunk {
+  uint8_t* buf;
+  size_t   len;
+  uint8_t  flags;
+  // Valid on the last chunk of a file:
+  char     path[FileWalk::MAX_PATH];
+  uint64_t key;
+  uint64_t size;
+  uint32_t mtime;
+  uint8_t  digest[Digest::MAX_SIZE];   // CHUNK_INDEX only
+};
+
+struct Run {
+  Digest::Algo      algo;
+  bool              incremental;
+  Chunk             chunks[SLOTS];
+  HashIndex::Reader index;       // previous run (reader side)
+  HashIndex::Writer fresh;       // this run (hasher side)
+  QueueHandle_t     freeQ;       // slot indices the reader may fill
+  QueueHandle_t     fullQ;       // slot indices waiting for the hasher
+  SemaphoreHandle_t hasherDone;
+  FILE*             manifest;
+  char              tmpPath[48];
+  uint32_t          files;
+  uint32_t          errors;
+  uint32_t          reused;      // files answered from the index
+  uint64_t          bytes;       // bytes actually read and hashed
+};
+
+static Digest::Algo s_algo        = Digest::Algo::Sha256;
+static bool         s_incremental = true;
+
+// ---------------- Manifest ----------------
+static const char* relPath(const char* path) {
+  const size_t rootLen = strlen(SdCard::FS_ROOT);
+  return path[rootLen] == '/' ? path + rootLen + 1 : path;
+}
+
+static void writeLine(Run& run, const char* path, const uint8_t* digest, size_t len) {
+  char hex[2 * Digest::MAX_SIZE + 1];
+  Digest::toHex(digest, len, hex);
+  const char* rel = relPath(path);
+
+  if (run.algo == Digest::Algo::Crc32) {
+    for (char* c = hex; *c; ++c) *c = toupper(*c);
+    fprintf(run.manifest, "%s %s\n", rel, hex);
+    return;
+  }
+  // sha256sum convention: names with '\' or newline are escaped and the line gets a leading '\'.
+  if (!strpbrk(rel, "\\\n")) {
+    fprintf(run.manifest, "%s  %s\n", hex, rel);
+    return;
+  }
+  fprintf(run.manifest, "\\%s  ", hex);
+  for (const char* c = rel; *c; ++c) {
+    if (*c == '\\') fputs("\\\\", run.manifest);
+    else if (*c == '\n') fputs("\\n", run.manifest);
+    else fputc(*c, run.manifest);
+  }
+  fputc('\n', run.manifest);
+}
+
+// ---------------- Hasher task (other core) ----------------
+static void hasherTask(void* p) {
+  Run& run = *(Run*)p;
+  Digest::Hasher hasher(run.algo);
+  uint8_t digest[Digest::MAX_SIZE];
+
+  for (;;) {
+    uint8_t idx;
+    xQueueReceive(run.fullQ, &idx, portMAX_DELAY);
+    Chunk& c = run.chunks[idx];
+    if (c.flags & CHUNK_END) break;
+
+    if (c.flags & CHUNK_FIRST) hasher.reset();
+    if (!(c.flags & CHUNK_ERROR) && c.len) {
+      TRACE_SCOPE_ARG("hash.update", c.len);
+      hasher.update(c.buf, c.len);
+    }
+    if (c.flags & CHUNK_LAST) {
+      if (c.flags & CHUNK_ERROR) {
+        if (!CardJob::cancelled()) {
+          run.errors++;
+          Serial.printf("hash: read error, skipped %s\n", c.path);
+        }
+      } else {
+        const uint8_t* d = c.digest;
+        if (!(c.flags & CHUNK_INDEX)) {
+          hasher.finish(digest);
+          d = digest;
+        }
+        writeLine(run, c.path, d, Digest::size(run.algo));
+        run.fresh.add(c.key, c.size, c.mtime, d);
+        run.files++;
+        CardJob::advance(0, 1);
+      }
+    }
+    xQueueSend(run.freeQ, &idx, portMAX_DELAY);
+  }
+  xSemaphoreGive(run.hasherDone);
+  vTaskDelete(nullptr);
+}
+
+// ---------------- Reader (job task) ----------------
+static uint8_t takeSlot(Run& run) {
+  uint8_t idx;
+  xQueueReceive(run.freeQ, &idx, portMAX_DELAY);
+  return idx;
+}
+
+static bool isManifest(const char* path) {
+  const char* rel = relPath(path);
+  for (const char* name : MANIFEST_NAMES) {
+    const size_t n = strlen(name);
+    if (strncmp(rel, name, n) != 0) continue;
+    const char* ext = rel + n;
+    if (!*ext || !strcmp(ext, ".tmp") || !strcmp(ext, ".idx") || !strcmp(ext, ".idx.tmp")) return true;
+  }
+  return false;
+}
+
+static FileWalk::Action readFile(const char* path, bool isDir, void* p) {
+  Run& run = *(Run*)p;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  if (isDir) {
+    return strcmp(relPath(path), SKIP_DIR) == 0 ? FileWalk::Action::Skip : FileWalk::Action::Continue;
+  }
+  if (isManifest(path)) return FileWalk::Action::Continue;
+
+  const char* rel = relPath(path);
+  CardJob::setItem(rel);
+  struct stat st;
+  if (stat(path, &st) != 0) st.st_size = -1;
+  const uint64_t key   = HashIndex::pathKey(rel);
+  const uint32_t mtime = (uint32_t)st.st_mtime;
+
+  // Unchanged since the last run: reuse the indexed digest, don't read the file.
+  uint8_t cached[Digest::MAX_SIZE];
+  if (st.st_size >= 0 && run.incremental && run.index.find(key, st.st_size, mtime, cached)) {
+    const uint8_t idx = takeSlot(run);
+    Chunk& c = run.chunks[idx];
+    c.len   = 0;
+    c.flags = CHUNK_FIRST | CHUNK_LAST | CHUNK_INDEX;
+    c.key   = key;
+    c.size  = st.st_size;
+    c.mtime = mtime;
+    memcpy(c.digest, cached, sizeof(cached));
+    strlcpy(c.path, path, sizeof(c.path));
+    xQueueSend(run.fullQ, &idx, portMAX_DELAY);
+    run.reused++;
+    CardJob::advance(st.st_size);
+    return FileWalk::Action::Continue;
+  }
+
+  const int fd = st.st_size >= 0 ? open(path, O_RDONLY) : -1;
+  uint64_t left = fd >= 0 ? (uint64_t)st.st_size : 0;
+  uint8_t flags = CHUNK_FIRST | (fd < 0 ? CHUNK_ERROR | CHUNK_LAST : 0);
+
+  do {
+    const uint8_t idx = takeSlot(run);
+    Chunk& c = run.chunks[idx];
+    c.len = 0;
+    if (!(flags & CHUNK_ERROR)) {
+      const ssize_t n = read(fd, c.buf, (size_t)min<uint64_t>(left, CHUNK_BYTES));
+      if (n < 0 || (n == 0 && left) || CardJob::cancelled()) {
+        flags |= CHUNK_ERROR | CHUNK_LAST;
+      } else {
+        c.len = n;
+        left -= n;
+        run.bytes += n;
+        CardJob::advance(n);
+        CardJob::countIo(n, 0);
+        if (!left) flags |= CHUNK_LAST;
+      }
+    }
+    c.flags = flags;
+    if (flags & CHUNK_LAST) {
+      strlcpy(c.path, path, sizeof(c.path));
+      c.key   = key;
+      c.size  = st.st_size;
+      c.mtime = mtime;
+    }
+    xQueueSend(run.fullQ, &idx, portMAX_DELAY);
+    flags &= ~CHUNK_FIRST;
+  } while (!(flags & CHUNK_LAST));
+
+  if (fd >= 0) close(fd);
+  return FileWalk::Action::Continue;
+}
+
+static bool hashJob(void*) {
+  Run* run = new (std::nothrow) Run();
+  if (!run) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  run->algo        = s_algo;
+  run->incremental = s_incremental;
+  bool ok = true;
+  for (auto& c : run->chunks) {
+    c.buf = (uint8_t*)SdCard::allocBuffer(CHUNK_BYTES);
+    ok = ok && c.buf;
+  }
+  run->freeQ      = xQueueCreate(SLOTS, sizeof(uint8_t));
+  run->fullQ      = xQueueCreate(SLOTS, sizeof(uint8_t));
+  run->hasherDone = xSemaphoreCreateBinary();
+
+  char finalPath[48], indexPath[48];
+  snprintf(finalPath, sizeof(finalPath), "%s/%s", SdCard::FS_ROOT, HashJob::manifestName(run->algo));
+  snprintf(indexPath, sizeof(indexPath), "%s.idx", finalPath);
+  snprintf(run->tmpPath, sizeof(run->tmpPath), "%s.tmp", finalPath);
+  run->fresh.begin(run->algo);
+  if (run->incremental && run->index.open(indexPath, run->algo)) {
+    Serial.printf("hash: index has %u files\n", (unsigned)run->index.count());
+  }
+  ok = ok && run->freeQ && run->fullQ && run->hasherDone;
+  if (ok) run->manifest = fopen(run->tmpPath, "w");
+  if (run->manifest) setvbuf(run->manifest, nullptr, _IOFBF, 4096);  // few, larger manifest writes
+
+  // Other core from the job task, so reading and hashing really overlap.
+  if (!ok || !run->manifest) {
+    CardJob::finish(ok ? "cannot create %s" : "out of memory", run->tmpPath);
+    ok = false;
+  } else if (xTaskCreatePinnedToCore(hasherTask, "hasher", 4096, run, 1, nullptr, 1) != pdPASS) {
+    fclose(run->manifest);
+    unlink(run->tmpPath);
+    CardJob::finish("could not start hasher task");
+    ok = false;
+  } else {
+    if (run->algo == Digest::Algo::Crc32) fprintf(run->manifest, "; generated by SD-Mounter\n");
+    for (uint8_t i = 0; i < SLOTS; ++i) xQueueSend(run->freeQ, &i, 0);
+    CardJob::setTotal(SD_MMC.usedBytes());
+
+    const uint32_t t0 = millis();
+    FileWalk::walk(SdCard::FS_ROOT, readFile, run);
+
+    const uint8_t idx = takeSlot(*run);
+    run->chunks[idx].flags = CHUNK_END;
+    xQueueSend(run->fullQ, &idx, portMAX_DELAY);
+    xSemaphoreTake(run->hasherDone, portMAX_DELAY);
+    const float secs = (millis() - t0) / 1000.0f;
+
+    const bool wrote = fclose(run->manifest) == 0;
+    if (CardJob::cancelled() || !wrote) {
+      unlink(run->tmpPath);
+      CardJob::finish(wrote ? "cancelled, previous manifest kept" : "manifest write failed");
+      ok = false;
+    } else {
+      unlink(finalPath);
+      ok = rename(run->tmpPath, finalPath) == 0;
+      run->index.close();
+      // The index only goes with a manifest that is in place
+      const bool indexed = ok && run->fresh.write(indexPath);
+      if (!indexed) {
+        Serial.println("hash: could not write index, next run will rehash everything");
+        unlink(indexPath);
+      }
+      if (!ok) {
+        CardJob::finish("could not rename the manifest to %s, left as %s",
+                        HashJob::manifestName(run->algo), run->tmpPath + strlen(SdCard::FS_ROOT) + 1);
+      } else {
+        CardJob::finish("%u files (%u unchanged), %.1f MB hashed in %.1f s (%.2f MB/s), %u errors -> %s%s",
+                        (unsigned)run->files, (unsigned)run->reused, run->bytes / 1048576.0, secs,
+                        secs > 0 ? run->bytes / 1048576.0 / secs : 0.0, (unsigned)run->errors,
+                        HashJob::manifestName(run->algo), indexed ? "" : " (index not saved)");
+      }
+    }
+  }
+
+  for (auto& c : run->chunks) heap_caps_free(c.buf);
+  if (run->freeQ) vQueueDelete(run->freeQ);
+  if (run->fullQ) vQueueDelete(run->fullQ);
+  if (run->hasherDone) vSemaphoreDelete(run->hasherDone);
+  delete run;
+  return ok;
+}
+
+// ---------------- Console ----------------
+static void cmdHash(Print& out, const char* args) {
+  Digest::Algo algo = Digest::Algo::Sha256;
+  char name[16] = "";
+  char mode[8]  = "";
+  sscanf(args, "%15s %7s", name, mode);
+  const bool full = strcmp(name, "full") == 0 || strcmp(mode, "full") == 0;
+  if ((*name && strcmp(name, "full") != 0 && !Digest::parse(name, algo)) || (*mode && !full)) {
+    out.println("usage: hash [sha256|crc32|xxh32] [full]");
+    return;
+  }
+  if (HashJob::start(algo, !full)) {
+    out.printf("hash: %s job started, see \"job\" for progress\n", Digest::name(algo));
+  } else {
+    out.println("hash: card busy or missing (unmount USB first)");
+  }
+}
+
+namespace HashJob {
+
+void begin() {
+  Console::add("hash", "hash all files to a manifest: [sha256|crc32|xxh32] [full]", cmdHash);
+}
+
+bool start(Digest::Algo algo, bool incremental) {
+  s_algo        = algo;
+  s_incremental = incremental;
+  return CardJob::start("hash", CardJob::Access::Files, hashJob, nullptr);
+}
+
+const char* manifestName(Digest::Algo algo) {
+  return algo < Digest::Algo::Count ? MANIFEST_NAMES[(size_t)algo] : "HASHES";
+}
+
+} // namespace HashJob
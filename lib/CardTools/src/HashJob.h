@@ -0,0 +1,26 @@
+#pragma once
+#include <Arduino.h>
+#include "Digest.h"
+
+// Card-wide file hashing ("hash" console command, Tools screen).
+// The job task reads each file in large chunks while a hasher task on the
+// other core digests the previous chunk (two buffers ping-pong between
+// them), so throughput is bounded by the card rather than the hash.
+// The manifest goes to the card root in the usual checker format:
+//   sha256 -> SHA256SUMS  (sha256sum -c)
+//   xxh32  -> XXH32SUMS   (xxhsum -c)
+//   crc32  -> CRC32.sfv   (SFV)
+// Next to it, <manifest>.idx (see HashIndex) remembers each file's digest by
+// path, size and mtime; incremental runs only read files that changed.
+namespace HashJob {
+
+  // Register the console command.
+  void begin();
+
+  // Start hashing every file on the card (false if the card is busy/missing).
+  // incremental=false ignores the index and rereads everything.
+  bool start(Digest::Algo algo, bool incremental = true);
+
+  const char* manifestName(Digest::Algo algo);
+
+} // namespace HashJob
@@ -0,0 +1,567 @@
+#include "MountDiff.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <Storage.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+
+static constexpr uint32_t    NONE        = UINT32_MAX;
+static constexpr uint32_t    ROOT        = 0;
+static constexpr uint32_t    FIRST_ITEMS = 4096;
+static constexpr uint32_t    FIRST_DIRS  = 256;
+static constexpr size_t      FIRST_NAMES = 16 * 1024;
+static constexpr uint32_t    MAX_CHAIN   = 1u << 16;    // clusters followed per folder
+static const char* const     SKIP_DIR    = "System Volume Information";   // host metadata
+
+// One directory entry of the snapshot
+struct Item {
+  uint32_t name;            // hash of the name
+  uint32_t meta;            // hash of size, time, attributes, start cluster
+  uint32_t dir;             // its Dir, NONE for files
+};
+
+struct Run {
+  uint32_t first;
+  uint32_t count;
+};
+
+struct Dir {
+  uint32_t cluster;
+  uint32_t size;            // exFAT bytes from its entry; 0 on FAT32
+  bool     contiguous;
+  uint32_t parent;
+  uint32_t name;            // into the name pool
+  uint32_t items;           // range in items[], sorted by name hash
+  uint32_t itemCount;
+  uint32_t runs;            // its clusters, range in runs[]
+  uint32_t runCount;
+};
+
+struct Snapshot {
+  Item*    items;           // PSRAM
+  size_t   itemCap;
+  uint32_t itemCount;
+  Dir*     dirs;
+  size_t   dirCap;
+  uint32_t dirCount;
+  Run*     runs;
+  size_t   runCap;
+  uint32_t runCount;
+  char*    names;
+  size_t   namesCap;
+  size_t   namesUsed;
+  uint64_t card;            // cardId() when taken
+  bool     ready;
+};
+
+// A folder seen by compare(): in the snapshot, on the card now, or both
+struct Pair {
+  uint32_t old;             // snapshot Dir, NONE if new
+  uint32_t cluster;         // now, if it exists
+  uint32_t size;
+  bool     contiguous;
+  bool     exists;
+  uint32_t parent;          // Pair
+  uint32_t name;            // into the compare's name pool
+};
+
+// An entry of a folder read again
+struct Current {
+  uint32_t name;
+  uint32_t meta;
+  uint32_t cluster;
+  uint32_t size;
+  bool     dir;
+  bool     contiguous;
+  uint32_t dirName;         // into the compare's name pool (folders)
+};
+
+struct Compare {
+  Pair*     pairs;
+  size_t    pairCap;
+  uint32_t  pairCount;
+  Current*  cur;
+  size_t    curCap;
+  uint8_t*  matched;        // per item of the old folder
+  size_t    matchedCap;
+  char*     names;
+  size_t    namesCap;
+  size_t    namesUsed;
+  bool      failed;         // out of memory
+  MountDiff::Result* r;
+};
+
+static Snapshot           s_snap    = {};
+static MountDiff::Result* s_result  = nullptr;   // PSRAM, last completed compare; loop task only
+static MountDiff::Result* s_pending = nullptr;   // handed over by the job, under s_lock
+static portMUX_TYPE       s_lock    = portMUX_INITIALIZER_UNLOCKED;
+
+// Double a PSRAM array until it holds `need` elements.
+static bool reserve(void** p, size_t* cap, size_t need, size_t elem, size_t first) {
+  if (need <= *cap) return true;
+  size_t n = *cap ? *cap : first;
+  while (n < need) n *= 2;
+  void* q = heap_caps_realloc(*p, n * elem, MALLOC_CAP_SPIRAM);
+  if (!q) return false;
+  *p   = q;
+  *cap = n;
+  return true;
+}
+
+static uint32_t addName(char** names, size_t* cap, size_t* used, const char* name) {
+  const size_t len = strlen(name) + 1;
+  if (!reserve((void**)names, cap, *used + len, 1, FIRST_NAMES)) return NONE;
+  memcpy(*names + *used, name, len);
+  *used += len;
+  return *used - len;
+}
+
+static uint32_t fnv32(uint32_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len--) h = (h ^ *p++) * 0x01000193u;
+  return h;
+}
+
+static uint32_t nameHash(const char* name) { return fnv32(0x811C9DC5u, name, strlen(name)); }
+
+static uint32_t metaHash(const Entry& e) {
+  uint32_t h = 0x811C9DC5u;
+  h = fnv32(h, &e.size, sizeof(e.size));
+  h = fnv32(h, &e.mtime, sizeof(e.mtime));
+  h = fnv32(h, &e.attr, sizeof(e.attr));
+  return fnv32(h, &e.firstCluster, sizeof(e.firstCluster));
+}
+
+// Card in the slot and its volume; the snapshot is only compared to the same.
+static uint64_t cardId() {
+  const sdmmc_cid_t& cid = SdCard::card()->cid;
+  const FatVolume::Info& vi = FatVolume::info();
+  uint64_t h = 0xCBF29CE484222325ull;
+  auto mix = [&h](const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len--) h = (h ^ *p++) * 0x100000001B3ull;
+  };
+  mix(&cid.mfg_id, sizeof(cid.mfg_id));
+  mix(&cid.oem_id, sizeof(cid.oem_id));
+  mix(cid.name, sizeof(cid.name));
+  mix(&cid.serial, sizeof(cid.serial));
+  mix(&vi.partStart, sizeof(vi.partStart));
+  mix(&vi.partSectors, sizeof(vi.partSectors));
+  mix(&vi.clusters, sizeof(vi.clusters));
+  return h;
+}
+
+// Contents of a folder from its start cluster, size and NoFatChain flag
+static FatVolume::DirPos dirAt(uint32_t cluster, uint32_t size, bool contiguous, bool root) {
+  if (root) return FatVolume::rootDir();
+  Entry e = {};
+  e.firstCluster = cluster;
+  e.size         = size;
+  e.contiguous   = contiguous;
+  e.dir          = true;
+  return FatVolume::dirOf(e);
+}
+
+static void freeSnapshot() {
+  heap_caps_free(s_snap.items);
+  heap_caps_free(s_snap.dirs);
+  heap_caps_free(s_snap.runs);
+  heap_caps_free(s_snap.names);
+  s_snap = {};
+}
+
+// ---------------- Snapshot ----------------
+// Clusters of dir d as runs of consecutive clusters
+static bool addRuns(uint32_t d) {
+  Snapshot& s = s_snap;
+  const Dir dir = s.dirs[d];
+  const uint32_t first = s.runCount;
+  auto add = [&s, first](uint32_t c, uint32_t n) {
+    if (s.runCount > first && s.runs[s.runCount - 1].first + s.runs[s.runCount - 1].count == c) {
+      s.runs[s.runCount - 1].count += n;
+      return true;
+    }
+    if (!reserve((void**)&s.runs, &s.runCap, s.runCount + 1, sizeof(Run), FIRST_DIRS)) return false;
+    s.runs[s.runCount++] = { c, n };
+    return true;
+  };
+  if (!FatVolume::isCluster(dir.cluster)) {
+    // nothing to read
+  } else if (dir.contiguous) {
+    const uint32_t cb = FatVolume::info().clusterBytes;
+    if (!add(dir.cluster, max<uint32_t>(1, (dir.size + cb - 1) / cb))) return false;
+  } else {
+    uint32_t c = dir.cluster;
+    for (uint32_t n = 0; FatVolume::isCluster(c) && n < MAX_CHAIN; ++n, c = FatVolume::next(c)) {
+      if (!add(c, 1)) return false;
+    }
+  }
+  s.dirs[d].runs     = first;
+  s.dirs[d].runCount = s.runCount - first;
+  return true;
+}
+
+// Read folder d into items[], queueing its subfolders as new Dirs.
+static bool readSnapDir(uint32_t d, const char** error) {
+  Snapshot& s = s_snap;
+  *error = "out of memory for the snapshot";
+  if (!addRuns(d)) return false;
+  const uint32_t first = s.itemCount;
+  s.dirs[d].items = first;
+  if (!FatVolume::isCluster(s.dirs[d].cluster)) return true;
+
+  FatVolume::DirPos pos = dirAt(s.dirs[d].cluster, s.dirs[d].size, s.dirs[d].contiguous, d == ROOT);
+  Entry e;
+  bool ok = true;
+  CardJob::setItem(s.names + s.dirs[d].name);
+  while (FatVolume::readDir(pos, e, &ok)) {
+    if (CardJob::cancelled()) return false;
+    if (d == ROOT && e.dir && strcmp(e.name, SKIP_DIR) == 0) continue;
+    if (s.itemCount >= MountDiff::MAX_ENTRIES) {
+      *error = "too many entries for a snapshot";
+      return false;
+    }
+    if (!reserve((void**)&s.items, &s.itemCap, s.itemCount + 1, sizeof(Item), FIRST_ITEMS)) return false;
+    Item& item = s.items[s.itemCount++];
+    item = { nameHash(e.name), metaHash(e), NONE };
+    if (e.dir) {
+      const uint32_t name = addName(&s.names, &s.namesCap, &s.namesUsed, e.name);
+      if (name == NONE || !reserve((void**)&s.dirs, &s.dirCap, s.dirCount + 1, sizeof(Dir), FIRST_DIRS)) return false;
+      s.dirs[s.dirCount] = { e.firstCluster, (uint32_t)min<uint64_t>(e.size, UINT32_MAX), e.contiguous, d, name, 0, 0, 0, 0 };
+      item.dir = s.dirCount++;
+    }
+    CardJob::advance(0, 1);
+  }
+  if (!ok) {
+    *error = "directory read error";
+    return false;
+  }
+  s.dirs[d].itemCount = s.itemCount - first;
+  std::sort(s.items + first, s.items + s.itemCount, [](const Item& a, const Item& b) { return a.name < b.name; });
+  return true;
+}
+
+static bool snapshotJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  s_snap.ready = false;
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  // Buffers of an earlier snapshot are reused
+  Snapshot& s = s_snap;
+  s.itemCount = s.dirCount = s.runCount = 0;
+  s.namesUsed = 0;
+  s.card      = cardId();
+  const char* error = "out of memory for the snapshot";
+  const uint32_t root = addName(&s.names, &s.namesCap, &s.namesUsed, "");
+  bool ok = root != NONE && reserve((void**)&s.dirs, &s.dirCap, 1, sizeof(Dir), FIRST_DIRS);
+  if (ok) {
+    FatVolume::loadFat();
+    s.dirs[ROOT] = { FatVolume::info().rootCluster, 0, false, ROOT, root, 0, 0, 0, 0 };
+    s.dirCount   = 1;
+    // Breadth first: the folders queue up in dirs[] as they are found
+    for (uint32_t d = 0; d < s.dirCount && ok; ++d) ok = readSnapDir(d, &error);
+  }
+  FatVolume::close();
+
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled");
+  } else if (!ok) {
+    CardJob::finish("%s", error);
+  } else {
+    s.ready = true;
+    const size_t bytes = s.itemCount * sizeof(Item) + s.dirCount * sizeof(Dir) + s.runCount * sizeof(Run) + s.namesUsed;
+    CardJob::finish("snapshot of %u folders, %u entries in %u KB, %.1f s", (unsigned)s.dirCount,
+                    (unsigned)s.itemCount, (unsigned)(bytes / 1024), (esp_timer_get_time() - start) / 1e6f);
+  }
+  if (!s.ready) freeSnapshot();
+  return s.ready;
+}
+
+// ---------------- Compare ----------------
+// Folder unchanged since the snapshot: same start, size and chain, and the
+// host wrote none of its clusters. Its entries are then the snapshot's.
+static bool unchanged(const Dir& d, const Pair& p) {
+  if (d.cluster != p.cluster || d.size != p.size || d.contiguous != p.contiguous) return false;
+  if (!FatVolume::isCluster(d.cluster)) return true;
+  const FatVolume::Info& vi = FatVolume::info();
+  uint32_t c = d.cluster;
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < d.runCount; ++i) {
+    const Run& run = s_snap.runs[d.runs + i];
+    if (Storage::written(FatVolume::clusterLba(run.first), run.count * vi.spc)) return false;
+    if (d.contiguous) continue;
+    for (uint32_t k = 0; k < run.count; ++k, ++n, c = FatVolume::next(c)) {
+      if (c != run.first + k) return false;
+    }
+  }
+  // A chain cut at MAX_CHAIN can't be told apart from a longer one
+  return d.contiguous || (c == FatVolume::END && n < MAX_CHAIN);
+}
+
+// name: already in the compare's name pool
+static bool addPair(Compare& c, uint32_t old, uint32_t cluster, uint32_t size, bool contiguous, bool exists,
+                    uint32_t parent, uint32_t name) {
+  if (name == NONE || !reserve((void**)&c.pairs, &c.pairCap, c.pairCount + 1, sizeof(Pair), FIRST_DIRS)) {
+    c.failed = true;
+    return false;
+  }
+  c.pairs[c.pairCount++] = { old, cluster, size, contiguous, exists, parent, name };
+  return true;
+}
+
+// Snapshot subfolder of an unchanged or removed folder
+static bool addOldPair(Compare& c, uint32_t dir, bool exists, uint32_t parent) {
+  const Dir& d = s_snap.dirs[dir];
+  const uint32_t name = addName(&c.names, &c.namesCap, &c.namesUsed, s_snap.names + d.name);
+  return addPair(c, dir, d.cluster, d.size, d.contiguous, exists, parent, name);
+}
+
+static void pairPath(const Compare& c, uint32_t p, char* out, size_t len) {
+  uint32_t chain[FatVolume::MAX_DEPTH + 1];
+  uint32_t depth = 0;
+  for (; p != ROOT && depth <= (uint32_t)FatVolume::MAX_DEPTH; p = c.pairs[p].parent) chain[depth++] = p;
+  size_t used = 0;
+  strlcpy(out, "/", len);
+  while (depth--) {
+    const int n = snprintf(out + used, len - used, "/%s", c.names + c.pairs[chain[depth]].name);
+    if (n < 0 || used + n >= len) return;
+    used += n;
+  }
+}
+
+// Keep the listed folders sorted by number of changes, most first.
+static void rank(Compare& c, uint32_t p, const MountDiff::Folder& f) {
+  MountDiff::Result& r = *c.r;
+  auto weight = [](const MountDiff::Folder& x) { return x.added + x.deleted + x.changed + (x.created || x.removed); };
+  const uint32_t w = weight(f);
+  uint32_t pos = r.listed;
+  while (pos > 0 && weight(r.list[pos - 1]) < w) pos--;
+  if (pos >= MountDiff::MAX_FOLDERS) return;
+  const uint32_t last = min(r.listed, MountDiff::MAX_FOLDERS - 1);
+  memmove(&r.list[pos + 1], &r.list[pos], (last - pos) * sizeof(MountDiff::Folder));
+  r.list[pos] = f;
+  pairPath(c, p, r.list[pos].path, sizeof(r.list[pos].path));
+  if (r.listed < MountDiff::MAX_FOLDERS) r.listed++;
+}
+
+// Read pair p's folder as it is now into c.cur; count of entries, NONE on error.
+static uint32_t readCurrent(Compare& c, const Pair& p, bool root) {
+  FatVolume::DirPos pos = dirAt(p.cluster, p.size, p.contiguous, root);
+  Entry e;
+  bool ok = true;
+  uint32_t n = 0;
+  if (!root && !FatVolume::isCluster(p.cluster)) return 0;
+  while (FatVolume::readDir(pos, e, &ok)) {
+    if (root && e.dir && strcmp(e.name, SKIP_DIR) == 0) continue;
+    const uint32_t dirName = e.dir ? addName(&c.names, &c.namesCap, &c.namesUsed, e.name) : 0;
+    if (dirName == NONE || !reserve((void**)&c.cur, &c.curCap, n + 1, sizeof(Current), FIRST_ITEMS)) {
+      c.failed = true;
+      return NONE;
+    }
+    c.cur[n++] = { nameHash(e.name), metaHash(e), e.firstCluster, (uint32_t)min<uint64_t>(e.size, UINT32_MAX),
+                   e.dir, e.contiguous, dirName };
+  }
+  return ok ? n : NONE;
+}
+
+// Diff one folder, queueing its subfolders; false on error or cancel.
+static bool diffPair(Compare& c, uint32_t index) {
+  const Pair p = c.pairs[index];
+  const Dir* old = p.old != NONE ? &s_snap.dirs[p.old] : nullptr;
+  const Item* items = old ? s_snap.items + old->items : nullptr;
+  const uint32_t itemCount = old ? old->itemCount : 0;
+  MountDiff::Folder f = {};
+  f.created = !old;
+  f.removed = !p.exists;
+
+  if (!p.exists) {
+    // Gone: its files are deleted, its subfolders removed
+    for (uint32_t i = 0; i < itemCount; ++i) {
+      if (items[i].dir == NONE) {
+        f.deleted++;
+      } else if (!addOldPair(c, items[i].dir, false, index)) {
+        return false;
+      }
+    }
+  } else if (old && unchanged(*old, p)) {
+    c.r->dirsReused++;
+    for (uint32_t i = 0; i < itemCount; ++i) {
+      if (items[i].dir != NONE && !addOldPair(c, items[i].dir, true, index)) return false;
+    }
+  } else {
+    c.r->dirsRead++;
+    const uint32_t n = readCurrent(c, p, index == ROOT);
+    if (n == NONE) return false;
+    if (!reserve((void**)&c.matched, &c.matchedCap, max<uint32_t>(itemCount, 1), 1, FIRST_ITEMS)) {
+      c.failed = true;
+      return false;
+    }
+    memset(c.matched, 0, itemCount);
+    for (uint32_t k = 0; k < n; ++k) {
+      const Current& e = c.cur[k];
+      // Same name (hash) and kind; the items are sorted by name hash
+      uint32_t j = std::lower_bound(items, items + itemCount, e.name,
+                                    [](const Item& a, uint32_t name) { return a.name < name; }) - items;
+      while (j < itemCount && items[j].name == e.name && (c.matched[j] || (items[j].dir != NONE) != e.dir)) j++;
+      const bool found = j < itemCount && items[j].name == e.name;
+      if (found) c.matched[j] = 1;
+      if (e.dir) {
+        if (!addPair(c, found ? items[j].dir : NONE, e.cluster, e.size, e.contiguous, true, index, e.dirName)) {
+          return false;
+        }
+      } else if (!found) {
+        f.added++;
+      } else if (items[j].meta != e.meta) {
+        f.changed++;
+      }
+    }
+    for (uint32_t i = 0; i < itemCount; ++i) {
+      if (c.matched[i]) continue;
+      if (items[i].dir == NONE) {
+        f.deleted++;
+      } else if (!addOldPair(c, items[i].dir, false, index)) {
+        return false;
+      }
+    }
+  }
+
+  MountDiff::Result& r = *c.r;
+  r.added          += f.added;
+  r.deleted        += f.deleted;
+  r.changed        += f.changed;
+  r.foldersAdded   += f.created;
+  r.foldersRemoved += f.removed;
+  if (f.added || f.deleted || f.changed || f.created || f.removed) {
+    r.folders++;
+    rank(c, index, f);
+  }
+  return true;
+}
+
+static bool compareJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    freeSnapshot();
+    return false;
+  }
+  Compare c = {};
+  c.r = (MountDiff::Result*)heap_caps_calloc(1, sizeof(MountDiff::Result), MALLOC_CAP_SPIRAM);
+  const char* error = "out of memory";
+  bool ok = c.r != nullptr;
+  if (ok && s_snap.card != cardId()) {
+    ok    = false;
+    error = "not the card of the snapshot";
+  }
+  if (ok) {
+    FatVolume::loadFat();
+    const FatVolume::Info& vi = FatVolume::info();
+    ok = addPair(c, ROOT, vi.rootCluster, 0, false, true, ROOT, addName(&c.names, &c.namesCap, &c.namesUsed, ""));
+    CardJob::setTotal(s_snap.dirCount);
+    // Breadth first, like the snapshot; pairs queue up as folders are found
+    for (uint32_t i = 0; i < c.pairCount && ok; ++i) {
+      if (CardJob::cancelled()) {
+        ok = false;
+        break;
+      }
+      CardJob::setItem(c.names + c.pairs[i].name);
+      ok = diffPair(c, i);
+      CardJob::advance(c.pairs[i].old != NONE ? 1 : 0, 1);
+    }
+    if (!ok) error = c.failed ? "out of memory" : "directory read error";
+  }
+  FatVolume::close();
+  freeSnapshot();
+
+  MountDiff::Result* r = c.r;
+  if (CardJob::cancelled()) {
+    CardJob::finish("cancelled");
+  } else if (!ok) {
+    CardJob::finish("%s", error);
+  } else {
+    CardJob::finish("%u files added, %u deleted, %u changed in %u folders; %u folders read, %u unchanged, %.1f s",
+                    (unsigned)r->added, (unsigned)r->deleted, (unsigned)r->changed, (unsigned)r->folders,
+                    (unsigned)r->dirsRead, (unsigned)r->dirsReused, (esp_timer_get_time() - start) / 1e6f);
+    // The readers may be using s_result; result() adopts this one on their task
+    portENTER_CRITICAL(&s_lock);
+    std::swap(s_pending, r);
+    portEXIT_CRITICAL(&s_lock);
+  }
+  heap_caps_free(r);   // failed compare, or a result no reader has seen
+  heap_caps_free(c.pairs);
+  heap_caps_free(c.cur);
+  heap_caps_free(c.matched);
+  heap_caps_free(c.names);
+  return ok && !CardJob::cancelled();
+}
+
+// ---------------- Console ----------------
+static void cmdMdiff(Print& out, const char* args) {
+  if (strcmp(args, "snap") == 0) {
+    out.println(MountDiff::snapshot() ? "mdiff: reading folders, \"job\" for progress"
+                                      : "mdiff: card busy or missing (unmount USB first)");
+  } else if (strcmp(args, "compare") == 0) {
+    out.println(MountDiff::compare() ? "mdiff: comparing, \"job\" for progress, \"mdiff\" for results"
+                                     : "mdiff: card busy or no snapshot (\"mdiff snap\" first)");
+  } else if (*args == '\0') {
+    MountDiff::printResult(out);
+  } else {
+    out.println("usage: mdiff [snap|compare]");
+  }
+}
+
+namespace MountDiff {
+
+void begin() {
+  Console::add("mdiff", "changes since the mount: [snap|compare]", cmdMdiff);
+}
+
+bool snapshot() {
+  if (CardJob::busy()) return false;
+  return CardJob::start("snapshot", CardJob::Access::Raw, snapshotJob, nullptr);
+}
+
+bool hasSnapshot() { return s_snap.ready; }
+
+bool compare() {
+  if (!s_snap.ready || CardJob::busy()) return false;
+  return CardJob::start("card changes", CardJob::Access::Raw, compareJob, nullptr);
+}
+
+const Result* result() {
+  portENTER_CRITICAL(&s_lock);
+  Result* fresh = s_pending;
+  s_pending = nullptr;
+  portEXIT_CRITICAL(&s_lock);
+  if (fresh) {
+    heap_caps_free(s_result);
+    s_result = fresh;
+  }
+  return s_result;
+}
+
+void printResult(Print& out) {
+  const Result* r = result();
+  if (!r) {
+    out.println("mdiff: no completed compare");
+    return;
+  }
+  out.printf("Changes: %u files added, %u deleted, %u changed; %u folders added, %u removed\n",
+             (unsigned)r->added, (unsigned)r->deleted, (unsigned)r->changed, (unsigned)r->foldersAdded,
+             (unsigned)r->foldersRemoved);
+  out.printf("  %u folders read again, %u taken from the snapshot\n", (unsigned)r->dirsRead, (unsigned)r->dirsReused);
+  for (uint32_t i = 0; i < r->listed; ++i) {
+    const Folder& f = r->list[i];
+    out.printf("  %s%s: +%u -%u ~%u\n", f.path, f.created ? " (new)" : f.removed ? " (removed)" : "",
+               (unsigned)f.added, (unsigned)f.deleted, (unsigned)f.changed);
+  }
+  if (r->folders > r->listed) out.printf("  and %u more folders\n", (unsigned)(r->folders - r->listed));
+}
+
+} // namespace MountDiff
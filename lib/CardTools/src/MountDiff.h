@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include "FatVolume.h"
+
+// What a USB session changed on the card ("12 files added to /DCIM, 3
+// deleted"; "mdiff" console command, shown after Unmount). snapshot() reads
+// the directory tree before Storage::mount() and keeps only hashes: per
+// entry its name and its size, time, attributes and start cluster, 12 bytes
+// in PSRAM; folder names are kept for the report. compare() after
+// Storage::unmount() walks the tree again, but takes a folder from the
+// snapshot without reading it when the host wrote none of its clusters
+// (Storage::written()) and its chain is the same; only its subfolders are
+// looked at. Changes are counted per folder, files only. Two names with
+// the same hash in one folder can hide a change.
+namespace MountDiff {
+
+  static constexpr uint32_t MAX_ENTRIES = 1u << 20;   // larger trees are not snapshot
+  static constexpr uint32_t MAX_FOLDERS = 16;         // listed, most changes first
+
+  struct Folder {
+    char     path[FatVolume::MAX_PATH];
+    uint32_t added;             // files directly in it
+    uint32_t deleted;
+    uint32_t changed;           // size, time, attributes or start cluster
+    bool     created;           // the folder itself is new
+    bool     removed;           // the folder itself is gone
+  };
+
+  struct Result {
+    uint32_t added;             // files, whole card
+    uint32_t deleted;
+    uint32_t changed;
+    uint32_t foldersAdded;
+    uint32_t foldersRemoved;
+    uint32_t folders;           // with any change
+    uint32_t dirsRead;          // read again
+    uint32_t dirsReused;        // taken from the snapshot
+    uint32_t listed;
+    Folder   list[MAX_FOLDERS];
+  };
+
+  // Register the console command.
+  void begin();
+
+  // Job reading the tree before a session; false if busy or no card.
+  bool snapshot();
+  bool hasSnapshot();
+  // Job diffing the card against the snapshot after the session; false if
+  // busy or there is no snapshot. The snapshot is freed once it has run.
+  bool compare();
+  // Last completed compare, kept while a new one runs; nullptr before one.
+  // Call from the loop task only (UI and console): a compare that finished
+  // since the last call replaces the result here, never under a reader.
+  const Result* result();
+  void printResult(Print& out);
+
+} // namespace MountDiff
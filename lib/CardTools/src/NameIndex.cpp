@@ -0,0 +1,532 @@
+#include "NameIndex.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <esp_timer.h>
+
+using NameIndex::BUCKETS;
+using NameIndex::NONE;
+
+static constexpr uint32_t    MAGIC        = 0x4E4D4453;   // "SDMN"
+static constexpr uint8_t     VERSION      = 1;
+static constexpr const char* PARTITION    = "storage";
+static constexpr uint32_t    FLASH_SECTOR = 4096;
+static constexpr uint32_t    ERASE_STEP   = 64 * 1024;    // per call, so other tasks get the flash in between
+static constexpr uint32_t    FIRST_ROWS   = 4096;
+static constexpr size_t      FIRST_NAMES  = 64 * 1024;
+static constexpr size_t      MAX_QUERY    = 64;
+static constexpr uint32_t    FIND_LINES   = 20;
+
+struct Row {
+  uint32_t name : 31;       // offset in the name pool
+  uint32_t dir  : 1;
+  uint32_t parent;          // row of the folder, NONE in the root
+};
+
+// Saved in the first flash sector; the rest follows it:
+// rows, names, bucket offsets (BUCKETS + 1), postings
+struct Header {
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  reserved[3];
+  uint32_t buckets;
+  uint32_t count;
+  uint32_t namesBytes;
+  uint32_t postBytes;
+  uint32_t check;           // FNV-1a 32 of the rest
+  uint64_t fingerprint;
+};
+
+static Row*          s_rows      = nullptr;   // PSRAM, sorted by name once built
+static size_t        s_rowCap    = 0;
+static uint32_t      s_count     = 0;
+static char*         s_names     = nullptr;
+static size_t        s_namesCap  = 0;
+static size_t        s_namesUsed = 0;
+static uint32_t*     s_offsets   = nullptr;   // BUCKETS + 1, into s_posts
+static uint8_t*      s_posts     = nullptr;   // per bucket: rows + 1 as LEB128 deltas
+static volatile bool s_ready     = false;
+static uint64_t      s_fingerprint = 0;      // card the index in memory was made from; 0 if none
+static volatile uint32_t s_generation = 0;
+
+// Build only
+static uint32_t s_stack[FatVolume::MAX_DEPTH + 1];   // row of the folder at each depth
+static uint32_t s_dropped = 0;
+static bool     s_failed  = false;
+static uint16_t s_trigrams[FatVolume::MAX_PATH];
+
+static inline char lower(char c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+static inline const char* nameOf(uint32_t row) { return s_names + s_rows[row].name; }
+
+static bool reserve(void** p, size_t* cap, size_t need, size_t elem, size_t first) {
+  if (need <= *cap) return true;
+  size_t n = *cap ? *cap : first;
+  while (n < need) n *= 2;
+  void* q = heap_caps_realloc(*p, n * elem, MALLOC_CAP_SPIRAM);
+  if (!q) return false;
+  *p   = q;
+  *cap = n;
+  return true;
+}
+
+static void freeIndex() {
+  heap_caps_free(s_rows);
+  heap_caps_free(s_names);
+  heap_caps_free(s_offsets);
+  heap_caps_free(s_posts);
+  s_rows      = nullptr;
+  s_names     = nullptr;
+  s_offsets   = nullptr;
+  s_posts     = nullptr;
+  s_rowCap    = 0;
+  s_namesCap  = 0;
+  s_count     = 0;
+  s_namesUsed = 0;
+  s_fingerprint = 0;
+  s_generation = s_generation + 1;
+}
+
+// Distinct buckets of the trigrams of a lowercased name; returns the count.
+static uint32_t nameBuckets(const char* name, uint16_t* out, uint32_t max) {
+  uint32_t n = 0;
+  const size_t len = strlen(name);
+  for (size_t i = 0; i + 3 <= len && n < max; ++i) {
+    const uint32_t t = (uint8_t)lower(name[i]) << 16 | (uint8_t)lower(name[i + 1]) << 8 | (uint8_t)lower(name[i + 2]);
+    out[n++] = (t * 2654435761u) >> 20;
+  }
+  std::sort(out, out + n);
+  return std::unique(out, out + n) - out;
+}
+
+static inline uint32_t varLen(uint32_t v) {
+  uint32_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+static uint64_t fnv64(uint64_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len--) h = (h ^ *p++) * 0x100000001B3ull;
+  return h;
+}
+
+static uint32_t fnv32(uint32_t h, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  while (len--) h = (h ^ *p++) * 0x01000193u;
+  return h;
+}
+
+// Card in the slot and the state of its allocation; 0 if unknown. Volume open.
+static uint64_t cardFingerprint() {
+  const uint32_t* bits = FatVolume::loadBitmap();
+  if (!bits) return 0;
+  const sdmmc_cid_t& cid = SdCard::card()->cid;
+  const FatVolume::Info& vi = FatVolume::info();
+  uint64_t h = 0xCBF29CE484222325ull;
+  h = fnv64(h, &cid.mfg_id, sizeof(cid.mfg_id));
+  h = fnv64(h, &cid.oem_id, sizeof(cid.oem_id));
+  h = fnv64(h, cid.name, sizeof(cid.name));
+  h = fnv64(h, &cid.serial, sizeof(cid.serial));
+  h = fnv64(h, &vi.partStart, sizeof(vi.partStart));
+  h = fnv64(h, &vi.partSectors, sizeof(vi.partSectors));
+  h = fnv64(h, &vi.clusters, sizeof(vi.clusters));
+  h = fnv64(h, bits, ((vi.clusters + 31) / 32) * sizeof(uint32_t));
+  return h ? h : 1;
+}
+
+// ---------------- Flash ----------------
+// Sequential writer through an internal buffer (flash writes can't read PSRAM)
+struct FlashOut {
+  const esp_partition_t* part;
+  size_t                 at;
+  uint8_t*               buf;
+  size_t                 used;
+  uint32_t               check;
+  bool                   ok;
+};
+
+static void flushOut(FlashOut& o) {
+  if (o.ok && o.used) o.ok = esp_partition_write(o.part, o.at, o.buf, o.used) == ESP_OK;
+  o.at  += o.used;
+  o.used = 0;
+}
+
+static void putOut(FlashOut& o, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  o.check = fnv32(o.check, data, len);
+  while (len && o.ok) {
+    const size_t n = min<size_t>(len, FLASH_SECTOR - o.used);
+    memcpy(o.buf + o.used, p, n);
+    o.used += n;
+    p      += n;
+    len    -= n;
+    if (o.used == FLASH_SECTOR) flushOut(o);
+  }
+}
+
+static bool readIn(const esp_partition_t* part, size_t& at, void* dst, size_t len, uint8_t* buf, uint32_t& check) {
+  uint8_t* p = (uint8_t*)dst;
+  while (len) {
+    const size_t n = min<size_t>(len, FLASH_SECTOR);
+    if (esp_partition_read(part, at, buf, n) != ESP_OK) return false;
+    memcpy(p, buf, n);
+    check = fnv32(check, buf, n);
+    at  += n;
+    p   += n;
+    len -= n;
+  }
+  return true;
+}
+
+static const esp_partition_t* findPartition() {
+  return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION);
+}
+
+// The header goes last, so a cut save leaves no index rather than a broken one.
+static bool save(uint64_t fingerprint) {
+  const esp_partition_t* part = findPartition();
+  const size_t offsetBytes = (BUCKETS + 1) * sizeof(uint32_t);
+  const size_t total = FLASH_SECTOR + s_count * sizeof(Row) + s_namesUsed + offsetBytes + s_offsets[BUCKETS];
+  if (!part || total > part->size) return false;
+  CardJob::setItem("saving the name index");
+  const size_t erase = (total + FLASH_SECTOR - 1) / FLASH_SECTOR * FLASH_SECTOR;
+  for (size_t at = 0; at < erase; at += ERASE_STEP) {
+    if (esp_partition_erase_range(part, at, min<size_t>(ERASE_STEP, erase - at)) != ESP_OK) return false;
+  }
+
+  FlashOut o = { part, FLASH_SECTOR, (uint8_t*)heap_caps_malloc(FLASH_SECTOR, MALLOC_CAP_INTERNAL), 0, 0x811C9DC5u,
+                 true };
+  if (!o.buf) return false;
+  putOut(o, s_rows, s_count * sizeof(Row));
+  putOut(o, s_names, s_namesUsed);
+  putOut(o, s_offsets, offsetBytes);
+  putOut(o, s_posts, s_offsets[BUCKETS]);
+  flushOut(o);
+
+  Header h = {};
+  h.magic       = MAGIC;
+  h.version     = VERSION;
+  h.buckets     = BUCKETS;
+  h.count       = s_count;
+  h.namesBytes  = s_namesUsed;
+  h.postBytes   = s_offsets[BUCKETS];
+  h.check       = o.check;
+  h.fingerprint = fingerprint;
+  memset(o.buf, 0, FLASH_SECTOR);
+  memcpy(o.buf, &h, sizeof(h));
+  const bool ok = o.ok && esp_partition_write(part, 0, o.buf, FLASH_SECTOR) == ESP_OK;
+  heap_caps_free(o.buf);
+  return ok;
+}
+
+// Keep the index in memory if it still matches the card, else load the
+// saved one if that does.
+static bool loadJob(void*) {
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  CardJob::setItem("checking the card");
+  const uint64_t fingerprint = cardFingerprint();
+  FatVolume::close();
+  if (fingerprint && fingerprint == s_fingerprint) {
+    s_ready = true;
+    CardJob::finish("%u names, index matches the card", (unsigned)s_count);
+    return true;
+  }
+  freeIndex();
+
+  const esp_partition_t* part = findPartition();
+  Header h;
+  if (!part || esp_partition_read(part, 0, &h, sizeof(h)) != ESP_OK || h.magic != MAGIC || h.version != VERSION ||
+      h.buckets != BUCKETS) {
+    CardJob::finish("no saved name index (scan the card first)");
+    return false;
+  }
+  if (!fingerprint || fingerprint != h.fingerprint) {
+    CardJob::finish("the saved name index is for another card, or this one changed (scan again)");
+    return false;
+  }
+
+  CardJob::setItem("loading the name index");
+  const size_t offsetBytes = (BUCKETS + 1) * sizeof(uint32_t);
+  s_rows    = (Row*)heap_caps_malloc(max<size_t>(h.count, 1) * sizeof(Row), MALLOC_CAP_SPIRAM);
+  s_names   = (char*)heap_caps_malloc(max<size_t>(h.namesBytes, 1), MALLOC_CAP_SPIRAM);
+  s_offsets = (uint32_t*)heap_caps_malloc(offsetBytes, MALLOC_CAP_SPIRAM);
+  s_posts   = (uint8_t*)heap_caps_malloc(max<size_t>(h.postBytes, 1), MALLOC_CAP_SPIRAM);
+  uint8_t* buf = (uint8_t*)heap_caps_malloc(FLASH_SECTOR, MALLOC_CAP_INTERNAL);
+  size_t at = FLASH_SECTOR;
+  uint32_t check = 0x811C9DC5u;
+  bool ok = s_rows && s_names && s_offsets && s_posts && buf &&
+            readIn(part, at, s_rows, h.count * sizeof(Row), buf, check) &&
+            readIn(part, at, s_names, h.namesBytes, buf, check) &&
+            readIn(part, at, s_offsets, offsetBytes, buf, check) &&
+            readIn(part, at, s_posts, h.postBytes, buf, check);
+  heap_caps_free(buf);
+  ok = ok && check == h.check && s_offsets[BUCKETS] == h.postBytes;
+  if (!ok) {
+    freeIndex();
+    CardJob::finish("could not load the name index (out of memory or damaged)");
+    return false;
+  }
+  s_count     = h.count;
+  s_namesUsed = h.namesBytes;
+  s_rowCap    = h.count;
+  s_namesCap  = h.namesBytes;
+  s_fingerprint = fingerprint;
+  s_ready     = true;
+  CardJob::finish("%u names loaded", (unsigned)s_count);
+  return true;
+}
+
+// ---------------- Search ----------------
+static bool contains(const char* hay, const char* needle, size_t len) {
+  for (; *hay; ++hay) {
+    size_t i = 0;
+    while (i < len && lower(hay[i]) == needle[i]) i++;
+    if (i == len) return true;
+  }
+  return false;
+}
+
+// Walks one bucket's rows in order; v is row + 1, UINT32_MAX at the end
+struct Cursor {
+  const uint8_t* p;
+  const uint8_t* end;
+  uint32_t       v;
+};
+
+static void advance(Cursor& c) {
+  if (c.p == c.end) {
+    c.v = UINT32_MAX;
+    return;
+  }
+  uint32_t d = 0;
+  for (uint32_t shift = 0; c.p < c.end; shift += 7) {
+    const uint8_t b = *c.p++;
+    d |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) break;
+  }
+  c.v += d;
+}
+
+// ---------------- Console ----------------
+static void cmdFind(Print& out, const char* args) {
+  if (!*args) {
+    out.println("find: find <text> | find load");
+    return;
+  }
+  if (strcmp(args, "load") == 0) {
+    out.println(NameIndex::load() ? "find: loading, \"job\" for progress"
+                                  : "find: card busy or missing (unmount USB first)");
+    return;
+  }
+  if (!NameIndex::ready()) {
+    out.println("find: no index (run \"du scan\", or \"find load\" for the saved one)");
+    return;
+  }
+  uint32_t rows[FIND_LINES];
+  const int64_t t0 = esp_timer_get_time();
+  const uint32_t total = NameIndex::search(args, rows, FIND_LINES);
+  const int64_t us = esp_timer_get_time() - t0;
+  char path[FatVolume::MAX_PATH];
+  for (uint32_t i = 0; i < min(total, FIND_LINES); ++i) {
+    NameIndex::path(rows[i], path, sizeof(path));
+    out.printf("  %s%s\n", path, NameIndex::isDir(rows[i]) ? "/" : "");
+  }
+  out.printf("%u matches in %.1f ms\n", (unsigned)total, us / 1000.0f);
+}
+
+namespace NameIndex {
+
+void begin() {
+  Console::add("find", "find files by name: <text>|load", cmdFind);
+}
+
+void buildBegin() {
+  s_ready     = false;
+  s_fingerprint = 0;
+  s_generation = s_generation + 1;
+  s_count     = 0;
+  s_namesUsed = 0;
+  s_dropped   = 0;
+  s_failed    = false;
+  heap_caps_free(s_offsets);
+  heap_caps_free(s_posts);
+  s_offsets = nullptr;
+  s_posts   = nullptr;
+}
+
+void buildAdd(const FatVolume::Entry& e) {
+  if (s_failed) return;
+  if (s_count >= MAX_ENTRIES) {
+    s_dropped++;
+    return;
+  }
+  const size_t len = strlen(e.name) + 1;
+  if (!reserve((void**)&s_rows, &s_rowCap, s_count + 1, sizeof(Row), FIRST_ROWS) ||
+      !reserve((void**)&s_names, &s_namesCap, s_namesUsed + len, 1, FIRST_NAMES)) {
+    s_failed = true;
+    return;
+  }
+  const uint32_t id = s_count++;
+  memcpy(s_names + s_namesUsed, e.name, len);
+  s_rows[id].name   = s_namesUsed;
+  s_rows[id].dir    = e.dir;
+  s_rows[id].parent = e.depth ? s_stack[e.depth - 1] : NONE;
+  s_namesUsed += len;
+  if (e.dir) s_stack[e.depth] = id;
+}
+
+bool buildEnd(bool* saved) {
+  *saved = false;
+  const uint32_t n = s_count;
+  uint32_t* order  = (uint32_t*)heap_caps_malloc(max<size_t>(n, 1) * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  uint32_t* rank   = (uint32_t*)heap_caps_malloc(max<size_t>(n, 1) * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  Row*      sorted = (Row*)heap_caps_malloc(max<size_t>(n, 1) * sizeof(Row), MALLOC_CAP_SPIRAM);
+  s_offsets = (uint32_t*)heap_caps_calloc(BUCKETS + 1, sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  uint32_t* last = (uint32_t*)heap_caps_malloc(BUCKETS * sizeof(uint32_t), MALLOC_CAP_SPIRAM);   // row + 1 per bucket
+  uint32_t* pos  = (uint32_t*)heap_caps_malloc(BUCKETS * sizeof(uint32_t), MALLOC_CAP_SPIRAM);   // write offset
+  bool ok = !s_failed && order && rank && sorted && s_offsets && last && pos;
+
+  if (ok) {
+    // Name order (any case), parents renumbered to match
+    CardJob::setItem("sorting names");
+    for (uint32_t i = 0; i < n; ++i) order[i] = i;
+    std::sort(order, order + n, [](uint32_t a, uint32_t b) {
+      const int c = strcasecmp(nameOf(a), nameOf(b));
+      return c ? c < 0 : a < b;
+    });
+    for (uint32_t r = 0; r < n; ++r) rank[order[r]] = r;
+    for (uint32_t r = 0; r < n; ++r) {
+      sorted[r] = s_rows[order[r]];
+      if (sorted[r].parent != NONE) sorted[r].parent = rank[sorted[r].parent];
+    }
+    heap_caps_free(s_rows);
+    s_rows   = sorted;
+    s_rowCap = n;
+    sorted   = nullptr;
+
+    // Postings: sizes first, then fill
+    CardJob::setItem("indexing trigrams");
+    memset(last, 0, BUCKETS * sizeof(uint32_t));
+    for (uint32_t r = 0; r < n; ++r) {
+      const uint32_t k = nameBuckets(nameOf(r), s_trigrams, FatVolume::MAX_PATH);
+      for (uint32_t i = 0; i < k; ++i) {
+        const uint16_t b = s_trigrams[i];
+        s_offsets[b + 1] += varLen(r + 1 - last[b]);
+        last[b] = r + 1;
+      }
+    }
+    for (uint32_t b = 0; b < BUCKETS; ++b) s_offsets[b + 1] += s_offsets[b];
+    s_posts = (uint8_t*)heap_caps_malloc(max<size_t>(s_offsets[BUCKETS], 1), MALLOC_CAP_SPIRAM);
+    ok = s_posts != nullptr;
+    if (ok) {
+      memset(last, 0, BUCKETS * sizeof(uint32_t));
+      memcpy(pos, s_offsets, BUCKETS * sizeof(uint32_t));
+      for (uint32_t r = 0; r < n; ++r) {
+        const uint32_t k = nameBuckets(nameOf(r), s_trigrams, FatVolume::MAX_PATH);
+        for (uint32_t i = 0; i < k; ++i) {
+          const uint16_t b = s_trigrams[i];
+          uint32_t d = r + 1 - last[b];
+          last[b] = r + 1;
+          while (d >= 0x80) {
+            s_posts[pos[b]++] = (d & 0x7F) | 0x80;
+            d >>= 7;
+          }
+          s_posts[pos[b]++] = d;
+        }
+      }
+    }
+  }
+  heap_caps_free(order);
+  heap_caps_free(rank);
+  heap_caps_free(sorted);
+  heap_caps_free(last);
+  heap_caps_free(pos);
+  if (!ok) {
+    freeIndex();
+    return false;
+  }
+  const uint64_t fingerprint = cardFingerprint();
+  s_fingerprint = fingerprint;
+  s_ready = true;
+  *saved = fingerprint && !s_dropped && save(fingerprint);
+  return true;
+}
+
+bool load() {
+  if (CardJob::busy()) return false;
+  s_ready = false;
+  return CardJob::start("name index", CardJob::Access::Raw, loadJob, nullptr);
+}
+
+bool     ready() { return s_ready; }
+uint32_t count() { return s_count; }
+uint32_t generation() { return s_generation; }
+
+uint32_t search(const char* text, uint32_t* rows, uint32_t max) {
+  if (!s_ready) return 0;
+  char q[MAX_QUERY];
+  size_t len = 0;
+  for (; text[len] && len < MAX_QUERY - 1; ++len) q[len] = lower(text[len]);
+  q[len] = '\0';
+  if (!len) return 0;
+
+  uint32_t total = 0;
+  auto emit = [&](uint32_t row) {
+    if (total < max) rows[total] = row;
+    total++;
+  };
+  if (len < 3) {
+    for (uint32_t r = 0; r < s_count; ++r) {
+      if (contains(nameOf(r), q, len)) emit(r);
+    }
+    return total;
+  }
+
+  // Rows in every list of the query's trigrams, driven by the shortest list
+  uint16_t buckets[MAX_QUERY];
+  const uint32_t k = nameBuckets(q, buckets, MAX_QUERY);
+  Cursor cur[MAX_QUERY];
+  uint32_t driver = 0;
+  for (uint32_t i = 0; i < k; ++i) {
+    cur[i] = { s_posts + s_offsets[buckets[i]], s_posts + s_offsets[buckets[i] + 1], 0 };
+    if (cur[i].end - cur[i].p < cur[driver].end - cur[driver].p) driver = i;
+  }
+  while (true) {
+    advance(cur[driver]);
+    const uint32_t v = cur[driver].v;
+    if (v == UINT32_MAX) break;
+    bool all = true;
+    for (uint32_t i = 0; i < k && all; ++i) {
+      while (cur[i].v < v) advance(cur[i]);
+      all = cur[i].v == v;
+    }
+    if (all && contains(nameOf(v - 1), q, len)) emit(v - 1);
+  }
+  return total;
+}
+
+void path(uint32_t row, char* out, size_t len) {
+  uint32_t chain[FatVolume::MAX_DEPTH + 1];
+  uint32_t depth = 0;
+  for (uint32_t r = row; r != NONE && depth <= (uint32_t)FatVolume::MAX_DEPTH; r = s_rows[r].parent) chain[depth++] = r;
+  size_t used = 0;
+  out[0] = '\0';
+  while (depth--) {
+    const int n = snprintf(out + used, len - used, "/%s", nameOf(chain[depth]));
+    if (n < 0 || used + n >= len) break;
+    used += n;
+  }
+}
+
+bool isDir(uint32_t row) { return s_rows[row].dir; }
+
+} // namespace NameIndex
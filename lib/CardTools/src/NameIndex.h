@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+#include "FatVolume.h"
+
+// Find files by name ("find" console command, Find files screen) without
+// walking the card. The index is built during SpaceTree's scan: every
+// entry's name and parent folder, in a table sorted by name, plus trigram
+// postings (each 3-byte piece of a lowercased name hashed to one of
+// BUCKETS lists of table rows, delta-coded). A substring search intersects
+// the lists of its trigrams and checks only the rows left, so 100k names
+// answer in milliseconds; queries under 3 characters scan the table.
+//
+// The index is kept in the "storage" flash partition with a fingerprint of
+// the card (CID, volume geometry and a hash of the allocation bitmap) and
+// is loaded again only if the card still matches. Files created, deleted or
+// resized change the bitmap; renames and same-size rewrites don't, rescan
+// after those.
+namespace NameIndex {
+
+  static constexpr uint32_t BUCKETS     = 4096;
+  static constexpr uint32_t MAX_ENTRIES = 1u << 20;   // later entries are left out
+  static constexpr uint32_t NONE        = UINT32_MAX;
+
+  // Register the console command.
+  void begin();
+
+  // ---- Building, by SpaceTree: begin before its job starts, the rest
+  // from the job (volume open) ----
+  void buildBegin();
+  void buildAdd(const FatVolume::Entry& e);
+  // Sort, make the postings and save; false if out of memory. saved tells
+  // whether it went to flash too (false if larger than the partition).
+  bool buildEnd(bool* saved);
+
+  // Raw CardJob checking the index against the card in the slot: the one
+  // in memory is kept if it still matches, else it is dropped and the saved
+  // one loaded if that matches. False if the card is busy or missing.
+  bool load();
+  // An index is in memory (built or loaded); false while rebuilding.
+  bool     ready();
+  uint32_t count();
+  // Changes whenever the index is dropped or rebuilt: rows from another
+  // generation name other entries.
+  uint32_t generation();
+
+  // Rows whose name contains text (any case), in name order: the first max
+  // go to rows, the return value counts all.
+  uint32_t search(const char* text, uint32_t* rows, uint32_t max);
+  // "/DCIM/100CANON/IMG_0001.JPG"
+  void path(uint32_t row, char* out, size_t len);
+  bool isDir(uint32_t row);
+
+} // namespace NameIndex
@@ -0,0 +1,392 @@
+#include "QuickFormat.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+
+static constexpr uint32_t BUF_SECTORS     = 128;                   // 64 KB: zero fill, boot regions
+static constexpr uint32_t DEFAULT_AU      = 8192;                  // 4 MB when the SSR has none
+static constexpr uint32_t MAX_AU          = 32768;                 // 16 MB keeps FAT32 reserved sectors in 16 bits
+static constexpr uint32_t SDHC_MAX        = 64u * 1024u * 1024u;   // 32 GB in sectors
+static constexpr uint32_t FAT32_MIN_CLUSTERS = 65525;
+static const char* const  VOLUME_LABEL    = "KODEDOT SD ";         // 11 chars, space padded
+
+static QuickFormat::Fs s_fs = QuickFormat::Fs::Auto;
+
+// All values in sectors; offsets from partStart.
+struct Layout {
+  bool     exfat;
+  uint32_t au;
+  uint32_t partStart;
+  uint32_t partSize;
+  uint32_t spc;           // sectors per cluster
+  uint32_t fatOffset;     // FAT32: reserved sector count
+  uint32_t fatSize;       // per FAT
+  uint32_t dataStart;     // first cluster (FAT32 data area / exFAT cluster heap)
+  uint32_t clusters;
+  uint32_t bitmapClusters;   // exFAT: bitmap at cluster 2, then up-case, then root
+  uint32_t rootCluster;
+};
+
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+static inline void put64(uint8_t* p, uint64_t v) { put32(p, v); put32(p + 4, v >> 32); }
+static inline uint32_t roundUp(uint32_t v, uint32_t to) { return (v + to - 1) / to * to; }
+
+// ---------------- Layout ----------------
+static bool planFat32(Layout& l) {
+  l.spc = l.partSize < 8u * 1024u * 1024u ? 8 : 64;   // 4 KB below 4 GB, 32 KB like the SD formatter
+  // Size the FAT for the whole partition (a slight overestimate), then grow
+  // the reserved area so the data area starts on an AU boundary.
+  const uint32_t maxClusters = (l.partSize - 32) / l.spc;
+  l.fatSize   = roundUp((maxClusters + 2) * 4, SdCard::SECTOR_SIZE) / SdCard::SECTOR_SIZE;
+  l.dataStart = roundUp(l.partStart + 32 + 2 * l.fatSize, l.au) - l.partStart;
+  l.fatOffset = l.dataStart - 2 * l.fatSize;
+  l.clusters  = (l.partSize - l.dataStart) / l.spc;
+  l.rootCluster = 2;
+  return l.clusters >= FAT32_MIN_CLUSTERS && l.dataStart < l.partSize;
+}
+
+static bool planExFat(Layout& l) {
+  const uint64_t bytes = (uint64_t)l.partSize * SdCard::SECTOR_SIZE;
+  l.spc = bytes <= (32ull << 30) ? 64 : bytes <= (512ull << 30) ? 256 : bytes <= (1024ull << 30) ? 512 : 1024;
+  // FAT right before the cluster heap, heap on an AU boundary.
+  const uint32_t maxClusters = l.partSize / l.spc;
+  l.fatSize   = roundUp((maxClusters + 2) * 4, SdCard::SECTOR_SIZE) / SdCard::SECTOR_SIZE;
+  l.dataStart = roundUp(l.partStart + 24 + l.fatSize, l.au) - l.partStart;
+  l.fatOffset = l.dataStart - l.fatSize;
+  l.clusters  = (l.partSize - l.dataStart) / l.spc;
+  const uint32_t clusterBytes = l.spc * SdCard::SECTOR_SIZE;
+  l.bitmapClusters = (roundUp(l.clusters, 8) / 8 + clusterBytes - 1) / clusterBytes;
+  l.rootCluster    = 2 + l.bitmapClusters + 1;   // after the one-cluster up-case table
+  return l.clusters > l.rootCluster && l.dataStart < l.partSize;
+}
+
+// ---------------- Writers ----------------
+static bool writeSectors(const uint8_t* buf, uint32_t lba, uint32_t count) {
+  const bool ok = SdCard::write(buf, lba, count);
+  CardJob::advance((uint64_t)count * SdCard::SECTOR_SIZE);
+  CardJob::countIo(0, (uint64_t)count * SdCard::SECTOR_SIZE);
+  return ok;
+}
+
+// Zero [0, end): one SD ERASE when erased sectors read as zeros, else writes.
+static bool clearMetadata(uint8_t* buf, uint32_t end, bool& erased) {
+  erased = SdCard::erasedByte() == 0x00 && SdCard::erase(0, end);
+  if (erased) {
+    CardJob::advance((uint64_t)end * SdCard::SECTOR_SIZE);
+    return true;
+  }
+  memset(buf, 0, BUF_SECTORS * SdCard::SECTOR_SIZE);
+  for (uint32_t lba = 0; lba < end; lba += BUF_SECTORS) {
+    if (!writeSectors(buf, lba, min(BUF_SECTORS, end - lba))) return false;
+  }
+  return true;
+}
+
+static bool writeMbr(uint8_t* s, const Layout& l) {
+  memset(s, 0, SdCard::SECTOR_SIZE);
+  uint8_t* e = s + 446;                      // first partition entry, LBA only
+  e[1] = 0xFE; e[2] = 0xFF; e[3] = 0xFF;
+  e[4] = l.exfat ? 0x07 : 0x0C;              // exFAT / FAT32 LBA
+  e[5] = 0xFE; e[6] = 0xFF; e[7] = 0xFF;
+  put32(e + 8, l.partStart);
+  put32(e + 12, l.partSize);
+  s[510] = 0x55; s[511] = 0xAA;
+  return writeSectors(s, 0, 1);
+}
+
+static bool writeFat32(uint8_t* buf, const Layout& l, uint32_t serial) {
+  const uint32_t base = l.partStart;
+  uint8_t* bs = buf;                         // boot sector
+  uint8_t* fi = buf + SdCard::SECTOR_SIZE;   // FSInfo
+  memset(buf, 0, 2 * SdCard::SECTOR_SIZE);
+  bs[0] = 0xEB; bs[1] = 0x58; bs[2] = 0x90;
+  memcpy(bs + 3, "MSDOS5.0", 8);
+  put16(bs + 11, SdCard::SECTOR_SIZE);
+  bs[13] = l.spc;
+  put16(bs + 14, l.fatOffset);
+  bs[16] = 2;                                // FATs
+  bs[21] = 0xF8;                             // fixed media
+  put16(bs + 24, 63);                        // sectors per track
+  put16(bs + 26, 255);                       // heads
+  put32(bs + 28, l.partStart);               // hidden sectors
+  put32(bs + 32, l.partSize);
+  put32(bs + 36, l.fatSize);
+  put32(bs + 44, l.rootCluster);
+  put16(bs + 48, 1);                         // FSInfo sector
+  put16(bs + 50, 6);                         // backup boot sector
+  bs[64] = 0x80;
+  bs[66] = 0x29;
+  put32(bs + 67, serial);
+  memcpy(bs + 71, VOLUME_LABEL, 11);
+  memcpy(bs + 82, "FAT32   ", 8);
+  bs[510] = 0x55; bs[511] = 0xAA;
+
+  put32(fi, 0x41615252);
+  put32(fi + 484, 0x61417272);
+  put32(fi + 488, l.clusters - 1);           // free (root uses one)
+  put32(fi + 492, l.rootCluster + 1);        // next free hint
+  put32(fi + 508, 0xAA550000);
+  if (!writeSectors(buf, base, 2) || !writeSectors(buf, base + 6, 2)) return false;
+
+  // FAT: media/reserved entries and the root directory's single cluster
+  memset(buf, 0, SdCard::SECTOR_SIZE);
+  put32(buf, 0x0FFFFFF8);
+  put32(buf + 4, 0x0FFFFFFF);
+  put32(buf + 8, 0x0FFFFFFF);
+  if (!writeSectors(buf, base + l.fatOffset, 1) ||
+      !writeSectors(buf, base + l.fatOffset + l.fatSize, 1)) return false;
+
+  memset(buf, 0, SdCard::SECTOR_SIZE);
+  memcpy(buf, VOLUME_LABEL, 11);
+  buf[11] = 0x08;                            // ATTR_VOLUME_ID
+  return writeSectors(buf, base + l.dataStart + (l.rootCluster - 2) * l.spc, 1);
+}
+
+static uint32_t exfatSum(uint32_t sum, uint8_t byte) {
+  return ((sum & 1) ? 0x80000000u : 0) + (sum >> 1) + byte;
+}
+
+// Up-case mapping as ranges of lowercase characters: first..last, every
+// step-th one maps to c + delta. Unicode simple uppercase mappings of the BMP
+// as of Unicode 5.0, the generation the spec's recommended table covers.
+struct UpcaseRange {
+  uint16_t first, last;
+  int16_t  delta;
+  uint8_t  step;
+};
+static const UpcaseRange UPCASE[] = {
+  { 0x0061, 0x007A,    -32, 1 }, { 0x00B5, 0x00B5,    743, 1 }, { 0x00E0, 0x00F6,    -32, 1 },
+  { 0x00F8, 0x00FE,    -32, 1 }, { 0x00FF, 0x00FF,    121, 1 }, { 0x0101, 0x012F,     -1, 2 },
+  { 0x0131, 0x0131,   -232, 1 }, { 0x0133, 0x0137,     -1, 2 }, { 0x013A, 0x0148,     -1, 2 },
+  { 0x014B, 0x0177,     -1, 2 }, { 0x017A, 0x017E,     -1, 2 }, { 0x017F, 0x017F,   -300, 1 },
+  { 0x0180, 0x0180,    195, 1 }, { 0x0183, 0x0185,     -1, 2 }, { 0x0188, 0x0188,     -1, 1 },
+  { 0x018C, 0x018C,     -1, 1 }, { 0x0192, 0x0192,     -1, 1 }, { 0x0195, 0x0195,     97, 1 },
+  { 0x0199, 0x0199,     -1, 1 }, { 0x019A, 0x019A,    163, 1 }, { 0x019E, 0x019E,    130, 1 },
+  { 0x01A1, 0x01A5,     -1, 2 }, { 0x01A8, 0x01A8,     -1, 1 }, { 0x01AD, 0x01AD,     -1, 1 },
+  { 0x01B0, 0x01B0,     -1, 1 }, { 0x01B4, 0x01B6,     -1, 2 }, { 0x01B9, 0x01B9,     -1, 1 },
+  { 0x01BD, 0x01BD,     -1, 1 }, { 0x01BF, 0x01BF,     56, 1 }, { 0x01C5, 0x01C5,     -1, 1 },
+  { 0x01C6, 0x01C6,     -2, 1 }, { 0x01C8, 0x01C8,     -1, 1 }, { 0x01C9, 0x01C9,     -2, 1 },
+  { 0x01CB, 0x01CB,     -1, 1 }, { 0x01CC, 0x01CC,     -2, 1 }, { 0x01CE, 0x01DC,     -1, 2 },
+  { 0x01DD, 0x01DD,    -79, 1 }, { 0x01DF, 0x01EF,     -1, 2 }, { 0x01F2, 0x01F2,     -1, 1 },
+  { 0x01F3, 0x01F3,     -2, 1 }, { 0x01F5, 0x01F5,     -1, 1 }, { 0x01F9, 0x021F,     -1, 2 },
+  { 0x0223, 0x0233,     -1, 2 }, { 0x023C, 0x023C,     -1, 1 }, { 0x0242, 0x0242,     -1, 1 },
+  { 0x0247, 0x024F,     -1, 2 }, { 0x0253, 0x0253,   -210, 1 }, { 0x0254, 0x0254,   -206, 1 },
+  { 0x0256, 0x0257,   -205, 1 }, { 0x0259, 0x0259,   -202, 1 }, { 0x025B, 0x025B,   -203, 1 },
+  { 0x0260, 0x0260,   -205, 1 }, { 0x0263, 0x0263,   -207, 1 }, { 0x0268, 0x0268,   -209, 1 },
+  { 0x0269, 0x0269,   -211, 1 }, { 0x026B, 0x026B,  10743, 1 }, { 0x026F, 0x026F,   -211, 1 },
+  { 0x0272, 0x0272,   -213, 1 }, { 0x0275, 0x0275,   -214, 1 }, { 0x027D, 0x027D,  10727, 1 },
+  { 0x0280, 0x0280,   -218, 1 }, { 0x0283, 0x0283,   -218, 1 }, { 0x0288, 0x0288,   -218, 1 },
+  { 0x0289, 0x0289,    -69, 1 }, { 0x028A, 0x028B,   -217, 1 }, { 0x028C, 0x028C,    -71, 1 },
+  { 0x0292, 0x0292,   -219, 1 }, { 0x0345, 0x0345,     84, 1 }, { 0x037B, 0x037D,    130, 1 },
+  { 0x03AC, 0x03AC,    -38, 1 }, { 0x03AD, 0x03AF,    -37, 1 }, { 0x03B1, 0x03C1,    -32, 1 },
+  { 0x03C2, 0x03C2,    -31, 1 }, { 0x03C3, 0x03CB,    -32, 1 }, { 0x03CC, 0x03CC,    -64, 1 },
+  { 0x03CD, 0x03CE,    -63, 1 }, { 0x03D0, 0x03D0,    -62, 1 }, { 0x03D1, 0x03D1,    -57, 1 },
+  { 0x03D5, 0x03D5,    -47, 1 }, { 0x03D6, 0x03D6,    -54, 1 }, { 0x03D9, 0x03EF,     -1, 2 },
+  { 0x03F0, 0x03F0,    -86, 1 }, { 0x03F1, 0x03F1,    -80, 1 }, { 0x03F2, 0x03F2,      7, 1 },
+  { 0x03F5, 0x03F5,    -96, 1 }, { 0x03F8, 0x03F8,     -1, 1 }, { 0x03FB, 0x03FB,     -1, 1 },
+  { 0x0430, 0x044F,    -32, 1 }, { 0x0450, 0x045F,    -80, 1 }, { 0x0461, 0x0481,     -1, 2 },
+  { 0x048B, 0x04BF,     -1, 2 }, { 0x04C2, 0x04CE,     -1, 2 }, { 0x04CF, 0x04CF,    -15, 1 },
+  { 0x04D1, 0x0513,     -1, 2 }, { 0x0561, 0x0586,    -48, 1 }, { 0x1D7D, 0x1D7D,   3814, 1 },
+  { 0x1E01, 0x1E95,     -1, 2 }, { 0x1E9B, 0x1E9B,    -59, 1 }, { 0x1EA1, 0x1EF9,     -1, 2 },
+  { 0x1F00, 0x1F07,      8, 1 }, { 0x1F10, 0x1F15,      8, 1 }, { 0x1F20, 0x1F27,      8, 1 },
+  { 0x1F30, 0x1F37,      8, 1 }, { 0x1F40, 0x1F45,      8, 1 }, { 0x1F51, 0x1F57,      8, 2 },
+  { 0x1F60, 0x1F67,      8, 1 }, { 0x1F70, 0x1F71,     74, 1 }, { 0x1F72, 0x1F75,     86, 1 },
+  { 0x1F76, 0x1F77,    100, 1 }, { 0x1F78, 0x1F79,    128, 1 }, { 0x1F7A, 0x1F7B,    112, 1 },
+  { 0x1F7C, 0x1F7D,    126, 1 }, { 0x1F80, 0x1F87,      8, 1 }, { 0x1F90, 0x1F97,      8, 1 },
+  { 0x1FA0, 0x1FA7,      8, 1 }, { 0x1FB0, 0x1FB1,      8, 1 }, { 0x1FB3, 0x1FB3,      9, 1 },
+  { 0x1FBE, 0x1FBE,  -7205, 1 }, { 0x1FC3, 0x1FC3,      9, 1 }, { 0x1FD0, 0x1FD1,      8, 1 },
+  { 0x1FE0, 0x1FE1,      8, 1 }, { 0x1FE5, 0x1FE5,      7, 1 }, { 0x1FF3, 0x1FF3,      9, 1 },
+  { 0x214E, 0x214E,    -28, 1 }, { 0x2170, 0x217F,    -16, 1 }, { 0x2184, 0x2184,     -1, 1 },
+  { 0x24D0, 0x24E9,    -26, 1 }, { 0x2C30, 0x2C5E,    -48, 1 }, { 0x2C61, 0x2C61,     -1, 1 },
+  { 0x2C65, 0x2C65, -10795, 1 }, { 0x2C66, 0x2C66, -10792, 1 }, { 0x2C68, 0x2C6C,     -1, 2 },
+  { 0x2C76, 0x2C76,     -1, 1 }, { 0x2C81, 0x2CE3,     -1, 2 }, { 0x2D00, 0x2D25,  -7264, 1 },
+  { 0xFF41, 0xFF5A,    -32, 1 },
+};
+static constexpr uint32_t UPCASE_RUN = 512;   // shorter identity runs are stored verbatim
+
+// Compressed up-case table (0xFFFF n = n identity-mapped characters) into
+// out; returns its size in bytes. Same 5836-byte layout as the spec's table.
+static uint32_t buildUpcase(uint8_t* out) {
+  uint32_t n = 0, run = 0, r = 0;
+  auto flush = [&](uint32_t c) {
+    if (run >= UPCASE_RUN) {
+      put16(out + n, 0xFFFF);
+      put16(out + n + 2, run);
+      n += 4;
+    } else {
+      for (uint32_t i = c - run; i < c; ++i, n += 2) put16(out + n, i);
+    }
+    run = 0;
+  };
+  for (uint32_t c = 0; c <= 0xFFFF; ++c) {
+    while (r < sizeof(UPCASE) / sizeof(UPCASE[0]) && UPCASE[r].last < c) ++r;
+    const UpcaseRange* u = r < sizeof(UPCASE) / sizeof(UPCASE[0]) ? &UPCASE[r] : nullptr;
+    if (!u || c < u->first || (c - u->first) % u->step) {
+      run++;
+      continue;
+    }
+    flush(c);
+    put16(out + n, c + u->delta);
+    n += 2;
+  }
+  flush(0x10000);
+  return n;
+}
+
+static bool writeExFat(uint8_t* buf, const Layout& l, uint32_t serial) {
+  const uint32_t base = l.partStart;
+  const uint32_t S    = SdCard::SECTOR_SIZE;
+  uint8_t shift = 0;
+  while ((1u << shift) < l.spc) shift++;
+
+  // Boot region: boot sector, 8 extended boot sectors, OEM, reserved, checksum
+  memset(buf, 0, 12 * S);
+  uint8_t* bs = buf;
+  bs[0] = 0xEB; bs[1] = 0x76; bs[2] = 0x90;
+  memcpy(bs + 3, "EXFAT   ", 8);
+  put64(bs + 64, l.partStart);
+  put64(bs + 72, l.partSize);
+  put32(bs + 80, l.fatOffset);
+  put32(bs + 84, l.fatSize);
+  put32(bs + 88, l.dataStart);
+  put32(bs + 92, l.clusters);
+  put32(bs + 96, l.rootCluster);
+  put32(bs + 100, serial);
+  put16(bs + 104, 0x0100);                   // revision 1.0
+  bs[108] = 9;                               // 512-byte sectors
+  bs[109] = shift;
+  bs[110] = 1;                               // FATs
+  bs[111] = 0x80;
+  bs[510] = 0x55; bs[511] = 0xAA;
+  for (uint32_t i = 1; i <= 8; ++i) put32(buf + i * S + S - 4, 0xAA550000);
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < 11 * S; ++i) {
+    if (i == 106 || i == 107 || i == 112) continue;   // VolumeFlags, PercentInUse
+    sum = exfatSum(sum, buf[i]);
+  }
+  for (uint32_t i = 0; i < S; i += 4) put32(buf + 11 * S + i, sum);
+  if (!writeSectors(buf, base, 12) || !writeSectors(buf, base + 12, 12)) return false;
+
+  // FAT: bitmap chain, up-case and root, one cluster each after the bitmap
+  const uint32_t lastEntry = l.rootCluster;
+  const uint32_t fatSectors = ((lastEntry + 1) * 4 + S - 1) / S;
+  memset(buf, 0, fatSectors * S);
+  put32(buf, 0xFFFFFFF8);
+  put32(buf + 4, 0xFFFFFFFF);
+  for (uint32_t c = 2; c < 2 + l.bitmapClusters; ++c) put32(buf + c * 4, c + 1);
+  put32(buf + (1 + l.bitmapClusters) * 4, 0xFFFFFFFF);
+  put32(buf + (2 + l.bitmapClusters) * 4, 0xFFFFFFFF);
+  put32(buf + l.rootCluster * 4, 0xFFFFFFFF);
+  if (!writeSectors(buf, base + l.fatOffset, fatSectors)) return false;
+
+  auto clusterLba = [&](uint32_t c) { return base + l.dataStart + (c - 2) * l.spc; };
+
+  // Allocation bitmap: bit n is cluster n + 2
+  const uint32_t used = l.rootCluster - 1;
+  memset(buf, 0, S);
+  for (uint32_t i = 0; i < used; ++i) buf[i / 8] |= 1 << (i % 8);
+  if (!writeSectors(buf, clusterLba(2), 1)) return false;
+
+  const uint32_t upBytes   = buildUpcase(buf);
+  const uint32_t upSectors = (upBytes + S - 1) / S;
+  memset(buf + upBytes, 0, upSectors * S - upBytes);
+  uint32_t upSum = 0;
+  for (uint32_t i = 0; i < upBytes; ++i) upSum = exfatSum(upSum, buf[i]);
+  if (!writeSectors(buf, clusterLba(2 + l.bitmapClusters), upSectors)) return false;
+
+  // Root directory: volume label, bitmap and up-case entries
+  memset(buf, 0, S);
+  uint8_t* e = buf;
+  e[0] = 0x83;
+  e[1] = 10;
+  for (uint32_t i = 0; i < 10; ++i) put16(e + 2 + i * 2, VOLUME_LABEL[i]);   // "KODEDOT SD"
+  e += 32;
+  e[0] = 0x81;
+  put32(e + 20, 2);
+  put64(e + 24, roundUp(l.clusters, 8) / 8);
+  e += 32;
+  e[0] = 0x82;
+  put32(e + 4, upSum);
+  put32(e + 20, 2 + l.bitmapClusters);
+  put64(e + 24, upBytes);
+  return writeSectors(buf, clusterLba(l.rootCluster), 1);
+}
+
+static bool formatJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  const uint32_t total = SdCard::sectorCount();
+  uint32_t au = SdCard::allocUnitSectors();
+  const bool auKnown = au && (au & (au - 1)) == 0;
+  if (!auKnown) au = DEFAULT_AU;
+  au = min(au, MAX_AU);
+
+  Layout l = {};
+  l.exfat     = s_fs == QuickFormat::Fs::ExFat || (s_fs == QuickFormat::Fs::Auto && total > SDHC_MAX);
+  l.au        = au;
+  l.partStart = au;
+  l.partSize  = total > au ? total - au : 0;
+  if (!l.partSize || !(l.exfat ? planExFat(l) : planFat32(l))) {
+    CardJob::finish("card too small for %s", l.exfat ? "exFAT" : "FAT32");
+    return false;
+  }
+
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(BUF_SECTORS * SdCard::SECTOR_SIZE);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  // Everything up to the end of the clusters the new volume uses
+  const uint32_t metaEnd = l.partStart + l.dataStart + (l.rootCluster - 1) * l.spc;
+  CardJob::setTotal((uint64_t)(metaEnd + 64) * SdCard::SECTOR_SIZE);
+
+  bool erased = false;
+  CardJob::setItem("clearing metadata");
+  bool ok = clearMetadata(buf, metaEnd, erased);
+  CardJob::setItem("writing file system");
+  ok = ok && writeMbr(buf, l);
+  const uint32_t serial = esp_random();
+  ok = ok && (l.exfat ? writeExFat(buf, l, serial) : writeFat32(buf, l, serial));
+  heap_caps_free(buf);
+
+  const float secs = (esp_timer_get_time() - start) / 1e6f;
+  if (!ok) {
+    CardJob::finish("write failed, card left unformatted");
+    return false;
+  }
+  CardJob::finish("%s, %u KB clusters, %u KB aligned%s, %s, %.2f s", l.exfat ? "exFAT" : "FAT32",
+                  (unsigned)(l.spc / 2), (unsigned)(au / 2), auKnown ? "" : " (AU unknown)",
+                  erased ? "SD ERASE" : "zero fill", secs);
+  return true;
+}
+
+// ---------------- Console ----------------
+static void cmdFormat(Print& out, const char* args) {
+  QuickFormat::Fs fs;
+  if (strcmp(args, "yes") == 0) fs = QuickFormat::Fs::Auto;
+  else if (strcmp(args, "fat32 yes") == 0) fs = QuickFormat::Fs::Fat32;
+  else if (strcmp(args, "exfat yes") == 0) fs = QuickFormat::Fs::ExFat;
+  else {
+    out.println("usage: format [fat32|exfat] yes  (destroys all data on the card)");
+    return;
+  }
+  out.println(QuickFormat::start(fs) ? "format: started, \"job\" for progress"
+                                     : "format: card busy or missing (unmount USB first)");
+}
+
+namespace QuickFormat {
+
+void begin() {
+  Console::add("format", "quick format: [fat32|exfat] yes", cmdFormat);
+}
+
+bool start(Fs fs) {
+  if (CardJob::busy()) return false;
+  s_fs = fs;
+  return CardJob::start("format", CardJob::Access::Raw, formatJob, nullptr);
+}
+
+} // namespace QuickFormat
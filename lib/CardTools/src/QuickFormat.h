@@ -0,0 +1,23 @@
+#pragma once
+#include <Arduino.h>
+
+// Quick format ("format" console command, Tools screen): MBR with one
+// partition and a fresh FAT32 or exFAT volume, laid out like the SD
+// Association formatter - partition start and data area aligned to the
+// card's allocation unit (SD Status register). Only metadata is touched:
+// the metadata area is cleared with SD ERASE (zero-writes if the card
+// can't), so the time doesn't grow with capacity.
+namespace QuickFormat {
+
+  enum class Fs : uint8_t {
+    Auto,    // FAT32 up to 32 GB (SDHC), exFAT above (SDXC)
+    Fat32,
+    ExFat,
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start(Fs fs = Fs::Auto);
+
+} // namespace QuickFormat
@@ -0,0 +1,108 @@
+#include "SecureErase.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+
+static constexpr uint32_t ERASE_SECTORS = 512u * 1024u * 1024u / SdCard::SECTOR_SIZE;  // per command, for progress
+static constexpr uint32_t FILL_SECTORS  = 128;                                         // 64 KB writes
+static constexpr uint32_t VERIFY_SAMPLES = 64;
+
+// Overwrite [lba, end) with zeros.
+static uint32_t fill(uint8_t* buf, uint32_t lba, uint32_t end) {
+  memset(buf, 0, FILL_SECTORS * SdCard::SECTOR_SIZE);
+  for (; lba < end && !CardJob::cancelled(); lba += FILL_SECTORS) {
+    const uint32_t n = min(FILL_SECTORS, end - lba);
+    if (!SdCard::write(buf, lba, n)) return lba;
+    CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE);
+    CardJob::countIo(0, (uint64_t)n * SdCard::SECTOR_SIZE);
+  }
+  return lba;
+}
+
+// Erased content is checked on a random sample plus both ends of the card:
+// erasedByte() below erasedEnd, zeros from the pattern fill above it.
+static uint32_t verify(uint8_t* buf, uint32_t total, uint32_t erasedEnd) {
+  uint32_t bad = 0;
+  for (uint32_t i = 0; i < VERIFY_SAMPLES + 2; ++i) {
+    const uint32_t lba    = i == 0 ? 0 : i == 1 ? total - 1 : esp_random() % total;
+    const uint8_t  expect = lba < erasedEnd ? SdCard::erasedByte() : 0x00;
+    bool ok = SdCard::read(buf, lba, 1);
+    for (uint32_t b = 0; ok && b < SdCard::SECTOR_SIZE; ++b) ok = buf[b] == expect;
+    if (!ok) bad++;
+  }
+  return bad;
+}
+
+static bool eraseJob(void*) {
+  const uint32_t total = SdCard::sectorCount();
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(FILL_SECTORS * SdCard::SECTOR_SIZE);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  CardJob::setTotal((uint64_t)total * SdCard::SECTOR_SIZE);
+  const int64_t start = esp_timer_get_time();
+
+  // Ranges are multiples of the AU so the card can drop whole blocks.
+  const uint32_t au   = max<uint32_t>(SdCard::allocUnitSectors(), 1);
+  const uint32_t step = max(ERASE_SECTORS / au, 1u) * au;
+  uint32_t lba = 0;
+  CardJob::setItem("SD ERASE");
+  while (lba < total && !CardJob::cancelled()) {
+    const uint32_t n = min(step, total - lba);
+    if (!SdCard::erase(lba, n)) break;
+    lba += n;
+    CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE, 1);
+  }
+
+  const uint32_t erasedEnd = lba;
+  const bool filled = lba < total && !CardJob::cancelled();
+  if (filled) {
+    CardJob::setItem("pattern fill (no SD ERASE)");
+    lba = fill(buf, lba, total);
+  }
+  if (CardJob::cancelled()) {
+    heap_caps_free(buf);
+    CardJob::finish("cancelled at %u MB, card partly erased", (unsigned)(lba / 2048));
+    return false;
+  }
+  if (lba < total) {
+    heap_caps_free(buf);
+    CardJob::finish("write failed at LBA %u", (unsigned)lba);
+    return false;
+  }
+
+  CardJob::setItem("verifying");
+  const uint32_t bad = verify(buf, total, erasedEnd);
+  heap_caps_free(buf);
+
+  const float secs = (esp_timer_get_time() - start) / 1e6f;
+  CardJob::finish("%.1f GB erased by %s in %.1f s%s", total / 2097152.0f, filled ? "pattern fill" : "SD ERASE",
+                  secs, bad ? ", NOT ERASED on readback" : "");
+  return bad == 0;
+}
+
+// ---------------- Console ----------------
+static void cmdErase(Print& out, const char* args) {
+  if (strcmp(args, "yes") != 0) {
+    out.println("usage: erase yes  (destroys all data on the card)");
+    return;
+  }
+  out.println(SecureErase::start() ? "erase: started, \"job\" for progress"
+                                   : "erase: card busy or missing (unmount USB first)");
+}
+
+namespace SecureErase {
+
+void begin() {
+  Console::add("erase", "erase the whole card: yes", cmdErase);
+}
+
+bool start() {
+  return CardJob::start("erase", CardJob::Access::Raw, eraseJob, nullptr);
+}
+
+} // namespace SecureErase
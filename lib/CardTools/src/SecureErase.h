@@ -0,0 +1,16 @@
+#pragma once
+#include <Arduino.h>
+
+// Whole-card erase ("erase" console command, Tools screen). Uses SD ERASE
+// in AU-aligned ranges so the controller drops every flash block; cards
+// without erase support (or failing mid-way) get the rest overwritten with
+// zeros instead. A sample of sectors is read back at the end.
+// Leaves the card without a file system.
+namespace SecureErase {
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+
+} // namespace SecureErase
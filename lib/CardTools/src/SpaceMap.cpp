@@ -0,0 +1,152 @@
+#include "SpaceMap.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include <Console.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static constexpr uint32_t CONSOLE_COLS  = 64;
+static constexpr uint32_t CONSOLE_ROWS  = 16;
+
+static uint8_t*          s_density  = nullptr;
+static uint32_t          s_capacity = 0;      // cells s_density holds
+static uint32_t          s_asked    = 0;
+static SpaceMap::Summary s_summary  = {};
+
+// Set bits in [from, to), bit n = cluster n + 2; whole words in the middle.
+static uint32_t countUsed(const uint32_t* bits, uint32_t from, uint32_t to) {
+  if (from >= to) return 0;
+  const uint32_t w0 = from >> 5, w1 = (to - 1) >> 5;
+  const uint32_t head = ~0u << (from & 31);
+  const uint32_t tail = ~0u >> (31 - ((to - 1) & 31));
+  if (w0 == w1) return __builtin_popcount(bits[w0] & head & tail);
+  uint32_t n = __builtin_popcount(bits[w0] & head) + __builtin_popcount(bits[w1] & tail);
+  for (uint32_t w = w0 + 1; w < w1; ++w) n += __builtin_popcount(bits[w]);
+  return n;
+}
+
+// Longest free run, skipping full and empty words whole.
+static uint32_t largestFreeRun(const uint32_t* bits, uint32_t clusters) {
+  uint32_t best = 0, len = 0;
+  for (uint32_t w = 0; w < (clusters + 31) / 32; ++w) {
+    const uint32_t word = bits[w];
+    if (word == 0xFFFFFFFF) {
+      len = 0;
+    } else if (word == 0 && w * 32 + 32 <= clusters) {
+      len += 32;
+      best = max(best, len);
+    } else {
+      for (uint32_t b = 0; b < 32 && w * 32 + b < clusters; ++b) {
+        len = (word & (1u << b)) ? 0 : len + 1;
+        best = max(best, len);
+      }
+    }
+  }
+  return best;
+}
+
+static bool mapJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  CardJob::setItem("reading allocation table");
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  const FatVolume::Info& vi = FatVolume::info();
+  const uint32_t* bits = FatVolume::loadBitmap();
+  if (!bits) {
+    FatVolume::close();
+    CardJob::finish("out of memory for the allocation bitmap");
+    return false;
+  }
+
+  SpaceMap::Summary s = {};
+  s.clusters     = vi.clusters;
+  s.clusterBytes = vi.clusterBytes;
+  s.cells        = min(s_asked, vi.clusters);
+  CardJob::setTotal(s.cells);
+  for (uint32_t i = 0; i < s.cells; ++i) {
+    const uint32_t from = (uint64_t)i * vi.clusters / s.cells;
+    const uint32_t to   = (uint64_t)(i + 1) * vi.clusters / s.cells;
+    const uint32_t used = countUsed(bits, from, to);
+    s_density[i] = used * 255 / (to - from);
+    s.used += used;
+  }
+  CardJob::advance(s.cells);
+  s.largestFree = largestFreeRun(bits, vi.clusters);
+  FatVolume::close();
+
+  s.valid   = true;
+  s_summary = s;
+  CardJob::finish("%.1f%% used, largest free run %.1f MB, %.2f s", 100.0 * s.used / s.clusters,
+                  (double)s.largestFree * s.clusterBytes / 1048576.0, (esp_timer_get_time() - start) / 1e6f);
+  return true;
+}
+
+// ---------------- Console ----------------
+static void printMap(Print& out) {
+  const SpaceMap::Summary s = s_summary;
+  if (!s.valid) {
+    out.println("spacemap: no map yet (run \"spacemap\" first)");
+    return;
+  }
+  static const char SHADES[] = " .:-=+*#%@";
+  out.printf("Space map: %u clusters of %u KB, %.1f%% used, largest free run %.1f MB\n", (unsigned)s.clusters,
+             (unsigned)(s.clusterBytes / 1024), 100.0 * s.used / s.clusters,
+             (double)s.largestFree * s.clusterBytes / 1048576.0);
+  const uint32_t cells = min(s.cells, CONSOLE_COLS * CONSOLE_ROWS);
+  char line[CONSOLE_COLS + 3];
+  uint32_t col = 0;
+  line[col++] = '|';
+  for (uint32_t i = 0; i < cells; ++i) {
+    // Average the map cells that fall into this character
+    const uint32_t from = (uint64_t)i * s.cells / cells, to = (uint64_t)(i + 1) * s.cells / cells;
+    uint32_t sum = 0;
+    for (uint32_t j = from; j < to; ++j) sum += s_density[j];
+    line[col++] = SHADES[sum / (to - from) * 9 / 255];
+    if (col == CONSOLE_COLS + 1 || i + 1 == cells) {
+      line[col++] = '|';
+      line[col] = '\0';
+      out.println(line);
+      col = 0;
+      line[col++] = '|';
+    }
+  }
+}
+
+static void cmdSpacemap(Print& out, const char* args) {
+  if (strcmp(args, "show") == 0) {
+    printMap(out);
+  } else if (*args == '\0') {
+    out.println(SpaceMap::start(CONSOLE_COLS * CONSOLE_ROWS) ? "spacemap: building, \"spacemap show\" to print"
+                                                             : "spacemap: card busy or missing (unmount USB first)");
+  } else {
+    out.println("usage: spacemap [show]");
+  }
+}
+
+namespace SpaceMap {
+
+void begin() {
+  Console::add("spacemap", "cluster allocation map: [show]", cmdSpacemap);
+}
+
+bool start(uint32_t cells) {
+  if (CardJob::busy() || !cells) return false;
+  if (cells > s_capacity) {
+    heap_caps_free(s_density);
+    s_capacity = 0;
+    s_density  = (uint8_t*)heap_caps_malloc(cells, MALLOC_CAP_SPIRAM);
+    if (!s_density) return false;
+    s_capacity = cells;
+  }
+  s_asked         = cells;
+  s_summary.valid = false;
+  return CardJob::start("space map", CardJob::Access::Raw, mapJob, nullptr);
+}
+
+const uint8_t* density() { return s_density; }
+
+Summary summary() { return s_summary; }
+
+} // namespace SpaceMap
@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+
+// Allocation map of the card ("spacemap" console command, Space map screen):
+// the cluster range is split into equal cells, in cluster order, and each
+// cell gets its used density from the allocation bitmap (exFAT's own, or
+// streamed from the FAT on FAT32) with 32-bit popcounts. One streaming pass,
+// no directory reads.
+namespace SpaceMap {
+
+  struct Summary {
+    bool     valid;            // a map was built (false while building)
+    uint32_t cells;            // may be fewer than asked on tiny volumes
+    uint32_t clusters;
+    uint32_t used;
+    uint32_t clusterBytes;
+    uint32_t largestFree;      // longest run of free clusters
+  };
+
+  // Register the console command.
+  void begin();
+
+  // Build a map of `cells` cells as a raw CardJob.
+  bool start(uint32_t cells);
+  // Used density per cell, 0 (free) .. 255 (full); valid once summary().valid.
+  const uint8_t* density();
+  Summary summary();
+
+} // namespace SpaceMap
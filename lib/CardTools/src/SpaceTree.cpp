@@ -0,0 +1,189 @@
+#include "SpaceTree.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include "NameIndex.h"
+#include <Console.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+using FatVolume::Entry;
+using SpaceTree::Node;
+using SpaceTree::NONE;
+
+static constexpr uint32_t FIRST_NODES = 1024;
+static constexpr size_t   FIRST_NAMES = 16 * 1024;
+static constexpr uint32_t DU_LINES    = 20;
+
+static Node*         s_nodes     = nullptr;
+static size_t        s_nodeCap   = 0;
+static uint32_t      s_count     = 0;
+static char*         s_names     = nullptr;
+static size_t        s_namesCap  = 0;
+static size_t        s_namesUsed = 0;
+static volatile bool s_ready     = false;
+static uint32_t      s_generation = 0;
+
+struct Build {
+  uint32_t stack[FatVolume::MAX_DEPTH + 1];   // node of the folder at each depth
+  uint32_t dropped;                           // folders past MAX_DIRS
+};
+
+// Double a PSRAM array until it holds `need` elements.
+static bool reserve(void** p, size_t* cap, size_t need, size_t elem, size_t first) {
+  if (need <= *cap) return true;
+  size_t n = *cap ? *cap : first;
+  while (n < need) n *= 2;
+  void* q = heap_caps_realloc(*p, n * elem, MALLOC_CAP_SPIRAM);
+  if (!q) return false;
+  *p   = q;
+  *cap = n;
+  return true;
+}
+
+static uint32_t addNode(uint32_t parent, const char* name) {
+  const size_t len = strlen(name) + 1;
+  if (s_count >= SpaceTree::MAX_DIRS ||
+      !reserve((void**)&s_nodes, &s_nodeCap, s_count + 1, sizeof(Node), FIRST_NODES) ||
+      !reserve((void**)&s_names, &s_namesCap, s_namesUsed + len, 1, FIRST_NAMES)) {
+    return NONE;
+  }
+  const uint32_t id = s_count++;
+  memcpy(s_names + s_namesUsed, name, len);
+  s_nodes[id] = { 0, 0, parent, NONE, NONE, (uint32_t)s_namesUsed, 0 };
+  s_namesUsed += len;
+  if (parent != NONE) {
+    s_nodes[id].nextSibling    = s_nodes[parent].firstChild;
+    s_nodes[parent].firstChild = id;
+  }
+  return id;
+}
+
+static FileWalk::Action visitEntry(const Entry& e, void* arg) {
+  Build& b = *(Build*)arg;
+  if (CardJob::cancelled()) return FileWalk::Action::Stop;
+  NameIndex::buildAdd(e);
+  const uint32_t parent = b.stack[e.depth];
+  if (!e.dir) {
+    s_nodes[parent].bytes += e.size;
+    s_nodes[parent].files++;
+    CardJob::advance(0, 1);
+    return FileWalk::Action::Continue;
+  }
+  const uint32_t id = addNode(parent, e.name);
+  if (id == NONE) b.dropped++;
+  b.stack[e.depth + 1] = id == NONE ? parent : id;
+  CardJob::setItem(e.path);
+  return FileWalk::Action::Continue;
+}
+
+static bool treeJob(void*) {
+  const int64_t start = esp_timer_get_time();
+  if (!FatVolume::open()) {
+    CardJob::finish("no FAT32/exFAT volume found");
+    return false;
+  }
+  Build b = {};
+  s_count     = 0;
+  s_namesUsed = 0;
+  b.stack[0]  = addNode(NONE, "");
+  bool walked = b.stack[0] != NONE && FatVolume::walk(visitEntry, &b);
+  bool indexed = false, saved = false;
+  if (walked) indexed = NameIndex::buildEnd(&saved);
+  FatVolume::close();
+  if (!walked) {
+    CardJob::finish(CardJob::cancelled() ? "cancelled" : "directory read error");
+    return false;
+  }
+
+  // Children always come after their parent: one backward pass sums subtrees
+  for (uint32_t i = s_count - 1; i > 0; --i) {
+    Node& p = s_nodes[s_nodes[i].parent];
+    p.bytes += s_nodes[i].bytes;
+    p.files += s_nodes[i].files;
+    p.dirs  += s_nodes[i].dirs + 1;
+  }
+  s_ready = true;
+  const Node& root = s_nodes[SpaceTree::ROOT];
+  CardJob::finish("%u files in %u folders, %.1f MB, %.1f s%s%s", (unsigned)root.files, (unsigned)root.dirs,
+                  root.bytes / 1048576.0, (esp_timer_get_time() - start) / 1e6f,
+                  b.dropped ? " (deepest folders merged)" : "",
+                  !indexed ? ", no name index (out of memory)" : saved ? "" : ", name index not saved");
+  return true;
+}
+
+// ---------------- Console ----------------
+static void cmdDu(Print& out, const char* args) {
+  if (strcmp(args, "scan") == 0) {
+    out.println(SpaceTree::start() ? "du: scanning, \"job\" for progress"
+                                   : "du: card busy or missing (unmount USB first)");
+    return;
+  }
+  if (!SpaceTree::ready()) {
+    out.println("du: no scan yet (run \"du scan\" first)");
+    return;
+  }
+  const uint32_t dir = SpaceTree::find(*args ? args : "/");
+  if (dir == NONE) {
+    out.println("du: no such folder");
+    return;
+  }
+  const Node& d = SpaceTree::node(dir);
+  out.printf("%.1f MB in %u files, %u folders\n", d.bytes / 1048576.0, (unsigned)d.files, (unsigned)d.dirs);
+
+  // Largest children first (ties by index): pick the next one after the last printed
+  uint64_t own = d.bytes, below = UINT64_MAX;
+  uint32_t lastPicked = NONE;
+  for (uint32_t c = d.firstChild; c != NONE; c = SpaceTree::node(c).nextSibling) own -= SpaceTree::node(c).bytes;
+  for (uint32_t line = 0; line < DU_LINES; ++line) {
+    uint32_t pick = NONE;
+    for (uint32_t c = d.firstChild; c != NONE; c = SpaceTree::node(c).nextSibling) {
+      const uint64_t b = SpaceTree::node(c).bytes;
+      if (!(b < below || (b == below && c > lastPicked))) continue;   // already printed
+      if (pick == NONE || b > SpaceTree::node(pick).bytes || (b == SpaceTree::node(pick).bytes && c < pick)) pick = c;
+    }
+    if (pick == NONE) break;
+    out.printf("  %10.1f MB  %s/\n", SpaceTree::node(pick).bytes / 1048576.0, SpaceTree::name(pick));
+    below      = SpaceTree::node(pick).bytes;
+    lastPicked = pick;
+  }
+  out.printf("  %10.1f MB  (files here)\n", own / 1048576.0);
+}
+
+namespace SpaceTree {
+
+void begin() {
+  Console::add("du", "space per folder: [scan|/path]", cmdDu);
+}
+
+bool start() {
+  if (CardJob::busy()) return false;
+  s_ready = false;
+  s_generation++;
+  NameIndex::buildBegin();
+  return CardJob::start("folder sizes", CardJob::Access::Raw, treeJob, nullptr);
+}
+
+bool        ready() { return s_ready; }
+uint32_t    generation() { return s_generation; }
+uint32_t    count() { return s_count; }
+const Node& node(uint32_t i) { return s_nodes[i]; }
+const char* name(uint32_t i) { return s_names + s_nodes[i].nameOff; }
+
+uint32_t find(const char* path) {
+  if (!s_ready) return NONE;
+  uint32_t n = ROOT;
+  while (*path) {
+    while (*path == '/') path++;
+    if (!*path) break;
+    const char* end = strchr(path, '/');
+    const size_t len = end ? (size_t)(end - path) : strlen(path);
+    uint32_t c = s_nodes[n].firstChild;
+    while (c != NONE && !(strncmp(name(c), path, len) == 0 && name(c)[len] == '\0')) c = s_nodes[c].nextSibling;
+    if (c == NONE) return NONE;
+    n = c;
+    path += len;
+  }
+  return n;
+}
+
+} // namespace SpaceTree
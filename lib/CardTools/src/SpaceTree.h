@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// Space used per folder ("du" console command, Space by folder screen),
+// from one raw walk of the directory tree. Only folders get a node (32
+// bytes in PSRAM, names in a separate pool), so 100k files in a few
+// thousand folders take well under 1 MB. Sizes are totals of the whole
+// subtree; the space taken by a folder's own files is its size minus its
+// children's. The same walk builds the NameIndex.
+namespace SpaceTree {
+
+  static constexpr uint32_t NONE     = UINT32_MAX;
+  static constexpr uint32_t ROOT     = 0;
+  static constexpr uint32_t MAX_DIRS = 262144;   // deeper folders count toward their parent
+
+  struct Node {
+    uint64_t bytes;         // file sizes in the subtree
+    uint32_t files;         // files in the subtree
+    uint32_t parent;        // NONE for the root
+    uint32_t firstChild;    // children in no particular order
+    uint32_t nextSibling;
+    uint32_t nameOff;       // into the name pool
+    uint32_t dirs;          // folders in the subtree, itself excluded
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+  // The tree of the last completed scan; false while none or rebuilding.
+  bool        ready();
+  // Changes with every start(): node numbers from another generation are
+  // stale even if ready() is true again.
+  uint32_t    generation();
+  uint32_t    count();
+  const Node& node(uint32_t i);
+  const char* name(uint32_t i);          // "" for the root
+  // Node of "/A/B" (exact names); NONE if not found.
+  uint32_t    find(const char* path);
+
+} // namespace SpaceTree
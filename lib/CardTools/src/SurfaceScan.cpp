@@ -0,0 +1,190 @@
+#include "SurfaceScan.h"
+#include "CardJob.h"
+#include <Console.h>
+#include <SdCard.h>
+#include <algorithm>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static constexpr uint32_t CHUNK_SECTORS   = 128;                       // 64 KB per command
+static constexpr uint32_t REGION_SECTORS  = 64u * 1024u * 1024u / SdCard::SECTOR_SIZE;
+static constexpr uint32_t WARMUP_CHUNKS   = 16;                        // before judging latency
+static constexpr uint32_t SLOW_FACTOR     = 3;                         // x running average ...
+static constexpr uint32_t SLOW_MIN_EXTRA  = 20000;                     // ... and at least +20 ms
+
+static SurfaceScan::Region*  s_regions       = nullptr;
+static float*                s_speeds        = nullptr;   // of scanned regions, partly ordered
+static uint32_t              s_speedCount    = 0;
+static volatile float        s_median        = 0.0f;
+static SurfaceScan::Flagged  s_flagged[SurfaceScan::MAX_FLAGGED];
+static volatile uint32_t     s_flaggedCount  = 0;
+static uint32_t              s_regionCount   = 0;
+static uint32_t              s_regionSectors = REGION_SECTORS;
+
+static void flag(uint32_t lba, uint32_t sectors, uint32_t us, bool error) {
+  if (s_flaggedCount < SurfaceScan::MAX_FLAGGED) {
+    s_flagged[s_flaggedCount] = { lba, sectors, us, error };
+    s_flaggedCount = s_flaggedCount + 1;
+  }
+}
+
+// One more region scanned: the median is kept here on the job, so readers
+// (UI updates, report) don't sort anything. nth_element leaves s_speeds the
+// same set, so each region costs one partial pass.
+static void addSpeed(float mbps) {
+  s_speeds[s_speedCount++] = mbps;
+  float* mid = s_speeds + s_speedCount / 2;
+  std::nth_element(s_speeds, mid, s_speeds + s_speedCount);
+  s_median = *mid;
+}
+
+// A multi-block read failed: find the bad sectors one by one.
+static uint32_t probeSectors(uint8_t* buf, uint32_t lba, uint32_t count) {
+  uint32_t bad = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!SdCard::read(buf, lba + i, 1)) {
+      bad++;
+      flag(lba + i, 1, 0, true);
+    }
+  }
+  return bad;
+}
+
+static bool scanJob(void*) {
+  const uint32_t total = SdCard::sectorCount();
+  uint32_t regionSectors = REGION_SECTORS;
+  while ((total + regionSectors - 1) / regionSectors > SurfaceScan::MAX_REGIONS) regionSectors *= 2;
+  memset(s_regions, 0, SurfaceScan::MAX_REGIONS * sizeof(SurfaceScan::Region));
+  s_flaggedCount  = 0;
+  s_speedCount    = 0;
+  s_median        = 0.0f;
+  s_regionSectors = regionSectors;
+  s_regionCount   = (total + regionSectors - 1) / regionSectors;
+
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(CHUNK_SECTORS * SdCard::SECTOR_SIZE);
+  if (!buf) {
+    CardJob::finish("out of memory");
+    return false;
+  }
+  CardJob::setTotal((uint64_t)total * SdCard::SECTOR_SIZE);
+
+  uint64_t avgUs       = 0;    // running transfer latency, 1/16 EWMA, ignores outliers
+  uint32_t chunks      = 0;
+  uint32_t slowTotal   = 0;
+  uint32_t badTotal    = 0;
+  const int64_t start  = esp_timer_get_time();
+
+  for (uint32_t r = 0; r < s_regionCount && !CardJob::cancelled(); ++r) {
+    const uint32_t first = r * s_regionSectors;
+    const uint32_t end   = min(total, first + s_regionSectors);
+    char item[32];
+    snprintf(item, sizeof(item), "%u / %u MB", (unsigned)(first / 2048), (unsigned)(total / 2048));
+    CardJob::setItem(item);
+
+    SurfaceScan::Region& reg = s_regions[r];
+    int64_t regionUs = 0;
+    for (uint32_t lba = first; lba < end && !CardJob::cancelled(); lba += CHUNK_SECTORS) {
+      const uint32_t n  = min(CHUNK_SECTORS, end - lba);
+      const int64_t  t0 = esp_timer_get_time();
+      const bool     ok = SdCard::read(buf, lba, n);
+      const uint32_t us = esp_timer_get_time() - t0;
+      regionUs += us;
+
+      if (!ok) {
+        const uint32_t bad = probeSectors(buf, lba, n);
+        reg.badSectors = min<uint32_t>(reg.badSectors + bad, UINT16_MAX);
+        badTotal += bad;
+      } else if (chunks >= WARMUP_CHUNKS && n == CHUNK_SECTORS &&
+                 us > max<uint64_t>(avgUs * SLOW_FACTOR, avgUs + SLOW_MIN_EXTRA)) {
+        reg.slowBlocks = min<uint32_t>(reg.slowBlocks + 1, UINT16_MAX);
+        slowTotal++;
+        flag(lba, n, us, false);
+      } else if (n == CHUNK_SECTORS) {
+        avgUs = chunks ? avgUs + ((int64_t)us - (int64_t)avgUs) / 16 : us;
+        chunks++;
+      }
+      CardJob::advance((uint64_t)n * SdCard::SECTOR_SIZE);
+      CardJob::countIo((uint64_t)n * SdCard::SECTOR_SIZE, 0);
+    }
+    if (regionUs > 0) {
+      reg.mbps = (end - first) * (float)SdCard::SECTOR_SIZE / 1048576.0f / (regionUs / 1e6f);
+      if (reg.mbps > 0) addSpeed(reg.mbps);
+    }
+    CardJob::advance(0, 1);
+  }
+
+  heap_caps_free(buf);
+  const float secs = (esp_timer_get_time() - start) / 1e6f;
+  CardJob::finish("%.2f MB/s median, %u slow transfers, %u bad sectors, %.0f s%s",
+                  SurfaceScan::medianMbps(), (unsigned)slowTotal, (unsigned)badTotal, secs,
+                  CardJob::cancelled() ? " (cancelled)" : "");
+  SurfaceScan::printReport(Serial);
+  return !CardJob::cancelled() && badTotal == 0;
+}
+
+// ---------------- Console ----------------
+static void cmdSurface(Print& out, const char* args) {
+  if (strcmp(args, "report") == 0) {
+    SurfaceScan::printReport(out);
+  } else if (*args == '\0') {
+    if (SurfaceScan::start()) {
+      out.println("surface: scan started, \"job\" for progress, \"surface report\" for results");
+    } else {
+      out.println("surface: card busy or missing (unmount USB first)");
+    }
+  } else {
+    out.println("usage: surface [report]");
+  }
+}
+
+namespace SurfaceScan {
+
+void begin() {
+  Console::add("surface", "read-only surface scan: [report]", cmdSurface);
+}
+
+bool start() {
+  if (!s_regions) {
+    s_regions = (Region*)heap_caps_calloc(MAX_REGIONS, sizeof(Region), MALLOC_CAP_SPIRAM);
+    if (!s_regions) return false;
+  }
+  if (!s_speeds) {
+    s_speeds = (float*)heap_caps_malloc(MAX_REGIONS * sizeof(float), MALLOC_CAP_SPIRAM);
+    if (!s_speeds) return false;
+  }
+  return CardJob::start("surface", CardJob::Access::Raw, scanJob, nullptr);
+}
+
+uint32_t       regionCount()   { return s_regionCount; }
+uint32_t       regionSectors() { return s_regionSectors; }
+const Region*  regions()       { return s_regions; }
+uint32_t       flaggedCount()  { return s_flaggedCount; }
+const Flagged* flagged()       { return s_flagged; }
+
+float medianMbps() { return s_median; }
+
+void printReport(Print& out) {
+  if (!s_regionCount) {
+    out.println("surface: no scan yet");
+    return;
+  }
+  const float median = medianMbps();
+  out.printf("Surface scan: %u regions of %u MB, median %.2f MB/s\n", (unsigned)s_regionCount,
+             (unsigned)(s_regionSectors / 2048), median);
+  out.println("region   offset MB    MB/s   vs median  slow  bad");
+  for (uint32_t i = 0; i < s_regionCount; ++i) {
+    const Region& r = s_regions[i];
+    if (r.mbps <= 0) continue;
+    // Only list what stands out; a healthy card prints nothing here.
+    if (r.mbps >= median * 0.85f && !r.slowBlocks && !r.badSectors) continue;
+    out.printf("%6u  %10u  %6.2f  %+8.0f%%  %4u  %3u\n", (unsigned)i, (unsigned)(i * (s_regionSectors / 2048)),
+               r.mbps, (r.mbps - median) * 100.0f / median, r.slowBlocks, r.badSectors);
+  }
+  for (uint32_t i = 0; i < s_flaggedCount; ++i) {
+    const Flagged& f = s_flagged[i];
+    if (f.error) out.printf("  read error at LBA %u\n", (unsigned)f.lba);
+    else out.printf("  slow: LBA %u +%u took %.1f ms\n", (unsigned)f.lba, (unsigned)f.sectors, f.us / 1000.0f);
+  }
+}
+
+} // namespace SurfaceScan
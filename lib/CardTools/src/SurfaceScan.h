@@ -0,0 +1,41 @@
+#pragma once
+#include <Arduino.h>
+
+// Read-only full-card surface scan ("surface" console command, Tools screen).
+// Reads every sector in 64 KB multi-block transfers, keeps the throughput of
+// each region (64 MB, or larger on big cards so there are at most
+// MAX_REGIONS) and flags transfers with abnormal latency or read errors.
+namespace SurfaceScan {
+
+  static constexpr uint32_t MAX_REGIONS = 1024;
+  static constexpr uint32_t MAX_FLAGGED = 64;
+
+  struct Region {
+    float    mbps;         // 0 = not scanned yet
+    uint16_t slowBlocks;   // transfers well above the running latency
+    uint16_t badSectors;   // sectors that failed to read
+  };
+
+  struct Flagged {
+    uint32_t lba;
+    uint32_t sectors;
+    uint32_t us;           // transfer latency (0 for read errors)
+    bool     error;
+  };
+
+  // Register the console command.
+  void begin();
+
+  bool start();
+
+  // Live results (valid during and after a scan, until the next start()).
+  uint32_t      regionCount();
+  uint32_t      regionSectors();
+  const Region* regions();
+  uint32_t      flaggedCount();
+  const Flagged* flagged();
+  float         medianMbps();   // over scanned regions, updated by the scan as it goes
+
+  void printReport(Print& out);
+
+} // namespace SurfaceScan
@@ -0,0 +1,492 @@
+#include "Thumbs.h"
+#include "CardJob.h"
+#include "FatVolume.h"
+#include "HashIndex.h"
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <ff.h>
+#include <rom/tjpgd.h>
+
+using Thumbs::SIDE;
+using Thumbs::SLOTS;
+using Thumbs::State;
+
+struct __attribute__((packed)) Header {
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  reserved;
+  uint16_t side;
+  uint32_t slots;
+};
+
+struct Key {
+  uint64_t key;
+  uint32_t seq;
+  uint32_t reserved;
+};
+
+static constexpr uint32_t MAGIC          = 0x544D4453;   // "SDMT"
+static constexpr uint8_t  VERSION        = 1;
+static constexpr uint32_t SECTOR         = SdCard::SECTOR_SIZE;
+static constexpr uint32_t THUMB_BYTES    = SIDE * SIDE * 2;
+static constexpr uint32_t THUMB_SECTORS  = (THUMB_BYTES + SECTOR - 1) / SECTOR;
+static constexpr uint32_t KEYS_PER_SEC   = SECTOR / sizeof(Key);
+static constexpr uint32_t KEY_SECTORS    = SLOTS / KEYS_PER_SEC;
+static constexpr uint32_t DATA_SECTOR    = 1 + KEY_SECTORS;
+static constexpr uint32_t FILE_SECTORS   = DATA_SECTOR + SLOTS * THUMB_SECTORS;
+static constexpr uint32_t HEAD_BYTES     = 64 * 1024;    // EXIF is in the first segment, at most 64 KB
+static constexpr uint32_t STREAM_SECTORS = HEAD_BYTES / SECTOR;
+static constexpr uint32_t MEM_SLOTS      = Thumbs::MAX_WINDOW;   // decoded thumbnails waiting for the UI
+static constexpr size_t   POOL_BYTES     = 4096;         // TJpgDec work area
+
+struct Mem {
+  uint64_t key;
+  uint32_t used;            // LRU tick
+  State    state;
+  uint8_t  readers;         // get() copying px out; not evicted meanwhile
+  uint16_t* px;
+};
+
+// Raw sequential reader of a file (or of a block already in memory)
+struct FileStream {
+  uint32_t       cluster;
+  uint32_t       sector;    // next sector in the cluster
+  bool           contiguous;
+  uint64_t       left;      // file bytes not read yet
+  const uint8_t* data;
+  uint32_t       len;
+  uint32_t       pos;
+};
+
+// Box filter from the decoded (scaled) image into the thumbnail
+struct Fit {
+  uint32_t  srcW, srcH;
+  uint32_t  dstW, dstH, offX, offY;
+  uint32_t* acc;            // SIDE x SIDE x RGB sums
+  uint16_t* count;
+};
+
+struct Decode {             // TJpgDec's device
+  FileStream s;
+  Fit        fit;
+};
+
+static portMUX_TYPE s_lock    = portMUX_INITIALIZER_UNLOCKED;
+static char         s_dir[FatVolume::MAX_PATH];
+static Mem          s_mem[MEM_SLOTS];
+static uint32_t     s_tick    = 0;
+static uint32_t     s_first   = 0;
+static uint32_t     s_count   = 0;
+
+// Job side
+static bool      s_cacheChecked = false;
+static bool      s_cacheCreated = false;      // by the last prepare()
+static bool      s_cacheOk      = false;
+static uint32_t* s_cacheLba     = nullptr;   // first sector of each cluster of the cache file
+static Key*      s_keys         = nullptr;   // KEY_SECTORS sectors, as on the card
+static uint32_t  s_seq          = 0;
+static uint8_t*  s_head         = nullptr;   // read buffer, HEAD_BYTES
+static uint32_t* s_acc          = nullptr;
+static uint16_t* s_accCount     = nullptr;
+static void*     s_pool         = nullptr;
+
+static uint64_t thumbKey(const DirPager::Item& it) {
+  char path[FatVolume::MAX_PATH];
+  snprintf(path, sizeof(path), "%s/%s", strcmp(s_dir, "/") ? s_dir : "", it.name);
+  uint64_t h = HashIndex::pathKey(path);
+  h = (h ^ it.size) * 0x100000001B3ull;
+  h = (h ^ it.mtime) * 0x100000001B3ull;
+  return h ? h : 1;   // 0 marks a free cache slot
+}
+
+static Mem* findMem(uint64_t key) {
+  for (Mem& m : s_mem) {
+    if (m.key == key) return &m;
+  }
+  return nullptr;
+}
+
+// ---------------- Cache file (raw, in place) ----------------
+static bool cacheIo(uint32_t sector, void* buf, uint32_t count, bool write) {
+  const uint32_t spc = FatVolume::info().spc;
+  uint8_t* p = (uint8_t*)buf;
+  while (count) {
+    const uint32_t off = sector % spc;
+    const uint32_t n   = min(count, spc - off);
+    const uint32_t lba = s_cacheLba[sector / spc] + off;
+    if (!(write ? SdCard::write(p, lba, n) : SdCard::read(p, lba, n))) return false;
+    CardJob::countIo(write ? 0 : n * SECTOR, write ? n * SECTOR : 0);
+    sector += n;
+    count  -= n;
+    p      += n * SECTOR;
+  }
+  return true;
+}
+
+// Find the cache file in the root, map its clusters and load the key table.
+static bool openCache() {
+  FatVolume::DirPos pos = FatVolume::rootDir();
+  FatVolume::Entry e;
+  bool found = false;
+  while (!found && FatVolume::readDir(pos, e)) {
+    found = !e.dir && strcmp(e.name, Thumbs::CACHE_NAME) == 0;
+  }
+  if (!found || e.size != (uint64_t)FILE_SECTORS * SECTOR) return false;
+
+  const FatVolume::Info& vi = FatVolume::info();
+  const uint32_t clusters = (FILE_SECTORS + vi.spc - 1) / vi.spc;
+  heap_caps_free(s_cacheLba);
+  s_cacheLba = (uint32_t*)heap_caps_malloc(clusters * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+  if (!s_cacheLba) return false;
+  uint32_t c = e.firstCluster;
+  for (uint32_t i = 0; i < clusters; ++i) {
+    if (!FatVolume::isCluster(c)) return false;
+    s_cacheLba[i] = FatVolume::clusterLba(c);
+    c = e.contiguous ? c + 1 : FatVolume::next(c);
+  }
+
+  Header h;
+  if (!cacheIo(0, s_head, 1, false)) return false;
+  memcpy(&h, s_head, sizeof(h));
+  if (h.magic != MAGIC || h.version != VERSION || h.side != SIDE || h.slots != SLOTS) return false;
+  if (!cacheIo(1, s_keys, KEY_SECTORS, false)) return false;
+  s_seq = 0;
+  for (uint32_t i = 0; i < SLOTS; ++i) s_seq = max(s_seq, s_keys[i].seq);
+  return true;
+}
+
+static bool cacheRead(uint64_t key, uint16_t* px) {
+  for (uint32_t i = 0; i < SLOTS; ++i) {
+    if (s_keys[i].key == key) return cacheIo(DATA_SECTOR + i * THUMB_SECTORS, px, THUMB_SECTORS, false);
+  }
+  return false;
+}
+
+static void cacheWrite(uint64_t key, const uint16_t* px) {
+  uint32_t slot = 0;
+  for (uint32_t i = 0; i < SLOTS && s_keys[slot].key; ++i) {
+    if (!s_keys[i].key || s_keys[i].seq < s_keys[slot].seq) slot = i;
+  }
+  // Free the slot before overwriting it, so a cut write never shows up under the old key
+  Key* sec = s_keys + slot / KEYS_PER_SEC * KEYS_PER_SEC;
+  const uint32_t keySector = 1 + slot / KEYS_PER_SEC;
+  s_keys[slot] = {};
+  s_cacheOk = cacheIo(keySector, sec, 1, true) &&
+              cacheIo(DATA_SECTOR + slot * THUMB_SECTORS, (void*)px, THUMB_SECTORS, true);
+  if (!s_cacheOk) return;
+  s_keys[slot] = { key, ++s_seq, 0 };
+  s_cacheOk = cacheIo(keySector, sec, 1, true);
+}
+
+// ---------------- Decoding ----------------
+// Next block of the file into dst, merging clusters that follow each other
+// on the card; bytes read (0 at the end or on error).
+static uint32_t readBlock(FileStream& s, uint8_t* dst, uint32_t maxSectors) {
+  if (!s.left || !FatVolume::isCluster(s.cluster)) return 0;
+  const uint32_t spc  = FatVolume::info().spc;
+  const uint32_t want = (uint32_t)min<uint64_t>((s.left + SECTOR - 1) / SECTOR, maxSectors);
+  const uint32_t lba  = FatVolume::clusterLba(s.cluster) + s.sector;
+  uint32_t n = 0;
+  while (n < want) {
+    const uint32_t take = min(want - n, spc - s.sector);
+    n        += take;
+    s.sector += take;
+    if (s.sector < spc) break;
+    const uint32_t next = s.contiguous ? s.cluster + 1 : FatVolume::next(s.cluster);
+    const bool adjacent = next == s.cluster + 1;
+    s.cluster = next;
+    s.sector  = 0;
+    if (!adjacent || !FatVolume::isCluster(next)) break;
+  }
+  if (!SdCard::read(dst, lba, n)) return 0;
+  CardJob::countIo(n * SECTOR, 0);
+  const uint32_t len = (uint32_t)min<uint64_t>(n * SECTOR, s.left);
+  s.left -= len;
+  return len;
+}
+
+static bool fill(FileStream& s) {
+  s.len  = readBlock(s, s_head, STREAM_SECTORS);
+  s.data = s_head;
+  s.pos  = 0;
+  return s.len > 0;
+}
+
+static UINT jpegInput(JDEC* jd, BYTE* buf, UINT n) {
+  FileStream& s = ((Decode*)jd->device)->s;
+  UINT done = 0;
+  while (done < n) {
+    if (s.pos == s.len && !fill(s)) break;
+    const UINT k = min<UINT>(n - done, s.len - s.pos);
+    if (buf) memcpy(buf + done, s.data + s.pos, k);
+    s.pos += k;
+    done  += k;
+  }
+  return done;
+}
+
+static UINT jpegOutput(JDEC* jd, void* bitmap, JRECT* rect) {
+  const Fit& f = ((Decode*)jd->device)->fit;
+  const uint8_t* rgb = (const uint8_t*)bitmap;
+  for (uint32_t y = rect->top; y <= rect->bottom; ++y) {
+    const uint32_t ty = f.offY + y * f.dstH / f.srcH;
+    for (uint32_t x = rect->left; x <= rect->right; ++x, rgb += 3) {
+      if (y >= f.srcH || x >= f.srcW) continue;
+      const uint32_t t = ty * SIDE + f.offX + x * f.dstW / f.srcW;
+      f.acc[t * 3]     += rgb[0];
+      f.acc[t * 3 + 1] += rgb[1];
+      f.acc[t * 3 + 2] += rgb[2];
+      f.count[t]++;
+    }
+  }
+  return !CardJob::cancelled();
+}
+
+// Decode the JPEG in s into px, scaled to fit SIDE x SIDE (never enlarged).
+static bool decodeJpeg(const FileStream& s, uint16_t* px) {
+  Decode dec;
+  dec.s = s;
+  JDEC jd;
+  if (jd_prepare(&jd, jpegInput, s_pool, POOL_BYTES, &dec) != JDR_OK) return false;
+
+  // Largest DCT scaling (1/2^n) that still leaves more pixels than the thumbnail
+  uint8_t scale = 0;
+  while (scale < 3 && max(jd.width, jd.height) >> (scale + 1) >= SIDE) scale++;
+  Fit& fit = dec.fit;
+  fit.srcW  = (jd.width + (1u << scale) - 1) >> scale;
+  fit.srcH  = (jd.height + (1u << scale) - 1) >> scale;
+  const uint32_t big = max(fit.srcW, fit.srcH);
+  fit.dstW  = big > SIDE ? max<uint32_t>(1, fit.srcW * SIDE / big) : fit.srcW;
+  fit.dstH  = big > SIDE ? max<uint32_t>(1, fit.srcH * SIDE / big) : fit.srcH;
+  fit.offX  = (SIDE - fit.dstW) / 2;
+  fit.offY  = (SIDE - fit.dstH) / 2;
+  fit.acc   = s_acc;
+  fit.count = s_accCount;
+  memset(s_acc, 0, SIDE * SIDE * 3 * sizeof(uint32_t));
+  memset(s_accCount, 0, SIDE * SIDE * sizeof(uint16_t));
+  if (jd_decomp(&jd, jpegOutput, scale) != JDR_OK) return false;
+
+  for (uint32_t i = 0; i < SIDE * SIDE; ++i) {
+    const uint32_t n = s_accCount[i];
+    if (!n) {
+      px[i] = 0;
+      continue;
+    }
+    const uint32_t r = s_acc[i * 3] / n, g = s_acc[i * 3 + 1] / n, b = s_acc[i * 3 + 2] / n;
+    px[i] = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+  }
+  return true;
+}
+
+static inline uint16_t exif16(const uint8_t* p, bool le) { return le ? p[0] | p[1] << 8 : p[0] << 8 | p[1]; }
+static inline uint32_t exif32(const uint8_t* p, bool le) {
+  return le ? exif16(p, le) | (uint32_t)exif16(p + 2, le) << 16 : (uint32_t)exif16(p, le) << 16 | exif16(p + 2, le);
+}
+
+// EXIF thumbnail (IFD1 JPEGInterchangeFormat) inside the first len bytes of
+// a JPEG; false if there is none or it isn't all there.
+static bool findExifThumb(const uint8_t* d, uint32_t len, uint32_t* off, uint32_t* size) {
+  if (len < 4 || d[0] != 0xFF || d[1] != 0xD8) return false;
+  uint32_t p = 2;
+  while (p + 4 <= len && d[p] == 0xFF && d[p + 1] != 0xDA) {
+    const uint32_t segLen = d[p + 2] << 8 | d[p + 3];
+    const uint32_t body = p + 4;
+    if (d[p + 1] == 0xE1 && segLen >= 16 && body + segLen - 2 <= len && memcmp(d + body, "Exif\0\0", 6) == 0) {
+      const uint8_t* t = d + body + 6;
+      const uint32_t tiffLen = segLen - 8;
+      if (t[0] != t[1] || (t[0] != 'I' && t[0] != 'M')) return false;
+      const bool le = t[0] == 'I';
+      uint32_t ifd = exif32(t + 4, le);
+      // Offsets come from the file: compare by subtraction so they can't wrap
+      if (ifd > tiffLen - 2) return false;
+      ifd = ifd + 2 + exif16(t + ifd, le) * 12;             // skip IFD0
+      if (ifd > tiffLen - 4 || !(ifd = exif32(t + ifd, le)) || ifd > tiffLen - 2) return false;
+      uint32_t start = 0, bytes = 0;
+      const uint16_t entries = exif16(t + ifd, le);
+      for (uint16_t i = 0; i < entries && ifd + 2 + (i + 1) * 12 <= tiffLen; ++i) {
+        const uint8_t* en = t + ifd + 2 + i * 12;
+        if (exif16(en, le) == 0x0201) start = exif32(en + 8, le);
+        if (exif16(en, le) == 0x0202) bytes = exif32(en + 8, le);
+      }
+      if (!start || !bytes || start > tiffLen || bytes > tiffLen - start) return false;
+      *off  = (t - d) + start;
+      *size = bytes;
+      return true;
+    }
+    p = body + segLen - 2;
+  }
+  return false;
+}
+
+static bool makeThumb(const DirPager::Item& it, uint16_t* px) {
+  // The first HEAD_BYTES, where an EXIF thumbnail would be
+  FileStream s = { it.firstCluster, 0, it.contiguous, it.size, s_head, 0, 0 };
+  uint32_t n;
+  while (s.len < HEAD_BYTES && (n = readBlock(s, s_head + s.len, (HEAD_BYTES - s.len) / SECTOR))) s.len += n;
+  uint32_t off, size;
+  if (findExifThumb(s.data, s.len, &off, &size)) {
+    const FileStream exif = { 0, 0, false, 0, s.data + off, size, 0 };
+    if (decodeJpeg(exif, px)) return true;
+  }
+  // No usable EXIF thumbnail: decode the image itself, from the start again
+  return s.len && decodeJpeg(s, px);
+}
+
+// DirPager worker: one thumbnail of the window per call.
+static bool work() {
+  if (!s_cacheChecked) {
+    s_cacheChecked = true;
+    s_cacheOk = openCache();
+  }
+  portENTER_CRITICAL(&s_lock);
+  const uint32_t first = s_first, count = s_count;
+  portEXIT_CRITICAL(&s_lock);
+
+  for (uint32_t i = first; i < first + count && !CardJob::cancelled(); ++i) {
+    DirPager::Item item;
+    if (!DirPager::get(i, item)) continue;   // its page comes first
+    const uint64_t key = thumbKey(item);
+    portENTER_CRITICAL(&s_lock);
+    Mem* m = findMem(key);
+    if (!m) {
+      m = nullptr;
+      for (Mem& o : s_mem) {
+        if (!o.readers && (!m || o.used < m->used)) m = &o;
+      }
+      m->key   = key;
+      m->state = State::Pending;
+    }
+    m->used = ++s_tick;   // keeps the window's slots over older ones
+    portEXIT_CRITICAL(&s_lock);
+    if (m->state != State::Pending) continue;
+
+    CardJob::setItem(item.name);
+    const bool cached = s_cacheOk && cacheRead(key, m->px);
+    const bool ok = cached || makeThumb(item, m->px);
+    if (ok && !cached && s_cacheOk) cacheWrite(key, m->px);
+    CardJob::advance(0, 1);
+    portENTER_CRITICAL(&s_lock);
+    if (m->key == key) m->state = ok ? State::Ready : State::Failed;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+  }
+  return false;
+}
+
+// ---------------- Cache file creation (file system) ----------------
+// Hidden, so hosts don't show 16 MB of unknown file in the card root (the
+// dot only hides it on Unix). Also fixes files made before it was set.
+static void hideCache() {
+  char path[32];
+  snprintf(path, sizeof(path), "%s/%s", SdCard::FS_DRIVE, Thumbs::CACHE_NAME);
+  f_chmod(path, AM_HID, AM_HID);
+}
+
+static bool prepareJob(void*) {
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s", SdCard::FS_ROOT, Thumbs::CACHE_NAME);
+  s_cacheCreated = false;
+  FILE* f = fopen(path, "rb");
+  if (f) {
+    Header h = {};
+    const bool valid = fread(&h, sizeof(h), 1, f) == 1 && h.magic == MAGIC && h.version == VERSION &&
+                       h.side == SIDE && h.slots == SLOTS && fseek(f, 0, SEEK_END) == 0 &&
+                       ftell(f) == (long)(FILE_SECTORS * SECTOR);
+    fclose(f);
+    if (valid) {
+      hideCache();
+      CardJob::finish("thumbnail cache ready");
+      return true;
+    }
+  }
+
+  // Header and an empty key table; the thumbnail area is just allocated
+  static uint8_t sector[SECTOR];
+  memset(sector, 0, sizeof(sector));
+  const Header h = { MAGIC, VERSION, 0, SIDE, SLOTS };
+  memcpy(sector, &h, sizeof(h));
+  f = fopen(path, "wb");
+  bool ok = f && fwrite(sector, SECTOR, 1, f) == 1;
+  memset(sector, 0, sizeof(sector));
+  for (uint32_t i = 0; i < KEY_SECTORS && ok; ++i) ok = fwrite(sector, SECTOR, 1, f) == 1;
+  ok = ok && fseek(f, FILE_SECTORS * SECTOR - 1, SEEK_SET) == 0 && fputc(0, f) != EOF;
+  if (f && fclose(f) != 0) ok = false;
+  if (!ok) {
+    remove(path);
+    CardJob::finish("could not create the thumbnail cache (card full or read-only?)");
+    return false;
+  }
+  hideCache();
+  s_cacheCreated = true;
+  CardJob::finish("thumbnail cache created: /%s, %u KB", Thumbs::CACHE_NAME, (unsigned)(FILE_SECTORS * SECTOR / 1024));
+  return true;
+}
+
+namespace Thumbs {
+
+bool prepare() {
+  if (CardJob::busy()) return false;
+  return CardJob::start("thumbnail cache", CardJob::Access::Files, prepareJob, nullptr);
+}
+
+bool start(const char* path) {
+  if (CardJob::busy()) return false;
+  if (!s_head) {
+    s_head     = (uint8_t*)heap_caps_malloc(HEAD_BYTES, MALLOC_CAP_SPIRAM);
+    s_keys     = (Key*)heap_caps_malloc(KEY_SECTORS * SECTOR, MALLOC_CAP_SPIRAM);
+    s_acc      = (uint32_t*)heap_caps_malloc(SIDE * SIDE * 3 * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    s_accCount = (uint16_t*)heap_caps_malloc(SIDE * SIDE * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    s_pool     = heap_caps_malloc(POOL_BYTES, MALLOC_CAP_INTERNAL);
+    for (Mem& m : s_mem) m.px = (uint16_t*)heap_caps_malloc(THUMB_SECTORS * SECTOR, MALLOC_CAP_SPIRAM);
+  }
+  if (!s_head || !s_keys || !s_acc || !s_accCount || !s_pool) return false;
+  for (Mem& m : s_mem) {
+    if (!m.px) return false;
+    m = { 0, 0, State::Pending, 0, m.px };
+  }
+  strlcpy(s_dir, path, sizeof(s_dir));
+  s_first = s_count = 0;
+  s_cacheChecked = false;
+  return DirPager::start(path, isJpeg, work);
+}
+
+uint32_t cacheBytes() { return FILE_SECTORS * SECTOR; }
+bool     cacheCreated() { return s_cacheCreated; }
+
+bool isJpeg(const char* name, bool dir) {
+  const char* dot = strrchr(name, '.');
+  return !dir && dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+void setWindow(uint32_t first, uint32_t count) {
+  count = min(count, MAX_WINDOW);
+  portENTER_CRITICAL(&s_lock);
+  const bool moved = first != s_first || count != s_count;
+  s_first = first;
+  s_count = count;
+  portEXIT_CRITICAL(&s_lock);
+  if (moved) DirPager::wake();
+}
+
+State get(const DirPager::Item& item, uint16_t* dst) {
+  const uint64_t key = thumbKey(item);
+  State st = State::Pending;
+  portENTER_CRITICAL(&s_lock);
+  Mem* m = findMem(key);
+  if (m) {
+    st = m->state;
+    m->used = ++s_tick;
+    if (st == State::Ready) m->readers++;
+  }
+  portEXIT_CRITICAL(&s_lock);
+  if (st == State::Ready) {
+    // Pinned, so the job can't reuse it; the copy runs with interrupts on
+    memcpy(dst, m->px, THUMB_BYTES);
+    portENTER_CRITICAL(&s_lock);
+    m->readers--;
+    portEXIT_CRITICAL(&s_lock);
+  }
+  return st;
+}
+
+} // namespace Thumbs
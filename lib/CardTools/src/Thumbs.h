@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+#include "DirPager.h"
+
+// JPEG thumbnails for the photo grid, made on the DirPager job task while
+// it lists a folder's JPEGs. The EXIF thumbnail is used when the file has
+// one (a few KB at the start of the file); otherwise the whole image is
+// decoded at 1/8 scale (TJpgDec in ROM scales in the IDCT, so most of the
+// work is skipped) and box-filtered down. Files are read raw by cluster.
+//
+// Thumbnails persist in CACHE_NAME at the card root, keyed by path, size
+// and mtime: a fixed-size hidden file (cacheBytes(), about 16 MB) created
+// once through the file system (prepare()), then read and written in place
+// through raw sectors.
+//   sector 0      header: magic "SDMT", version, side, slots
+//   sectors 1..   key table: SLOTS x { u64 key, u32 seq, u32 0 }, key 0 = free
+//   then          SLOTS thumbnails of SIDE x SIDE RGB565, sector-aligned
+// When full, the oldest thumbnail (lowest seq) is replaced.
+namespace Thumbs {
+
+  static constexpr uint32_t    SIDE       = 88;              // px, square
+  static constexpr uint32_t    SLOTS      = 1024;            // thumbnails in the cache file
+  static constexpr uint32_t    MAX_WINDOW = 32;              // entries on screen at most
+  static constexpr const char* CACHE_NAME = ".thumbcache";
+
+  enum class State : uint8_t { Pending, Ready, Failed };
+
+  // Create or check the cache file as a short file-system CardJob. If it
+  // fails, thumbnails are still made, just not kept.
+  bool prepare();
+  uint32_t cacheBytes();
+  bool     cacheCreated();    // by the last prepare(), for telling the user
+  // List the JPEGs of `path` (DirPager) and decode thumbnails on its job.
+  bool start(const char* path);
+
+  bool isJpeg(const char* name, bool dir);
+
+  // Entries on screen (up to MAX_WINDOW), decoded first to last.
+  void setWindow(uint32_t first, uint32_t count);
+  // SIDE x SIDE RGB565 pixels of a listed entry, copied to dst once decoded.
+  State get(const DirPager::Item& item, uint16_t* dst);
+
+} // namespace Thumbs
@@ -0,0 +1,65 @@
+#include "Console.h"
+
+static constexpr size_t MAX_COMMANDS     = 32;
+static constexpr size_t CONSOLE_LINE_MAX = 96;
+
+struct Command {
+  const char*      name;
+  const char*      help;
+  Console::Handler fn;
+};
+
+static Command s_cmds[MAX_COMMANDS];
+static size_t  s_cmdCount = 0;
+static char    s_line[CONSOLE_LINE_MAX];
+static size_t  s_lineLen  = 0;
+
+static void printHelp(Print& out) {
+  out.println("Commands:");
+  for (size_t i = 0; i < s_cmdCount; ++i) {
+    out.printf("  %-10s %s\n", s_cmds[i].name, s_cmds[i].help);
+  }
+}
+
+static void dispatch(Print& out, char* line) {
+  while (*line == ' ') ++line;
+  if (!*line) return;
+
+  char* args = line;
+  while (*args && *args != ' ') ++args;
+  if (*args) *args++ = '\0';
+  while (*args == ' ') ++args;
+
+  if (strcmp(line, "help") == 0) { printHelp(out); return; }
+  for (size_t i = 0; i < s_cmdCount; ++i) {
+    if (strcmp(line, s_cmds[i].name) == 0) {
+      s_cmds[i].fn(out, args);
+      return;
+    }
+  }
+  out.printf("Unknown command '%s' (try 'help')\n", line);
+}
+
+namespace Console {
+
+bool add(const char* name, const char* help, Handler fn) {
+  if (s_cmdCount >= MAX_COMMANDS || !name || !fn) return false;
+  s_cmds[s_cmdCount++] = { name, help ? help : "", fn };
+  return true;
+}
+
+void poll(Stream& io) {
+  while (io.available() > 0) {
+    const int c = io.read();
+    if (c < 0) break;
+    if (c == '\r' || c == '\n') {
+      s_line[s_lineLen] = '\0';
+      s_lineLen = 0;
+      dispatch(io, s_line);
+    } else if (s_lineLen + 1 < CONSOLE_LINE_MAX) {
+      s_line[s_lineLen++] = (char)c;
+    }
+  }
+}
+
+} // namespace Console
@@ -0,0 +1,18 @@
+#pragma once
+#include <Arduino.h>
+
+// Tiny line-based command console on the serial port.
+// Diagnostics modules register their commands at begin(); loop() pumps poll().
+namespace Console {
+
+  // Handler receives the output stream and the rest of the line after the
+  // command name (leading spaces stripped, never null).
+  using Handler = void (*)(Print& out, const char* args);
+
+  // Register a command. Returns false if the table is full.
+  bool add(const char* name, const char* help, Handler fn);
+
+  // Read pending characters and dispatch complete lines. Non-blocking.
+  void poll(Stream& io);
+
+} // namespace Console
@@ -0,0 +1,227 @@
+#include "Energy.h"
+#include "Console.h"
+#include <Wire.h>
+#include <esp_timer.h>
+#include <kodedot/pin_config.h>
+
+// BQ27220 standard commands (little-endian 16-bit registers).
+static constexpr uint8_t REG_VOLTAGE = 0x08;  // mV
+static constexpr uint8_t REG_CURRENT = 0x0C;  // mA, signed, negative = discharging
+
+static constexpr uint32_t SAMPLE_MS   = 250;
+static constexpr size_t   MAX_BUCKETS = 8;
+
+struct Bucket {
+  const char* name;
+  uint32_t    runs;
+  uint8_t     active;          // overlapping runs in progress
+  int64_t     sinceUs;         // start of the current run (valid while active)
+  uint64_t    pendingUs;       // closed run time not yet attributed to a sample
+  double      joules;
+  double      seconds;         // time with a measurable (battery) power reading
+  double      unmeasuredS;     // time on external power: battery current says nothing
+  uint64_t    bytesRead;
+  uint64_t    bytesWritten;
+};
+
+static bool         s_present      = false;
+static Bucket       s_acts[MAX_BUCKETS];
+static Bucket       s_states[MAX_BUCKETS];
+static Bucket*      s_state        = nullptr;
+static int64_t      s_lastUs       = 0;
+static float        s_lastWatts    = 0.0f;
+static bool         s_lastMeasured = false;
+static portMUX_TYPE s_lock         = portMUX_INITIALIZER_UNLOCKED;
+
+static bool readReg16(uint8_t reg, uint16_t& v) {
+  Wire.beginTransmission(BQ27220_I2C_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) return false;
+  if (Wire.requestFrom((uint8_t)BQ27220_I2C_ADDRESS, (uint8_t)2) != 2) return false;
+  const uint8_t lo = Wire.read();
+  const uint8_t hi = Wire.read();
+  v = (uint16_t)(lo | (hi << 8));
+  return true;
+}
+
+static Bucket* findBucket(Bucket (&table)[MAX_BUCKETS], const char* name) {
+  for (auto& b : table) {
+    if (b.name == name || (b.name && strcmp(b.name, name) == 0)) return &b;
+  }
+  for (auto& b : table) {
+    if (!b.name) { b.name = name; return &b; }
+  }
+  return nullptr;
+}
+
+// Time a bucket was active within (lastUs, now], consuming pending time.
+static uint64_t takeOverlap(Bucket& b, int64_t now) {
+  uint64_t us = b.pendingUs;
+  b.pendingUs = 0;
+  if (b.active) us += now - max(b.sinceUs, s_lastUs);
+  return us;
+}
+
+static void closeRun(Bucket& b, int64_t now) {
+  b.pendingUs += now - max(b.sinceUs, s_lastUs);
+}
+
+static void attribute(Bucket& b, uint64_t us, float watts, bool measured) {
+  const double s = us / 1e6;
+  if (measured) {
+    b.joules  += watts * s;
+    b.seconds += s;
+  } else {
+    b.unmeasuredS += s;
+  }
+}
+
+static void samplerTask(void*) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(SAMPLE_MS));
+
+    float volts, amps;
+    const bool ok       = Energy::read(volts, amps);
+    const bool measured = ok && amps < 0.0f;     // only battery discharge is the board's draw
+    const float watts   = measured ? volts * -amps : 0.0f;
+    // Trapezoid between this and the previous reading when both are usable.
+    const float avgW    = (measured && s_lastMeasured) ? 0.5f * (watts + s_lastWatts) : watts;
+
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    // Screen states only get the part of the interval no activity covered
+    // (activity overlap approximated by the longest one).
+    uint64_t busyUs = 0;
+    for (auto& b : s_acts) {
+      if (!b.name) continue;
+      const uint64_t us = takeOverlap(b, now);
+      attribute(b, us, avgW, measured);
+      busyUs = max(busyUs, us);
+    }
+    for (auto& b : s_states) {
+      if (!b.name) continue;
+      const uint64_t us = takeOverlap(b, now);
+      if (us > busyUs) attribute(b, us - busyUs, avgW, measured);
+    }
+    s_lastUs = now;
+    portEXIT_CRITICAL(&s_lock);
+
+    s_lastWatts    = watts;
+    s_lastMeasured = measured;
+  }
+}
+
+// ---------------- Console ----------------
+static void cmdEnergy(Print& out, const char*) {
+  Energy::printReport(out);
+}
+
+namespace Energy {
+
+bool begin() {
+  Wire.begin(TOUCH_I2C_SDA, TOUCH_I2C_SCL);  // shared bus; no-op if touch already started it
+  uint16_t mv;
+  s_present = readReg16(REG_VOLTAGE, mv) && mv > 0;
+  if (!s_present) {
+    Serial.println("Energy: BQ27220 not responding, energy accounting disabled");
+    return false;
+  }
+  s_lastUs = esp_timer_get_time();
+  Console::add("energy", "battery energy per state / J per GB", cmdEnergy);
+  return xTaskCreatePinnedToCore(samplerTask, "energy", 3072, nullptr, 2, nullptr, 0) == pdPASS;
+}
+
+bool read(float& volts, float& amps) {
+  if (!s_present) return false;
+  uint16_t mv, ma;
+  if (!readReg16(REG_VOLTAGE, mv) || !readReg16(REG_CURRENT, ma)) return false;
+  volts = mv / 1000.0f;
+  amps  = (int16_t)ma / 1000.0f;
+  return true;
+}
+
+void setScreenState(const char* state) {
+  if (!s_present) return;
+  const int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&s_lock);
+  Bucket* next = findBucket(s_states, state);
+  if (next != s_state) {
+    if (s_state) {
+      closeRun(*s_state, now);
+      s_state->active = 0;
+    }
+    if (next) {
+      next->active  = 1;
+      next->sinceUs = now;
+      next->runs++;
+    }
+    s_state = next;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void beginActivity(const char* name) {
+  if (!s_present) return;
+  const int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&s_lock);
+  if (Bucket* b = findBucket(s_acts, name)) {
+    if (b->active++ == 0) b->sinceUs = now;
+    b->runs++;
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void endActivity(const char* name, uint64_t bytesRead, uint64_t bytesWritten) {
+  if (!s_present) return;
+  const int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&s_lock);
+  Bucket* b = findBucket(s_acts, name);
+  if (b && b->active) {
+    b->bytesRead    += bytesRead;
+    b->bytesWritten += bytesWritten;
+    if (--b->active == 0) closeRun(*b, now);
+  }
+  portEXIT_CRITICAL(&s_lock);
+}
+
+void printReport(Print& out) {
+  if (!s_present) {
+    out.println("energy: no fuel gauge");
+    return;
+  }
+  float v = 0, a = 0;
+  read(v, a);
+  out.printf("Battery %.3f V, %+.3f A (%s)\n", v, a, a < 0 ? "discharging" : "external power");
+
+  Bucket states[MAX_BUCKETS], acts[MAX_BUCKETS];
+  portENTER_CRITICAL(&s_lock);
+  memcpy(states, s_states, sizeof(states));
+  memcpy(acts, s_acts, sizeof(acts));
+  portEXIT_CRITICAL(&s_lock);
+
+  double idleJ = 0, idleS = 0;
+  out.println("screen state        time s   avg W   (on ext. power s)");
+  for (const auto& b : states) {
+    if (!b.name) continue;
+    idleJ += b.joules;
+    idleS += b.seconds;
+    out.printf("%-18s %8.0f  %6.3f   (%.0f)\n", b.name, b.seconds,
+               b.seconds > 0 ? b.joules / b.seconds : 0.0, b.unmeasuredS);
+  }
+  const double idleW = idleS > 0 ? idleJ / idleS : 0.0;
+
+  // Net = energy above the average idle draw over the same time.
+  out.println("activity   runs   time s   energy J   GB read  GB written    J/GB  net J/GB");
+  for (const auto& b : acts) {
+    if (!b.name) continue;
+    const double gb   = (b.bytesRead + b.bytesWritten) / 1e9;
+    const double net  = b.joules - idleW * b.seconds;
+    out.printf("%-9s %5u %8.1f %10.1f %9.3f %11.3f", b.name, (unsigned)b.runs, b.seconds, b.joules,
+               b.bytesRead / 1e9, b.bytesWritten / 1e9);
+    if (gb > 0) out.printf(" %7.1f %9.1f", b.joules / gb, net / gb);
+    if (b.unmeasuredS > 0) out.printf("  (%.0f s on ext. power)", b.unmeasuredS);
+    out.println();
+  }
+}
+
+} // namespace Energy
@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+
+// Energy accounting from the BQ27220 fuel gauge ("energy").
+// A sampler task integrates battery power; the energy is attributed to the
+// current screen state (idle power) and to any running activities (MSC
+// session, scan, benchmark), which report joules per GB moved.
+// The gauge refreshes current about once a second, so figures are only
+// meaningful for activities lasting several seconds or repeated many times.
+namespace Energy {
+
+  // Probe the gauge, start the sampler and register the console command.
+  // Returns false (and stays inert) when no gauge answers.
+  bool begin();
+
+  // Screen/UI state used for idle-power accounting. Pass a string literal.
+  void setScreenState(const char* state);
+
+  // Bracket an I/O activity. Names are string literals; runs with the same
+  // name are aggregated. Activities may overlap and run on any task.
+  void beginActivity(const char* name);
+  void endActivity(const char* name, uint64_t bytesRead, uint64_t bytesWritten);
+
+  // Instantaneous battery reading (false if no gauge).
+  bool read(float& volts, float& amps);
+
+  void printReport(Print& out);
+
+} // namespace Energy
@@ -0,0 +1,231 @@
+#include "HeapMonitor.h"
+#include "Console.h"
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+#ifndef HEAPMON_SITES
+#define HEAPMON_SITES 0
+#endif
+
+#if HEAPMON_SITES
+#include <esp_debug_helpers.h>
+#endif
+
+static constexpr uint32_t POLL_INTERVAL_MS = 1000;
+#if HEAPMON_SITES
+static constexpr uint32_t LOG_INTERVAL_MS  = 30000;  // periodic report in debug builds
+#endif
+
+static const uint32_t REGION_CAPS[HeapMon::REGION_COUNT] = {
+  MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+  MALLOC_CAP_DMA,
+  MALLOC_CAP_SPIRAM,
+};
+
+static const char* const REGION_NAMES[HeapMon::REGION_COUNT] = {
+  "internal", "dma", "psram",
+};
+
+static size_t   s_minLargest[HeapMon::REGION_COUNT];
+static uint32_t s_lastPollMs = 0;
+static uint32_t s_lastLogMs  = 0;
+
+// ---------------- Allocation-site attribution (debug builds) ----------------
+#if HEAPMON_SITES
+
+static constexpr size_t SITE_DEPTH = 3;    // caller frames kept per site
+static constexpr size_t MAX_SITES  = 128;  // open-addressed table, power of two
+
+struct Site {
+  uint32_t pc[SITE_DEPTH];
+  uint32_t count;
+  uint32_t bytes;
+};
+
+static Site         s_sites[MAX_SITES];
+static uint32_t     s_sitesDropped = 0;
+static portMUX_TYPE s_siteLock     = portMUX_INITIALIZER_UNLOCKED;
+
+// Captures the frames above the __wrap_* function that called us.
+static void __attribute__((noinline)) captureSite(uint32_t (&pcs)[SITE_DEPTH]) {
+  memset(pcs, 0, sizeof(pcs));
+  esp_backtrace_frame_t f = {};
+  esp_backtrace_get_start(&f.pc, &f.sp, &f.next_pc);
+
+  // Frame 0 is captureSite(), frame 1 the __wrap_* shim.
+  size_t frame = 0, kept = 0;
+  while (kept < SITE_DEPTH && f.next_pc) {
+    if (!esp_backtrace_get_next_frame(&f)) break;
+    if (++frame >= 2) pcs[kept++] = esp_cpu_process_stack_pc(f.pc);
+  }
+}
+
+static void noteAlloc(size_t size) {
+  if (xPortInIsrContext()) return;
+
+  uint32_t pcs[SITE_DEPTH];
+  captureSite(pcs);
+
+  uint32_t h = 2166136261u;  // FNV-1a over the PCs
+  for (size_t i = 0; i < SITE_DEPTH; ++i) { h ^= pcs[i]; h *= 16777619u; }
+
+  portENTER_CRITICAL(&s_siteLock);
+  size_t idx = h & (MAX_SITES - 1);
+  for (size_t probe = 0; probe < MAX_SITES; ++probe, idx = (idx + 1) & (MAX_SITES - 1)) {
+    Site& s = s_sites[idx];
+    if (s.count == 0) {
+      memcpy(s.pc, pcs, sizeof(pcs));
+    } else if (memcmp(s.pc, pcs, sizeof(pcs)) != 0) {
+      continue;
+    }
+    s.count++;
+    s.bytes += size;
+    portEXIT_CRITICAL(&s_siteLock);
+    return;
+  }
+  s_sitesDropped++;
+  portEXIT_CRITICAL(&s_siteLock);
+}
+
+// Linker wraps (-Wl,--wrap=...) so every allocation in the image goes through here.
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_heap_caps_malloc(size_t size, uint32_t caps);
+
+void* __wrap_malloc(size_t size) {
+  noteAlloc(size);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  noteAlloc(n * size);
+  return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  noteAlloc(size);
+  return __real_realloc(ptr, size);
+}
+
+void* __wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+  noteAlloc(size);
+  return __real_heap_caps_malloc(size, caps);
+}
+} // extern "C"
+
+#endif // HEAPMON_SITES
+
+// ---------------- Console ----------------
+static void cmdHeap(Print& out, const char* args) {
+  if (strcmp(args, "sites") == 0) {
+    HeapMon::printSites(out);
+  } else if (strcmp(args, "reset") == 0) {
+    HeapMon::resetSites();
+    out.println("heap: site counters cleared");
+  } else {
+    HeapMon::printReport(out);
+  }
+}
+
+namespace HeapMon {
+
+void begin() {
+  for (uint8_t r = 0; r < REGION_COUNT; ++r) {
+    s_minLargest[r] = heap_caps_get_largest_free_block(REGION_CAPS[r]);
+  }
+  s_lastPollMs = s_lastLogMs = millis();
+  Console::add("heap", "heap stats [sites|reset]", cmdHeap);
+}
+
+void poll() {
+  const uint32_t now = millis();
+  if (now - s_lastPollMs < POLL_INTERVAL_MS) return;
+  s_lastPollMs = now;
+
+  for (uint8_t r = 0; r < REGION_COUNT; ++r) {
+    const size_t largest = heap_caps_get_largest_free_block(REGION_CAPS[r]);
+    if (largest < s_minLargest[r]) s_minLargest[r] = largest;
+  }
+
+#if HEAPMON_SITES
+  if (now - s_lastLogMs >= LOG_INTERVAL_MS) {
+    s_lastLogMs = now;
+    printReport(Serial);
+    printSites(Serial, 10);
+  }
+#endif
+}
+
+RegionStats stats(Region r) {
+  RegionStats s = {};
+  if (r >= REGION_COUNT) return s;
+  const uint32_t caps = REGION_CAPS[r];
+  s.totalBytes      = heap_caps_get_total_size(caps);
+  s.freeBytes       = heap_caps_get_free_size(caps);
+  s.largestBlock    = heap_caps_get_largest_free_block(caps);
+  s.minFreeBytes    = heap_caps_get_minimum_free_size(caps);
+  s.minLargestBlock = min(s_minLargest[r], s.largestBlock);
+  return s;
+}
+
+const char* regionName(Region r) {
+  return r < REGION_COUNT ? REGION_NAMES[r] : "?";
+}
+
+uint8_t fragmentationPct(const RegionStats& s) {
+  if (!s.freeBytes) return 0;
+  return (uint8_t)(100 - (uint64_t)s.largestBlock * 100 / s.freeBytes);
+}
+
+void printReport(Print& out) {
+  out.println("region      total     free  largest  min-free  min-lrg  frag");
+  for (uint8_t r = 0; r < REGION_COUNT; ++r) {
+    const RegionStats s = stats((Region)r);
+    if (!s.totalBytes) continue;  // e.g. no PSRAM fitted
+    out.printf("%-8s %8u %8u %8u  %8u %8u  %3u%%\n",
+               REGION_NAMES[r],
+               (unsigned)s.totalBytes, (unsigned)s.freeBytes, (unsigned)s.largestBlock,
+               (unsigned)s.minFreeBytes, (unsigned)s.minLargestBlock,
+               (unsigned)fragmentationPct(s));
+  }
+}
+
+void printSites(Print& out, size_t maxRows) {
+#if HEAPMON_SITES
+  // Snapshot under the lock, then sort/print without holding it.
+  static Site snap[MAX_SITES];
+  portENTER_CRITICAL(&s_siteLock);
+  memcpy(snap, s_sites, sizeof(snap));
+  const uint32_t dropped = s_sitesDropped;
+  portEXIT_CRITICAL(&s_siteLock);
+
+  std::sort(snap, snap + MAX_SITES, [](const Site& a, const Site& b) { return a.count > b.count; });
+
+  out.println("allocs     bytes  call site (innermost first; decode with addr2line)");
+  for (size_t i = 0; i < MAX_SITES && i < maxRows && snap[i].count; ++i) {
+    out.printf("%6u %9u ", (unsigned)snap[i].count, (unsigned)snap[i].bytes);
+    for (size_t d = 0; d < SITE_DEPTH && snap[i].pc[d]; ++d) out.printf(" 0x%08x", (unsigned)snap[i].pc[d]);
+    out.println();
+  }
+  if (dropped) out.printf("(%u allocations not attributed: site table full)\n", (unsigned)dropped);
+#else
+  (void)maxRows;
+  out.println("heap: site attribution disabled (build env:kode_dot_debug)");
+#endif
+}
+
+void resetSites() {
+#if HEAPMON_SITES
+  portENTER_CRITICAL(&s_siteLock);
+  memset(s_sites, 0, sizeof(s_sites));
+  s_sitesDropped = 0;
+  portEXIT_CRITICAL(&s_siteLock);
+#endif
+  for (uint8_t r = 0; r < REGION_COUNT; ++r) {
+    s_minLargest[r] = heap_caps_get_largest_free_block(REGION_CAPS[r]);
+  }
+}
+
+} // namespace HeapMon
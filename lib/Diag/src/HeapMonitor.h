@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+
+// Heap / PSRAM fragmentation monitor.
+// Tracks free bytes, largest free block and low-water marks for each
+// capability class. Builds with -DHEAPMON_SITES=1 (env:kode_dot_debug) also
+// wrap malloc & co. at link time and count allocations per call site.
+namespace HeapMon {
+
+  enum Region : uint8_t {
+    REGION_INTERNAL = 0,
+    REGION_DMA,
+    REGION_PSRAM,
+    REGION_COUNT
+  };
+
+  struct RegionStats {
+    size_t totalBytes;
+    size_t freeBytes;
+    size_t largestBlock;     // biggest single allocation that would succeed now
+    size_t minFreeBytes;     // allocator low-water mark since boot
+    size_t minLargestBlock;  // smallest largest-block seen by poll()
+  };
+
+  // Registers the "heap" console command and takes a first sample.
+  void begin();
+
+  // Cheap, rate-limited sampling. Call from loop().
+  void poll();
+
+  RegionStats stats(Region r);
+  const char* regionName(Region r);
+
+  // Percentage of free memory that is NOT in the largest block (0 = unfragmented).
+  uint8_t fragmentationPct(const RegionStats& s);
+
+  void printReport(Print& out);
+
+  // Allocation-site table (only populated when HEAPMON_SITES is enabled).
+  void printSites(Print& out, size_t maxRows = 20);
+  void resetSites();
+
+} // namespace HeapMon
@@ -0,0 +1,241 @@
+#include "InputLatency.h"
+#include "Console.h"
+#include "Trace.h"
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static constexpr size_t   MAX_SAMPLES        = 256;
+static constexpr uint32_t SYNTH_HOLD_US      = 100000;  // finger down for 100 ms
+static constexpr uint32_t LOAD_CHUNK_SECTORS = 64;
+
+struct LatencySample {
+  uint32_t pollUs;      // tap requested -> touch read saw it (synthetic taps only)
+  uint32_t dispatchUs;  // touch edge -> LV_EVENT_PRESSED handler
+  uint32_t renderUs;    // handler -> end of flush covering the widget
+  uint32_t totalUs;     // origin -> end of flush
+};
+
+enum SynthPhase : uint8_t { SYNTH_IDLE, SYNTH_REQUESTED, SYNTH_HOLD, SYNTH_SLIDE_OFF };
+
+static lv_obj_t*          s_target      = nullptr;
+static LatencySample      s_samples[MAX_SAMPLES];
+static size_t             s_count       = 0;  // total samples ever (ring index = count % MAX)
+static InputLatency::Load s_load        = InputLatency::Load::None;
+static volatile bool      s_loadStop    = false;
+static volatile bool      s_loadRunning = false;
+
+// In-flight measurement (LVGL context only, except s_requestUs/s_phase).
+static bool      s_lastPressed = false;
+static bool      s_pending     = false;     // edge seen, waiting for handler
+static bool      s_handled     = false;     // handler ran, waiting for flush
+static int64_t   s_originUs    = 0;
+static int64_t   s_edgeUs      = 0;
+static int64_t   s_handledUs   = 0;
+static lv_area_t s_targetArea;
+
+static volatile SynthPhase s_phase       = SYNTH_IDLE;
+static volatile int64_t    s_requestUs   = 0;
+static int64_t             s_holdUntilUs = 0;
+
+// ---------------- Hooks ----------------
+static void touchHook(lv_indev_data_t* data) {
+  const int64_t now = esp_timer_get_time();
+  bool synthetic = false;
+
+  switch (s_phase) {
+    case SYNTH_REQUESTED:
+    case SYNTH_HOLD: {
+      if (s_phase == SYNTH_REQUESTED) {
+        s_holdUntilUs = now + SYNTH_HOLD_US;
+        s_phase = SYNTH_HOLD;
+        synthetic = true;
+      } else if (now >= s_holdUntilUs) {
+        s_phase = SYNTH_SLIDE_OFF;
+      }
+      lv_area_t a;
+      lv_obj_get_coords(s_target, &a);
+      data->state   = LV_INDEV_STATE_PRESSED;
+      data->point.x = s_phase == SYNTH_SLIDE_OFF ? 0 : (a.x1 + a.x2) / 2;
+      data->point.y = s_phase == SYNTH_SLIDE_OFF ? 0 : (a.y1 + a.y2) / 2;
+      break;
+    }
+    case SYNTH_SLIDE_OFF:
+      data->state   = LV_INDEV_STATE_RELEASED;
+      data->point.x = 0;
+      data->point.y = 0;
+      s_phase = SYNTH_IDLE;
+      break;
+    default:
+      break;
+  }
+
+  const bool pressed = data->state == LV_INDEV_STATE_PRESSED;
+  if (pressed && !s_lastPressed) {
+    Trace::instant("touch.edge");
+    s_pending  = true;
+    s_handled  = false;
+    s_edgeUs   = now;
+    s_originUs = synthetic ? s_requestUs : now;
+  }
+  s_lastPressed = pressed;
+}
+
+static void pressedCb(lv_event_t*) {
+  if (!s_pending) return;
+  Trace::instant("touch.handler");
+  s_pending   = false;
+  s_handled   = true;
+  s_handledUs = esp_timer_get_time();
+  lv_obj_get_coords(s_target, &s_targetArea);
+}
+
+static void flushHook(const lv_area_t* area) {
+  if (!s_handled) return;
+  if (area->x2 < s_targetArea.x1 || area->x1 > s_targetArea.x2 ||
+      area->y2 < s_targetArea.y1 || area->y1 > s_targetArea.y2) return;
+
+  const int64_t now = esp_timer_get_time();
+  Trace::instant("touch.photon");
+  LatencySample& s = s_samples[s_count % MAX_SAMPLES];
+  s.pollUs     = (uint32_t)(s_edgeUs - s_originUs);
+  s.dispatchUs = (uint32_t)(s_handledUs - s_edgeUs);
+  s.renderUs   = (uint32_t)(now - s_handledUs);
+  s.totalUs    = (uint32_t)(now - s_originUs);
+  s_count++;
+  s_handled = false;
+}
+
+// ---------------- Synthetic taps / background load ----------------
+struct AutoArgs { uint16_t count; uint32_t intervalMs; };
+static AutoArgs s_auto;
+
+static void autoTask(void*) {
+  for (uint16_t i = 0; i < s_auto.count; ++i) {
+    while (s_phase != SYNTH_IDLE) vTaskDelay(pdMS_TO_TICKS(5));
+    s_requestUs = esp_timer_get_time();
+    s_phase     = SYNTH_REQUESTED;
+    vTaskDelay(pdMS_TO_TICKS(s_auto.intervalMs));
+  }
+  Serial.println("lat: synthetic taps done");
+  InputLatency::printReport(Serial);
+  vTaskDelete(nullptr);
+}
+
+// Mimics the MSC read path: back-to-back multi-block reads + a copy.
+static void mscLoadTask(void*) {
+  const size_t bytes = LOAD_CHUNK_SECTORS * SdCard::SECTOR_SIZE;
+  uint8_t* a = (uint8_t*)SdCard::allocBuffer(bytes);
+  uint8_t* b = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+  const uint32_t end = SdCard::sectorCount();
+  uint32_t lba = 0;
+  while (!s_loadStop && a && b) {
+    if (lba + LOAD_CHUNK_SECTORS > end) lba = 0;
+    if (!SdCard::read(a, lba, LOAD_CHUNK_SECTORS)) break;
+    memcpy(b, a, bytes);
+    lba += LOAD_CHUNK_SECTORS;
+  }
+  heap_caps_free(a);
+  heap_caps_free(b);
+  SdCard::end();
+  s_loadRunning = false;
+  vTaskDelete(nullptr);
+}
+
+// ---------------- Stats ----------------
+static uint32_t percentile(uint32_t* v, size_t n, uint8_t pct) {
+  return v[min(n - 1, (n * pct) / 100)];
+}
+
+static void printRow(Print& out, const char* name, uint32_t LatencySample::*field, size_t n) {
+  static uint32_t v[MAX_SAMPLES];
+  for (size_t i = 0; i < n; ++i) v[i] = s_samples[i].*field;
+  std::sort(v, v + n);
+  out.printf("%-13s %7.1f %7.1f %7.1f %7.1f %7.1f\n", name,
+             v[0] / 1000.0f, percentile(v, n, 50) / 1000.0f, percentile(v, n, 90) / 1000.0f,
+             percentile(v, n, 99) / 1000.0f, v[n - 1] / 1000.0f);
+}
+
+static const char* loadName(InputLatency::Load l) {
+  switch (l) {
+    case InputLatency::Load::Scan: return "scan";
+    case InputLatency::Load::Msc:  return "msc";
+    default:                       return "none";
+  }
+}
+
+// ---------------- Console ----------------
+static void cmdLat(Print& out, const char* args) {
+  if (strncmp(args, "auto", 4) == 0) {
+    const int n = atoi(args + 4);
+    out.println(InputLatency::startAuto(n > 0 ? n : 20) ? "lat: injecting taps" : "lat: busy");
+  } else if (strncmp(args, "load ", 5) == 0) {
+    const char* mode = args + 5;
+    InputLatency::Load l = strcmp(mode, "scan") == 0 ? InputLatency::Load::Scan
+                         : strcmp(mode, "msc")  == 0 ? InputLatency::Load::Msc
+                                                     : InputLatency::Load::None;
+    if (InputLatency::setLoad(l)) out.printf("lat: load %s\n", loadName(l));
+    else                          out.println("lat: could not start load (card busy?)");
+  } else if (strcmp(args, "reset") == 0) {
+    InputLatency::reset();
+    out.println("lat: samples cleared");
+  } else {
+    InputLatency::printReport(out);
+    out.println("usage: lat [auto N|load none|scan|msc|reset]");
+  }
+}
+
+namespace InputLatency {
+
+void begin(DisplayManager& display, lv_obj_t* target) {
+  s_target = target;
+  display.setTouchHook(touchHook);
+  display.setFlushHook(flushHook);
+  lv_obj_add_event_cb(target, pressedCb, LV_EVENT_PRESSED, nullptr);
+  Console::add("lat", "touch-to-photon latency: auto N|load M|reset", cmdLat);
+}
+
+bool startAuto(uint16_t count, uint32_t intervalMs) {
+  if (!s_target || s_phase != SYNTH_IDLE) return false;
+  s_auto = { count, intervalMs };
+  return xTaskCreatePinnedToCore(autoTask, "lat_auto", 3072, nullptr, 3, nullptr, 0) == pdPASS;
+}
+
+bool setLoad(Load l) {
+  // Stop a running MSC load first and wait for it to release the card.
+  if (s_loadRunning) {
+    s_loadStop = true;
+    while (s_loadRunning) delay(5);
+  }
+  s_load = Load::None;
+
+  if (l == Load::Msc) {
+    if (!SdCard::begin()) return false;
+    s_loadStop    = false;
+    s_loadRunning = true;
+    if (xTaskCreatePinnedToCore(mscLoadTask, "lat_load", 4096, nullptr, 5, nullptr, 0) != pdPASS) {
+      SdCard::end();
+      s_loadRunning = false;
+      return false;
+    }
+  }
+  s_load = l;
+  return true;
+}
+
+Load load() { return s_load; }
+
+void reset() { s_count = 0; }
+
+void printReport(Print& out) {
+  const size_t n = min(s_count, MAX_SAMPLES);
+  out.printf("Touch-to-photon latency, %u samples, load: %s\n", (unsigned)n, loadName(s_load));
+  if (!n) return;
+  out.println("phase (ms)        min     p50     p90     p99     max");
+  printRow(out, "poll",         &LatencySample::pollUs,     n);
+  printRow(out, "dispatch",     &LatencySample::dispatchUs, n);
+  printRow(out, "render+flush", &LatencySample::renderUs,   n);
+  printRow(out, "total",        &LatencySample::totalUs,    n);
+}
+
+} // namespace InputLatency
@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include <lvgl.h>
+#include <kodedot/display_manager.h>
+
+// Touch-to-photon latency harness ("lat").
+// Times each press on a target widget from the touch edge (or, for synthetic
+// taps, from the moment the tap was requested) through its LV_EVENT_PRESSED
+// handler to the end of the first flush that repaints the widget.
+// Optional background load (card scan or MSC-like streaming) shows how I/O
+// hurts responsiveness.
+namespace InputLatency {
+
+  enum class Load : uint8_t { None, Scan, Msc };
+
+  // Hook the display and watch presses on `target` (e.g. the mount button).
+  void begin(DisplayManager& display, lv_obj_t* target);
+
+  // Inject `count` synthetic taps on the target, one every `intervalMs`.
+  // Taps slide off the widget before release, so they never trigger a click.
+  bool startAuto(uint16_t count, uint32_t intervalMs = 400);
+
+  bool setLoad(Load load);
+  Load load();
+
+  // True while the "scan" load is on: the UI should rescan back-to-back.
+  inline bool scanLoadActive() { return load() == Load::Scan; }
+
+  void reset();
+  void printReport(Print& out);
+
+} // namespace InputLatency
@@ -0,0 +1,188 @@
+#include "Profiler.h"
+#include "Console.h"
+#include <atomic>
+#include <driver/gptimer.h>
+#include <esp_heap_caps.h>
+#include <xtensa_context.h>
+
+struct Sample {
+  uint32_t pc;
+  uint32_t caller;
+  uint8_t  core;
+};
+
+static Sample*               s_buf      = nullptr;
+static uint32_t              s_capacity = 0;
+static std::atomic<uint32_t> s_count{0};
+static std::atomic<uint32_t> s_dropped{0};
+static gptimer_handle_t      s_timers[portNUM_PROCESSORS] = {};
+static uint32_t              s_periodUs = 0;
+static bool                  s_running  = false;
+
+// Windowed-ABI return address -> code address of the call instruction.
+static inline uint32_t IRAM_ATTR callerFromA0(uint32_t a0) {
+  if (!a0) return 0;
+  return ((a0 & 0x3FFFFFFFu) | 0x40000000u) - 3;
+}
+
+static bool IRAM_ATTR onAlarm(gptimer_handle_t, const gptimer_alarm_event_data_t*, void* arg) {
+  const uint32_t idx = s_count.fetch_add(1, std::memory_order_relaxed);
+  if (idx >= s_capacity) {
+    s_count.store(s_capacity, std::memory_order_relaxed);
+    s_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  Sample& s = s_buf[idx];
+  s.core = (uint8_t)(uintptr_t)arg;
+
+  // On the outermost interrupt level the port saves the interrupted task's
+  // registers as an XtExcFrame and stores its address in the TCB's first
+  // member (pxTopOfStack). Nested interrupts have no such frame. This handler
+  // already counts as one level, so only a count above 1 means nested
+  // (xPortInterruptedFromISRContext() is always true here).
+  if (port_interruptNesting[s.core] > 1) {
+    s.pc     = 0;
+    s.caller = 0;
+  } else {
+    const XtExcFrame* frame = *(XtExcFrame* const*)xTaskGetCurrentTaskHandleForCore(s.core);
+    s.pc     = frame->pc;
+    s.caller = callerFromA0(frame->a0);
+  }
+  return false;
+}
+
+// gptimer installs its interrupt on the core that registers the callbacks,
+// so each core's timer is set up from a short-lived task pinned to that core.
+struct TimerSetup {
+  BaseType_t        core;
+  SemaphoreHandle_t done;
+  bool              ok;
+};
+
+static void timerSetupTask(void* arg) {
+  TimerSetup* ts = static_cast<TimerSetup*>(arg);
+  gptimer_handle_t& t = s_timers[ts->core];
+
+  gptimer_config_t cfg = {};
+  cfg.clk_src       = GPTIMER_CLK_SRC_DEFAULT;
+  cfg.direction     = GPTIMER_COUNT_UP;
+  cfg.resolution_hz = 1000000;  // 1 tick = 1 us
+
+  gptimer_event_callbacks_t cbs = {};
+  cbs.on_alarm = onAlarm;
+
+  gptimer_alarm_config_t alarm = {};
+  alarm.alarm_count                = s_periodUs;
+  alarm.reload_count               = 0;
+  alarm.flags.auto_reload_on_alarm = true;
+
+  ts->ok = gptimer_new_timer(&cfg, &t) == ESP_OK &&
+           gptimer_register_event_callbacks(t, &cbs, (void*)(uintptr_t)ts->core) == ESP_OK &&
+           gptimer_set_alarm_action(t, &alarm) == ESP_OK &&
+           gptimer_enable(t) == ESP_OK &&
+           gptimer_start(t) == ESP_OK;
+
+  xSemaphoreGive(ts->done);
+  vTaskDelete(nullptr);
+}
+
+static void releaseTimers() {
+  for (auto& t : s_timers) {
+    if (!t) continue;
+    gptimer_stop(t);
+    gptimer_disable(t);
+    gptimer_del_timer(t);
+    t = nullptr;
+  }
+}
+
+// ---------------- Console ----------------
+static void cmdProf(Print& out, const char* args) {
+  if (strncmp(args, "start", 5) == 0) {
+    const uint32_t hz = (uint32_t)atoi(args + 5);
+    out.println(Profiler::start(hz ? hz : 997) ? "prof: sampling" : "prof: failed to start timers");
+  } else if (strcmp(args, "stop") == 0) {
+    Profiler::stop();
+    out.printf("prof: stopped, %u samples (%u dropped)\n",
+               (unsigned)Profiler::sampleCount(), (unsigned)Profiler::droppedCount());
+  } else if (strcmp(args, "dump") == 0) {
+    Profiler::stop();
+    Profiler::dump(out);
+  } else {
+    out.printf("prof: %s, %u samples\n", Profiler::running() ? "sampling" : "idle",
+               (unsigned)Profiler::sampleCount());
+    out.println("usage: prof start [hz]|stop|dump");
+  }
+}
+
+namespace Profiler {
+
+bool begin(size_t capacitySamples) {
+  if (s_buf) return true;
+  s_buf = (Sample*)heap_caps_calloc(capacitySamples, sizeof(Sample), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!s_buf) {
+    Serial.println("Profiler: PSRAM buffer allocation failed");
+    return false;
+  }
+  s_capacity = capacitySamples;
+  Console::add("prof", "sampling profiler: start [hz]|stop|dump", cmdProf);
+  return true;
+}
+
+bool start(uint32_t hz) {
+  if (!s_buf || !hz) return false;
+  stop();
+  s_count.store(0);
+  s_dropped.store(0);
+  s_periodUs = max<uint32_t>(1000000u / hz, 50);
+
+  TimerSetup ts = {};
+  ts.done = xSemaphoreCreateBinary();
+  if (!ts.done) return false;
+
+  bool ok = true;
+  for (BaseType_t core = 0; core < portNUM_PROCESSORS && ok; ++core) {
+    ts.core = core;
+    ts.ok   = false;
+    if (xTaskCreatePinnedToCore(timerSetupTask, "prof_setup", 3072, &ts,
+                                configMAX_PRIORITIES - 1, nullptr, core) != pdPASS) {
+      ok = false;
+      break;
+    }
+    xSemaphoreTake(ts.done, portMAX_DELAY);
+    ok = ts.ok;
+  }
+  vSemaphoreDelete(ts.done);
+
+  if (!ok) {
+    releaseTimers();
+    return false;
+  }
+  s_running = true;
+  return true;
+}
+
+void stop() {
+  releaseTimers();
+  s_running = false;
+}
+
+bool running() { return s_running; }
+
+size_t sampleCount() { return min<uint32_t>(s_count.load(), s_capacity); }
+
+size_t droppedCount() { return s_dropped.load(); }
+
+void dump(Print& out) {
+  const size_t n = sampleCount();
+  out.printf("----- profile begin ----- period_us=%u samples=%u dropped=%u\n",
+             (unsigned)s_periodUs, (unsigned)n, (unsigned)droppedCount());
+  for (size_t i = 0; i < n; ++i) {
+    const Sample& s = s_buf[i];
+    out.printf("P %u 0x%08x 0x%08x\n", (unsigned)s.core, (unsigned)s.pc, (unsigned)s.caller);
+  }
+  out.println("----- profile end -----");
+}
+
+} // namespace Profiler
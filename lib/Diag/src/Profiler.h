@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+// Statistical sampling profiler.
+// A hardware timer interrupt on each core records the PC of the interrupted
+// task (plus its immediate caller) into a PSRAM buffer. Dump with "prof dump"
+// and symbolize on the host with extra_scripts/profile_report.py.
+namespace Profiler {
+
+  // Allocate the sample buffer and register the "prof" console command.
+  bool begin(size_t capacitySamples = 32768);
+
+  // Start sampling both cores at roughly hz samples/s per core.
+  // Default is just off 1 kHz so samples don't lock-step with the RTOS tick.
+  bool start(uint32_t hz = 997);
+  void stop();
+  bool running();
+
+  size_t sampleCount();
+  size_t droppedCount();  // samples lost because the buffer was full
+
+  // One "P <core> <pc> <caller>" line per sample, framed by marker lines.
+  void dump(Print& out);
+
+} // namespace Profiler
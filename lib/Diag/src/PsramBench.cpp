@@ -0,0 +1,195 @@
+#include "PsramBench.h"
+#include "Console.h"
+#include "Energy.h"
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
+#include <lvgl.h>
+
+static constexpr uint32_t RUN_MS          = 3000;
+static constexpr uint32_t SETTLE_MS       = 300;
+static constexpr uint32_t PROBE_MS        = 500;
+static constexpr uint32_t PROBE_BYTES     = 256 * 1024;            // per buffer, well past the data cache
+static constexpr uint32_t CHUNK_SECTORS   = 64;                    // 32 KB per transfer
+static constexpr uint32_t CHUNK_BYTES     = CHUNK_SECTORS * SdCard::SECTOR_SIZE;
+static constexpr uint32_t REGION_SECTORS  = 256u * 1024u * 1024u / SdCard::SECTOR_SIZE;
+
+enum Scenario : uint8_t { UI_IDLE = 0, UI_ANIMATION, UI_FULL_REDRAW, SCENARIO_COUNT };
+enum Placement : uint8_t { BUF_INTERNAL = 0, BUF_PSRAM, PLACEMENT_COUNT };
+
+static const char* const SCENARIO_NAMES[SCENARIO_COUNT]   = { "ui idle", "animation", "full redraw" };
+static const char* const PLACEMENT_NAMES[PLACEMENT_COUNT] = { "internal", "psram" };
+
+struct Result {
+  bool  ok;
+  float streamMBps;
+  float flushMBps;   // panel bytes read out of the PSRAM draw buffers
+  float psramMBps;   // PSRAM->PSRAM memcpy, bytes read + written, under the same UI load
+};
+
+static DisplayManager*   s_display  = nullptr;
+static Print*            s_out      = nullptr;
+static volatile bool     s_running  = false;
+static volatile Scenario s_scenario = UI_IDLE;
+static Scenario          s_applied  = UI_IDLE;
+static lv_obj_t*         s_spinner  = nullptr;
+static uint64_t          s_bytes    = 0;       // total streamed, for energy accounting
+static bool              s_bounced[PLACEMENT_COUNT];   // card reads went through the driver's bounce buffer
+static uint8_t*          s_probe    = nullptr;   // 2 x PROBE_BYTES, PSRAM
+
+// PSRAM bandwidth the CPU still gets while the scenario's UI load runs.
+static float probePsram() {
+  if (!s_probe) return 0.0f;
+  const uint32_t t0 = millis();
+  uint64_t bytes = 0;
+  uint32_t dt;
+  while ((dt = millis() - t0) < PROBE_MS) {
+    memcpy(s_probe + PROBE_BYTES, s_probe, PROBE_BYTES);
+    bytes += 2 * PROBE_BYTES;
+  }
+  return (float)bytes / 1048576.0f * 1000.0f / (float)dt;
+}
+
+static Result runOne(uint8_t* cardBuf, uint8_t* usbBuf, Scenario sc) {
+  Result r = {};
+  s_scenario = sc;
+  vTaskDelay(pdMS_TO_TICKS(SETTLE_MS));
+
+  const uint32_t regionEnd = min(SdCard::sectorCount(), REGION_SECTORS);
+  const DisplayManager::FlushStats f0 = s_display->getFlushStats();
+  const uint32_t t0 = millis();
+  uint64_t bytes = 0;
+  uint32_t lba   = 0;
+
+  while (millis() - t0 < RUN_MS) {
+    if (lba + CHUNK_SECTORS > regionEnd) lba = 0;
+    if (!SdCard::read(cardBuf, lba, CHUNK_SECTORS)) return r;
+    memcpy(usbBuf, cardBuf, CHUNK_BYTES);  // stands in for the copy into the USB endpoint
+    bytes += CHUNK_BYTES;
+    lba   += CHUNK_SECTORS;
+  }
+
+  const uint32_t dt = millis() - t0;
+  s_bytes += bytes;
+  const DisplayManager::FlushStats f1 = s_display->getFlushStats();
+  r.ok         = true;
+  r.streamMBps = (float)bytes / 1048576.0f * 1000.0f / (float)dt;
+  r.flushMBps  = (float)((f1.pixels - f0.pixels) * 2) / 1048576.0f * 1000.0f / (float)dt;
+  r.psramMBps  = probePsram();
+  return r;
+}
+
+static void report(Print& out, const Result (&res)[PLACEMENT_COUNT][SCENARIO_COUNT]) {
+  out.println("PSRAM contention (SD->USB stream vs UI load)");
+  out.println("buffers   scenario      stream MB/s  vs idle  flush MB/s  PSRAM copy MB/s");
+  for (uint8_t p = 0; p < PLACEMENT_COUNT; ++p) {
+    const float base = res[p][UI_IDLE].streamMBps;
+    for (uint8_t s = 0; s < SCENARIO_COUNT; ++s) {
+      const Result& r = res[p][s];
+      if (!r.ok) {
+        out.printf("%-9s %-12s  (failed)\n", PLACEMENT_NAMES[p], SCENARIO_NAMES[s]);
+        continue;
+      }
+      const float delta = base > 0 ? (r.streamMBps - base) * 100.0f / base : 0.0f;
+      out.printf("%-9s %-12s  %10.2f  %+6.1f%%  %10.2f  %15.2f\n",
+                 PLACEMENT_NAMES[p], SCENARIO_NAMES[s], r.streamMBps, delta, r.flushMBps, r.psramMBps);
+    }
+  }
+  if (!s_probe) out.println("note: no PSRAM for the copy probe");
+  for (uint8_t p = 0; p < PLACEMENT_COUNT; ++p) {
+    if (s_bounced[p]) {
+      out.printf("note: %s buffers are not DMA-capable, the card driver copied each sector "
+                 "through an internal bounce buffer\n", PLACEMENT_NAMES[p]);
+    }
+  }
+}
+
+static void benchTask(void*) {
+  static Result res[PLACEMENT_COUNT][SCENARIO_COUNT];
+  memset(res, 0, sizeof(res));
+  s_bytes = 0;
+  s_probe = (uint8_t*)heap_caps_malloc(2 * PROBE_BYTES, MALLOC_CAP_SPIRAM);
+  if (s_probe) memset(s_probe, 0x5A, 2 * PROBE_BYTES);
+  Energy::beginActivity("bench");
+
+  for (uint8_t p = 0; p < PLACEMENT_COUNT; ++p) {
+    // PSRAM the card can DMA into (cache-line aligned) when the heap has it,
+    // otherwise plain PSRAM, which the driver bounces one sector at a time.
+    const uint32_t caps = p == BUF_INTERNAL ? (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) : (MALLOC_CAP_SPIRAM | MALLOC_CAP_DMA);
+    uint8_t* cardBuf = (uint8_t*)heap_caps_aligned_alloc(64, CHUNK_BYTES, caps);
+    if (!cardBuf && p == BUF_PSRAM) cardBuf = (uint8_t*)heap_caps_aligned_alloc(64, CHUNK_BYTES, MALLOC_CAP_SPIRAM);
+    uint8_t* usbBuf  = (uint8_t*)heap_caps_aligned_alloc(64, CHUNK_BYTES, p == BUF_INTERNAL ? caps : MALLOC_CAP_SPIRAM);
+    s_bounced[p] = cardBuf && !esp_ptr_dma_capable(cardBuf) && !esp_ptr_dma_ext_capable(cardBuf);
+    if (cardBuf && usbBuf) {
+      for (uint8_t s = 0; s < SCENARIO_COUNT; ++s) res[p][s] = runOne(cardBuf, usbBuf, (Scenario)s);
+    }
+    heap_caps_free(cardBuf);
+    heap_caps_free(usbBuf);
+  }
+
+  s_scenario = UI_IDLE;
+  Energy::endActivity("bench", s_bytes, 0);
+  SdCard::end();
+  report(*s_out, res);
+  heap_caps_free(s_probe);
+  s_probe = nullptr;
+  s_running = false;
+  vTaskDelete(nullptr);
+}
+
+// ---------------- Console ----------------
+static void cmdBench(Print& out, const char* args) {
+  if (strcmp(args, "psram") == 0) {
+    if (PsramBench::start(out)) {
+      out.printf("bench: running %u scenarios x %u ms...\n",
+                 (unsigned)(SCENARIO_COUNT * PLACEMENT_COUNT), (unsigned)(RUN_MS + PROBE_MS));
+    } else {
+      out.println("bench: card busy or missing (unmount USB first)");
+    }
+  } else {
+    out.println("usage: bench psram");
+  }
+}
+
+namespace PsramBench {
+
+void begin(DisplayManager& display) {
+  s_display = &display;
+  Console::add("bench", "benchmarks: psram", cmdBench);
+}
+
+bool start(Print& out) {
+  if (s_running || !s_display) return false;
+  // Claim the card from the caller's (loop) context so the UI scanner sees it busy.
+  if (!SdCard::begin()) return false;
+  s_out     = &out;
+  s_running = true;
+  // Core 0: keeps the stream off the LVGL/loop core, like the USB task.
+  if (xTaskCreatePinnedToCore(benchTask, "psram_bench", 4096, nullptr, 5, nullptr, 0) != pdPASS) {
+    SdCard::end();
+    s_running = false;
+    return false;
+  }
+  return true;
+}
+
+bool running() { return s_running; }
+
+void pollUi() {
+  const Scenario want = s_scenario;
+  if (want != s_applied) {
+    if (s_spinner) {
+      lv_obj_delete(s_spinner);
+      s_spinner = nullptr;
+    }
+    if (want == UI_ANIMATION) {
+      s_spinner = lv_spinner_create(lv_screen_active());
+      lv_obj_set_size(s_spinner, 120, 120);
+      lv_obj_center(s_spinner);
+    }
+    s_applied = want;
+  }
+  if (want == UI_FULL_REDRAW) lv_obj_invalidate(lv_screen_active());
+}
+
+} // namespace PsramBench
@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+#include <kodedot/display_manager.h>
+
+// PSRAM bus contention benchmark ("bench psram").
+// Streams SD -> "USB" buffer copies (the MSC read path) while the UI is idle,
+// animating, or fully redrawing, once with the stream buffers in internal
+// SRAM and once in PSRAM, and reports throughput loss, the panel flush rate
+// and the PSRAM bandwidth per scenario (a timed PSRAM-to-PSRAM memcpy run
+// right after the stream, under the same UI load). The PSRAM card buffer is DMA-capable when the heap has
+// such memory; the report says when reads went through a bounce buffer.
+namespace PsramBench {
+
+  // Register the "bench" console command. `display` supplies flush counters.
+  void begin(DisplayManager& display);
+
+  // Kick off the benchmark on a worker task; the report goes to `out`.
+  // Fails if the card is busy (mounted over USB or used by another tool).
+  bool start(Print& out);
+  bool running();
+
+  // Applies the current UI load scenario. Call from loop() (LVGL context).
+  void pollUi();
+
+} // namespace PsramBench
@@ -0,0 +1,180 @@
+#include "SelfTest.h"
+#include "Console.h"
+#include <Preferences.h>
+#include <SdCard.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <esp_timer.h>
+#include <lvgl.h>
+
+static constexpr size_t   PSRAM_COPY_BYTES   = 1024 * 1024;
+static constexpr uint32_t SD_RANDOM_READS    = 64;
+static constexpr uint32_t SD_SEQ_CHUNK       = 128;              // sectors (64 KB)
+static constexpr uint32_t SD_SEQ_TOTAL       = 4096;             // sectors (2 MB)
+
+static const char* const METRIC_NAMES[SelfTest::METRIC_COUNT] = {
+  "PSRAM copy", "Full flush", "SD random read", "SD seq read",
+};
+static const char* const METRIC_UNITS[SelfTest::METRIC_COUNT] = {
+  "MB/s", "ms", "us", "MB/s",
+};
+// true when a bigger number is better (throughput), false for times
+static const bool HIGHER_IS_BETTER[SelfTest::METRIC_COUNT] = { true, false, false, true };
+static const char* const NVS_KEYS[SelfTest::METRIC_COUNT] = { "psram", "flush", "sd_rand", "sd_seq" };
+
+static DisplayManager*  s_display = nullptr;
+static Preferences      s_prefs;
+static SelfTest::Result s_last    = {};
+static uint32_t         s_runs    = 0;
+
+// ---------------- Individual checks ----------------
+static bool measurePsramCopy(float& mbps) {
+  uint8_t* a = (uint8_t*)heap_caps_malloc(PSRAM_COPY_BYTES, MALLOC_CAP_SPIRAM);
+  uint8_t* b = (uint8_t*)heap_caps_malloc(PSRAM_COPY_BYTES, MALLOC_CAP_SPIRAM);
+  bool ok = a && b;
+  if (ok) {
+    memset(a, 0x5A, PSRAM_COPY_BYTES);
+    const int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < 4; ++i) memcpy(i & 1 ? a : b, i & 1 ? b : a, PSRAM_COPY_BYTES);
+    const int64_t dt = esp_timer_get_time() - t0;
+    mbps = 4.0f * PSRAM_COPY_BYTES / 1048576.0f / (dt / 1e6f);
+  }
+  heap_caps_free(a);
+  heap_caps_free(b);
+  return ok;
+}
+
+static bool measureFullFlush(float& ms) {
+  if (!s_display) return false;
+  lv_obj_invalidate(lv_screen_active());
+  const DisplayManager::FlushStats f0 = s_display->getFlushStats();
+  lv_refr_now(nullptr);
+  const DisplayManager::FlushStats f1 = s_display->getFlushStats();
+  if (f1.flushes == f0.flushes) return false;
+  ms = (f1.busyUs - f0.busyUs) / 1000.0f;
+  return true;
+}
+
+static bool measureSd(float& randomUs, float& seqMbps, uint32_t& serial) {
+  if (!SdCard::begin()) return false;
+  serial = (uint32_t)SdCard::card()->cid.serial;
+
+  bool ok = false;
+  const uint32_t sectors = SdCard::sectorCount();
+  uint8_t* buf = (uint8_t*)SdCard::allocBuffer(SD_SEQ_CHUNK * SdCard::SECTOR_SIZE);
+  if (buf && sectors > SD_SEQ_TOTAL) {
+    ok = true;
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < SD_RANDOM_READS && ok; ++i) {
+      ok = SdCard::read(buf, esp_random() % sectors, 1);
+    }
+    randomUs = (esp_timer_get_time() - t0) / (float)SD_RANDOM_READS;
+
+    // Start past the FAT region so the card's metadata cache doesn't flatter us.
+    const uint32_t start = sectors / 2;
+    t0 = esp_timer_get_time();
+    for (uint32_t s = 0; s < SD_SEQ_TOTAL && ok; s += SD_SEQ_CHUNK) {
+      ok = SdCard::read(buf, start + s, SD_SEQ_CHUNK);
+    }
+    const int64_t dt = esp_timer_get_time() - t0;
+    seqMbps = SD_SEQ_TOTAL * SdCard::SECTOR_SIZE / 1048576.0f / (dt / 1e6f);
+  }
+  heap_caps_free(buf);
+  SdCard::end();
+  return ok;
+}
+
+// ---------------- Console ----------------
+static void cmdSelfTest(Print& out, const char* args) {
+  if (strcmp(args, "rebase") == 0) {
+    SelfTest::rebase();
+    out.println("selftest: baselines replaced with last results");
+  } else if (strcmp(args, "boot on") == 0 || strcmp(args, "boot off") == 0) {
+    SelfTest::setBootEnabled(args[6] == 'n');
+    out.printf("selftest: boot run %s\n", SelfTest::bootEnabled() ? "on" : "off");
+  } else if (*args == '\0') {
+    SelfTest::run();
+    if (!SelfTest::anyRegression()) out.println("selftest: no regressions");
+  } else {
+    out.println("usage: selftest [rebase|boot on|boot off]");
+  }
+}
+
+namespace SelfTest {
+
+void begin(DisplayManager& display) {
+  s_display = &display;
+  s_prefs.begin("selftest", false);
+  Console::add("selftest", "perf self-test vs NVS baseline: [rebase|boot on|off]", cmdSelfTest);
+}
+
+bool bootEnabled()          { return s_prefs.getUChar("boot", 1) != 0; }
+void setBootEnabled(bool on) { s_prefs.putUChar("boot", on ? 1 : 0); }
+
+const Result& run() {
+  Result r = {};
+  uint32_t serial = 0;
+  r.measured[PSRAM_COPY_MBPS] = measurePsramCopy(r.value[PSRAM_COPY_MBPS]);
+  r.measured[FLUSH_FULL_MS]   = measureFullFlush(r.value[FLUSH_FULL_MS]);
+  const bool sd = measureSd(r.value[SD_RANDOM_READ_US], r.value[SD_SEQ_READ_MBPS], serial);
+  r.measured[SD_RANDOM_READ_US] = r.measured[SD_SEQ_READ_MBPS] = sd;
+
+  // A different card means the SD baselines don't apply: start over for it.
+  if (sd && s_prefs.getUInt("sd_serial", 0) != serial) {
+    s_prefs.putUInt("sd_serial", serial);
+    s_prefs.remove(NVS_KEYS[SD_RANDOM_READ_US]);
+    s_prefs.remove(NVS_KEYS[SD_SEQ_READ_MBPS]);
+  }
+
+  Serial.println("Self-test:");
+  for (uint8_t m = 0; m < METRIC_COUNT; ++m) {
+    if (!r.measured[m]) {
+      Serial.printf("  %-15s skipped\n", METRIC_NAMES[m]);
+      continue;
+    }
+    r.baseline[m] = s_prefs.getFloat(NVS_KEYS[m], 0.0f);
+    if (r.baseline[m] <= 0.0f) {
+      s_prefs.putFloat(NVS_KEYS[m], r.value[m]);  // first run becomes the baseline
+    } else {
+      const float ratio = HIGHER_IS_BETTER[m] ? r.baseline[m] / r.value[m] : r.value[m] / r.baseline[m];
+      r.regressed[m] = ratio > 1.0f + REGRESSION_PCT / 100.0f;
+    }
+    Serial.printf("  %-15s %8.1f %-4s (baseline %s%.1f)%s\n", METRIC_NAMES[m], r.value[m], METRIC_UNITS[m],
+                  r.baseline[m] > 0 ? "" : "new ", r.baseline[m] > 0 ? r.baseline[m] : r.value[m],
+                  r.regressed[m] ? "  <-- REGRESSION" : "");
+  }
+  s_last = r;
+  s_runs++;
+  return s_last;
+}
+
+const Result& last() { return s_last; }
+uint32_t runCount()   { return s_runs; }
+
+bool anyRegression() {
+  for (bool b : s_last.regressed) if (b) return true;
+  return false;
+}
+
+void describeRegressions(char* buf, size_t len) {
+  if (!len) return;
+  buf[0] = '\0';
+  size_t used = 0;
+  for (uint8_t m = 0; m < METRIC_COUNT && used < len; ++m) {
+    if (!s_last.regressed[m]) continue;
+    used += snprintf(buf + used, len - used, "%s%s %.1f %s (was %.1f)", used ? "\n" : "",
+                     METRIC_NAMES[m], s_last.value[m], METRIC_UNITS[m], s_last.baseline[m]);
+  }
+}
+
+void rebase() {
+  for (uint8_t m = 0; m < METRIC_COUNT; ++m) {
+    if (s_last.measured[m]) s_prefs.putFloat(NVS_KEYS[m], s_last.value[m]);
+    s_last.regressed[m] = false;
+  }
+  s_runs++;
+}
+
+const char* metricName(Metric m) { return m < METRIC_COUNT ? METRIC_NAMES[m] : "?"; }
+
+} // namespace SelfTest
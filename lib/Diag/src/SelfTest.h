@@ -0,0 +1,53 @@
+#pragma once
+#include <Arduino.h>
+#include <kodedot/display_manager.h>
+
+// Quick (~few hundred ms) performance self-test with baselines kept in NVS.
+// Measures PSRAM memcpy bandwidth, full-screen flush time, SD random-read
+// latency and multi-block read speed, and flags results that are more than
+// REGRESSION_PCT worse than the stored baseline. SD baselines belong to one
+// card (by CID serial); a different card starts a fresh SD baseline.
+namespace SelfTest {
+
+  enum Metric : uint8_t {
+    PSRAM_COPY_MBPS = 0,
+    FLUSH_FULL_MS,
+    SD_RANDOM_READ_US,
+    SD_SEQ_READ_MBPS,
+    METRIC_COUNT
+  };
+
+  static constexpr uint8_t REGRESSION_PCT = 20;
+
+  struct Result {
+    bool  measured[METRIC_COUNT];
+    float value[METRIC_COUNT];
+    float baseline[METRIC_COUNT];    // 0 = no baseline yet (this run became it)
+    bool  regressed[METRIC_COUNT];
+  };
+
+  // Register the "selftest" console command.
+  void begin(DisplayManager& display);
+
+  // Whether to run at boot (persisted, default on).
+  bool bootEnabled();
+  void setBootEnabled(bool on);
+
+  // Run all checks. Must be called from LVGL context (setup()/loop()); the
+  // card must not be in use. Results are logged to Serial.
+  const Result& run();
+  const Result& last();
+  bool anyRegression();
+
+  // Incremented after every run, so the UI can notice console-triggered runs.
+  uint32_t runCount();
+
+  // Short human-readable list of regressions for the UI ("" if none).
+  void describeRegressions(char* buf, size_t len);
+
+  // Replace stored baselines with the last results.
+  void rebase();
+
+  const char* metricName(Metric m);
+
+} // namespace SelfTest
@@ -0,0 +1,165 @@
+#include "Trace.h"
+#include "Console.h"
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static constexpr uint32_t MAX_OPEN = 32;   // per-core scope nesting tracked by dump()
+
+struct Event {
+  uint32_t    tsUs;
+  const char* name;
+  uint32_t    arg;
+  uint8_t     phase;
+  uint8_t     core;
+  uint16_t    reserved;
+};
+
+static Event*                s_ring   = nullptr;
+static uint32_t              s_mask   = 0;      // capacity - 1
+static std::atomic<uint32_t> s_head{0};         // total events ever recorded since clear()
+static bool                  s_armed  = false;
+
+namespace Trace { namespace detail { volatile bool active = false; } }
+
+// ---------------- Console ----------------
+static void cmdTrace(Print& out, const char* args) {
+  if (strcmp(args, "start") == 0) {
+    Trace::start();
+    out.println("trace: recording");
+  } else if (strcmp(args, "stop") == 0) {
+    Trace::stop();
+    out.printf("trace: stopped, %u events\n", (unsigned)Trace::eventCount());
+  } else if (strcmp(args, "arm") == 0) {
+    Trace::arm(true);
+    out.println("trace: will record the next mount session");
+  } else if (strcmp(args, "dump") == 0) {
+    Trace::stop();
+    out.println("----- trace begin -----");
+    Trace::dump(out);
+    out.println("----- trace end -----");
+  } else {
+    out.printf("trace: %s, %u events buffered\n",
+               Trace::enabled() ? "recording" : "idle", (unsigned)Trace::eventCount());
+    out.println("usage: trace start|stop|arm|dump");
+  }
+}
+
+namespace Trace {
+
+bool begin(size_t capacityEvents) {
+  if (s_ring) return true;
+
+  size_t cap = 1;
+  while (cap * 2 <= capacityEvents) cap *= 2;
+  s_ring = (Event*)heap_caps_calloc(cap, sizeof(Event), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!s_ring) {
+    Serial.println("Trace: PSRAM ring allocation failed");
+    return false;
+  }
+  s_mask = cap - 1;
+  Console::add("trace", "event timeline: start|stop|arm|dump", cmdTrace);
+  return true;
+}
+
+void clear() {
+  if (!s_ring) return;
+  memset(s_ring, 0, (s_mask + 1) * sizeof(Event));
+  s_head.store(0);
+}
+
+void start() {
+  if (!s_ring) return;
+  detail::active = false;
+  clear();
+  detail::active = true;
+}
+
+void stop() { detail::active = false; }
+
+void arm(bool on) { s_armed = on; }
+
+void sessionBegin() {
+  if (s_armed) start();
+  instant("session.begin");
+}
+
+void sessionEnd() {
+  instant("session.end");
+  if (s_armed) { stop(); s_armed = false; }
+}
+
+void IRAM_ATTR record(const char* name, char phase, uint32_t arg) {
+  if (!s_ring) return;
+  const uint32_t idx = s_head.fetch_add(1, std::memory_order_relaxed) & s_mask;
+  Event& e = s_ring[idx];
+  // name doubles as the "slot complete" flag: clear it while the fields are
+  // rewritten, publish it with release so dump() never sees a stale payload.
+  __atomic_store_n(&e.name, (const char*)nullptr, __ATOMIC_RELAXED);
+  std::atomic_thread_fence(std::memory_order_release);
+  e.tsUs  = (uint32_t)esp_timer_get_time();
+  e.arg   = arg;
+  e.phase = (uint8_t)phase;
+  e.core  = (uint8_t)xPortGetCoreID();
+  __atomic_store_n(&e.name, name, __ATOMIC_RELEASE);
+}
+
+size_t eventCount() {
+  return min<uint32_t>(s_head.load(), s_ring ? s_mask + 1 : 0);
+}
+
+void dump(Print& out) {
+  if (!s_ring) { out.println("{\"traceEvents\":[]}"); return; }
+
+  const uint32_t head  = s_head.load();
+  const uint32_t count = min<uint32_t>(head, s_mask + 1);
+  const uint32_t first = head - count;
+
+  out.println("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  out.print("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"core 0\"}},\n");
+  out.print("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"core 1\"}}");
+
+  // Timestamps are 32-bit microseconds; rebuild a monotonic 64-bit timeline
+  // from signed deltas so a dump spanning a wrap still lines up.
+  int64_t  ts        = 0;
+  uint32_t prev      = 0;
+  bool     haveFirst = false;
+  // Open scopes per core keep the export balanced: an E whose B predates
+  // start() (or was overwritten) is dropped, scopes still open at stop()
+  // are closed at the last timestamp.
+  const char* open[2][MAX_OPEN];
+  uint32_t    depth[2] = { 0, 0 };
+  for (uint32_t i = first; i != head; ++i) {
+    const Event& slot = s_ring[i & s_mask];
+    const char* name = __atomic_load_n(&slot.name, __ATOMIC_ACQUIRE);
+    if (!name) continue;
+    const Event e = slot;
+    const uint32_t core = e.core & 1;
+    if (e.phase == 'E') {
+      if (!depth[core]) continue;
+      depth[core]--;
+    } else if (e.phase == 'B') {
+      if (depth[core] < MAX_OPEN) open[core][depth[core]] = name;
+      depth[core]++;
+    }
+    if (!haveFirst) { prev = e.tsUs; haveFirst = true; }
+    ts  += (int32_t)(e.tsUs - prev);
+    prev = e.tsUs;
+
+    out.printf(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u",
+               name, (char)e.phase, (long long)ts, (unsigned)core);
+    if (e.phase == 'i') out.print(",\"s\":\"g\"");
+    if (e.arg) out.printf(",\"args\":{\"v\":%u}", (unsigned)e.arg);
+    out.print("}");
+  }
+  for (uint32_t core = 0; core < 2; ++core) {
+    while (depth[core]) {
+      depth[core]--;
+      out.printf(",\n{\"name\":\"%s\",\"ph\":\"E\",\"ts\":%lld,\"pid\":1,\"tid\":%u}",
+                 depth[core] < MAX_OPEN ? open[core][depth[core]] : "", (long long)ts, (unsigned)core);
+    }
+  }
+  out.println("\n]}");
+}
+
+} // namespace Trace
@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+// Lightweight begin/end event tracer.
+// Events go into a lock-free ring buffer in PSRAM and are dumped as Chrome
+// trace-format JSON (open in chrome://tracing or ui.perfetto.dev).
+// Recording costs one flag check when tracing is off.
+namespace Trace {
+
+  namespace detail { extern volatile bool active; }
+
+  // Allocate the ring (power of two, rounded down) and register the "trace"
+  // console command. Safe to call once from setup().
+  bool begin(size_t capacityEvents = 65536);
+
+  void start();   // clear and begin recording
+  void stop();
+  void clear();
+  inline bool enabled() { return detail::active; }
+
+  // When armed, recording starts at Storage::mount() and stops at unmount(),
+  // so one trace covers exactly one USB session.
+  void arm(bool on);
+  void sessionBegin();
+  void sessionEnd();
+
+  // name must be a string literal (only the pointer is stored).
+  void record(const char* name, char phase, uint32_t arg = 0);
+  inline void beginEvent(const char* name, uint32_t arg = 0) { if (detail::active) record(name, 'B', arg); }
+  inline void endEvent(const char* name)                     { if (detail::active) record(name, 'E'); }
+  inline void instant(const char* name, uint32_t arg = 0)    { if (detail::active) record(name, 'i', arg); }
+
+  size_t eventCount();
+  void dump(Print& out);
+
+  // RAII helper for TRACE_SCOPE.
+  class Scope {
+  public:
+    explicit Scope(const char* name, uint32_t arg = 0) : _name(name) { beginEvent(name, arg); }
+    ~Scope() { endEvent(_name); }
+  private:
+    const char* _name;
+  };
+
+} // namespace Trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)          Trace::Scope TRACE_CONCAT(_trace_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, arg) Trace::Scope TRACE_CONCAT(_trace_, __LINE__)(name, (uint32_t)(arg))
@@ -0,0 +1,120 @@
+#include "SdCard.h"
+#include "Storage.h"
+#include <SD_MMC.h>
+#include <driver/sdmmc_host.h>
+#include <esp_heap_caps.h>
+#include <kodedot/pin_config.h>
+#include <Trace.h>
+
+static sdmmc_card_t  s_card;
+static volatile bool s_open = false;
+static volatile bool s_fs   = false;   // opened through SD_MMC rather than the raw host
+
+namespace SdCard {
+
+bool begin() {
+  if (s_open || Storage::isMounted()) return false;
+
+  sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+  host.slot         = SD_SDMMC_HOST;
+  host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+
+  sdmmc_slot_config_t slot = SDMMC_SLOT_CONFIG_DEFAULT();
+  slot.width = 1;
+  slot.clk   = (gpio_num_t)SD_PIN_CLK;
+  slot.cmd   = (gpio_num_t)SD_PIN_CMD;
+  slot.d0    = (gpio_num_t)SD_PIN_D0;
+  slot.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+
+  if (sdmmc_host_init() != ESP_OK) return false;
+  if (sdmmc_host_init_slot(host.slot, &slot) != ESP_OK) {
+    sdmmc_host_deinit();
+    return false;
+  }
+
+  // Some cards/wiring don't hold 40 MHz on one data line; retry at default speed.
+  if (sdmmc_card_init(&host, &s_card) != ESP_OK) {
+    host.max_freq_khz = SDMMC_FREQ_DEFAULT;
+    if (sdmmc_card_init(&host, &s_card) != ESP_OK) {
+      sdmmc_host_deinit();
+      return false;
+    }
+  }
+  if (s_card.csd.sector_size != SECTOR_SIZE) {
+    sdmmc_host_deinit();
+    return false;
+  }
+
+  s_open = true;
+  return true;
+}
+
+void end() {
+  if (!s_open || s_fs) return;
+  sdmmc_host_deinit();
+  s_open = false;
+}
+
+bool isOpen() { return s_open; }
+
+bool beginFs() {
+  if (s_open || Storage::isMounted()) return false;
+  SD_MMC.setPins(SD_PIN_CLK, SD_PIN_CMD, SD_PIN_D0);
+  if (!SD_MMC.begin(FS_ROOT, /*1-bit*/ true)) return false;
+  if (SD_MMC.cardType() == CARD_NONE) {
+    SD_MMC.end();
+    return false;
+  }
+  s_fs   = true;
+  s_open = true;
+  return true;
+}
+
+void endFs() {
+  if (!s_open || !s_fs) return;
+  SD_MMC.end();
+  s_fs   = false;
+  s_open = false;
+}
+
+bool isFsOpen() { return s_fs; }
+
+uint32_t sectorCount() {
+  if (!s_open) return 0;
+  return s_fs ? (uint32_t)SD_MMC.numSectors() : (uint32_t)s_card.csd.capacity;
+}
+
+const sdmmc_card_t* card() { return s_open && !s_fs ? &s_card : nullptr; }
+
+bool read(void* dst, uint32_t lba, uint32_t count) {
+  if (!s_open || s_fs || !count) return false;
+  TRACE_SCOPE_ARG("sd.read_multi", count);
+  return sdmmc_read_sectors(&s_card, dst, lba, count) == ESP_OK;
+}
+
+bool write(const void* src, uint32_t lba, uint32_t count) {
+  if (!s_open || s_fs || !count) return false;
+  TRACE_SCOPE_ARG("sd.write_multi", count);
+  return sdmmc_write_sectors(&s_card, src, lba, count) == ESP_OK;
+}
+
+bool erase(uint32_t lba, uint32_t count) {
+  if (!s_open || s_fs || !count) return false;
+  TRACE_SCOPE_ARG("sd.erase", count);
+  return sdmmc_erase_sectors(&s_card, lba, count, SDMMC_ERASE_ARG) == ESP_OK;
+}
+
+uint8_t erasedByte() { return s_card.scr.erase_mem_state ? 0xFF : 0x00; }
+
+uint32_t allocUnitSectors() {
+  if (!s_open || s_fs) return 0;
+  return s_card.ssr.alloc_unit_kb * 2;
+}
+
+void* allocBuffer(size_t bytes) {
+  void* p = heap_caps_aligned_alloc(4, bytes, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+  if (!p) p = heap_caps_aligned_alloc(64, bytes, MALLOC_CAP_SPIRAM);
+  return p;
+}
+
+} // namespace SdCard
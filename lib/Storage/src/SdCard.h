@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+#include <sdmmc_cmd.h>
+
+// Raw block access to the SD card for on-device tools (benchmarks, scans,
+// formatting). Drives the SDMMC host directly, without FATFS or SD_MMC, and
+// moves many sectors per command. Mutually exclusive with Storage::mount()
+// and with SD_MMC.begin(): callers must check isOpen() before touching SD_MMC.
+namespace SdCard {
+
+  static constexpr uint32_t SECTOR_SIZE = 512;
+  static constexpr const char* FS_ROOT  = "/sdcard";
+  // FatFs drive of the beginFs() mount, for f_* calls the VFS has no
+  // equivalent of; SD_MMC itself assumes drive 0 (totalBytes()).
+  static constexpr const char* FS_DRIVE = "0:";
+
+  // Initialize host + card (1-bit, board pins). Returns false if the card is
+  // missing, already mounted over USB, or already open.
+  bool begin();
+  void end();
+  bool isOpen();
+
+  // File-level access for tools: mounts the card through SD_MMC at FS_ROOT
+  // (use POSIX/stdio calls under it). Same exclusivity as begin(); isOpen()
+  // is true while mounted, raw read()/write() are refused.
+  bool beginFs();
+  void endFs();
+  bool isFsOpen();
+
+  uint32_t sectorCount();
+  const sdmmc_card_t* card();
+
+  // Multi-block transfers. Buffers in internal DMA-capable RAM avoid the
+  // driver's per-sector bounce copy; PSRAM works but is slower.
+  bool read(void* dst, uint32_t lba, uint32_t count);
+  bool write(const void* src, uint32_t lba, uint32_t count);
+
+  // SD ERASE (CMD32/33/38) of a sector range; the card erases whole flash
+  // blocks internally, much faster than writing. False if unsupported.
+  // Erased sectors read back as erasedByte() (0x00 or 0xFF, from the SCR).
+  bool    erase(uint32_t lba, uint32_t count);
+  uint8_t erasedByte();
+
+  // Allocation unit from the SD Status register, in sectors (0 if unknown).
+  uint32_t allocUnitSectors();
+
+  // DMA-capable internal buffer helper (falls back to PSRAM if internal is short).
+  void* allocBuffer(size_t bytes);
+
+} // namespace SdCard
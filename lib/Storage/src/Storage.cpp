@@ -1,4 +1,9 @@
 #include "Storage.h"
+#include "SdCard.h"
+#include <Console.h>
+#include <Energy.h>
+#include <Trace.h>
+#include <esp_heap_caps.h>
 
 // ---- Your SD pin map (1-bit) ----
 static constexpr int PIN_SD_CLK = 6;  // CLK
@@ -9,19 +14,192 @@ static USBMSC s_msc;
 static bool   s_mounted   = false;   // our own truth for “presented as drive”
 static bool   s_usbOnline = false;   // driven by USB.onEvent()
 
+static constexpr uint32_t SECTOR_SIZE = 512;  // SD_MMC raw I/O is fixed at 512-byte sectors
+
+static Storage::Stats       s_stats      = {};
+static Storage::WriteCache  s_cacheMode  = Storage::WriteCache::Off;
+static SemaphoreHandle_t    s_ioLock     = nullptr;  // serializes MSC callbacks vs poll()/flush
+
+// Areas the host wrote this session: one bit per 2^s_writtenShift sectors,
+// in PSRAM. Kept after unmount() for tools that diff the card against what
+// they read before the session; cleared by the next mount().
+static constexpr uint32_t   WRITTEN_BITS   = 1u << 20;   // 128 KB at most
+static uint32_t*            s_written      = nullptr;
+static uint32_t             s_writtenWords = 0;
+static uint8_t              s_writtenShift = 0;
+
+static void markWritten(uint32_t blk) {
+  const uint32_t g = blk >> s_writtenShift;
+  if (g / 32 < s_writtenWords) s_written[g / 32] |= 1u << (g % 32);
+}
+
+static void resetWritten(uint32_t secCount) {
+  uint8_t shift = 0;
+  while ((secCount >> shift) >= WRITTEN_BITS) shift++;
+  const uint32_t words = ((secCount >> shift) + 32) / 32;
+  if (words != s_writtenWords) {
+    heap_caps_free(s_written);
+    s_written      = (uint32_t*)heap_caps_malloc(words * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    s_writtenWords = s_written ? words : 0;
+  }
+  if (s_written) memset(s_written, 0, s_writtenWords * sizeof(uint32_t));
+  s_writtenShift = shift;
+}
+
+// ---------------- SD primitives (traced + accounted) ----------------
+static bool sdRead(uint8_t* dst, uint32_t blk) {
+  Trace::beginEvent("sd.read", blk);
+  const bool ok = SD_MMC.readRAW(dst, blk);
+  Trace::endEvent("sd.read");
+  if (ok) s_stats.sdBytesRead += SECTOR_SIZE;
+  return ok;
+}
+
+static bool sdWrite(uint8_t* src, uint32_t blk) {
+  Trace::beginEvent("sd.write", blk);
+  const bool ok = SD_MMC.writeRAW(src, blk);
+  Trace::endEvent("sd.write");
+  markWritten(blk);   // failed writes may still have changed the card
+  if (ok) s_stats.sdBytesWritten += SECTOR_SIZE;
+  return ok;
+}
+
+// ---------------- Partial-sector write cache ----------------
+// Hosts occasionally write less than a sector at a time. Instead of a card
+// read-modify-write per fragment, fragments are merged in RAM; a slot whose
+// bytes all get written goes to the card as a plain sector write, anything
+// left incomplete is RMW'd once when it is evicted, idle, or at unmount.
+// Cached data is NOT on the card until flushed; unmount() always flushes.
+static constexpr size_t   CACHE_SLOTS         = 8;
+static constexpr uint32_t CACHE_IDLE_FLUSH_MS = 250;
+
+struct CacheSlot {
+  bool     used;
+  uint32_t lba;
+  uint32_t touchedMs;
+  uint32_t valid[SECTOR_SIZE / 32];  // one bit per byte
+  uint8_t  data[SECTOR_SIZE];
+};
+
+static CacheSlot s_cache[CACHE_SLOTS];
+
+static void markValid(CacheSlot& s, uint32_t off, uint32_t len) {
+  for (uint32_t i = off; i < off + len; ++i) s.valid[i >> 5] |= 1u << (i & 31);
+}
+
+static bool slotComplete(const CacheSlot& s) {
+  for (uint32_t w : s.valid) if (w != 0xFFFFFFFFu) return false;
+  return true;
+}
+
+static CacheSlot* findSlot(uint32_t lba) {
+  for (auto& s : s_cache) if (s.used && s.lba == lba) return &s;
+  return nullptr;
+}
+
+// Read-modify-write one sector on the card, replacing [off, off+len) with src.
+// Bytes of the sector still pending in the write cache are older than src:
+// they are merged in and the slot dropped.
+static bool sdReadModifyWrite(uint32_t blk, const uint8_t* src, uint32_t off, uint32_t len) {
+  uint8_t tmp[SECTOR_SIZE];
+  Trace::beginEvent("sd.rmw_read", blk);
+  const bool ok = sdRead(tmp, blk);
+  Trace::endEvent("sd.rmw_read");
+  if (!ok) return false;
+  s_stats.rmwReads++;
+  if (CacheSlot* slot = findSlot(blk)) {
+    for (uint32_t i = 0; i < SECTOR_SIZE; ++i) {
+      if (slot->valid[i >> 5] & (1u << (i & 31))) tmp[i] = slot->data[i];
+    }
+    slot->used = false;
+  }
+  memcpy(tmp + off, src, len);
+  if (!sdWrite(tmp, blk)) return false;
+  s_stats.rmwSectors++;
+  return true;
+}
+
+// On failure the slot keeps its bytes (idle flush retries; the host reads
+// them back through the overlay meanwhile).
+static bool flushSlot(CacheSlot& s) {
+  if (!s.used) return true;
+  bool ok;
+  if (slotComplete(s)) {
+    ok = sdWrite(s.data, s.lba);
+  } else {
+    uint8_t tmp[SECTOR_SIZE];
+    Trace::beginEvent("sd.rmw_read", s.lba);
+    ok = sdRead(tmp, s.lba);
+    Trace::endEvent("sd.rmw_read");
+    if (ok) {
+      s_stats.rmwReads++;
+      for (uint32_t i = 0; i < SECTOR_SIZE; ++i) {
+        if (s.valid[i >> 5] & (1u << (i & 31))) tmp[i] = s.data[i];
+      }
+      ok = sdWrite(tmp, s.lba);
+      if (ok) s_stats.rmwSectors++;
+    }
+  }
+  if (ok) s.used = false;
+  return ok;
+}
+
+static bool flushAll() {
+  bool ok = true;
+  for (auto& s : s_cache) ok &= flushSlot(s);
+  return ok;
+}
+
+static bool cacheWritePartial(uint32_t blk, const uint8_t* src, uint32_t off, uint32_t len) {
+  CacheSlot* slot = findSlot(blk);
+  if (!slot) {
+    // Take a free slot, else evict the least recently touched one.
+    CacheSlot* victim = &s_cache[0];
+    for (auto& s : s_cache) {
+      if (!s.used) { victim = &s; break; }
+      if (s.touchedMs < victim->touchedMs) victim = &s;
+    }
+    // The victim's bytes can't be written: keep them, and this chunk
+    // goes straight to the card instead
+    if (!flushSlot(*victim)) return sdReadModifyWrite(blk, src, off, len);
+    slot = victim;
+    memset(slot->valid, 0, sizeof(slot->valid));
+    slot->used = true;
+    slot->lba  = blk;
+  }
+  memcpy(slot->data + off, src, len);
+  markValid(*slot, off, len);
+  slot->touchedMs = millis();
+  s_stats.cacheMerges++;
+
+  if (slotComplete(*slot)) return flushSlot(*slot);  // fully rewritten: no RMW needed
+  return true;
+}
+
 // ---------------- MSC callbacks ----------------
 static int32_t onRead(uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize) {
+  TRACE_SCOPE_ARG("msc.read", bufsize);
   const uint32_t sec = SD_MMC.sectorSize();
-  if (!sec || !bufsize) return -1;
+  if (sec != SECTOR_SIZE || !bufsize) return -1;
 
   uint8_t* dst   = static_cast<uint8_t*>(buffer);
   uint32_t remain = bufsize;
   uint32_t blk    = lba;
   uint32_t off    = offset;
 
+  if (s_ioLock) xSemaphoreTake(s_ioLock, portMAX_DELAY);
   while (remain) {
-    uint8_t tmp[512];
-    if (!SD_MMC.readRAW(tmp, blk)) return -1;
+    uint8_t tmp[SECTOR_SIZE];
+    if (!sdRead(tmp, blk)) {
+      if (s_ioLock) xSemaphoreGive(s_ioLock);
+      return -1;
+    }
+    // Overlay bytes still pending in the write cache.
+    if (const CacheSlot* slot = findSlot(blk)) {
+      for (uint32_t i = 0; i < SECTOR_SIZE; ++i) {
+        if (slot->valid[i >> 5] & (1u << (i & 31))) tmp[i] = slot->data[i];
+      }
+    }
 
     uint32_t chunk = min(remain, sec - off);
     memcpy(dst, tmp + off, chunk);
@@ -31,32 +209,44 @@ static int32_t onRead(uint32_t lba, uint32_t offset, void *buffer, uint32_t bufs
     off     = 0;
     blk    += 1;
   }
+  if (s_ioLock) xSemaphoreGive(s_ioLock);
+  s_stats.hostBytesRead += bufsize;
   return (int32_t)bufsize;
 }
 
 static int32_t onWrite(uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
+  TRACE_SCOPE_ARG("msc.write", bufsize);
   const uint32_t sec = SD_MMC.sectorSize();
-  if (!sec || !bufsize) return -1;
+  if (sec != SECTOR_SIZE || !bufsize) return -1;
 
   uint8_t* src   = buffer;
   uint32_t remain = bufsize;
   uint32_t blk    = lba;
   uint32_t off    = offset;
+  const bool cached = s_stats.writeCache == Storage::WriteCache::Partial;   // mode of this session
 
-  while (remain) {
-    uint8_t tmp[512];
-    if (off != 0 || remain < sec) {
-      if (!SD_MMC.readRAW(tmp, blk)) return -1;  // read-modify-write for partials
-    }
+  if (s_ioLock) xSemaphoreTake(s_ioLock, portMAX_DELAY);
+  bool ok = true;
+  while (remain && ok) {
     uint32_t chunk = min(remain, sec - off);
-    memcpy(tmp + off, src, chunk);
-    if (!SD_MMC.writeRAW(tmp, blk)) return -1;
+    if (chunk < sec) {
+      s_stats.partialWrites++;
+      ok = cached ? cacheWritePartial(blk, src, off, chunk)
+                  : sdReadModifyWrite(blk, src, off, chunk);
+    } else {
+      // A whole-sector write supersedes anything pending for that sector.
+      if (CacheSlot* slot = findSlot(blk)) slot->used = false;
+      ok = sdWrite(src, blk);
+    }
 
     src    += chunk;
     remain -= chunk;
     off     = 0;
     blk    += 1;
   }
+  if (s_ioLock) xSemaphoreGive(s_ioLock);
+  if (!ok) return -1;
+  s_stats.hostBytesWritten += bufsize;
   return (int32_t)bufsize;
 }
 
@@ -68,6 +258,20 @@ static bool onStartStop(uint8_t /*power_condition*/, bool start, bool load_eject
   return true;
 }
 
+// ---------------- Console ----------------
+static void cmdMsc(Print& out, const char* args) {
+  if (strcmp(args, "cache partial") == 0) {
+    Storage::setWriteCache(Storage::WriteCache::Partial);
+    out.println("msc: partial-sector write cache on (next mount)");
+  } else if (strcmp(args, "cache off") == 0) {
+    Storage::setWriteCache(Storage::WriteCache::Off);
+    out.println("msc: write cache off (next mount)");
+  } else {
+    Storage::printStats(out);
+    out.println("usage: msc [cache partial|cache off]");
+  }
+}
+
 // ---------------- USB event wiring ----------------
 static void usbEventCallback(void*, esp_event_base_t base, int32_t id, void* event_data) {
   if (base != ARDUINO_USB_EVENTS) return;
@@ -89,10 +293,12 @@ void attachUsbEvents() {
   // This tracks the TinyUSB device state (MSC/CDC/HID) and is robust across unmounts.  // docs show event list
   USB.onEvent(usbEventCallback);  // ARDUINO_USB_* events. 
   // (You still call USB.begin() when you actually want to enumerate your device.)
+  Console::add("msc", "USB session I/O stats, write cache mode", cmdMsc);
 }
 
 bool mount() {
   if (s_mounted) return true;
+  if (SdCard::isOpen()) return false;   // a raw-card tool owns the SDMMC host
 
   // 1) Mount SD in 1-bit mode with your custom pins
   SD_MMC.setPins(PIN_SD_CLK, PIN_SD_CMD, PIN_SD_D0);
@@ -104,7 +310,13 @@ bool mount() {
     return false;
   }
 
-  // 2) Configure MSC and present media
+  // 2) Fresh per-session accounting and an empty write cache
+  if (!s_ioLock) s_ioLock = xSemaphoreCreateMutex();
+  s_stats = {};
+  s_stats.writeCache = s_cacheMode;
+  memset(s_cache, 0, sizeof(s_cache));
+
+  // 3) Configure MSC and present media
   s_msc.vendorID("ESP32");
   s_msc.productID("SD-USB");
   s_msc.productRevision("1.0");
@@ -119,30 +331,39 @@ bool mount() {
     return false;
   }
 
+  resetWritten(secCount);
   s_msc.mediaPresent(true);
   if (!s_msc.begin(secCount, secSize)) {   // start MSC class
     SD_MMC.end();
     return false;
   }
 
-  // 3) Start the USB device stack (enumeration); safe to call more than once
+  // 4) Start the USB device stack (enumeration); safe to call more than once
   USB.begin();   // API docs: common USB begin/start; events fire via onEvent
   s_mounted = true;
+  Trace::sessionBegin();
+  Energy::beginActivity("msc");
   return true;
 }
 
 void unmount() {
   if (!s_mounted) return;
+  Trace::sessionEnd();
 
   // Tell the host the drive is going away, then stop MSC and free the SD bus.
   // These APIs are the officially documented way to remove MSC. 
   s_msc.mediaPresent(false);     // signal “no media” to host first
   delay(50);                     // short debounce window for host to close handles
+  xSemaphoreTake(s_ioLock, portMAX_DELAY);
+  if (!flushAll()) Serial.println("Storage: write cache flush failed");
+  xSemaphoreGive(s_ioLock);
   s_msc.end();                   // release MSC class resources
   delay(10);
   SD_MMC.end();                  // release SDMMC bus/pins
 
   s_mounted = false;
+  Energy::endActivity("msc", s_stats.hostBytesRead, s_stats.hostBytesWritten);
+  printStats(Serial);
 
   // NOTE: We intentionally DO NOT call any “USB end” here.
   // Arduino-ESP32 documents MSC::end() but USB has only begin()+events;
@@ -152,4 +373,47 @@ void unmount() {
 bool isMounted()   { return s_mounted; }
 bool isUsbOnline() { return s_usbOnline; }
 
+void poll() {
+  if (!s_mounted || s_stats.writeCache != WriteCache::Partial) return;
+  if (xSemaphoreTake(s_ioLock, 0) != pdTRUE) return;  // USB task is busy; try next loop
+  const uint32_t now = millis();
+  for (auto& slot : s_cache) {
+    if (slot.used && now - slot.touchedMs >= CACHE_IDLE_FLUSH_MS) flushSlot(slot);
+  }
+  xSemaphoreGive(s_ioLock);
+}
+
+Stats stats() { return s_stats; }
+
+bool written(uint32_t lba, uint32_t count) {
+  if (!s_written) return true;
+  if (!count) return false;
+  const uint32_t last = (lba + count - 1) >> s_writtenShift;
+  for (uint32_t g = lba >> s_writtenShift; g <= last; ++g) {
+    if (g / 32 >= s_writtenWords || (s_written[g / 32] >> (g % 32) & 1)) return true;
+  }
+  return false;
+}
+
+float writeAmplification() {
+  if (!s_stats.hostBytesWritten) return 0.0f;
+  return (float)s_stats.sdBytesWritten / (float)s_stats.hostBytesWritten;
+}
+
+void setWriteCache(WriteCache mode) { s_cacheMode = mode; }
+WriteCache writeCache()             { return s_cacheMode; }
+
+void printStats(Print& out) {
+  const Stats s = s_stats;
+  out.printf("MSC session (%s cache): host read %llu B, wrote %llu B\n",
+             s.writeCache == WriteCache::Partial ? "partial" : "no",
+             (unsigned long long)s.hostBytesRead, (unsigned long long)s.hostBytesWritten);
+  out.printf("  card read %llu B, wrote %llu B, write amplification %.2fx\n",
+             (unsigned long long)s.sdBytesRead, (unsigned long long)s.sdBytesWritten,
+             writeAmplification());
+  out.printf("  partial-sector writes %u, RMW reads %u, RMW sectors %u, merged in RAM %u\n",
+             (unsigned)s.partialWrites, (unsigned)s.rmwReads, (unsigned)s.rmwSectors,
+             (unsigned)s.cacheMerges);
+}
+
 } // namespace Storage
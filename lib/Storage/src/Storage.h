@@ -22,4 +22,35 @@ namespace Storage {
   bool isMounted();            // true after successful mount() and before unmount()
   bool isUsbOnline();          // reflects USB STARTED/RESUME vs STOPPED/SUSPEND (from events)
 
+  // Housekeeping (flushes idle write-cache sectors). Call from loop().
+  void poll();
+
+  // How host writes smaller than a sector reach the card:
+  //  Off     - read-modify-write the card sector for every fragment
+  //  Partial - merge fragments in RAM, write once (RMW only if never completed)
+  // Takes effect on the next mount().
+  enum class WriteCache : uint8_t { Off, Partial };
+  void       setWriteCache(WriteCache mode);
+  WriteCache writeCache();
+
+  // Per-session I/O accounting, reset by mount().
+  struct Stats {
+    uint64_t   hostBytesRead;
+    uint64_t   hostBytesWritten;
+    uint64_t   sdBytesRead;      // includes RMW reads
+    uint64_t   sdBytesWritten;
+    uint32_t   partialWrites;    // host chunks smaller than a sector
+    uint32_t   rmwReads;         // card reads done to complete a partial sector
+    uint32_t   rmwSectors;       // sectors written back after such a read
+    uint32_t   cacheMerges;      // partial chunks absorbed by the write cache
+    WriteCache writeCache;       // mode the session ran with
+  };
+  Stats stats();
+  // Whether the host may have written any of sectors [lba, lba + count) in
+  // the last session (coarse: 1 MB areas on a 512 GB card). Kept after
+  // unmount() until the next mount(); true when not tracked.
+  bool  written(uint32_t lba, uint32_t count);
+  float writeAmplification();  // card bytes written / host bytes written (0 if none)
+  void  printStats(Print& out);
+
 } // namespace Storage
@@ -16,6 +16,21 @@
  * - Provide simple helpers for brightness and touch reading
  */
 class DisplayManager {
+public:
+    /**
+     * @brief Cumulative panel flush statistics since init().
+     */
+    struct FlushStats {
+        uint32_t flushes;   // flush callbacks
+        uint64_t pixels;    // pixels pushed to the panel (2 bytes each, read from the draw buffer)
+        uint64_t busyUs;    // time spent inside the flush callback
+    };
+
+    // Optional instrumentation observers, called from LVGL context.
+    using TouchHook = void (*)(lv_indev_data_t *data);  // sees (and may override) each touch read
+    using FlushHook = void (*)(const lv_area_t *area);  // called once an area has reached the panel
+    using TraceHook = void (*)(const char *name, char phase, uint32_t arg);  // 'B'/'E' around timer and flush work
+
 private:
     // Hardware interfaces
     Arduino_DataBus *bus;
@@ -27,6 +42,10 @@ private:
     lv_color_t *buf;
     lv_color_t *buf2;
     uint32_t last_tick_ms;
+    FlushStats flush_stats;
+    TouchHook touch_hook;
+    FlushHook flush_hook;
+    TraceHook trace_hook;
     
     // Static callbacks required by LVGL v9
     static void disp_flush_callback(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
@@ -73,6 +92,18 @@ public:
      * @return true if there is an active touch
      */
     bool getTouchCoordinates(int16_t &x, int16_t &y);
+
+    /**
+     * @brief Snapshot of flush counters (for bandwidth/latency measurements).
+     */
+    FlushStats getFlushStats() const { return flush_stats; }
+
+    /**
+     * @brief Install touch/flush/trace observers (pass nullptr to remove).
+     */
+    void setTouchHook(TouchHook hook) { touch_hook = hook; }
+    void setFlushHook(FlushHook hook) { flush_hook = hook; }
+    void setTraceHook(TraceHook hook) { trace_hook = hook; }
 };
 
 
@@ -70,6 +70,7 @@
 /* ---------- Sensors ---------- */
 #define MAX17048_I2C_ADDRESS  0x36
 #define BQ25896_I2C_ADDRESS   0x6A
+#define BQ27220_I2C_ADDRESS   0x55   // Fuel gauge
 
 /* ---------- IO Expander pin map ---------- */
 // These defines require including <TCA9555.h> in the source file that uses them
@@ -43,7 +43,7 @@ static void display_rounder_event_cb(lv_event_t *e) {
     }
 }
 
-DisplayManager::DisplayManager() : bus(nullptr), gfx(nullptr), display(nullptr), buf(nullptr), buf2(nullptr), last_tick_ms(0) {
+DisplayManager::DisplayManager() : bus(nullptr), gfx(nullptr), display(nullptr), buf(nullptr), buf2(nullptr), last_tick_ms(0), flush_stats{}, touch_hook(nullptr), flush_hook(nullptr), trace_hook(nullptr) {
     instance = this;
 }
 
@@ -169,7 +169,9 @@ void DisplayManager::update() {
     uint32_t delta = now - last_tick_ms;
     last_tick_ms = now;
     lv_tick_inc(delta);
+    if (trace_hook) trace_hook("lv.timer", 'B', 0);
     lv_timer_handler();
+    if (trace_hook) trace_hook("lv.timer", 'E', 0);
 }
 
 void DisplayManager::setBrightness(uint8_t brightness) {
@@ -198,12 +200,20 @@ void DisplayManager::disp_flush_callback(lv_display_t *disp, const lv_area_t *ar
     
     uint32_t w = (area->x2 - area->x1 + 1);
     uint32_t h = (area->y2 - area->y1 + 1);
+    if (instance->trace_hook) instance->trace_hook("lv.flush", 'B', w * h);
+    uint32_t t0 = micros();
 
     instance->gfx->startWrite();
     instance->gfx->writeAddrWindow(area->x1, area->y1, w, h);
     instance->gfx->writePixels((uint16_t *)px_map, w * h);
     instance->gfx->endWrite();
 
+    instance->flush_stats.flushes++;
+    instance->flush_stats.pixels += (uint64_t)w * h;
+    instance->flush_stats.busyUs += micros() - t0;
+    if (instance->flush_hook) instance->flush_hook(area);
+    if (instance->trace_hook) instance->trace_hook("lv.flush", 'E', 0);
+
     lv_display_flush_ready(disp);
 }
 
@@ -219,6 +229,7 @@ void DisplayManager::touchpad_read_callback(lv_indev_t *indev, lv_indev_data_t *
     } else {
         data->state = LV_INDEV_STATE_RELEASED;
     }
+    if (instance->touch_hook) instance->touch_hook(data);
 }
 
 
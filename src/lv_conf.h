@@ -65,6 +65,7 @@
 #define LV_FONT_MONTSERRAT_42    1
 #define LV_FONT_MONTSERRAT_46    1
 #define LV_FONT_MONTSERRAT_48    1
+#define LV_FONT_UNSCII_16        1   /* monospace, file viewer */
 
 /* Others */
 #define LV_USE_PERF_MONITOR     0
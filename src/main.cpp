@@ -12,20 +12,37 @@
 #include <driver/usb_serial_jtag.h>
 #include <Storage.h>
 #include <Adafruit_NeoPixel.h>
+#include <CardJob.h>
+#include <Console.h>
+#include <Defrag.h>
+#include <DeletedScan.h>
+#include <DupScan.h>
+#include <Energy.h>
+#include <FakeCheck.h>
+#include <FragScan.h>
+#include <FsCheck.h>
+#include <HashJob.h>
+#include <HeapMonitor.h>
+#include <InputLatency.h>
+#include <MountDiff.h>
+#include <NameIndex.h>
+#include <Profiler.h>
+#include <PsramBench.h>
+#include <QuickFormat.h>
+#include <SdCard.h>
+#include <SecureErase.h>
+#include <SelfTest.h>
+#include <SpaceMap.h>
+#include <SpaceTree.h>
+#include <SurfaceScan.h>
+#include <Trace.h>
+#include "screens/screens.h"
 
 // ───────── Visuals ─────────
-#define COLOR_GREY_BTN   0x666666
-#define COLOR_GREY_TEXT  0xAAAAAA
-#define COLOR_ORANGE     0xFF7F1F
-#define COLOR_GREEN      0x4CAF50
-#define COLOR_WHITE      0xFFFFFF
-#define COLOR_RED        0xFF6B6B
-#define COLOR_PURE_GREEN 0x00FF00  // Pure green for NeoPixel
+// Palette lives in screens/screens.h, shared with the secondary screens
 
 // Include Inter fonts and logo
 extern const lv_font_t Inter_50;
-extern const lv_font_t Inter_30;
-extern const lv_font_t Inter_20;
 extern const lv_image_dsc_t logotipo;
 
 // Display manager
@@ -42,6 +59,7 @@ struct SDCardInfo {
     int folderCount = 0;
     int rootFileCount = 0;
     int totalFileCount = 0;
+    uint64_t scannedBytes = 0;   // directory entries read by the scan
 };
 
 // ───────── UI ─────────
@@ -51,9 +69,11 @@ lv_obj_t *storage_label;
 lv_obj_t *folders_label;
 lv_obj_t *root_files_label;
 lv_obj_t *total_files_label;
+lv_obj_t *selftest_label;
 
 lv_obj_t *mount_btn;
 lv_obj_t *mount_btn_label;
+lv_obj_t *tools_btn;
 
 // ───────── USB Detection ─────────
 bool usb_connected = false;
@@ -63,6 +83,7 @@ bool usb_was_ever_mounted = false;
 
 // ───────── Mount State ─────────
 bool sd_card_mounted = false;
+bool mount_pending = false;   // USB drive presented once the pre-mount snapshot is done
 
 // ───────── Function declarations ─────────
 void createSDCardScreen();
@@ -70,6 +91,7 @@ void refreshSDCardInfo();
 SDCardInfo getSDCardInfo();
 void countFilesAndFolders(const char* path, SDCardInfo& info, bool isRoot = false);
 String formatBytes(uint64_t bytes);
+void updateSelfTestLabel();
 
 void updateMountButtonState();
 bool isUSBConnected();
@@ -99,11 +121,52 @@ bool isUSBConnected() {
     return usb_serial_jtag_is_connected();
 }
 
+// LVGL timer and flush spans from the BSP, recorded only while tracing
+static void traceDisplay(const char* name, char phase, uint32_t arg) {
+    if (Trace::enabled()) Trace::record(name, phase, arg);
+}
+
+// Present the card to the host; if that fails, go back to the unmounted
+// state and say so
+static void presentDrive() {
+    if (Storage::mount()) {
+        return;
+    }
+    Serial.println("Error: SD card mount failed");
+    sd_card_mounted = false;
+    usb_was_connected_before_mount = false;
+    refreshSDCardInfo();
+    updateMountButtonState();
+    lv_obj_t *box = lv_msgbox_create(nullptr);
+    lv_msgbox_add_title(box, "Mount failed");
+    lv_msgbox_add_text(box, "The card could not be presented to the computer.");
+    lv_msgbox_add_close_button(box);
+}
+
 
 // ───────── Setup/loop ─────────
 void setup() {
     Serial.begin(115200);
     Serial.println("SD Card Info Display with USB Detection starting...");
+    HeapMon::begin();
+    Trace::begin();
+    Profiler::begin();
+    Storage::attachUsbEvents();
+    CardJob::begin();
+    HashJob::begin();
+    SurfaceScan::begin();
+    FakeCheck::begin();
+    SecureErase::begin();
+    QuickFormat::begin();
+    FsCheck::begin();
+    DeletedScan::begin();
+    FragScan::begin();
+    DupScan::begin();
+    Defrag::begin();
+    SpaceMap::begin();
+    SpaceTree::begin();
+    NameIndex::begin();
+    MountDiff::begin();
     
     // Initialize NeoPixel
     pixels = new Adafruit_NeoPixel(NEO_PIXEL_COUNT, NEO_PIXEL_PIN, NEO_GRB + NEO_KHZ800);
@@ -115,13 +178,27 @@ void setup() {
         Serial.println("Error: Failed to initialize display");
         while (1) { delay(1000); }
     }
+    display.setTraceHook(traceDisplay);
+    PsramBench::begin(display);
+    Energy::begin();
+    SelfTest::begin(display);
     
     createSDCardScreen();
+    InputLatency::begin(display, mount_btn);
+    if (SelfTest::bootEnabled()) {
+        SelfTest::run();
+    }
+    updateSelfTestLabel();
     Serial.println("SD Card screen ready!");
 }
 
 void loop() {
     display.update();
+    Console::poll(Serial);
+    HeapMon::poll();
+    Storage::poll();
+    PsramBench::pollUi();
+    updateSelfTestLabel();
     const unsigned long now = millis();
     
     // Check USB connection status
@@ -146,7 +223,16 @@ void loop() {
         lastUSBCheckTime = now;
     }
     
-    if (now - lastRefreshTime >= REFRESH_INTERVAL) {
+    // Present the card once the folders have been read (or that failed)
+    if (mount_pending && !CardJob::busy()) {
+        mount_pending = false;
+        if (sd_card_mounted) {
+            presentDrive();
+        }
+    }
+
+    // Latency harness "scan" load: rescan back-to-back like a busy card would
+    if (now - lastRefreshTime >= REFRESH_INTERVAL || InputLatency::scanLoadActive()) {
         refreshSDCardInfo();
         lastRefreshTime = now;
     }
@@ -161,6 +247,11 @@ static void mount_btn_event_handler(lv_event_t * e) {
     if (usb_connected && !sd_card_mounted) {
         // USB is connected - Mount SD Card action
         Serial.println("Mount SD Card button pressed");
+        if (CardJob::busy()) {
+            // A card tool owns the card; its job screen has a Cancel button
+            Serial.println("Card tool running - cannot mount SD card");
+            return;
+        }
         
         // Hide storage information
         lv_obj_add_flag(storage_label, LV_OBJ_FLAG_HIDDEN);
@@ -179,12 +270,21 @@ static void mount_btn_event_handler(lv_event_t * e) {
         
         // Set NeoPixel to pure green
         updateNeoPixel(COLOR_PURE_GREEN);
+        Energy::setScreenState("mounted");
         
         // Set mount state
         sd_card_mounted = true;
         usb_was_connected_before_mount = usb_connected;  // Preserve USB state
+        lv_obj_add_flag(tools_btn, LV_OBJ_FLAG_HIDDEN);   // tools need the card
         
-        Storage::mount();
+        // Read the folders first so Unmount can show what the host changed;
+        // loop() mounts when that is done
+        mount_pending = MountDiff::snapshot();
+        if (mount_pending) {
+            lv_label_set_text(status_label, "Reading card before mount...");
+        } else {
+            presentDrive();
+        }
 
         usb_was_ever_mounted = true;
         
@@ -192,7 +292,11 @@ static void mount_btn_event_handler(lv_event_t * e) {
         // Already mounted - Unmount SD Card action
         Serial.println("Unmount SD Card button pressed");
         
-        // Unmount the SD card
+        // Unmount the SD card (or stop reading its folders, if not mounted yet)
+        if (mount_pending) {
+            CardJob::cancel();
+            mount_pending = false;
+        }
         Storage::unmount();
         
         // Reset mount state
@@ -204,6 +308,11 @@ static void mount_btn_event_handler(lv_event_t * e) {
         
         // Update button back to "Mount SD Card" (this will also update NeoPixel to orange)
         updateMountButtonState();
+
+        // What the host changed since the snapshot taken at mount
+        if (MountDiff::compare()) {
+            Screens::showJob("Card changes", &Screens::mountDiffPanel);
+        }
         
     } else {
         // USB not connected - show message or refresh
@@ -212,8 +321,16 @@ static void mount_btn_event_handler(lv_event_t * e) {
     }
 }
 
+static void tools_btn_event_handler(lv_event_t * e) {
+    Screens::showTools();
+}
+
 
 void updateMountButtonState() {
+    if (!sd_card_mounted) {
+        lv_obj_clear_flag(tools_btn, LV_OBJ_FLAG_HIDDEN);
+    }
+
     // First check if SD card is detected
     bool sd_card_detected = false;
     if (!sd_card_mounted) {
@@ -234,6 +351,7 @@ void updateMountButtonState() {
         
         // Set NeoPixel to orange
         updateNeoPixel(COLOR_ORANGE);
+        Energy::setScreenState("ready to mount");
         
     } else if (usb_connected && !sd_card_mounted && !sd_card_detected) {
         // USB connected, no SD card detected: Grey button with "No SD Card"
@@ -244,6 +362,7 @@ void updateMountButtonState() {
         
         // Turn off NeoPixel
         updateNeoPixel(0x000000);
+        Energy::setScreenState("no sd card");
         
     } else if (usb_connected && sd_card_mounted) {
         // USB connected, already mounted: Green button with "Unmount SD Card"
@@ -254,6 +373,7 @@ void updateMountButtonState() {
         
         // Set NeoPixel to pure green
         updateNeoPixel(COLOR_PURE_GREEN);
+        Energy::setScreenState("mounted");
         
     } else {
         // USB not connected: Grey button with "Connect USB C to PC"
@@ -264,6 +384,7 @@ void updateMountButtonState() {
         
         // Turn off NeoPixel
         updateNeoPixel(0x000000);
+        Energy::setScreenState("no usb");
         
         // Reset mount state when USB disconnects
         if (sd_card_mounted) {
@@ -312,6 +433,14 @@ void createSDCardScreen() {
     lv_obj_set_style_text_font(total_files_label, &Inter_20, 0);
     lv_obj_align(total_files_label, LV_ALIGN_TOP_MID, 0, 230);
 
+    // Self-test regressions (hidden unless the last run flagged something)
+    selftest_label = lv_label_create(scr);
+    lv_obj_set_style_text_color(selftest_label, lv_color_hex(COLOR_RED), 0);
+    lv_obj_set_style_text_font(selftest_label, &lv_font_montserrat_16, 0);
+    lv_obj_set_style_text_align(selftest_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_align(selftest_label, LV_ALIGN_TOP_MID, 0, 270);
+    lv_obj_add_flag(selftest_label, LV_OBJ_FLAG_HIDDEN);
+
 
 
     // Button with dynamic behavior
@@ -325,6 +454,21 @@ void createSDCardScreen() {
     mount_btn_label = lv_label_create(mount_btn);
     lv_obj_set_style_text_font(mount_btn_label, &lv_font_montserrat_16, 0);
     lv_obj_center(mount_btn_label);
+
+    // On-device card tools (hashing, scans...)
+    tools_btn = lv_btn_create(scr);
+    lv_obj_set_size(tools_btn, 200, 44);
+    lv_obj_align(tools_btn, LV_ALIGN_BOTTOM_MID, 0, -80);
+    lv_obj_set_style_bg_color(tools_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(tools_btn, 0, 0);
+    lv_obj_set_style_radius(tools_btn, 10, 0);
+    lv_obj_add_event_cb(tools_btn, tools_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *tools_btn_label = lv_label_create(tools_btn);
+    lv_label_set_text(tools_btn_label, LV_SYMBOL_SETTINGS " Tools");
+    lv_obj_set_style_text_font(tools_btn_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(tools_btn_label);
+    Screens::init(scr);
     
     // Set initial button state (check current USB status)
     usb_connected = isUSBConnected();
@@ -338,7 +482,13 @@ void createSDCardScreen() {
 void refreshSDCardInfo() {
     // If SD card is mounted, don't try to access it
     if (sd_card_mounted) {
-        lv_label_set_text(status_label, "SD Card in Mount Mode");
+        if (mount_pending) {
+            // Snapshot for the Unmount report; the host sees the drive after it
+            lv_label_set_text_fmt(status_label, "Reading card before mount... %u entries",
+                                  (unsigned)CardJob::status().items);
+        } else {
+            lv_label_set_text(status_label, "SD Card in Mount Mode");
+        }
         lv_obj_set_style_text_color(status_label, lv_color_hex(COLOR_ORANGE), 0);
         lv_obj_add_flag(storage_label, LV_OBJ_FLAG_HIDDEN);
         lv_obj_add_flag(folders_label, LV_OBJ_FLAG_HIDDEN);
@@ -403,38 +553,53 @@ void refreshSDCardInfo() {
 }
 
 SDCardInfo getSDCardInfo() {
+    TRACE_SCOPE("scan");
+    static SDCardInfo last_info;
+    // A raw-card tool owns the SDMMC host; report what we saw last.
+    if (SdCard::isOpen()) {
+        return last_info;
+    }
+
     SDCardInfo info;
     
     if (!SD_MMC.setPins(SD_PIN_CLK, SD_PIN_CMD, SD_PIN_D0)) {
         info.detected = false;
+        last_info = info;
         return info;
     }
     
     if (!SD_MMC.begin("/sdcard", /*1-bit*/ true)) {
         info.detected = false;
+        last_info = info;
         return info;
     }
     
     if (SD_MMC.cardType() == CARD_NONE) {
         info.detected = false;
         SD_MMC.end();
+        last_info = info;
         return info;
     }
     
     info.detected = true;
     info.totalBytes = SD_MMC.totalBytes();
     info.usedBytes = SD_MMC.usedBytes();
+    Energy::beginActivity("scan");
     countFilesAndFolders("/", info, true);
+    Energy::endActivity("scan", info.scannedBytes, 0);
     SD_MMC.end();
+    last_info = info;
     return info;
 }
 
 void countFilesAndFolders(const char* path, SDCardInfo& info, bool isRoot) {
+    TRACE_SCOPE("scan.dir");
     File dir = SD_MMC.open(path);
     if (!dir || !dir.isDirectory()) return;
 
     File file = dir.openNextFile();
     while (file) {
+        info.scannedBytes += 32;   // one directory entry; long-name entries not counted
         if (file.isDirectory()) {
             info.folderCount++;
             String subPath = String(path) + String(file.name()) + "/";
@@ -449,6 +614,22 @@ void countFilesAndFolders(const char* path, SDCardInfo& info, bool isRoot) {
     dir.close();
 }
 
+// Show/hide the self-test regression banner after each run (boot or console)
+void updateSelfTestLabel() {
+    static uint32_t shown_run = 0;
+    if (!selftest_label || SelfTest::runCount() == shown_run) return;
+    shown_run = SelfTest::runCount();
+
+    if (SelfTest::anyRegression()) {
+        char text[192];
+        SelfTest::describeRegressions(text, sizeof(text));
+        lv_label_set_text_fmt(selftest_label, "Self-test regression:\n%s", text);
+        lv_obj_clear_flag(selftest_label, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(selftest_label, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
 String formatBytes(uint64_t bytes) {
     if (bytes >= 1024ULL * 1024ULL * 1024ULL) {
         double gb = (double)bytes / (1024.0 * 1024.0 * 1024.0);
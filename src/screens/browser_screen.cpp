@@ -0,0 +1,316 @@
+/**
+ * Files: browse the card one folder at a time. DirPager reads the folder in
+ * pages on its job task; the list is virtual: a fixed pool of rows covers
+ * the visible window plus a margin and is rebound to other entries as it
+ * scrolls, with a spacer giving the scroll range of the whole folder. The
+ * LVGL heap cost is the same for 10 entries or 20k.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <DirPager.h>
+
+static constexpr int32_t LIST_W  = 390;
+static constexpr int32_t LIST_H  = 310;
+static constexpr int32_t LIST_Y  = 92;
+static constexpr int32_t ROW_H   = 44;
+static constexpr uint32_t MARGIN = 3;                               // rows kept above and below the view
+static constexpr uint32_t POOL   = LIST_H / ROW_H + 1 + 2 * MARGIN;
+
+struct Row {
+    lv_obj_t *obj;
+    lv_obj_t *icon;
+    lv_obj_t *name;
+    lv_obj_t *detail;
+    uint32_t index;     // bound entry, UINT32_MAX if none
+    bool loaded;        // false while the entry's page is being read
+};
+
+static lv_obj_t *br_list;
+static lv_obj_t *br_spacer;
+static lv_obj_t *br_path_label;
+static lv_obj_t *br_info_label;
+static Row rows[POOL];
+static uint32_t shown_count;
+static uint32_t info_count;    // count in the "N items" label, UINT32_MAX if it shows something else
+static bool br_active;         // the pager job was started by this screen
+static bool br_waiting;        // for the card, to start the pager job on br_start_path
+static char br_start_path[FatVolume::MAX_PATH];
+
+static void format_size(char *out, size_t len, uint64_t bytes) {
+    if (bytes >= 1073741824ull) {
+        snprintf(out, len, "%.1f GB", bytes / 1073741824.0);
+    } else if (bytes >= 1048576) {
+        snprintf(out, len, "%.1f MB", bytes / 1048576.0);
+    } else if (bytes >= 1024) {
+        snprintf(out, len, "%.1f KB", bytes / 1024.0);
+    } else {
+        snprintf(out, len, "%u B", (unsigned)bytes);
+    }
+}
+
+static void bind_row(Row &row, uint32_t index) {
+    if (index >= shown_count) {
+        row.index = UINT32_MAX;
+        lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    if (row.index != index) {
+        row.index = index;
+        row.loaded = false;
+        lv_obj_set_y(row.obj, index * ROW_H);
+        lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+    } else if (row.loaded) {
+        return;
+    }
+
+    DirPager::Item item;
+    if (!DirPager::get(index, item)) {
+        lv_label_set_text(row.icon, "");
+        lv_label_set_text(row.name, "...");
+        lv_label_set_text(row.detail, "");
+        return;
+    }
+    char size[16] = "";
+    if (!item.dir) {
+        format_size(size, sizeof(size), item.size);
+    }
+    row.loaded = true;
+    lv_label_set_text(row.icon, item.dir ? LV_SYMBOL_DIRECTORY : LV_SYMBOL_FILE);
+    lv_label_set_text(row.name, item.name);
+    lv_label_set_text(row.detail, size);
+}
+
+// Rows cycle through the pool by index, so a scroll by one row rebinds one row
+static void bind_rows() {
+    const int32_t top = lv_obj_get_scroll_y(br_list) / ROW_H;
+    const uint32_t first = top > (int32_t)MARGIN ? top - MARGIN : 0;
+    for (uint32_t i = first; i < first + POOL; ++i) {
+        bind_row(rows[i % POOL], i);
+    }
+}
+
+static void set_count(uint32_t count) {
+    shown_count = count;
+    lv_obj_set_y(br_spacer, count ? count * ROW_H - 1 : 0);
+}
+
+static void show_folder(const char *path) {
+    DirPager::open(path);
+    lv_label_set_text(br_path_label, path);
+    lv_label_set_text(br_info_label, "Reading...");
+    info_count = UINT32_MAX;
+    for (Row &row : rows) {
+        row.index = UINT32_MAX;
+    }
+    set_count(0);
+    lv_obj_scroll_to_y(br_list, 0, LV_ANIM_OFF);
+    bind_rows();
+}
+
+static void row_event_handler(lv_event_t *e) {
+    const Row &row = rows[(uintptr_t)lv_event_get_user_data(e)];
+    if (!row.loaded || row.index == UINT32_MAX) {
+        return;
+    }
+    DirPager::Item item;
+    if (!DirPager::get(row.index, item)) {
+        return;
+    }
+    char path[FatVolume::MAX_PATH];
+    const char *cur = DirPager::path();
+    if (snprintf(path, sizeof(path), "%s/%s", strcmp(cur, "/") ? cur : "", item.name) >= (int)sizeof(path)) {
+        lv_label_set_text(br_info_label, "Path too long");
+        return;
+    }
+    if (!item.dir) {
+        DirPager::stop();
+        Screens::showViewer(path);
+        return;
+    }
+    show_folder(path);
+}
+
+static void up_btn_event_handler(lv_event_t *e) {
+    char path[FatVolume::MAX_PATH];
+    strlcpy(path, DirPager::path(), sizeof(path));
+    char *slash = strrchr(path, '/');
+    if (!slash || (slash == path && !path[1])) {
+        return;   // already at the root
+    }
+    slash[slash == path ? 1 : 0] = '\0';
+    show_folder(path);
+}
+
+static void photos_btn_event_handler(lv_event_t *e) {
+    char path[FatVolume::MAX_PATH];
+    strlcpy(path, br_active ? DirPager::path() : br_start_path, sizeof(path));
+    DirPager::stop();
+    Screens::showPhotos(path);
+}
+
+static void list_scroll_handler(lv_event_t *e) {
+    bind_rows();
+}
+
+// Starts the pager job once the card is free (the photo grid's job may
+// still be closing)
+static void try_start() {
+    if (CardJob::busy()) {
+        lv_label_set_text(br_info_label, "Waiting for the card...");
+        return;
+    }
+    br_waiting = false;
+    br_active = DirPager::start(br_start_path);
+    if (br_active) {
+        show_folder(br_start_path);
+    } else {
+        lv_label_set_text(br_info_label, "Card busy or missing (unmount USB first)");
+    }
+}
+
+static void update_browser(lv_timer_t *t) {
+    if (br_waiting) {
+        try_start();
+        return;
+    }
+    if (!br_active) {
+        return;
+    }
+    if (!DirPager::running()) {
+        br_active = false;
+        lv_label_set_text(br_info_label, CardJob::status().message);
+        return;
+    }
+    const DirPager::Listing l = DirPager::listing();
+    if (l.count != shown_count) {
+        set_count(l.count);
+    }
+    // Rows still waiting for their page, and rows that just came into range
+    bind_rows();
+    if (l.failed) {
+        lv_label_set_text(br_info_label, l.count ? "Read error" : "Folder not found");
+        info_count = UINT32_MAX;
+    } else if (!l.complete) {
+        lv_label_set_text_fmt(br_info_label, "Reading... %u items", (unsigned)l.count);
+        info_count = UINT32_MAX;
+    } else if (info_count != l.count) {
+        lv_label_set_text_fmt(br_info_label, "%u items", (unsigned)l.count);
+        info_count = l.count;
+    }
+}
+
+static void browser_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+    DirPager::stop();
+}
+
+static void create_row(uint32_t slot) {
+    Row &row = rows[slot];
+    row.obj = lv_obj_create(br_list);
+    lv_obj_remove_style_all(row.obj);
+    lv_obj_set_size(row.obj, LIST_W, ROW_H);
+    lv_obj_set_style_bg_color(row.obj, lv_color_hex(COLOR_GREY_BTN), LV_STATE_PRESSED);
+    lv_obj_set_style_bg_opa(row.obj, LV_OPA_COVER, LV_STATE_PRESSED);
+    lv_obj_set_style_border_color(row.obj, lv_color_hex(0x333333), 0);
+    lv_obj_set_style_border_width(row.obj, 1, 0);
+    lv_obj_set_style_border_side(row.obj, LV_BORDER_SIDE_BOTTOM, 0);
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(row.obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(row.obj, row_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)slot);
+
+    row.icon = lv_label_create(row.obj);
+    lv_obj_set_style_text_color(row.icon, lv_color_hex(COLOR_ORANGE), 0);
+    lv_obj_set_style_text_font(row.icon, &lv_font_montserrat_16, 0);
+    lv_obj_align(row.icon, LV_ALIGN_LEFT_MID, 8, 0);
+
+    row.name = lv_label_create(row.obj);
+    lv_label_set_long_mode(row.name, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(row.name, 250);
+    lv_obj_set_style_text_color(row.name, lv_color_hex(COLOR_WHITE), 0);
+    lv_obj_set_style_text_font(row.name, &lv_font_montserrat_16, 0);
+    lv_obj_align(row.name, LV_ALIGN_LEFT_MID, 38, 0);
+
+    row.detail = lv_label_create(row.obj);
+    lv_obj_set_style_text_color(row.detail, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(row.detail, &lv_font_montserrat_14, 0);
+    lv_obj_align(row.detail, LV_ALIGN_RIGHT_MID, -8, 0);
+
+    row.index = UINT32_MAX;
+}
+
+namespace Screens {
+
+void showBrowser(const char *path) {
+    lv_obj_t *scr = createScreen("Files");
+    lv_obj_set_width(backButton(scr), 120);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+
+    br_path_label = lv_label_create(scr);
+    lv_label_set_text(br_path_label, "");
+    lv_label_set_long_mode(br_path_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(br_path_label, LIST_W);
+    lv_obj_set_style_text_align(br_path_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(br_path_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(br_path_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(br_path_label, LV_ALIGN_TOP_MID, 0, 65);
+
+    br_list = lv_obj_create(scr);
+    lv_obj_remove_style_all(br_list);
+    lv_obj_set_size(br_list, LIST_W, LIST_H);
+    lv_obj_align(br_list, LV_ALIGN_TOP_MID, 0, LIST_Y);
+    lv_obj_set_scroll_dir(br_list, LV_DIR_VER);
+    lv_obj_set_style_bg_color(br_list, lv_color_hex(COLOR_GREY_BTN), LV_PART_SCROLLBAR);
+    lv_obj_set_style_bg_opa(br_list, LV_OPA_COVER, LV_PART_SCROLLBAR);
+    lv_obj_set_style_width(br_list, 4, LV_PART_SCROLLBAR);
+    lv_obj_add_event_cb(br_list, list_scroll_handler, LV_EVENT_SCROLL, nullptr);
+
+    // Stretches the scroll range to the whole folder
+    br_spacer = lv_obj_create(br_list);
+    lv_obj_remove_style_all(br_spacer);
+    lv_obj_set_size(br_spacer, 1, 1);
+    for (uint32_t i = 0; i < POOL; ++i) {
+        create_row(i);
+    }
+
+    br_info_label = lv_label_create(scr);
+    lv_label_set_text(br_info_label, "");
+    lv_obj_set_style_text_color(br_info_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(br_info_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(br_info_label, LV_ALIGN_TOP_MID, 0, LIST_Y + LIST_H + 6);
+
+    lv_obj_t *photos_btn = lv_btn_create(scr);
+    lv_obj_set_size(photos_btn, 120, 50);
+    lv_obj_align(photos_btn, LV_ALIGN_BOTTOM_MID, 0, -20);
+    lv_obj_set_style_bg_color(photos_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(photos_btn, 0, 0);
+    lv_obj_set_style_radius(photos_btn, 10, 0);
+    lv_obj_add_event_cb(photos_btn, photos_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *photos_label = lv_label_create(photos_btn);
+    lv_label_set_text(photos_label, LV_SYMBOL_IMAGE " Photos");
+    lv_obj_set_style_text_font(photos_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(photos_label);
+
+    lv_obj_t *up_btn = lv_btn_create(scr);
+    lv_obj_set_size(up_btn, 120, 50);
+    lv_obj_align(up_btn, LV_ALIGN_BOTTOM_RIGHT, -15, -20);
+    lv_obj_set_style_bg_color(up_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(up_btn, 0, 0);
+    lv_obj_set_style_radius(up_btn, 10, 0);
+    lv_obj_add_event_cb(up_btn, up_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *up_label = lv_label_create(up_btn);
+    lv_label_set_text(up_label, LV_SYMBOL_UP " Up");
+    lv_obj_set_style_text_font(up_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(up_label);
+
+    lv_timer_t *timer = lv_timer_create(update_browser, 50, nullptr);
+    lv_obj_add_event_cb(scr, browser_delete_handler, LV_EVENT_DELETE, timer);
+    strlcpy(br_start_path, path, sizeof(br_start_path));
+    br_active = false;
+    br_waiting = true;
+    try_start();
+    load(scr);
+}
+
+} // namespace Screens
@@ -0,0 +1,68 @@
+/**
+ * Deleted-file scan panel for the job screen: the latest entries found, with
+ * their size, coloured by how much of their data is still on the card.
+ */
+#include "screens.h"
+#include <DeletedScan.h>
+
+#define COLOR_ROW_PARTIAL 0xFFC107
+#define COLOR_ROW_GONE    0x777777
+
+static constexpr int ROWS    = 8;
+static constexpr int32_t ROW_H = Screens::JOB_PANEL_H / ROWS;
+
+static lv_obj_t *rows[ROWS];
+static uint32_t shown_count;   // DeletedScan::count() the rows were filled for
+
+static void panel_delete_handler(lv_event_t *e) {
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = nullptr;
+    }
+}
+
+static void create_deleted_panel(lv_obj_t *scr) {
+    shown_count = UINT32_MAX;
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = lv_label_create(scr);
+        lv_label_set_text(rows[i], "");
+        lv_label_set_long_mode(rows[i], LV_LABEL_LONG_DOT);
+        lv_obj_set_width(rows[i], 370);
+        lv_obj_set_style_text_font(rows[i], &lv_font_montserrat_14, 0);
+        lv_obj_align(rows[i], LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y + i * ROW_H);
+    }
+    lv_obj_add_event_cb(rows[0], panel_delete_handler, LV_EVENT_DELETE, nullptr);
+}
+
+static void update_deleted_panel() {
+    const uint32_t n = DeletedScan::count();
+    if (!rows[0] || n == shown_count) {
+        return;
+    }
+    shown_count = n;
+
+    const uint32_t first = n > ROWS ? n - ROWS : 0;
+    for (int i = 0; i < ROWS; ++i) {
+        DeletedScan::Item it;
+        if (!DeletedScan::item(first + i, it)) {
+            lv_label_set_text(rows[i], "");
+            continue;
+        }
+        const uint32_t color = it.state == DeletedScan::State::Intact  ? COLOR_GREEN
+                             : it.state == DeletedScan::State::Partial ? COLOR_ROW_PARTIAL
+                             : COLOR_ROW_GONE;
+        if (it.dir) {
+            lv_label_set_text_fmt(rows[i], LV_SYMBOL_DIRECTORY " %s", it.path);
+        } else if (it.size >= 1048576) {
+            lv_label_set_text_fmt(rows[i], "%.1f MB  %s", it.size / 1048576.0, it.path);
+        } else {
+            lv_label_set_text_fmt(rows[i], "%u KB  %s", (unsigned)((it.size + 1023) / 1024), it.path);
+        }
+        lv_obj_set_style_text_color(rows[i], lv_color_hex(color), 0);
+    }
+}
+
+namespace Screens {
+
+const JobPanel deletedScanPanel = { create_deleted_panel, update_deleted_panel };
+
+} // namespace Screens
@@ -0,0 +1,82 @@
+/**
+ * Duplicate files panel for the job screen: the sets of identical files
+ * that take the most space, once the scan has finished. Tapping one lists
+ * where its copies are.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <DupScan.h>
+
+static constexpr int ROWS      = 8;
+static constexpr int32_t ROW_H = Screens::JOB_PANEL_H / ROWS;
+
+static lv_obj_t *rows[ROWS];
+static bool shown;   // rows filled from a finished scan
+
+static void row_event_handler(lv_event_t *e) {
+    const uint32_t i = (uint32_t)(uintptr_t)lv_event_get_user_data(e);
+    const DupScan::Result *r = DupScan::result();
+    if (!r || i >= r->listed || CardJob::busy()) {
+        return;
+    }
+    const DupScan::Group &g = r->list[i];
+    lv_obj_t *box = lv_msgbox_create(nullptr);
+    lv_msgbox_add_title(box, "Identical files");
+    for (uint32_t k = 0; k < g.paths; ++k) {
+        lv_msgbox_add_text(box, g.path[k]);
+    }
+    if (g.copies > g.paths) {
+        char more[32];
+        snprintf(more, sizeof(more), "and %u more", (unsigned)(g.copies - g.paths));
+        lv_msgbox_add_text(box, more);
+    }
+    lv_msgbox_add_close_button(box);
+}
+
+static void panel_delete_handler(lv_event_t *e) {
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = nullptr;
+    }
+}
+
+static void create_dup_panel(lv_obj_t *scr) {
+    shown = false;
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = lv_label_create(scr);
+        lv_label_set_text(rows[i], "");
+        lv_label_set_long_mode(rows[i], LV_LABEL_LONG_DOT);
+        lv_obj_set_width(rows[i], 370);
+        lv_obj_set_style_text_color(rows[i], lv_color_hex(COLOR_GREY_TEXT), 0);
+        lv_obj_set_style_text_font(rows[i], &lv_font_montserrat_14, 0);
+        lv_obj_align(rows[i], LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y + i * ROW_H);
+        lv_obj_add_event_cb(rows[i], row_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)i);
+    }
+    lv_obj_add_event_cb(rows[0], panel_delete_handler, LV_EVENT_DELETE, nullptr);
+}
+
+static void update_dup_panel() {
+    if (!rows[0] || shown || CardJob::status().running) {
+        return;
+    }
+    shown = true;
+
+    const DupScan::Result *r = DupScan::result();
+    if (!r || !CardJob::status().ok) {
+        return;
+    }
+    if (!r->listed) {
+        lv_label_set_text(rows[0], "No duplicate files");
+        return;
+    }
+    for (uint32_t i = 0; i < ROWS && i < r->listed; ++i) {
+        const DupScan::Group &g = r->list[i];
+        lv_label_set_text_fmt(rows[i], "%u x %.1f MB  %s", (unsigned)g.copies, g.size / 1048576.0, g.path[0]);
+        lv_obj_add_flag(rows[i], LV_OBJ_FLAG_CLICKABLE);
+    }
+}
+
+namespace Screens {
+
+const JobPanel dupPanel = { create_dup_panel, update_dup_panel };
+
+} // namespace Screens
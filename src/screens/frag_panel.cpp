@@ -0,0 +1,90 @@
+/**
+ * Fragmentation panel for the job screen: the most fragmented large files
+ * once the scan has finished. Tapping one offers to defragment it.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <Defrag.h>
+#include <FragScan.h>
+
+static constexpr int ROWS      = 8;
+static constexpr int32_t ROW_H = Screens::JOB_PANEL_H / ROWS;
+
+static lv_obj_t *rows[ROWS];
+static bool shown;   // rows filled from a finished scan
+static lv_obj_t *confirm_box = nullptr;
+
+static void confirm_btn_event_handler(lv_event_t *e) {
+    const FragScan::File *file = (const FragScan::File *)lv_event_get_user_data(e);
+    lv_msgbox_close_async(confirm_box);   // we are inside one of its buttons' events
+    confirm_box = nullptr;
+    if (file && Defrag::start(file->path)) {
+        Screens::showJob("Defragment");
+    }
+}
+
+static void row_event_handler(lv_event_t *e) {
+    const uint32_t i = (uint32_t)(uintptr_t)lv_event_get_user_data(e);
+    const FragScan::Result &r = FragScan::result();
+    if (i >= r.worstCount || CardJob::busy()) {
+        return;
+    }
+    const FragScan::File *file = &r.worst[i];
+    confirm_box = lv_msgbox_create(nullptr);
+    lv_msgbox_add_title(confirm_box, "Defragment");
+    lv_msgbox_add_text(confirm_box, file->path);
+    lv_msgbox_add_text(confirm_box, "Copies the file into one contiguous free\narea, then frees its old clusters.");
+    lv_obj_t *btn = lv_msgbox_add_footer_button(confirm_box, "Start");
+    lv_obj_set_style_bg_color(btn, lv_color_hex(COLOR_ORANGE), 0);
+    lv_obj_add_event_cb(btn, confirm_btn_event_handler, LV_EVENT_CLICKED, (void *)file);
+    btn = lv_msgbox_add_footer_button(confirm_box, "Cancel");
+    lv_obj_add_event_cb(btn, confirm_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+}
+
+static void panel_delete_handler(lv_event_t *e) {
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = nullptr;
+    }
+}
+
+static void create_frag_panel(lv_obj_t *scr) {
+    shown = false;
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = lv_label_create(scr);
+        lv_label_set_text(rows[i], "");
+        lv_label_set_long_mode(rows[i], LV_LABEL_LONG_DOT);
+        lv_obj_set_width(rows[i], 370);
+        lv_obj_set_style_text_color(rows[i], lv_color_hex(COLOR_GREY_TEXT), 0);
+        lv_obj_set_style_text_font(rows[i], &lv_font_montserrat_14, 0);
+        lv_obj_align(rows[i], LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y + i * ROW_H);
+        lv_obj_add_event_cb(rows[i], row_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)i);
+    }
+    lv_obj_add_event_cb(rows[0], panel_delete_handler, LV_EVENT_DELETE, nullptr);
+}
+
+static void update_frag_panel() {
+    if (!rows[0] || shown || CardJob::status().running) {
+        return;
+    }
+    shown = true;
+
+    const FragScan::Result &r = FragScan::result();
+    if (!r.valid) {
+        return;
+    }
+    if (!r.worstCount) {
+        lv_label_set_text(rows[0], "No fragmented files of 1 MB or more");
+        return;
+    }
+    for (uint32_t i = 0; i < ROWS && i < r.worstCount; ++i) {
+        const FragScan::File &f = r.worst[i];
+        lv_label_set_text_fmt(rows[i], "%u extents  %.1f MB  %s", (unsigned)f.extents, f.size / 1048576.0, f.path);
+        lv_obj_add_flag(rows[i], LV_OBJ_FLAG_CLICKABLE);
+    }
+}
+
+namespace Screens {
+
+const JobPanel fragPanel = { create_frag_panel, update_frag_panel };
+
+} // namespace Screens
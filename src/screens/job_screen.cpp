@@ -0,0 +1,113 @@
+/**
+ * Progress of a background card job (CardJob): bar, current item, rate,
+ * the final summary and an optional job-specific panel. Back leaves the
+ * job running.
+ */
+#include "screens.h"
+#include <CardJob.h>
+
+static lv_obj_t *job_bar;
+static lv_obj_t *job_pct_label;
+static lv_obj_t *job_item_label;
+static lv_obj_t *job_stats_label;
+static lv_obj_t *job_cancel_btn;
+static const Screens::JobPanel *job_panel;
+
+static void cancel_btn_event_handler(lv_event_t *e) {
+    CardJob::cancel();
+}
+
+static void job_screen_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+    job_panel = nullptr;
+}
+
+static void update_job_screen(lv_timer_t *t) {
+    const CardJob::Status st = CardJob::status();
+    const float secs = st.elapsedMs / 1000.0f;
+
+    if (st.total > 0) {
+        const int32_t permille = (int32_t)min<uint64_t>(st.done * 1000 / st.total, 1000);
+        lv_bar_set_value(job_bar, permille, LV_ANIM_OFF);
+        lv_label_set_text_fmt(job_pct_label, "%d.%d%%", (int)(permille / 10), (int)(permille % 10));
+    }
+
+    if (st.running) {
+        lv_label_set_text(job_item_label, st.cancelled ? "Cancelling..." : st.item);
+        lv_label_set_text_fmt(job_stats_label, "%.1f MB  %.2f MB/s\n%u items  %.0f s",
+                              st.done / 1048576.0, secs > 0 ? st.done / 1048576.0 / secs : 0.0,
+                              (unsigned)st.items, secs);
+    } else {
+        lv_label_set_text(job_item_label, st.ok ? "Done" : "Stopped");
+        lv_obj_set_style_text_color(job_item_label, lv_color_hex(st.ok ? COLOR_GREEN : COLOR_RED), 0);
+        lv_label_set_text(job_stats_label, st.message);
+        lv_obj_add_flag(job_cancel_btn, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    if (job_panel) {
+        job_panel->update();
+    }
+}
+
+namespace Screens {
+
+void showJob(const char *title, const JobPanel *panel) {
+    lv_obj_t *scr = createScreen(title);
+    // Back and Cancel side by side, leaving room for the panel
+    lv_obj_set_width(backButton(scr), 180);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+
+    job_bar = lv_bar_create(scr);
+    lv_obj_set_size(job_bar, 340, 24);
+    lv_obj_align(job_bar, LV_ALIGN_TOP_MID, 0, 90);
+    lv_bar_set_range(job_bar, 0, 1000);
+
+    job_pct_label = lv_label_create(scr);
+    lv_label_set_text(job_pct_label, "");
+    lv_obj_set_style_text_color(job_pct_label, lv_color_hex(COLOR_WHITE), 0);
+    lv_obj_set_style_text_font(job_pct_label, &Inter_20, 0);
+    lv_obj_align(job_pct_label, LV_ALIGN_TOP_MID, 0, 125);
+
+    job_item_label = lv_label_create(scr);
+    lv_label_set_text(job_item_label, "");
+    lv_label_set_long_mode(job_item_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(job_item_label, 360);
+    lv_obj_set_style_text_align(job_item_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(job_item_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(job_item_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(job_item_label, LV_ALIGN_TOP_MID, 0, 165);
+
+    job_stats_label = lv_label_create(scr);
+    lv_label_set_text(job_stats_label, "");
+    lv_label_set_long_mode(job_stats_label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_width(job_stats_label, 360);
+    lv_obj_set_style_text_align(job_stats_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(job_stats_label, lv_color_hex(0x999999), 0);
+    lv_obj_set_style_text_font(job_stats_label, &Inter_20, 0);
+    lv_obj_align(job_stats_label, LV_ALIGN_TOP_MID, 0, 205);
+
+    job_cancel_btn = lv_btn_create(scr);
+    lv_obj_set_size(job_cancel_btn, 180, 50);
+    lv_obj_align(job_cancel_btn, LV_ALIGN_BOTTOM_RIGHT, -15, -20);
+    lv_obj_set_style_bg_color(job_cancel_btn, lv_color_hex(COLOR_RED), 0);
+    lv_obj_set_style_border_width(job_cancel_btn, 0, 0);
+    lv_obj_set_style_radius(job_cancel_btn, 10, 0);
+    lv_obj_add_event_cb(job_cancel_btn, cancel_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *cancel_label = lv_label_create(job_cancel_btn);
+    lv_label_set_text(cancel_label, LV_SYMBOL_CLOSE " Cancel");
+    lv_obj_set_style_text_font(cancel_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(cancel_label);
+
+    job_panel = panel;
+    if (job_panel) {
+        job_panel->create(scr);
+    }
+
+    lv_timer_t *timer = lv_timer_create(update_job_screen, 200, nullptr);
+    lv_obj_add_event_cb(scr, job_screen_delete_handler, LV_EVENT_DELETE, timer);
+    update_job_screen(timer);
+    load(scr);
+}
+
+} // namespace Screens
@@ -0,0 +1,74 @@
+/**
+ * Card changes panel for the job screen, shown after Unmount: the folders
+ * the USB session changed most, with files added, deleted and changed in
+ * each, once the compare has finished.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <MountDiff.h>
+
+static constexpr int ROWS      = 8;
+static constexpr int32_t ROW_H = Screens::JOB_PANEL_H / ROWS;
+
+static lv_obj_t *rows[ROWS];
+static bool shown;   // rows filled from a finished compare
+
+static void panel_delete_handler(lv_event_t *e) {
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = nullptr;
+    }
+}
+
+static void create_mount_diff_panel(lv_obj_t *scr) {
+    shown = false;
+    for (int i = 0; i < ROWS; ++i) {
+        rows[i] = lv_label_create(scr);
+        lv_label_set_text(rows[i], "");
+        lv_label_set_long_mode(rows[i], LV_LABEL_LONG_DOT);
+        lv_obj_set_width(rows[i], 370);
+        lv_obj_set_style_text_color(rows[i], lv_color_hex(COLOR_GREY_TEXT), 0);
+        lv_obj_set_style_text_font(rows[i], &lv_font_montserrat_14, 0);
+        lv_obj_align(rows[i], LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y + i * ROW_H);
+    }
+    lv_obj_add_event_cb(rows[0], panel_delete_handler, LV_EVENT_DELETE, nullptr);
+}
+
+static void update_mount_diff_panel() {
+    if (!rows[0] || shown || CardJob::status().running) {
+        return;
+    }
+    shown = true;
+
+    const MountDiff::Result *r = MountDiff::result();
+    if (!r || !CardJob::status().ok) {
+        return;
+    }
+    if (!r->listed) {
+        lv_label_set_text(rows[0], "No files changed");
+        return;
+    }
+    for (uint32_t i = 0; i < ROWS && i < r->listed; ++i) {
+        // "12 added, 3 deleted  /DCIM/100CANON"
+        const MountDiff::Folder &f = r->list[i];
+        char text[64];
+        size_t used = 0;
+        auto part = [&](uint32_t n, const char *what) {
+            if (n && used < sizeof(text)) {
+                used += snprintf(text + used, sizeof(text) - used, "%s%u %s", used ? ", " : "", (unsigned)n, what);
+            }
+        };
+        part(f.added, "added");
+        part(f.deleted, "deleted");
+        part(f.changed, "changed");
+        if (!used) {
+            strlcpy(text, f.created ? "new folder" : "folder removed", sizeof(text));
+        }
+        lv_label_set_text_fmt(rows[i], "%s  %s%s", text, f.path, f.created && used ? " (new)" : "");
+    }
+}
+
+namespace Screens {
+
+const JobPanel mountDiffPanel = { create_mount_diff_panel, update_mount_diff_panel };
+
+} // namespace Screens
@@ -0,0 +1,289 @@
+/**
+ * Photos: a grid of JPEG thumbnails of one folder. DirPager lists the
+ * folder's JPEGs and Thumbs decodes the ones on screen on the same job
+ * task, so the grid scrolls while thumbnails come in. Like the file browser
+ * the grid is virtual: a fixed pool of canvases (RGB565 buffers in PSRAM)
+ * is rebound as it scrolls. The card must be free first: the thumbnail
+ * cache file is checked by a short job of its own before listing starts,
+ * and the info line says so when that job had to create it.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <Thumbs.h>
+#include <esp_heap_caps.h>
+
+static constexpr int32_t GRID_W   = 390;
+static constexpr int32_t GRID_H   = 310;
+static constexpr int32_t GRID_Y   = 92;
+static constexpr int32_t CELL     = Thumbs::SIDE;
+static constexpr uint32_t COLS    = 4;
+static constexpr int32_t PITCH_X  = CELL + (GRID_W - COLS * CELL) / (COLS - 1);
+static constexpr int32_t PITCH_Y  = CELL + 10;
+static constexpr uint32_t MARGIN  = 1;                                      // rows kept above and below the view
+static constexpr uint32_t ROWS    = GRID_H / PITCH_Y + 1 + 2 * MARGIN;
+static constexpr uint32_t POOL    = ROWS * COLS;
+static_assert(POOL <= Thumbs::MAX_WINDOW, "thumbnail pool larger than the decode window");
+
+enum class Phase : uint8_t { WaitCard, Cache, Listing, Stopped };
+
+struct Cell {
+    lv_obj_t *canvas;
+    lv_obj_t *label;       // "..." or "No preview" over the canvas
+    uint16_t *px;
+    uint32_t index;        // bound entry, UINT32_MAX if none
+    Thumbs::State state;
+};
+
+static lv_obj_t *ph_grid;
+static lv_obj_t *ph_spacer;
+static lv_obj_t *ph_info_label;
+static Cell cells[POOL];
+static uint16_t *ph_buf;       // POOL thumbnails, PSRAM
+static char ph_path[FatVolume::MAX_PATH];
+static Phase ph_phase;
+static bool ph_uncached;       // the cache file could not be made
+static bool ph_created;        // ... or was made by this visit
+static uint32_t shown_count;
+static uint32_t info_count;    // count in the "N photos" label, UINT32_MAX if it shows something else
+
+static void bind_cell(Cell &cell, uint32_t index) {
+    if (index >= shown_count) {
+        cell.index = UINT32_MAX;
+        lv_obj_add_flag(cell.canvas, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    if (cell.index != index) {
+        cell.index = index;
+        cell.state = Thumbs::State::Pending;
+        memset(cell.px, 0, CELL * CELL * sizeof(uint16_t));
+        lv_label_set_text(cell.label, "...");
+        lv_obj_remove_flag(cell.label, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_set_pos(cell.canvas, (index % COLS) * PITCH_X, (index / COLS) * PITCH_Y);
+        lv_obj_remove_flag(cell.canvas, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_invalidate(cell.canvas);
+    } else if (cell.state != Thumbs::State::Pending) {
+        return;
+    }
+
+    DirPager::Item item;
+    if (!DirPager::get(index, item)) {
+        return;
+    }
+    cell.state = Thumbs::get(item, cell.px);
+    if (cell.state == Thumbs::State::Ready) {
+        lv_obj_add_flag(cell.label, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_invalidate(cell.canvas);
+    } else if (cell.state == Thumbs::State::Failed) {
+        lv_label_set_text(cell.label, "No preview");
+    }
+}
+
+// Cells cycle through the pool by index, so a scroll by one row rebinds one row
+static void bind_cells() {
+    const int32_t top = lv_obj_get_scroll_y(ph_grid) / PITCH_Y;
+    const uint32_t first = (top > (int32_t)MARGIN ? top - MARGIN : 0) * COLS;
+    for (uint32_t i = first; i < first + POOL; ++i) {
+        bind_cell(cells[i % POOL], i);
+    }
+    // Visible rows first, then the margin below
+    Thumbs::setWindow(top > 0 ? top * COLS : 0, POOL);
+}
+
+static void set_count(uint32_t count) {
+    shown_count = count;
+    lv_obj_set_y(ph_spacer, count ? ((count + COLS - 1) / COLS) * PITCH_Y - 1 : 0);
+}
+
+static void cell_event_handler(lv_event_t *e) {
+    const Cell &cell = cells[(uintptr_t)lv_event_get_user_data(e)];
+    DirPager::Item item;
+    if (cell.index == UINT32_MAX || !DirPager::get(cell.index, item)) {
+        return;
+    }
+    lv_label_set_text_fmt(ph_info_label, "%s, %.1f MB", item.name, item.size / 1048576.0);
+    info_count = shown_count;   // stays up until the listing changes
+}
+
+static void grid_scroll_handler(lv_event_t *e) {
+    bind_cells();
+}
+
+static void files_btn_event_handler(lv_event_t *e) {
+    DirPager::stop();
+    Screens::showBrowser(ph_path);
+}
+
+// Waits for the card, has the cache file checked, then lists the folder
+static void step_phase() {
+    switch (ph_phase) {
+    case Phase::WaitCard:
+        if (CardJob::busy()) {
+            lv_label_set_text(ph_info_label, "Waiting for the card...");
+        } else if (Thumbs::prepare()) {
+            ph_phase = Phase::Cache;
+            lv_label_set_text_fmt(ph_info_label, "Checking the thumbnail cache (/%s, %u MB)...",
+                                  Thumbs::CACHE_NAME, (unsigned)((Thumbs::cacheBytes() + (1u << 19)) >> 20));
+        } else {
+            ph_phase = Phase::Stopped;
+            lv_label_set_text(ph_info_label, "Card busy or missing (unmount USB first)");
+        }
+        break;
+    case Phase::Cache:
+        if (CardJob::busy()) {
+            break;
+        }
+        ph_uncached = !CardJob::status().ok;
+        ph_created  = !ph_uncached && Thumbs::cacheCreated();
+        if (Thumbs::start(ph_path)) {
+            ph_phase = Phase::Listing;
+            lv_label_set_text(ph_info_label, "Reading...");
+            info_count = UINT32_MAX;
+        } else {
+            ph_phase = Phase::Stopped;
+            lv_label_set_text(ph_info_label, "Card busy or missing (unmount USB first)");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void update_photos(lv_timer_t *t) {
+    if (ph_phase != Phase::Listing) {
+        step_phase();
+        return;
+    }
+    if (!DirPager::running()) {
+        ph_phase = Phase::Stopped;
+        lv_label_set_text(ph_info_label, CardJob::status().message);
+        return;
+    }
+    const DirPager::Listing l = DirPager::listing();
+    if (l.count != shown_count) {
+        set_count(l.count);
+    }
+    // Cells still waiting for their page or thumbnail
+    bind_cells();
+    if (l.failed) {
+        lv_label_set_text(ph_info_label, l.count ? "Read error" : "Folder not found");
+        info_count = UINT32_MAX;
+    } else if (!l.complete) {
+        lv_label_set_text_fmt(ph_info_label, "Reading... %u photos", (unsigned)l.count);
+        info_count = UINT32_MAX;
+    } else if (info_count != l.count) {
+        if (!l.count) {
+            lv_label_set_text(ph_info_label, "No JPEG photos here");
+        } else {
+            char note[48] = "";
+            if (ph_uncached) {
+                strlcpy(note, " (not cached: card full or read-only)", sizeof(note));
+            } else if (ph_created) {
+                snprintf(note, sizeof(note), " (made /%s, %u MB, hidden)", Thumbs::CACHE_NAME,
+                         (unsigned)((Thumbs::cacheBytes() + (1u << 19)) >> 20));
+            }
+            lv_label_set_text_fmt(ph_info_label, "%u photos%s", (unsigned)l.count, note);
+        }
+        info_count = l.count;
+    }
+}
+
+static void photos_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+    DirPager::stop();
+    heap_caps_free(ph_buf);
+    ph_buf = nullptr;
+}
+
+static void create_cell(uint32_t slot) {
+    Cell &cell = cells[slot];
+    cell.px = ph_buf + slot * CELL * CELL;
+    memset(cell.px, 0, CELL * CELL * sizeof(uint16_t));
+    cell.canvas = lv_canvas_create(ph_grid);
+    lv_canvas_set_buffer(cell.canvas, cell.px, CELL, CELL, LV_COLOR_FORMAT_RGB565);
+    lv_obj_add_flag(cell.canvas, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(cell.canvas, cell_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)slot);
+
+    cell.label = lv_label_create(cell.canvas);
+    lv_obj_set_style_text_color(cell.label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(cell.label, &lv_font_montserrat_14, 0);
+    lv_obj_center(cell.label);
+
+    cell.index = UINT32_MAX;
+    cell.state = Thumbs::State::Pending;
+}
+
+namespace Screens {
+
+void showPhotos(const char *path) {
+    lv_obj_t *scr = createScreen("Photos");
+    lv_obj_set_width(backButton(scr), 180);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+    strlcpy(ph_path, path, sizeof(ph_path));
+
+    lv_obj_t *path_label = lv_label_create(scr);
+    lv_label_set_text(path_label, ph_path);
+    lv_label_set_long_mode(path_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(path_label, GRID_W);
+    lv_obj_set_style_text_align(path_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(path_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(path_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(path_label, LV_ALIGN_TOP_MID, 0, 65);
+
+    ph_info_label = lv_label_create(scr);
+    lv_label_set_text(ph_info_label, "");
+    lv_label_set_long_mode(ph_info_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(ph_info_label, GRID_W);
+    lv_obj_set_style_text_align(ph_info_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(ph_info_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(ph_info_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(ph_info_label, LV_ALIGN_TOP_MID, 0, GRID_Y + GRID_H + 6);
+
+    lv_obj_t *files_btn = lv_btn_create(scr);
+    lv_obj_set_size(files_btn, 180, 50);
+    lv_obj_align(files_btn, LV_ALIGN_BOTTOM_RIGHT, -15, -20);
+    lv_obj_set_style_bg_color(files_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(files_btn, 0, 0);
+    lv_obj_set_style_radius(files_btn, 10, 0);
+    lv_obj_add_event_cb(files_btn, files_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *files_label = lv_label_create(files_btn);
+    lv_label_set_text(files_label, LV_SYMBOL_LIST " Files");
+    lv_obj_set_style_text_font(files_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(files_label);
+
+    ph_phase = Phase::Stopped;
+    shown_count = 0;
+    info_count = UINT32_MAX;
+    ph_buf = (uint16_t *)heap_caps_malloc(POOL * CELL * CELL * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (!ph_buf) {
+        lv_label_set_text(ph_info_label, "Out of memory");
+        load(scr);
+        return;
+    }
+
+    ph_grid = lv_obj_create(scr);
+    lv_obj_remove_style_all(ph_grid);
+    lv_obj_set_size(ph_grid, GRID_W, GRID_H);
+    lv_obj_align(ph_grid, LV_ALIGN_TOP_MID, 0, GRID_Y);
+    lv_obj_set_scroll_dir(ph_grid, LV_DIR_VER);
+    lv_obj_set_style_bg_color(ph_grid, lv_color_hex(COLOR_GREY_BTN), LV_PART_SCROLLBAR);
+    lv_obj_set_style_bg_opa(ph_grid, LV_OPA_COVER, LV_PART_SCROLLBAR);
+    lv_obj_set_style_width(ph_grid, 4, LV_PART_SCROLLBAR);
+    lv_obj_add_event_cb(ph_grid, grid_scroll_handler, LV_EVENT_SCROLL, nullptr);
+
+    // Stretches the scroll range to the whole folder
+    ph_spacer = lv_obj_create(ph_grid);
+    lv_obj_remove_style_all(ph_spacer);
+    lv_obj_set_size(ph_spacer, 1, 1);
+    for (uint32_t i = 0; i < POOL; ++i) {
+        create_cell(i);
+    }
+
+    lv_timer_t *timer = lv_timer_create(update_photos, 50, nullptr);
+    lv_obj_add_event_cb(scr, photos_delete_handler, LV_EVENT_DELETE, timer);
+    ph_phase = Phase::WaitCard;
+    step_phase();
+    load(scr);
+}
+
+} // namespace Screens
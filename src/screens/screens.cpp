@@ -0,0 +1,69 @@
+/**
+ * Screen plumbing shared by the secondary screens.
+ */
+#include "screens.h"
+
+static lv_obj_t *home_screen = nullptr;
+
+static void back_btn_event_handler(lv_event_t *e) {
+    Screens::goHome();
+}
+
+namespace Screens {
+
+void init(lv_obj_t *home) {
+    home_screen = home;
+}
+
+void goHome() {
+    load(home_screen);
+}
+
+void load(lv_obj_t *scr) {
+    lv_obj_t *old = lv_screen_active();
+    if (old == scr) return;
+    lv_screen_load(scr);
+    // Async: we are usually inside an event of the old screen
+    if (old != home_screen) {
+        lv_obj_delete_async(old);
+    }
+}
+
+lv_obj_t *createScreen(const char *title) {
+    lv_obj_t *scr = lv_obj_create(nullptr);
+    lv_obj_set_style_bg_color(scr, lv_color_hex(0x000000), LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, LV_PART_MAIN);
+
+    lv_obj_t *title_label = lv_label_create(scr);
+    lv_label_set_text(title_label, title);
+    lv_obj_set_style_text_color(title_label, lv_color_hex(COLOR_WHITE), 0);
+    lv_obj_set_style_text_font(title_label, &Inter_30, 0);
+    lv_obj_align(title_label, LV_ALIGN_TOP_MID, 0, 20);
+
+    lv_obj_t *back_btn = lv_btn_create(scr);
+    lv_obj_set_size(back_btn, 200, 50);
+    lv_obj_align(back_btn, LV_ALIGN_BOTTOM_MID, 0, -20);
+    lv_obj_set_style_bg_color(back_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(back_btn, 0, 0);
+    lv_obj_set_style_radius(back_btn, 10, 0);
+    lv_obj_add_event_cb(back_btn, back_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *back_label = lv_label_create(back_btn);
+    lv_label_set_text(back_label, LV_SYMBOL_LEFT " Back");
+    lv_obj_set_style_text_font(back_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(back_label);
+    return scr;
+}
+
+lv_obj_t *backButton(lv_obj_t *scr) {
+    // Created second by createScreen(), after the title
+    return lv_obj_get_child(scr, 1);
+}
+
+void setBackAction(lv_obj_t *scr, lv_event_cb_t cb) {
+    lv_obj_t *btn = backButton(scr);
+    lv_obj_remove_event_cb(btn, back_btn_event_handler);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, nullptr);
+}
+
+} // namespace Screens
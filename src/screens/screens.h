@@ -0,0 +1,78 @@
+#pragma once
+#include <lvgl.h>
+
+// ───────── Visuals (shared with the main screen) ─────────
+#define COLOR_GREY_BTN   0x666666
+#define COLOR_GREY_TEXT  0xAAAAAA
+#define COLOR_ORANGE     0xFF7F1F
+#define COLOR_GREEN      0x4CAF50
+#define COLOR_WHITE      0xFFFFFF
+#define COLOR_RED        0xFF6B6B
+#define COLOR_PURE_GREEN 0x00FF00  // Pure green for NeoPixel
+
+extern const lv_font_t Inter_30;
+extern const lv_font_t Inter_20;
+
+/**
+ * Secondary screens (Tools menu, card job progress, ...).
+ * Each show*() builds a fresh screen and loads it; the screen it replaces is
+ * freed, except the main screen which lives for the whole run.
+ */
+namespace Screens {
+
+    void init(lv_obj_t *home);
+
+    // Back to the main screen
+    void goHome();
+
+    // Tools menu
+    void showTools();
+
+    // Cluster allocation map
+    void showSpaceMap();
+
+    // Treemap of space per folder
+    void showTreemap();
+
+    // File browser, opened on a folder of the card
+    void showBrowser(const char *path = "/");
+
+    // Grid of JPEG thumbnails of a folder
+    void showPhotos(const char *path);
+
+    // Text / hex view of a file, or of the card's sectors (path nullptr)
+    void showViewer(const char *path);
+
+    // Find files by name, from the name index
+    void showSearch();
+
+    // Job-specific content shown under the progress stats, in the area
+    // JOB_PANEL_Y .. JOB_PANEL_Y + JOB_PANEL_H of the job screen
+    static constexpr int32_t JOB_PANEL_Y = 262;
+    static constexpr int32_t JOB_PANEL_H = 160;
+    struct JobPanel {
+        void (*create)(lv_obj_t *scr);
+        void (*update)();               // with every progress refresh
+    };
+
+    // Progress of the running (or last) CardJob
+    void showJob(const char *title, const JobPanel *panel = nullptr);
+
+    // Panels of specific jobs
+    extern const JobPanel surfaceScanPanel;   // per-region speed map
+    extern const JobPanel deletedScanPanel;   // latest deleted entries found
+    extern const JobPanel fragPanel;          // most fragmented large files
+    extern const JobPanel dupPanel;           // sets of identical files, most space first
+    extern const JobPanel mountDiffPanel;     // folders the last USB session changed
+
+    // ───────── Helpers for screen files ─────────
+    // Black screen with a title and a "Back" button at the bottom
+    lv_obj_t *createScreen(const char *title);
+    // Load scr and free the previous non-home screen
+    void load(lv_obj_t *scr);
+    // Bottom button of a screen made by createScreen()
+    lv_obj_t *backButton(lv_obj_t *scr);
+    // Make the back button run cb instead of going home
+    void setBackAction(lv_obj_t *scr, lv_event_cb_t cb);
+
+} // namespace Screens
@@ -0,0 +1,263 @@
+/**
+ * Find files: type part of a name, matches from NameIndex show as you type.
+ * On opening, the index is checked against the card: the one in memory is
+ * kept if it still matches, else the saved one is loaded if that does;
+ * Scan rebuilds it (the "folder sizes" walk). Tap a folder to browse it, a
+ * file to open it in the viewer.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <NameIndex.h>
+#include <SpaceTree.h>
+
+static constexpr int32_t LIST_W       = 390;
+static constexpr int32_t LIST_Y       = 140;
+static constexpr int32_t LIST_H       = 270;
+static constexpr int32_t ROW_H        = 44;
+static constexpr uint32_t MAX_RESULTS = 30;   // rows shown, the label counts all
+
+enum class Phase { WaitCard, Loading, Scanning, Ready, NoIndex };
+
+struct Row {
+    lv_obj_t *obj;
+    lv_obj_t *icon;
+    lv_obj_t *name;
+    lv_obj_t *detail;
+};
+
+static lv_obj_t *fs_area;
+static lv_obj_t *fs_keyboard;
+static lv_obj_t *fs_list;
+static lv_obj_t *fs_info_label;
+static Row rows[MAX_RESULTS];
+static uint32_t fs_hits[MAX_RESULTS];   // NameIndex rows
+static uint32_t fs_generation;          // of the index fs_hits came from
+static Phase fs_phase;
+
+static void run_search() {
+    const char *text = lv_textarea_get_text(fs_area);
+    fs_generation = NameIndex::generation();
+    const uint32_t total = *text ? NameIndex::search(text, fs_hits, MAX_RESULTS) : 0;
+    const uint32_t shown = min(total, MAX_RESULTS);
+    char path[FatVolume::MAX_PATH];
+    for (uint32_t i = 0; i < MAX_RESULTS; ++i) {
+        if (i >= shown) {
+            lv_obj_add_flag(rows[i].obj, LV_OBJ_FLAG_HIDDEN);
+            continue;
+        }
+        // Name on the left, its folder on the right
+        NameIndex::path(fs_hits[i], path, sizeof(path));
+        char *slash = strrchr(path, '/');
+        lv_label_set_text(rows[i].icon, NameIndex::isDir(fs_hits[i]) ? LV_SYMBOL_DIRECTORY : LV_SYMBOL_FILE);
+        if (slash) {
+            lv_label_set_text(rows[i].name, slash + 1);
+            slash[slash == path ? 1 : 0] = '\0';
+            lv_label_set_text(rows[i].detail, path);
+        } else {
+            // Empty or cut short: show what there is
+            lv_label_set_text(rows[i].name, path);
+            lv_label_set_text(rows[i].detail, "");
+        }
+        lv_obj_remove_flag(rows[i].obj, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_obj_scroll_to_y(fs_list, 0, LV_ANIM_OFF);
+    if (!*text) {
+        lv_label_set_text_fmt(fs_info_label, "%u names indexed", (unsigned)NameIndex::count());
+    } else if (total > shown) {
+        lv_label_set_text_fmt(fs_info_label, "First %u of %u matches", (unsigned)shown, (unsigned)total);
+    } else {
+        lv_label_set_text_fmt(fs_info_label, "%u matches", (unsigned)total);
+    }
+}
+
+static void set_phase(Phase phase) {
+    fs_phase = phase;
+    if (phase == Phase::Ready) {
+        lv_obj_remove_state(fs_area, LV_STATE_DISABLED);
+        lv_obj_remove_flag(fs_keyboard, LV_OBJ_FLAG_HIDDEN);
+        run_search();
+    } else {
+        lv_obj_add_state(fs_area, LV_STATE_DISABLED);
+        lv_obj_add_flag(fs_keyboard, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+static void area_event_handler(lv_event_t *e) {
+    if (fs_phase != Phase::Ready) {
+        return;
+    }
+    if (lv_event_get_code(e) == LV_EVENT_VALUE_CHANGED) {
+        run_search();
+    } else {
+        lv_obj_remove_flag(fs_keyboard, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+// OK and the close key both hide the keyboard, uncovering the results
+static void keyboard_event_handler(lv_event_t *e) {
+    lv_obj_add_flag(fs_keyboard, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void row_event_handler(lv_event_t *e) {
+    const uint32_t i = (uintptr_t)lv_event_get_user_data(e);
+    if (!NameIndex::ready() || NameIndex::generation() != fs_generation) {
+        return;   // being rebuilt or reloaded from the console; update_search redoes the list
+    }
+    char path[FatVolume::MAX_PATH];
+    NameIndex::path(fs_hits[i], path, sizeof(path));
+    if (NameIndex::isDir(fs_hits[i])) {
+        Screens::showBrowser(path);
+    } else {
+        Screens::showViewer(path);
+    }
+}
+
+static void scan_btn_event_handler(lv_event_t *e) {
+    if (fs_phase == Phase::Loading || fs_phase == Phase::Scanning) {
+        return;
+    }
+    if (!SpaceTree::start()) {
+        lv_label_set_text(fs_info_label, "Card busy or missing (unmount USB first)");
+        return;
+    }
+    set_phase(Phase::Scanning);
+}
+
+static void update_search(lv_timer_t *t) {
+    const CardJob::Status st = CardJob::status();
+    switch (fs_phase) {
+    case Phase::WaitCard:
+        if (CardJob::busy()) {
+            lv_label_set_text(fs_info_label, "Waiting for the card...");
+        } else if (NameIndex::load()) {
+            lv_label_set_text(fs_info_label, "Checking the index against the card...");
+            set_phase(Phase::Loading);
+        } else {
+            lv_label_set_text(fs_info_label, "Card busy or missing (unmount USB first)");
+            set_phase(Phase::NoIndex);
+        }
+        break;
+    case Phase::Loading:
+    case Phase::Scanning:
+        if (NameIndex::ready()) {
+            set_phase(Phase::Ready);
+        } else if (st.running) {
+            if (fs_phase == Phase::Scanning) {
+                lv_label_set_text_fmt(fs_info_label, "Scanning... %u files", (unsigned)st.items);
+            }
+        } else {
+            lv_label_set_text(fs_info_label, st.message);
+            set_phase(Phase::NoIndex);
+        }
+        break;
+    case Phase::Ready:
+        if (NameIndex::ready() && NameIndex::generation() != fs_generation) {
+            run_search();   // rebuilt or reloaded meanwhile: the rows name other entries
+        }
+        break;
+    case Phase::NoIndex:
+        break;
+    }
+}
+
+static void search_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+}
+
+static void create_row(uint32_t i) {
+    Row &row = rows[i];
+    row.obj = lv_obj_create(fs_list);
+    lv_obj_remove_style_all(row.obj);
+    lv_obj_set_size(row.obj, LIST_W, ROW_H);
+    lv_obj_set_y(row.obj, i * ROW_H);
+    lv_obj_set_style_bg_color(row.obj, lv_color_hex(COLOR_GREY_BTN), LV_STATE_PRESSED);
+    lv_obj_set_style_bg_opa(row.obj, LV_OPA_COVER, LV_STATE_PRESSED);
+    lv_obj_set_style_border_color(row.obj, lv_color_hex(0x333333), 0);
+    lv_obj_set_style_border_width(row.obj, 1, 0);
+    lv_obj_set_style_border_side(row.obj, LV_BORDER_SIDE_BOTTOM, 0);
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(row.obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(row.obj, row_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)i);
+
+    row.icon = lv_label_create(row.obj);
+    lv_obj_set_style_text_color(row.icon, lv_color_hex(COLOR_ORANGE), 0);
+    lv_obj_set_style_text_font(row.icon, &lv_font_montserrat_16, 0);
+    lv_obj_align(row.icon, LV_ALIGN_LEFT_MID, 8, 0);
+
+    row.name = lv_label_create(row.obj);
+    lv_label_set_long_mode(row.name, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(row.name, 190);
+    lv_obj_set_style_text_color(row.name, lv_color_hex(COLOR_WHITE), 0);
+    lv_obj_set_style_text_font(row.name, &lv_font_montserrat_16, 0);
+    lv_obj_align(row.name, LV_ALIGN_LEFT_MID, 38, 0);
+
+    row.detail = lv_label_create(row.obj);
+    lv_label_set_long_mode(row.detail, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(row.detail, 150);
+    lv_obj_set_style_text_align(row.detail, LV_TEXT_ALIGN_RIGHT, 0);
+    lv_obj_set_style_text_color(row.detail, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(row.detail, &lv_font_montserrat_14, 0);
+    lv_obj_align(row.detail, LV_ALIGN_RIGHT_MID, -8, 0);
+}
+
+namespace Screens {
+
+void showSearch() {
+    lv_obj_t *scr = createScreen("Find files");
+    lv_obj_set_width(backButton(scr), 180);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+
+    fs_area = lv_textarea_create(scr);
+    lv_textarea_set_one_line(fs_area, true);
+    lv_textarea_set_max_length(fs_area, 63);
+    lv_textarea_set_placeholder_text(fs_area, "Part of a name");
+    lv_obj_set_width(fs_area, LIST_W);
+    lv_obj_align(fs_area, LV_ALIGN_TOP_MID, 0, 65);
+    lv_obj_add_event_cb(fs_area, area_event_handler, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_add_event_cb(fs_area, area_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    fs_info_label = lv_label_create(scr);
+    lv_label_set_text(fs_info_label, "");
+    lv_obj_set_style_text_color(fs_info_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(fs_info_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(fs_info_label, LV_ALIGN_TOP_MID, 0, LIST_Y - 22);
+
+    fs_list = lv_obj_create(scr);
+    lv_obj_remove_style_all(fs_list);
+    lv_obj_set_size(fs_list, LIST_W, LIST_H);
+    lv_obj_align(fs_list, LV_ALIGN_TOP_MID, 0, LIST_Y);
+    lv_obj_set_scroll_dir(fs_list, LV_DIR_VER);
+    lv_obj_set_style_bg_color(fs_list, lv_color_hex(COLOR_GREY_BTN), LV_PART_SCROLLBAR);
+    lv_obj_set_style_bg_opa(fs_list, LV_OPA_COVER, LV_PART_SCROLLBAR);
+    lv_obj_set_style_width(fs_list, 4, LV_PART_SCROLLBAR);
+    for (uint32_t i = 0; i < MAX_RESULTS; ++i) {
+        create_row(i);
+    }
+
+    lv_obj_t *scan_btn = lv_btn_create(scr);
+    lv_obj_set_size(scan_btn, 180, 50);
+    lv_obj_align(scan_btn, LV_ALIGN_BOTTOM_RIGHT, -15, -20);
+    lv_obj_set_style_bg_color(scan_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(scan_btn, 0, 0);
+    lv_obj_set_style_radius(scan_btn, 10, 0);
+    lv_obj_add_event_cb(scan_btn, scan_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *scan_label = lv_label_create(scan_btn);
+    lv_label_set_text(scan_label, LV_SYMBOL_REFRESH " Scan");
+    lv_obj_set_style_text_font(scan_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(scan_label);
+
+    // Over the results and the footer while typing
+    fs_keyboard = lv_keyboard_create(scr);
+    lv_keyboard_set_textarea(fs_keyboard, fs_area);
+    lv_obj_add_event_cb(fs_keyboard, keyboard_event_handler, LV_EVENT_READY, nullptr);
+    lv_obj_add_event_cb(fs_keyboard, keyboard_event_handler, LV_EVENT_CANCEL, nullptr);
+
+    // A USB session or another card may have made the index stale
+    set_phase(Phase::WaitCard);
+    lv_timer_t *timer = lv_timer_create(update_search, 200, nullptr);
+    lv_obj_add_event_cb(scr, search_delete_handler, LV_EVENT_DELETE, timer);
+    load(scr);
+}
+
+} // namespace Screens
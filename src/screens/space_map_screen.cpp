@@ -0,0 +1,124 @@
+/**
+ * Space map: the card's clusters in order, left to right and top to bottom,
+ * one 2×2 cell per slice of the volume, brighter where more of it is used.
+ * Built by SpaceMap from the allocation table when the screen opens; tap the
+ * map to build it again.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <SpaceMap.h>
+#include <esp_heap_caps.h>
+
+#define COLOR_MAP_FREE 0x1A1A2E
+
+static constexpr int32_t MAP_W   = 390;
+static constexpr int32_t MAP_H   = 320;
+static constexpr int32_t MAP_Y   = 70;
+static constexpr int32_t CELL_PX = 2;
+static constexpr uint32_t CELLS  = (MAP_W / CELL_PX) * (MAP_H / CELL_PX);
+
+static lv_obj_t *map_canvas;
+static lv_obj_t *map_label;
+static uint16_t *map_buf;
+static bool map_drawn;
+
+static uint16_t rgb565(uint32_t hex) {
+    return ((hex >> 8) & 0xF800) | ((hex >> 5) & 0x07E0) | ((hex >> 3) & 0x001F);
+}
+
+// Free .. fully used as a ramp from dark blue to orange
+static uint16_t density_color(uint8_t d) {
+    uint32_t rgb = 0;
+    for (int shift = 0; shift <= 16; shift += 8) {
+        const int32_t c0 = (COLOR_MAP_FREE >> shift) & 0xFF, c1 = (COLOR_ORANGE >> shift) & 0xFF;
+        rgb |= (uint32_t)(c0 + (c1 - c0) * d / 255) << shift;
+    }
+    return rgb565(rgb);
+}
+
+static void draw_map() {
+    const SpaceMap::Summary s = SpaceMap::summary();
+    const uint8_t *density = SpaceMap::density();
+    uint16_t ramp[256];
+    for (int i = 0; i < 256; ++i) {
+        ramp[i] = density_color(i);
+    }
+
+    const int32_t cols = MAP_W / CELL_PX;
+    memset(map_buf, 0, MAP_W * MAP_H * sizeof(uint16_t));
+    for (uint32_t i = 0; i < s.cells; ++i) {
+        const uint16_t color = ramp[density[i]];
+        uint16_t *p = map_buf + (i / cols) * CELL_PX * MAP_W + (i % cols) * CELL_PX;
+        for (int32_t y = 0; y < CELL_PX; ++y, p += MAP_W) {
+            for (int32_t x = 0; x < CELL_PX; ++x) {
+                p[x] = color;
+            }
+        }
+    }
+    lv_obj_invalidate(map_canvas);
+
+    lv_label_set_text_fmt(map_label, "%.1f%% used of %.1f GB, %u KB clusters\nlargest free run %.1f MB",
+                          100.0 * s.used / s.clusters, (double)s.clusters * s.clusterBytes / 1e9,
+                          (unsigned)(s.clusterBytes / 1024), (double)s.largestFree * s.clusterBytes / 1048576.0);
+}
+
+static void build_map() {
+    const bool started = SpaceMap::start(CELLS);
+    map_drawn = !started;
+    lv_label_set_text(map_label, started ? "Reading allocation table..." : "Card busy or missing (unmount USB first)");
+}
+
+static void update_space_map(lv_timer_t *t) {
+    if (map_drawn || CardJob::busy()) {
+        return;
+    }
+    if (SpaceMap::summary().valid) {
+        map_drawn = true;
+        draw_map();
+    } else if (CardJob::status().name && !CardJob::status().ok) {
+        map_drawn = true;
+        lv_label_set_text(map_label, CardJob::status().message);
+    }
+}
+
+static void map_event_handler(lv_event_t *e) {
+    if (map_drawn) {
+        build_map();
+    }
+}
+
+static void space_map_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+    heap_caps_free(map_buf);
+    map_buf = nullptr;
+}
+
+namespace Screens {
+
+void showSpaceMap() {
+    map_buf = (uint16_t *)heap_caps_malloc(MAP_W * MAP_H * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (!map_buf) {
+        return;
+    }
+    lv_obj_t *scr = createScreen("Space map");
+    memset(map_buf, 0, MAP_W * MAP_H * sizeof(uint16_t));
+    map_canvas = lv_canvas_create(scr);
+    lv_canvas_set_buffer(map_canvas, map_buf, MAP_W, MAP_H, LV_COLOR_FORMAT_RGB565);
+    lv_obj_align(map_canvas, LV_ALIGN_TOP_MID, 0, MAP_Y);
+    lv_obj_add_flag(map_canvas, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(map_canvas, map_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    map_label = lv_label_create(scr);
+    lv_obj_set_width(map_label, MAP_W);
+    lv_obj_set_style_text_align(map_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(map_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(map_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(map_label, LV_ALIGN_TOP_MID, 0, MAP_Y + MAP_H + 4);
+
+    lv_timer_t *timer = lv_timer_create(update_space_map, 100, nullptr);
+    lv_obj_add_event_cb(scr, space_map_delete_handler, LV_EVENT_DELETE, timer);
+    build_map();
+    load(scr);
+}
+
+} // namespace Screens
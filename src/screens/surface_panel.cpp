@@ -0,0 +1,105 @@
+/**
+ * Surface scan panel for the job screen: one cell per card region, coloured
+ * by read speed relative to the median, red where sectors failed to read.
+ */
+#include "screens.h"
+#include <SurfaceScan.h>
+#include <esp_heap_caps.h>
+
+#define COLOR_CELL_EMPTY   0x333333
+#define COLOR_CELL_SLOWISH 0xFFC107
+#define COLOR_CELL_ERROR   0xFF0000
+
+static constexpr int32_t MAP_W = 370;
+static constexpr int32_t MAP_H = Screens::JOB_PANEL_H - 24;   // legend below
+
+static lv_obj_t *map_canvas;
+static uint16_t *map_buf;
+static uint32_t map_regions;   // layout the canvas was drawn for
+static int32_t map_cols;
+static int32_t map_cell;       // pitch in pixels (1px gap included)
+
+static void map_delete_handler(lv_event_t *e) {
+    heap_caps_free(map_buf);
+    map_buf = nullptr;
+    map_canvas = nullptr;
+}
+
+static uint16_t rgb565(uint32_t hex) {
+    return ((hex >> 8) & 0xF800) | ((hex >> 5) & 0x07E0) | ((hex >> 3) & 0x001F);
+}
+
+static void fill_cell(uint32_t i, uint16_t color) {
+    const int32_t x0 = (i % map_cols) * map_cell;
+    const int32_t y0 = (i / map_cols) * map_cell;
+    for (int32_t y = y0; y < y0 + map_cell - 1 && y < MAP_H; ++y) {
+        uint16_t *row = map_buf + y * MAP_W;
+        for (int32_t x = x0; x < x0 + map_cell - 1; ++x) {
+            row[x] = color;
+        }
+    }
+}
+
+static void layout_map(uint32_t regions) {
+    map_regions = regions;
+    // Largest square cell that fits every region
+    map_cell = 2;
+    while (true) {
+        const int32_t next = map_cell + 1;
+        if ((MAP_W / next) * (MAP_H / next) < (int32_t)regions) break;
+        map_cell = next;
+    }
+    map_cols = MAP_W / map_cell;
+    memset(map_buf, 0, MAP_W * MAP_H * sizeof(uint16_t));
+}
+
+static void create_surface_panel(lv_obj_t *scr) {
+    map_regions = 0;
+    map_buf = (uint16_t *)heap_caps_malloc(MAP_W * MAP_H * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    if (!map_buf) {
+        return;
+    }
+    memset(map_buf, 0, MAP_W * MAP_H * sizeof(uint16_t));
+    map_canvas = lv_canvas_create(scr);
+    lv_canvas_set_buffer(map_canvas, map_buf, MAP_W, MAP_H, LV_COLOR_FORMAT_RGB565);
+    lv_obj_align(map_canvas, LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y);
+    lv_obj_add_event_cb(map_canvas, map_delete_handler, LV_EVENT_DELETE, nullptr);
+
+    lv_obj_t *legend = lv_label_create(scr);
+    lv_label_set_text(legend, "vs median:  green ok  yellow <85%  orange <60%  red errors");
+    lv_obj_set_style_text_color(legend, lv_color_hex(0x999999), 0);
+    lv_obj_set_style_text_font(legend, &lv_font_montserrat_14, 0);
+    lv_obj_align(legend, LV_ALIGN_TOP_MID, 0, Screens::JOB_PANEL_Y + MAP_H + 6);
+}
+
+static void update_surface_panel() {
+    const uint32_t regions = SurfaceScan::regionCount();
+    if (!map_canvas || !regions) {
+        return;
+    }
+    if (regions != map_regions) {
+        layout_map(regions);
+    }
+
+    const SurfaceScan::Region *reg = SurfaceScan::regions();
+    const float median = SurfaceScan::medianMbps();
+    for (uint32_t i = 0; i < regions; ++i) {
+        uint32_t color = COLOR_CELL_EMPTY;
+        if (reg[i].badSectors) {
+            color = COLOR_CELL_ERROR;
+        } else if (reg[i].mbps > 0) {
+            const float rel = median > 0 ? reg[i].mbps / median : 1.0f;
+            color = rel >= 0.85f && !reg[i].slowBlocks ? COLOR_GREEN
+                  : rel >= 0.60f ? COLOR_CELL_SLOWISH
+                  : COLOR_ORANGE;
+        }
+        fill_cell(i, rgb565(color));
+    }
+    lv_obj_invalidate(map_canvas);
+}
+
+namespace Screens {
+
+const JobPanel surfaceScanPanel = { create_surface_panel, update_surface_panel };
+
+} // namespace Screens
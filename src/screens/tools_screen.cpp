@@ -0,0 +1,145 @@
+/**
+ * Tools menu: on-device card jobs. Each entry starts a CardJob and switches
+ * to the progress screen, or says why it could not start.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <DeletedScan.h>
+#include <DupScan.h>
+#include <FakeCheck.h>
+#include <FragScan.h>
+#include <FsCheck.h>
+#include <HashJob.h>
+#include <QuickFormat.h>
+#include <SecureErase.h>
+#include <SurfaceScan.h>
+
+struct Tool {
+    const char *icon;
+    const char *label;
+    bool (*start)();                    // false if the card is busy/missing
+    const Screens::JobPanel *panel;     // extra content on the job screen
+    const char *confirm;                // writes to the card: asked before starting
+};
+
+static const Tool TOOLS[] = {
+    { LV_SYMBOL_OK,      "Hash files (SHA-256)",  [] { return HashJob::start(Digest::Algo::Sha256); }, nullptr, nullptr },
+    { LV_SYMBOL_OK,      "Hash files (xxHash32)", [] { return HashJob::start(Digest::Algo::Xxh32); },  nullptr, nullptr },
+    { LV_SYMBOL_OK,      "Hash files (CRC32)",    [] { return HashJob::start(Digest::Algo::Crc32); },  nullptr, nullptr },
+    { LV_SYMBOL_DRIVE,   "Surface scan",          SurfaceScan::start, &Screens::surfaceScanPanel, nullptr },
+    { LV_SYMBOL_WARNING, "Fake capacity (free space)",
+      [] { return FakeCheck::start(FakeCheck::Mode::FreeSpace); }, nullptr, nullptr },
+    { LV_SYMBOL_WARNING, "Fake capacity (whole card)",
+      [] { return FakeCheck::start(FakeCheck::Mode::Destructive); }, nullptr,
+      "Tests every sector of the card.\nALL DATA ON THE CARD WILL BE ERASED\nand it will need formatting." },
+    { LV_SYMBOL_LIST,    "Check file system",     [] { return FsCheck::start(false); }, nullptr, nullptr },
+    { LV_SYMBOL_SETTINGS, "Repair file system",   [] { return FsCheck::start(true); }, nullptr,
+      "Frees lost clusters and cuts or shortens\nfiles whose chains don't match their size.\nBack up important files first." },
+    { LV_SYMBOL_LOOP,    "Find deleted files",    DeletedScan::start, &Screens::deletedScanPanel, nullptr },
+    { LV_SYMBOL_SHUFFLE, "Fragmentation / defrag", FragScan::start, &Screens::fragPanel, nullptr },
+    { LV_SYMBOL_COPY,    "Find duplicate files",  DupScan::start, &Screens::dupPanel, nullptr },
+    { LV_SYMBOL_TRASH,   "Quick format",          [] { return QuickFormat::start(); }, nullptr,
+      "New FAT32 (up to 32 GB) or exFAT volume.\nALL DATA ON THE CARD WILL BE LOST." },
+    { LV_SYMBOL_TRASH,   "Secure erase",          SecureErase::start, nullptr,
+      "Erases every block of the card.\nALL DATA WILL BE DESTROYED\nand it will need formatting." },
+};
+
+// Tools with a screen of their own, which runs their job
+struct View {
+    const char *icon;
+    const char *label;
+    void (*show)();
+};
+
+static const View VIEWS[] = {
+    { LV_SYMBOL_IMAGE,   "Space map",             Screens::showSpaceMap },
+    { LV_SYMBOL_DIRECTORY, "Space by folder",     Screens::showTreemap },
+    { LV_SYMBOL_FILE,    "Browse files",          [] { Screens::showBrowser("/"); } },
+    { LV_SYMBOL_LIST,    "Find files",            Screens::showSearch },
+    { LV_SYMBOL_EYE_OPEN, "View card sectors",    [] { Screens::showViewer(nullptr); } },
+};
+
+static lv_obj_t *tools_msg_label;
+static lv_obj_t *confirm_box = nullptr;
+static const Tool *last_tool = nullptr;
+
+static void start_tool(const Tool *tool) {
+    if (!tool->start()) {
+        lv_label_set_text(tools_msg_label, "Card busy or missing (unmount USB first)");
+        return;
+    }
+    last_tool = tool;
+    Screens::showJob(tool->label, tool->panel);
+}
+
+static void confirm_btn_event_handler(lv_event_t *e) {
+    const Tool *tool = (const Tool *)lv_event_get_user_data(e);
+    lv_msgbox_close_async(confirm_box);   // we are inside one of its buttons' events
+    confirm_box = nullptr;
+    if (tool) start_tool(tool);
+}
+
+static void tool_btn_event_handler(lv_event_t *e) {
+    const Tool *tool = (const Tool *)lv_event_get_user_data(e);
+    if (CardJob::busy()) {
+        lv_label_set_text(tools_msg_label, "A job is already running");
+        return;
+    }
+    if (!tool->confirm) {
+        start_tool(tool);
+        return;
+    }
+    confirm_box = lv_msgbox_create(nullptr);
+    lv_msgbox_add_title(confirm_box, tool->label);
+    lv_msgbox_add_text(confirm_box, tool->confirm);
+    lv_obj_t *btn = lv_msgbox_add_footer_button(confirm_box, "Start");
+    lv_obj_set_style_bg_color(btn, lv_color_hex(COLOR_RED), 0);
+    lv_obj_add_event_cb(btn, confirm_btn_event_handler, LV_EVENT_CLICKED, (void *)tool);
+    btn = lv_msgbox_add_footer_button(confirm_box, "Cancel");
+    lv_obj_add_event_cb(btn, confirm_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+}
+
+static void view_btn_event_handler(lv_event_t *e) {
+    const View *view = (const View *)lv_event_get_user_data(e);
+    if (CardJob::busy()) {
+        lv_label_set_text(tools_msg_label, "A job is already running");
+        return;
+    }
+    view->show();
+}
+
+static void job_status_btn_event_handler(lv_event_t *e) {
+    Screens::showJob(last_tool->label, last_tool->panel);
+}
+
+namespace Screens {
+
+void showTools() {
+    lv_obj_t *scr = createScreen("Tools");
+
+    lv_obj_t *list = lv_list_create(scr);
+    lv_obj_set_size(list, 370, 300);
+    lv_obj_align(list, LV_ALIGN_TOP_MID, 0, 70);
+    for (const Tool &tool : TOOLS) {
+        lv_obj_t *btn = lv_list_add_button(list, tool.icon, tool.label);
+        lv_obj_add_event_cb(btn, tool_btn_event_handler, LV_EVENT_CLICKED, (void *)&tool);
+    }
+    for (const View &view : VIEWS) {
+        lv_obj_t *btn = lv_list_add_button(list, view.icon, view.label);
+        lv_obj_add_event_cb(btn, view_btn_event_handler, LV_EVENT_CLICKED, (void *)&view);
+    }
+    if (last_tool) {
+        lv_obj_t *btn = lv_list_add_button(list, LV_SYMBOL_LIST, "Last job status");
+        lv_obj_add_event_cb(btn, job_status_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+    }
+
+    tools_msg_label = lv_label_create(scr);
+    lv_label_set_text(tools_msg_label, "");
+    lv_obj_set_style_text_color(tools_msg_label, lv_color_hex(COLOR_RED), 0);
+    lv_obj_set_style_text_font(tools_msg_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(tools_msg_label, LV_ALIGN_BOTTOM_MID, 0, -85);
+
+    load(scr);
+}
+
+} // namespace Screens
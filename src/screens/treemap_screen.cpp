@@ -0,0 +1,293 @@
+/**
+ * Space by folder: a squarified treemap of one folder level at a time from
+ * SpaceTree. The largest subfolders get a tile each, the folder's own files
+ * and the remaining small subfolders one tile each. Tap a folder tile to
+ * drill down, Up to go back a level. Only the visible level is ever laid
+ * out, so the tree's size doesn't matter.
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <SpaceTree.h>
+
+#define COLOR_TILE_FILES 0x555555
+#define COLOR_TILE_OTHER 0x333333
+
+static constexpr int32_t MAP_W     = 390;
+static constexpr int32_t MAP_H     = 300;
+static constexpr int32_t MAP_Y     = 95;
+static constexpr uint32_t MAX_DIRS = 24;   // folder tiles per level
+
+static const char FILES_LABEL[] = "Files";
+static const char OTHER_LABEL[] = "Other folders";
+static const uint32_t PALETTE[] = { 0x1E88E5, 0x43A047, 0xFB8C00, 0x8E24AA, 0x00ACC1, 0xE53935, 0x7CB342, 0x5E35B1 };
+
+struct Tile {
+    uint32_t node;     // SpaceTree::NONE for "files" and "other"
+    uint64_t bytes;
+    const char *label;
+};
+
+struct Rect {
+    float x, y, w, h;
+};
+
+static lv_obj_t *tm_area;
+static lv_obj_t *tm_path_label;
+static lv_obj_t *tm_info_label;
+static uint32_t tm_dir = SpaceTree::NONE;   // shown folder, NONE while scanning
+static uint32_t tm_generation;               // of the tree tm_dir and the tiles belong to
+static bool tm_scanning;
+static Tile tiles[MAX_DIRS + 2];
+static Rect rects[MAX_DIRS + 2];
+static uint32_t tile_count;
+
+// Largest subfolders (insertion into a short sorted array), then the rest
+static void collect_tiles(uint32_t dir) {
+    const SpaceTree::Node &d = SpaceTree::node(dir);
+    uint64_t own = d.bytes, rest = 0;
+    tile_count = 0;
+    for (uint32_t c = d.firstChild; c != SpaceTree::NONE; c = SpaceTree::node(c).nextSibling) {
+        const uint64_t bytes = SpaceTree::node(c).bytes;
+        own -= bytes;
+        if (!bytes) {
+            continue;
+        }
+        uint32_t pos = tile_count;
+        while (pos > 0 && tiles[pos - 1].bytes < bytes) {
+            pos--;
+        }
+        if (pos >= MAX_DIRS) {
+            rest += bytes;
+            continue;
+        }
+        if (tile_count == MAX_DIRS) {
+            rest += tiles[MAX_DIRS - 1].bytes;
+        } else {
+            tile_count++;
+        }
+        memmove(&tiles[pos + 1], &tiles[pos], (tile_count - 1 - pos) * sizeof(Tile));
+        tiles[pos] = { c, bytes, SpaceTree::name(c) };
+    }
+    const Tile extra[] = { { SpaceTree::NONE, own, FILES_LABEL }, { SpaceTree::NONE, rest, OTHER_LABEL } };
+    for (const Tile &t : extra) {
+        if (!t.bytes) {
+            continue;
+        }
+        uint32_t pos = tile_count++;
+        for (; pos > 0 && tiles[pos - 1].bytes < t.bytes; --pos) {
+            tiles[pos] = tiles[pos - 1];
+        }
+        tiles[pos] = t;
+    }
+}
+
+// Squarified layout (Bruls et al.): fill rows along the short side while the
+// worst aspect ratio in the row keeps improving. Tiles are sorted largest first.
+static void squarify(Rect r) {
+    double total = 0;
+    for (uint32_t i = 0; i < tile_count; ++i) {
+        total += tiles[i].bytes;
+    }
+    const double scale = r.w * r.h / total;
+    uint32_t i = 0;
+    while (i < tile_count) {
+        const double side = min(r.w, r.h);
+        const double largest = tiles[i].bytes * scale;
+        double sum = 0, worst = 1e30;
+        uint32_t j = i;
+        while (j < tile_count) {
+            const double a = tiles[j].bytes * scale, s = sum + a;
+            const double ratio = max(side * side * largest / (s * s), s * s / (side * side * a));
+            if (j > i && ratio > worst) {
+                break;
+            }
+            worst = ratio;
+            sum = s;
+            j++;
+        }
+        const float thick = sum / side;
+        float pos = 0;
+        for (uint32_t k = i; k < j; ++k) {
+            const float len = tiles[k].bytes * scale / thick;
+            rects[k] = r.w >= r.h ? Rect{ r.x, r.y + pos, thick, len } : Rect{ r.x + pos, r.y, len, thick };
+            pos += len;
+        }
+        if (r.w >= r.h) {
+            r.x += thick;
+            r.w -= thick;
+        } else {
+            r.y += thick;
+            r.h -= thick;
+        }
+        i = j;
+    }
+}
+
+static void show_dir(uint32_t dir);
+
+// The shown tree is still the one in SpaceTree (a scan from the console or
+// Find files replaces it)
+static bool tree_current() {
+    return tm_dir != SpaceTree::NONE && SpaceTree::ready() && SpaceTree::generation() == tm_generation;
+}
+
+static void tile_event_handler(lv_event_t *e) {
+    if (tree_current()) {
+        show_dir((uint32_t)(uintptr_t)lv_event_get_user_data(e));
+    }
+}
+
+static void up_btn_event_handler(lv_event_t *e) {
+    if (tree_current() && SpaceTree::node(tm_dir).parent != SpaceTree::NONE) {
+        show_dir(SpaceTree::node(tm_dir).parent);
+    }
+}
+
+static void set_path_label(uint32_t dir) {
+    // Walk up to the root, then print the names top-down
+    uint32_t chain[16];
+    uint32_t n = 0;
+    for (uint32_t d = dir; d != SpaceTree::ROOT && n < 16; d = SpaceTree::node(d).parent) {
+        chain[n++] = d;
+    }
+    char path[128] = "/";
+    size_t len = 1;
+    while (n-- > 0 && len < sizeof(path) - 1) {
+        len += snprintf(path + len, sizeof(path) - len, "%s%s", SpaceTree::name(chain[n]), n ? "/" : "");
+    }
+    lv_label_set_text(tm_path_label, path);
+}
+
+static void show_dir(uint32_t dir) {
+    tm_dir = dir;
+    tm_generation = SpaceTree::generation();
+    lv_obj_clean(tm_area);
+    set_path_label(dir);
+    const SpaceTree::Node &d = SpaceTree::node(dir);
+    lv_label_set_text_fmt(tm_info_label, "%.1f MB in %u files, %u folders", d.bytes / 1048576.0,
+                          (unsigned)d.files, (unsigned)d.dirs);
+
+    collect_tiles(dir);
+    if (!tile_count) {
+        lv_obj_t *empty = lv_label_create(tm_area);
+        lv_label_set_text(empty, "Empty");
+        lv_obj_set_style_text_color(empty, lv_color_hex(COLOR_GREY_TEXT), 0);
+        lv_obj_center(empty);
+        return;
+    }
+    squarify({ 0, 0, MAP_W, MAP_H });
+
+    for (uint32_t i = 0; i < tile_count; ++i) {
+        const Tile &t = tiles[i];
+        const int32_t x = (int32_t)(rects[i].x + 0.5f), y = (int32_t)(rects[i].y + 0.5f);
+        const int32_t w = (int32_t)(rects[i].x + rects[i].w + 0.5f) - x;
+        const int32_t h = (int32_t)(rects[i].y + rects[i].h + 0.5f) - y;
+        const uint32_t color = t.node != SpaceTree::NONE ? PALETTE[i % (sizeof(PALETTE) / sizeof(PALETTE[0]))]
+                             : t.label == FILES_LABEL ? COLOR_TILE_FILES
+                             : COLOR_TILE_OTHER;
+
+        lv_obj_t *tile = lv_obj_create(tm_area);
+        lv_obj_remove_style_all(tile);
+        lv_obj_set_pos(tile, x, y);
+        lv_obj_set_size(tile, w, h);
+        lv_obj_set_style_bg_color(tile, lv_color_hex(color), 0);
+        lv_obj_set_style_bg_opa(tile, LV_OPA_COVER, 0);
+        lv_obj_set_style_border_color(tile, lv_color_hex(0x000000), 0);
+        lv_obj_set_style_border_width(tile, 1, 0);
+        lv_obj_remove_flag(tile, LV_OBJ_FLAG_SCROLLABLE);
+        if (t.node != SpaceTree::NONE && SpaceTree::node(t.node).bytes) {
+            lv_obj_add_flag(tile, LV_OBJ_FLAG_CLICKABLE);
+            lv_obj_add_event_cb(tile, tile_event_handler, LV_EVENT_CLICKED, (void *)(uintptr_t)t.node);
+        }
+
+        if (w >= 48 && h >= 34) {
+            lv_obj_t *label = lv_label_create(tile);
+            lv_label_set_long_mode(label, LV_LABEL_LONG_DOT);
+            lv_obj_set_width(label, w - 8);
+            lv_label_set_text_fmt(label, "%s\n%.1f MB", t.label, t.bytes / 1048576.0);
+            lv_obj_set_style_text_color(label, lv_color_hex(COLOR_WHITE), 0);
+            lv_obj_set_style_text_font(label, &lv_font_montserrat_14, 0);
+            lv_obj_align(label, LV_ALIGN_TOP_LEFT, 4, 3);
+        }
+    }
+}
+
+static void update_treemap(lv_timer_t *t) {
+    if (tm_dir != SpaceTree::NONE && !tree_current()) {
+        // Rescanned elsewhere: drop the tiles, show the new tree when ready
+        tm_dir = SpaceTree::NONE;
+        tm_scanning = true;
+        lv_obj_clean(tm_area);
+        lv_label_set_text(tm_path_label, "");
+    }
+    if (!tm_scanning || tm_dir != SpaceTree::NONE) {
+        return;
+    }
+    const CardJob::Status st = CardJob::status();
+    if (SpaceTree::ready()) {
+        show_dir(SpaceTree::ROOT);
+    } else if (st.running) {
+        lv_label_set_text_fmt(tm_info_label, "Scanning... %u files", (unsigned)st.items);
+    } else {
+        tm_scanning = false;
+        lv_label_set_text(tm_info_label, st.message);
+    }
+}
+
+static void treemap_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+}
+
+namespace Screens {
+
+void showTreemap() {
+    lv_obj_t *scr = createScreen("Space by folder");
+    lv_obj_set_width(backButton(scr), 180);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+
+    tm_path_label = lv_label_create(scr);
+    lv_label_set_text(tm_path_label, "");
+    lv_label_set_long_mode(tm_path_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(tm_path_label, MAP_W);
+    lv_obj_set_style_text_align(tm_path_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(tm_path_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(tm_path_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(tm_path_label, LV_ALIGN_TOP_MID, 0, 65);
+
+    tm_area = lv_obj_create(scr);
+    lv_obj_remove_style_all(tm_area);
+    lv_obj_set_size(tm_area, MAP_W, MAP_H);
+    lv_obj_align(tm_area, LV_ALIGN_TOP_MID, 0, MAP_Y);
+    lv_obj_remove_flag(tm_area, LV_OBJ_FLAG_SCROLLABLE);
+
+    tm_info_label = lv_label_create(scr);
+    lv_label_set_text(tm_info_label, "");
+    lv_obj_set_style_text_color(tm_info_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(tm_info_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(tm_info_label, LV_ALIGN_TOP_MID, 0, MAP_Y + MAP_H + 6);
+
+    lv_obj_t *up_btn = lv_btn_create(scr);
+    lv_obj_set_size(up_btn, 180, 50);
+    lv_obj_align(up_btn, LV_ALIGN_BOTTOM_RIGHT, -15, -20);
+    lv_obj_set_style_bg_color(up_btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(up_btn, 0, 0);
+    lv_obj_set_style_radius(up_btn, 10, 0);
+    lv_obj_add_event_cb(up_btn, up_btn_event_handler, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *up_label = lv_label_create(up_btn);
+    lv_label_set_text(up_label, LV_SYMBOL_UP " Up");
+    lv_obj_set_style_text_font(up_label, &lv_font_montserrat_16, 0);
+    lv_obj_center(up_label);
+
+    // Sizes change with every mount session: scan again each time
+    tm_dir = SpaceTree::NONE;
+    tm_scanning = SpaceTree::start();
+    if (!tm_scanning) {
+        lv_label_set_text(tm_info_label, "Card busy or missing (unmount USB first)");
+    }
+    lv_timer_t *timer = lv_timer_create(update_treemap, 200, nullptr);
+    lv_obj_add_event_cb(scr, treemap_delete_handler, LV_EVENT_DELETE, timer);
+    load(scr);
+}
+
+} // namespace Screens
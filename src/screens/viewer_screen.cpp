@@ -0,0 +1,463 @@
+/**
+ * Viewer: a file as text or hex, or the card's sectors as hex. FileView
+ * reads pages on demand on its job task; this screen keeps just the offset
+ * of the top line and lays out the lines on screen from the bytes after it,
+ * so a 4 GB log costs the same as a 4 KB one. Drag to scroll, the slider to
+ * seek by percentage, Go to for an offset (a sector on the card view).
+ */
+#include "screens.h"
+#include <CardJob.h>
+#include <FatVolume.h>
+#include <FileView.h>
+
+static constexpr int32_t TEXT_W      = 390;
+static constexpr int32_t TEXT_Y      = 92;
+static constexpr int32_t LINE_H      = 18;
+static constexpr uint32_t LINES      = 15;
+static constexpr uint32_t COLS       = 48;          // unscii 16 is 8 px wide
+static constexpr uint32_t TAB        = 4;
+static constexpr uint32_t HEX_BYTES  = 8;           // per hex line
+static constexpr uint32_t WINDOW     = LINES * COLS * 2;   // bytes laid out for one screen (CRs, tabs)
+static constexpr uint32_t BACK_BYTES = 2048;        // searched back for the start of a line
+static constexpr int32_t SLIDER_MAX  = 1000;
+
+enum class Phase : uint8_t { WaitCard, Open, Stopped };
+
+static lv_obj_t *vw_lines[LINES];
+static lv_obj_t *vw_info_label;
+static lv_obj_t *vw_slider;
+static lv_obj_t *vw_mode_label;
+static lv_obj_t *vw_goto_panel;
+static lv_obj_t *vw_goto_area;
+static char vw_path[FatVolume::MAX_PATH];
+static bool vw_card;           // the card's sectors, not a file
+static Phase vw_phase;
+static bool vw_hex;
+static bool vw_detect;         // text or hex not chosen yet
+static bool vw_snap;           // vw_top must move back to the start of its line
+static uint64_t vw_top;        // offset of the top line
+static int32_t vw_drag;        // drag not turned into lines yet
+static uint8_t vw_buf[WINDOW];
+static uint8_t vw_back[BACK_BYTES];
+
+// One screen line of text from p: up to COLS columns, ended by a newline or
+// wrapped. Returns the bytes it takes; complete is false if the data ran out
+// first (and isn't the end of the file).
+static uint32_t layout_line(const uint8_t *p, uint32_t n, bool end, char *out, bool *complete) {
+    uint32_t col = 0, i = 0;
+    *complete = true;
+    while (true) {
+        if (i == n) {
+            *complete = end;
+            break;
+        }
+        const uint8_t c = p[i++];
+        if (c == '\n') {
+            break;
+        }
+        if (c == '\r') {
+            continue;
+        }
+        const uint32_t w = c == '\t' ? TAB - col % TAB : 1;
+        for (uint32_t k = 0; k < w && out; ++k) {
+            out[col + k] = c == '\t' ? ' ' : (c >= 0x20 && c < 0x7F) ? (char)c : '.';
+        }
+        col += w;
+        if (col == COLS) {
+            // A line break right after a full line belongs to it
+            if (i < n && p[i] == '\r') i++;
+            if (i < n && p[i] == '\n') i++;
+            break;
+        }
+    }
+    if (out) {
+        out[col] = '\0';
+    }
+    return i;
+}
+
+// Start of the last text line before limit; false while its bytes are read
+static bool line_start_before(uint64_t limit, uint64_t *start) {
+    if (limit == 0) {
+        *start = 0;
+        return true;
+    }
+    const uint64_t begin = limit > BACK_BYTES ? limit - BACK_BYTES : 0;
+    const uint32_t len = limit - begin;
+    if (FileView::read(begin, vw_back, len) < len) {
+        return false;
+    }
+    // After the newline before the one that may end the line at limit - 1
+    uint32_t pos = len - 1;
+    while (pos > 0 && vw_back[pos - 1] != '\n') {
+        pos--;
+    }
+    bool complete;
+    while (true) {
+        const uint32_t n = layout_line(vw_back + pos, len - pos, true, nullptr, &complete);
+        if (pos + n >= len) {
+            break;
+        }
+        pos += n;
+    }
+    *start = begin + pos;
+    return true;
+}
+
+static bool line_down() {
+    const uint64_t size = FileView::info().size;
+    if (vw_hex) {
+        if (vw_top + HEX_BYTES >= size) {
+            return false;
+        }
+        vw_top += HEX_BYTES;
+        return true;
+    }
+    const uint32_t got = FileView::read(vw_top, vw_buf, 2 * COLS + 2);
+    bool complete;
+    const uint32_t n = layout_line(vw_buf, got, vw_top + got >= size, nullptr, &complete);
+    if (!complete || vw_top + n >= size) {
+        return false;
+    }
+    vw_top += n;
+    return true;
+}
+
+static bool line_up() {
+    if (vw_top == 0) {
+        return false;
+    }
+    if (vw_hex) {
+        vw_top -= HEX_BYTES;
+        return true;
+    }
+    return line_start_before(vw_top, &vw_top);
+}
+
+static void seek(uint64_t offset) {
+    const uint64_t size = FileView::info().size;
+    if (!size) {
+        return;
+    }
+    vw_top = min<uint64_t>(offset, size - 1);
+    if (vw_hex) {
+        vw_top -= vw_top % HEX_BYTES;
+    } else {
+        vw_snap = true;
+    }
+}
+
+static void render_text(uint64_t size) {
+    const uint32_t got = FileView::read(vw_top, vw_buf, WINDOW);
+    const bool end = vw_top + got >= size;
+    uint32_t pos = 0;
+    bool waiting = false;
+    char line[COLS + 1];
+    for (uint32_t i = 0; i < LINES; ++i) {
+        line[0] = '\0';
+        if (pos < got && !waiting) {
+            bool complete;
+            pos += layout_line(vw_buf + pos, got - pos, end, line, &complete);
+            waiting = !complete;
+        } else if (!end && !waiting) {
+            strcpy(line, "...");   // page still being read
+            waiting = true;
+        }
+        lv_label_set_text(vw_lines[i], line);
+    }
+}
+
+static void render_hex(uint64_t size) {
+    const uint32_t got = FileView::read(vw_top, vw_buf, LINES * HEX_BYTES);
+    char line[COLS + 1];
+    for (uint32_t i = 0; i < LINES; ++i) {
+        const uint64_t off = vw_top + i * HEX_BYTES;
+        const uint32_t at = i * HEX_BYTES;
+        if (off >= size) {
+            line[0] = '\0';
+        } else if (at >= got) {
+            snprintf(line, sizeof(line), "%010llX ...", (unsigned long long)off);
+        } else {
+            const uint32_t n = min(HEX_BYTES, got - at);
+            int len = snprintf(line, sizeof(line), "%010llX", (unsigned long long)off);
+            for (uint32_t k = 0; k < HEX_BYTES; ++k) {
+                len += k < n ? snprintf(line + len, sizeof(line) - len, " %02X", vw_buf[at + k])
+                             : snprintf(line + len, sizeof(line) - len, "   ");
+            }
+            line[len++] = ' ';
+            for (uint32_t k = 0; k < n; ++k) {
+                const uint8_t c = vw_buf[at + k];
+                line[len++] = c >= 0x20 && c < 0x7F ? (char)c : '.';
+            }
+            line[len] = '\0';
+        }
+        lv_label_set_text(vw_lines[i], line);
+    }
+}
+
+static void render() {
+    const FileView::Info in = FileView::info();
+    if (vw_hex) {
+        render_hex(in.size);
+    } else {
+        render_text(in.size);
+    }
+    if (!lv_obj_has_state(vw_slider, LV_STATE_PRESSED)) {
+        lv_slider_set_value(vw_slider, in.size ? vw_top * SLIDER_MAX / in.size : 0, LV_ANIM_OFF);
+    }
+
+    const float pct = in.size ? vw_top * 100.0f / in.size : 0;
+    char errors[24] = "";
+    if (in.readErrors) {
+        snprintf(errors, sizeof(errors), ", %u read errors", (unsigned)in.readErrors);
+    }
+    if (vw_card) {
+        lv_label_set_text_fmt(vw_info_label, "Sector %u of %u (%.1f%%)%s", (unsigned)(vw_top / 512),
+                              (unsigned)(in.size / 512), pct, errors);
+        return;
+    }
+    const uint16_t d = in.mtime >> 16, t = in.mtime & 0xFFFF;
+    lv_label_set_text_fmt(vw_info_label, "%.1f%% of %.1f MB, %04u-%02u-%02u %02u:%02u%s%s", pct,
+                          in.size / 1048576.0, 1980 + (d >> 9), (d >> 5) & 15, d & 31, t >> 11, (t >> 5) & 63,
+                          in.failed ? ", chain broken" : "", errors);
+}
+
+static void set_mode(bool hex) {
+    vw_hex = hex;
+    lv_label_set_text(vw_mode_label, hex ? "Text" : "Hex");
+    seek(vw_top);
+}
+
+static void text_event_handler(lv_event_t *e) {
+    if (vw_phase != Phase::Open || !FileView::info().ready) {
+        return;
+    }
+    if (lv_event_get_code(e) == LV_EVENT_PRESSED) {
+        vw_drag = 0;
+        return;
+    }
+    // Finger up = further into the file
+    lv_point_t v;
+    lv_indev_get_vect(lv_indev_active(), &v);
+    vw_drag += v.y;
+    while (vw_drag <= -LINE_H && line_down()) {
+        vw_drag += LINE_H;
+    }
+    while (vw_drag >= LINE_H && line_up()) {
+        vw_drag -= LINE_H;
+    }
+    if (vw_drag <= -LINE_H || vw_drag >= LINE_H) {
+        vw_drag = 0;   // at an end, or the lines aren't read yet
+    }
+    render();
+}
+
+static void slider_event_handler(lv_event_t *e) {
+    const FileView::Info in = FileView::info();
+    const int32_t v = lv_slider_get_value(vw_slider);
+    if (lv_event_get_code(e) == LV_EVENT_VALUE_CHANGED) {
+        lv_label_set_text_fmt(vw_info_label, "Go to %.1f%%", v * 100.0f / SLIDER_MAX);
+        return;
+    }
+    seek(in.size * v / SLIDER_MAX);
+    render();
+}
+
+static void mode_btn_event_handler(lv_event_t *e) {
+    vw_detect = false;
+    set_mode(!vw_hex);
+    render();
+}
+
+static void goto_event_handler(lv_event_t *e) {
+    if (lv_event_get_code(e) == LV_EVENT_READY) {
+        const uint64_t v = strtoull(lv_textarea_get_text(vw_goto_area), nullptr, 10);
+        seek(vw_card ? v * 512 : v);
+        render();
+    }
+    lv_obj_delete_async(vw_goto_panel);   // we are inside its keyboard's event
+    vw_goto_panel = nullptr;
+}
+
+static void goto_btn_event_handler(lv_event_t *e) {
+    if (vw_goto_panel || vw_phase != Phase::Open) {
+        return;
+    }
+    vw_goto_panel = lv_obj_create(lv_screen_active());
+    lv_obj_set_size(vw_goto_panel, 410, 502);
+    lv_obj_center(vw_goto_panel);
+    lv_obj_set_style_bg_color(vw_goto_panel, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_border_width(vw_goto_panel, 0, 0);
+    lv_obj_set_style_radius(vw_goto_panel, 0, 0);
+    lv_obj_remove_flag(vw_goto_panel, LV_OBJ_FLAG_SCROLLABLE);
+
+    vw_goto_area = lv_textarea_create(vw_goto_panel);
+    lv_textarea_set_one_line(vw_goto_area, true);
+    lv_textarea_set_accepted_chars(vw_goto_area, "0123456789");
+    lv_textarea_set_max_length(vw_goto_area, 20);
+    lv_textarea_set_placeholder_text(vw_goto_area, vw_card ? "Sector" : "Byte offset");
+    lv_obj_set_width(vw_goto_area, 360);
+    lv_obj_align(vw_goto_area, LV_ALIGN_TOP_MID, 0, 80);
+
+    lv_obj_t *kb = lv_keyboard_create(vw_goto_panel);
+    lv_keyboard_set_mode(kb, LV_KEYBOARD_MODE_NUMBER);
+    lv_keyboard_set_textarea(kb, vw_goto_area);
+    lv_obj_add_event_cb(kb, goto_event_handler, LV_EVENT_READY, nullptr);
+    lv_obj_add_event_cb(kb, goto_event_handler, LV_EVENT_CANCEL, nullptr);
+}
+
+static void back_event_handler(lv_event_t *e) {
+    FileView::stop();
+    if (vw_card) {
+        Screens::goHome();
+        return;
+    }
+    // Back to the file's folder
+    char dir[FatVolume::MAX_PATH];
+    strlcpy(dir, vw_path, sizeof(dir));
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        slash[slash == dir ? 1 : 0] = '\0';
+    }
+    Screens::showBrowser(dir);
+}
+
+static void update_viewer(lv_timer_t *t) {
+    if (vw_phase == Phase::WaitCard) {
+        if (CardJob::busy()) {
+            lv_label_set_text(vw_info_label, "Waiting for the card...");
+            return;
+        }
+        if (!FileView::start(vw_card ? nullptr : vw_path)) {
+            vw_phase = Phase::Stopped;
+            lv_label_set_text(vw_info_label, "Card busy or missing (unmount USB first)");
+            return;
+        }
+        vw_phase = Phase::Open;
+        lv_label_set_text(vw_info_label, "Opening...");
+    }
+    if (vw_phase != Phase::Open) {
+        return;
+    }
+    if (!FileView::running()) {
+        vw_phase = Phase::Stopped;
+        lv_label_set_text(vw_info_label, CardJob::status().message);
+        return;
+    }
+    const FileView::Info in = FileView::info();
+    if (!in.ready) {
+        return;
+    }
+    if (vw_detect) {
+        // Binary if the start has NUL bytes
+        const uint32_t want = min<uint64_t>(512, in.size);
+        const uint32_t got = FileView::read(0, vw_buf, want);
+        if (got < want) {
+            return;
+        }
+        vw_detect = false;
+        set_mode(memchr(vw_buf, 0, got) != nullptr);
+    }
+    if (vw_snap && line_start_before(vw_top + 1, &vw_top)) {
+        vw_snap = false;
+    }
+    // Lines still waiting for their pages
+    render();
+}
+
+static void viewer_delete_handler(lv_event_t *e) {
+    lv_timer_delete((lv_timer_t *)lv_event_get_user_data(e));
+    FileView::stop();
+    vw_goto_panel = nullptr;
+}
+
+static lv_obj_t *footer_button(lv_obj_t *scr, lv_align_t align, int32_t x, const char *text, lv_event_cb_t cb) {
+    lv_obj_t *btn = lv_btn_create(scr);
+    lv_obj_set_size(btn, 120, 50);
+    lv_obj_align(btn, align, x, -20);
+    lv_obj_set_style_bg_color(btn, lv_color_hex(COLOR_GREY_BTN), 0);
+    lv_obj_set_style_border_width(btn, 0, 0);
+    lv_obj_set_style_radius(btn, 10, 0);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, nullptr);
+
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, text);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_16, 0);
+    lv_obj_center(label);
+    return label;
+}
+
+namespace Screens {
+
+void showViewer(const char *path) {
+    vw_card = !path;
+    strlcpy(vw_path, path ? path : "", sizeof(vw_path));
+    lv_obj_t *scr = createScreen(vw_card ? "Card sectors" : "Viewer");
+    lv_obj_set_width(backButton(scr), 120);
+    lv_obj_align(backButton(scr), LV_ALIGN_BOTTOM_LEFT, 15, -20);
+    setBackAction(scr, back_event_handler);
+
+    lv_obj_t *path_label = lv_label_create(scr);
+    lv_label_set_text(path_label, vw_card ? "Whole card, raw" : vw_path);
+    lv_label_set_long_mode(path_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(path_label, TEXT_W);
+    lv_obj_set_style_text_align(path_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(path_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(path_label, &lv_font_montserrat_16, 0);
+    lv_obj_align(path_label, LV_ALIGN_TOP_MID, 0, 65);
+
+    // Fixed lines; scrolling changes their text, never the objects
+    lv_obj_t *text = lv_obj_create(scr);
+    lv_obj_remove_style_all(text);
+    lv_obj_set_size(text, TEXT_W, LINES * LINE_H);
+    lv_obj_align(text, LV_ALIGN_TOP_MID, 0, TEXT_Y);
+    lv_obj_remove_flag(text, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(text, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(text, text_event_handler, LV_EVENT_PRESSED, nullptr);
+    lv_obj_add_event_cb(text, text_event_handler, LV_EVENT_PRESSING, nullptr);
+    for (uint32_t i = 0; i < LINES; ++i) {
+        vw_lines[i] = lv_label_create(text);
+        lv_label_set_text(vw_lines[i], "");
+        lv_label_set_long_mode(vw_lines[i], LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(vw_lines[i], TEXT_W);
+        lv_obj_set_style_text_color(vw_lines[i], lv_color_hex(COLOR_WHITE), 0);
+        lv_obj_set_style_text_font(vw_lines[i], &lv_font_unscii_16, 0);
+        lv_obj_set_pos(vw_lines[i], 0, i * LINE_H);
+    }
+
+    vw_info_label = lv_label_create(scr);
+    lv_label_set_text(vw_info_label, "");
+    lv_label_set_long_mode(vw_info_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_width(vw_info_label, TEXT_W);
+    lv_obj_set_style_text_align(vw_info_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_set_style_text_color(vw_info_label, lv_color_hex(COLOR_GREY_TEXT), 0);
+    lv_obj_set_style_text_font(vw_info_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(vw_info_label, LV_ALIGN_TOP_MID, 0, TEXT_Y + LINES * LINE_H + 6);
+
+    vw_slider = lv_slider_create(scr);
+    lv_slider_set_range(vw_slider, 0, SLIDER_MAX);
+    lv_obj_set_width(vw_slider, TEXT_W - 30);
+    lv_obj_align(vw_slider, LV_ALIGN_TOP_MID, 0, TEXT_Y + LINES * LINE_H + 36);
+    lv_obj_set_style_bg_color(vw_slider, lv_color_hex(COLOR_ORANGE), LV_PART_INDICATOR);
+    lv_obj_set_style_bg_color(vw_slider, lv_color_hex(COLOR_ORANGE), LV_PART_KNOB);
+    lv_obj_add_event_cb(vw_slider, slider_event_handler, LV_EVENT_VALUE_CHANGED, nullptr);
+    lv_obj_add_event_cb(vw_slider, slider_event_handler, LV_EVENT_RELEASED, nullptr);
+
+    vw_mode_label = footer_button(scr, LV_ALIGN_BOTTOM_MID, 0, "Hex", mode_btn_event_handler);
+    footer_button(scr, LV_ALIGN_BOTTOM_RIGHT, -15, LV_SYMBOL_RIGHT " Go to", goto_btn_event_handler);
+
+    vw_phase = Phase::WaitCard;
+    vw_hex = vw_card;
+    vw_detect = !vw_card;
+    vw_snap = false;
+    vw_top = 0;
+    vw_drag = 0;
+    vw_goto_panel = nullptr;
+    set_mode(vw_hex);
+    lv_timer_t *timer = lv_timer_create(update_viewer, 50, nullptr);
+    lv_obj_add_event_cb(scr, viewer_delete_handler, LV_EVENT_DELETE, timer);
+    update_viewer(timer);
+    load(scr);
+}
+
+} // namespace Screens